@@ -0,0 +1,187 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <SDL.h>
+#include <glm/glm.hpp>
+#include "gl_core_3_3.h"
+#include "util.h"
+#include "instance.h"
+#include "headless.h"
+#include "shader_variants.h"
+
+/*
+ * Small helpers shared by the benchmark programs
+ */
+namespace bench {
+	/*
+	 * Wall clock timer, starts timing when constructed
+	 */
+	class Timer {
+		std::chrono::high_resolution_clock::time_point start;
+
+	public:
+		Timer() : start(std::chrono::high_resolution_clock::now()){}
+		void reset(){
+			start = std::chrono::high_resolution_clock::now();
+		}
+		double elapsed_ms() const {
+			return std::chrono::duration<double, std::milli>(
+				std::chrono::high_resolution_clock::now() - start).count();
+		}
+	};
+	/*
+	 * Get the value of a "--name value" argument as an int, returns
+	 * the default passed if the argument wasn't given
+	 */
+	inline long long arg_int(int argc, char **argv, const std::string &name, long long def){
+		for (int i = 1; i < argc - 1; ++i){
+			if (name == argv[i]){
+				return std::atoll(argv[i + 1]);
+			}
+		}
+		return def;
+	}
+	//Check if a "--name" flag was passed
+	inline bool arg_flag(int argc, char **argv, const std::string &name){
+		for (int i = 1; i < argc; ++i){
+			if (name == argv[i]){
+				return true;
+			}
+		}
+		return false;
+	}
+	/*
+	 * A GL 3.3 core context for benchmarks that need to talk to the driver but
+	 * don't present anything. It's made on a hidden window, or if headless is
+	 * set or there's no display to make one on, through the same EGL context
+	 * --headless uses with a width x height framebuffer left bound in place
+	 * of the window's
+	 */
+	struct GLContext {
+		SDL_Window *win;
+		SDL_GLContext context;
+		std::unique_ptr<HeadlessContext> offscreen;
+
+		GLContext() : win(nullptr), context(nullptr){}
+		bool create(int width = 640, int height = 480, bool headless = false){
+			if (headless || !create_window(width, height)){
+				if (!headless){
+					std::cerr << "No window to render to, using a headless context\n";
+				}
+				offscreen.reset(new HeadlessContext{});
+				if (!offscreen->create(width, height)){
+					return false;
+				}
+			}
+			util::setup_shader_compiler();
+			std::cout << "OpenGL Renderer: " << glGetString(GL_RENDERER) << "\n";
+			return true;
+		}
+		~GLContext(){
+			offscreen.reset();
+			destroy_window();
+		}
+
+	private:
+		bool create_window(int width, int height){
+			if (SDL_Init(SDL_INIT_VIDEO) != 0){
+				std::cerr << "SDL_Init error: " << SDL_GetError() << "\n";
+				return false;
+			}
+			SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+			SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+			SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+			win = SDL_CreateWindow("bench", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+				width, height, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+			if (!win){
+				std::cerr << "SDL_CreateWindow error: " << SDL_GetError() << "\n";
+				destroy_window();
+				return false;
+			}
+			context = SDL_GL_CreateContext(win);
+			if (!context || ogl_LoadFunctions() == ogl_LOAD_FAILED){
+				std::cerr << "Failed to create GL context: " << SDL_GetError() << "\n";
+				destroy_window();
+				return false;
+			}
+			return true;
+		}
+		void destroy_window(){
+			if (context){
+				SDL_GL_DeleteContext(context);
+				context = nullptr;
+			}
+			if (win){
+				SDL_DestroyWindow(win);
+				win = nullptr;
+			}
+			SDL_Quit();
+		}
+	};
+	/*
+	 * The billboard shaders and uniform buffers setup like run() does them,
+	 * for benchmarks that need to draw billboards. The shaders are built with
+	 * sizes and rotations by default since the benchmarks' instances use them
+	 */
+	struct BillboardPipeline {
+		GLint program;
+		GLuint viewing_buf, color_buf, vao;
+
+		BillboardPipeline() : program(-1), viewing_buf(0), color_buf(0), vao(0){}
+		bool create(VariantKey variant = feature_bit(ShaderFeature::SIZE) | feature_bit(ShaderFeature::ROTATION)){
+			const std::string res_path = VSB_RES_DIR;
+			program = util::load_program({std::make_tuple(GL_VERTEX_SHADER, res_path + "vertex.glsl"),
+				std::make_tuple(GL_FRAGMENT_SHADER, res_path + "fragment.glsl")}, variant_defines(variant));
+			if (program == -1){
+				return false;
+			}
+			glUseProgram(program);
+			glGenBuffers(1, &viewing_buf);
+			glBindBuffer(GL_UNIFORM_BUFFER, viewing_buf);
+			glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4) + 2 * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+			glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Viewing"), 0);
+			glBindBufferBase(GL_UNIFORM_BUFFER, 0, viewing_buf);
+
+			std::vector<glm::vec4> colors(16, glm::vec4{1});
+			glGenBuffers(1, &color_buf);
+			glBindBuffer(GL_UNIFORM_BUFFER, color_buf);
+			glBufferData(GL_UNIFORM_BUFFER, colors.size() * sizeof(glm::vec4), colors.data(), GL_STATIC_DRAW);
+			glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Colors"), 1);
+			glBindBufferBase(GL_UNIFORM_BUFFER, 1, color_buf);
+
+			glGenVertexArrays(1, &vao);
+			glBindVertexArray(vao);
+			glEnable(GL_DEPTH_TEST);
+			return true;
+		}
+		//The viewport is only read by MIN_SIZE variants, its z is the pixel size they grow billboards to
+		void set_view(const glm::mat4 &view, const glm::mat4 &proj, const glm::vec3 &eye,
+			const glm::vec4 &viewport = glm::vec4{0})
+		{
+			glm::mat4 mats[2] = {view, proj};
+			const glm::vec4 vecs[2] = {glm::vec4{eye, 0}, viewport};
+			glBindBuffer(GL_UNIFORM_BUFFER, viewing_buf);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(mats), mats);
+			glBufferSubData(GL_UNIFORM_BUFFER, sizeof(mats), sizeof(vecs), vecs);
+		}
+		~BillboardPipeline(){
+			if (program != -1){
+				glDeleteProgram(program);
+				glDeleteBuffers(1, &viewing_buf);
+				glDeleteBuffers(1, &color_buf);
+				glDeleteVertexArrays(1, &vao);
+			}
+		}
+	};
+}
+
+#endif
+
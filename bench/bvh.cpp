@@ -0,0 +1,96 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <string>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include "util.h"
+#include "instance.h"
+#include "camera.h"
+#include "job_system.h"
+#include "cull.h"
+#include "bvh.h"
+#include "bench_util.h"
+
+/*
+ * Measure the BVH build time, node memory and the per-frame cost of culling
+ * with the BVH compared to linear culling for a few views seeing different
+ * fractions of the scene
+ * usage: bench_bvh [--instances N] [--iters N] [--leaf-size N]
+ */
+struct View {
+	std::string name;
+	Camera camera;
+};
+
+int main(int argc, char **argv){
+	const size_t n = bench::arg_int(argc, argv, "--instances", 10000000);
+	const int iters = bench::arg_int(argc, argv, "--iters", 10);
+	const size_t leaf_size = bench::arg_int(argc, argv, "--leaf-size", 64);
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> pos_dist(-100.f, 100.f);
+	std::vector<Instance> instances(n);
+	for (Instance &i : instances){
+		i = Instance{glm::vec3{pos_dist(rng), pos_dist(rng), pos_dist(rng)}, 0, 1,
+			pack_rgba8(glm::vec4{1}), 0};
+	}
+	JobSystem jobs;
+	BVH bvh;
+	bench::Timer timer;
+	bvh.build(jobs, instances, nullptr, leaf_size);
+	const double build_ms = timer.elapsed_ms();
+	std::cout << std::fixed << std::setprecision(2) << "BVH over " << n << " instances on "
+		<< jobs.size() << " threads\n\tbuild: " << build_ms << "ms\n\tnodes: "
+		<< bvh.node_list().size() << "\n\tnode memory: " << bvh.memory_bytes() / (1024.0 * 1024.0)
+		<< "MB (" << static_cast<double>(bvh.memory_bytes()) / n << " bytes/instance)\n";
+
+	InstanceSoA spheres;
+	spheres.assign(instances.data(), n);
+	std::vector<Instance> out(n);
+	std::vector<DrawRange> ranges;
+	ParallelCuller culler{jobs};
+	const CullISA isa = best_cull_isa();
+	const glm::mat4 proj = glm::perspective<float>(util::deg_to_rad(75.f), 16.f / 9.f, 1, 100);
+	const std::vector<View> views = {
+		View{"center", Camera{glm::vec3{0, 0, 5}, glm::vec3{0, 0, 0}, glm::vec3{0, 1, 0}}},
+		View{"corner", Camera{glm::vec3{90, 90, 110}, glm::vec3{90, 90, 0}, glm::vec3{0, 1, 0}}},
+		View{"outside", Camera{glm::vec3{0, 0, 180}, glm::vec3{0, 0, 0}, glm::vec3{0, 1, 0}}}
+	};
+
+	std::cout << std::left << std::setw(10) << "view" << std::setw(12) << "visible"
+		<< std::setw(14) << "linear (ms)" << std::setw(16) << "traverse (ms)" << std::setw(18)
+		<< "trav + copy (ms)" << std::setw(10) << "nodes" << std::setw(10) << "ranges" << "tested\n";
+	for (const View &v : views){
+		const Frustum frustum = billboard_frustum(v.camera.view_mat(), proj);
+		timer.reset();
+		size_t linear_visible = 0;
+		for (int it = 0; it < iters; ++it){
+			linear_visible = culler.cull(frustum, spheres, instances.data(), n, out.data(), isa);
+		}
+		const double linear_ms = timer.elapsed_ms() / iters;
+
+		BVHCullStats stats;
+		timer.reset();
+		for (int it = 0; it < iters; ++it){
+			bvh.cull(frustum, spheres, ranges, isa, &stats);
+		}
+		const double traverse_ms = timer.elapsed_ms() / iters;
+		timer.reset();
+		for (int it = 0; it < iters; ++it){
+			bvh.cull(frustum, spheres, ranges, isa);
+			copy_ranges(jobs, ranges, instances.data(), out.data());
+		}
+		const double total_ms = timer.elapsed_ms() / iters;
+		if (stats.visible != linear_visible){
+			std::cout << "Mismatch! BVH found " << stats.visible << " visible, linear culling "
+				<< linear_visible << "\n";
+		}
+		std::cout << std::setw(10) << v.name << std::setw(12) << stats.visible << std::setw(14) << linear_ms
+			<< std::setw(16) << traverse_ms << std::setw(18) << total_ms << std::setw(10)
+			<< stats.nodes_visited << std::setw(10) << ranges.size() << stats.instances_tested << "\n";
+	}
+	return 0;
+}
+
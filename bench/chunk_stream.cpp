@@ -0,0 +1,125 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <string>
+#include <cstdio>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include "instance.h"
+#include "cull.h"
+#include "scene_file.h"
+#include "chunk_stream.h"
+#include "frame_stats.h"
+#include "bench_util.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Fly the camera down a long corridor of billboards stored in a scene file
+ * while streaming its chunks through a GPU pool much smaller than the scene.
+ * Compares reading and uploading chunks on the render thread as soon as
+ * they're visible against streaming them with the I/O threads, with and
+ * without prefetching along the view direction. Reports the frame times, the
+ * chunk loads and evictions, and how many visible chunks were missing a frame.
+ * The scene's pages are dropped from the page cache before each run so chunks
+ * are read from disk, scale --instances up past the machine's memory to test
+ * a scene that can't be cached at all
+ * usage: bench_chunk_stream [--instances N] [--chunk N] [--pool-mb N] [--frames N] [--io-threads N] [--dir path] [--headless]
+ */
+namespace {
+	void drop_page_cache(const std::string &file){
+#ifndef _WIN32
+		const int fd = open(file.c_str(), O_RDONLY);
+		if (fd != -1){
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			close(fd);
+		}
+#endif
+	}
+}
+
+int main(int argc, char **argv){
+	const size_t n = bench::arg_int(argc, argv, "--instances", 16000000);
+	const uint32_t chunk_size = bench::arg_int(argc, argv, "--chunk", 16384);
+	const size_t pool_mb = bench::arg_int(argc, argv, "--pool-mb", 32);
+	const int frames = bench::arg_int(argc, argv, "--frames", 600);
+	const unsigned io_threads = bench::arg_int(argc, argv, "--io-threads", 2);
+	std::string dir = "./";
+	for (int i = 1; i < argc - 1; ++i){
+		if (std::string{argv[i]} == "--dir"){
+			dir = argv[i + 1];
+		}
+	}
+	bench::GLContext ctx;
+	if (!ctx.create(640, 480, bench::arg_flag(argc, argv, "--headless"))){
+		return 1;
+	}
+	bench::BillboardPipeline pipeline;
+	if (!pipeline.create()){
+		return 1;
+	}
+	//A corridor along -z, written in z order so each chunk is a thin slab of it
+	const float length = 2000, extent = 20;
+	const std::string scene_file = dir + "bench_chunk_stream.vsbs";
+	{
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> pos_dist(-extent, extent);
+		std::uniform_real_distribution<float> unit_dist(0.f, 1.f);
+		std::uniform_int_distribution<int> id_dist(0, 3);
+		std::vector<Instance> instances(n);
+		for (size_t i = 0; i < n; ++i){
+			const float z = -length * (i + unit_dist(rng)) / n;
+			instances[i] = Instance{glm::vec3{pos_dist(rng), pos_dist(rng), z}, id_dist(rng), 0.05f,
+				pack_rgba8(glm::vec4{unit_dist(rng), unit_dist(rng), unit_dist(rng), 1}), unit_dist(rng)};
+		}
+		if (!write_scene_file(scene_file, instances, chunk_size)){
+			return 1;
+		}
+	}
+	SceneFile scene;
+	if (!scene.open(scene_file, FileAccess::RANDOM)){
+		return 1;
+	}
+	const glm::mat4 proj = glm::perspective<GLfloat>(util::deg_to_rad(75.f), 640.f / 480.f, 0.1f, 30);
+	std::cout << "Streaming " << n << " instances (" << n * sizeof(Instance) / 1e6 << "MB) in "
+		<< scene.chunk_count() << " chunks through a " << pool_mb << "MB pool over " << frames << " frames\n"
+		<< std::left << std::setw(22) << "mode" << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms"
+		<< std::setw(10) << "max ms" << std::setw(8) << "loads" << std::setw(11) << "evictions"
+		<< std::setw(12) << "prefetches" << std::setw(14) << "missing/frame" << "max pending\n"
+		<< std::fixed << std::setprecision(3);
+	const char *names[] = {"sync (render thread)", "async", "async + prefetch"};
+	for (int mode = 0; mode < 3; ++mode){
+		drop_page_cache(scene_file);
+		ChunkStreamer streamer{scene, pool_mb * 1024 * 1024, mode == 0 ? 0 : io_threads,
+			mode == 0 ? size_t{0} : size_t{8 * 1024 * 1024}, mode == 2 ? 30.f : 0.f};
+		std::vector<double> times;
+		size_t max_pending = 0;
+		for (int f = 0; f < frames; ++f){
+			const glm::vec3 eye{0, 0, -length * f / frames};
+			const glm::mat4 view = glm::lookAt(eye, eye + glm::vec3{0, 0, -1}, glm::vec3{0, 1, 0});
+			bench::Timer timer;
+			pipeline.set_view(view, proj, eye);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			streamer.update(eye, glm::vec3{0, 0, -1}, billboard_frustum(view, proj));
+			streamer.upload();
+			streamer.draw();
+			glFinish();
+			times.push_back(timer.elapsed_ms());
+			max_pending = std::max(max_pending, streamer.frame_stats().pending);
+		}
+		const StatSummary s = summarize(times);
+		const ChunkStreamStats &stats = streamer.total_stats();
+		std::cout << std::setw(22) << names[mode] << std::setw(10) << s.p50 << std::setw(10) << s.p99
+			<< std::setw(10) << s.max << std::setw(8) << stats.loads << std::setw(11) << stats.evictions
+			<< std::setw(12) << stats.prefetches << std::setw(14) << stats.missing / static_cast<double>(frames)
+			<< max_pending << "\n";
+	}
+	scene.close();
+	std::remove(scene_file.c_str());
+	return 0;
+}
+
@@ -0,0 +1,64 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include "util.h"
+#include "instance.h"
+#include "camera.h"
+#include "cull.h"
+#include "bench_util.h"
+
+/*
+ * Measure the throughput of the frustum culling kernels for each ISA
+ * supported by this CPU. Instances are scattered uniformly in a cube
+ * around the camera so roughly a fifth of them are visible
+ * usage: bench_cull [--instances N] [--iters N]
+ */
+int main(int argc, char **argv){
+	const size_t n = bench::arg_int(argc, argv, "--instances", 10000000);
+	const int iters = bench::arg_int(argc, argv, "--iters", 10);
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> pos_dist(-100.f, 100.f);
+	std::vector<Instance> instances(n);
+	for (Instance &i : instances){
+		i = Instance{glm::vec3{pos_dist(rng), pos_dist(rng), pos_dist(rng)}, 0, 1,
+			pack_rgba8(glm::vec4{1}), 0};
+	}
+	InstanceSoA spheres;
+	spheres.assign(instances.data(), n);
+	std::vector<uint32_t> indices(n);
+	std::vector<Instance> out(n);
+
+	Camera camera{glm::vec3{0, 0, 5}, glm::vec3{0, 0, 0}, glm::vec3{0, 1, 0}};
+	const glm::mat4 proj = glm::perspective<float>(util::deg_to_rad(75.f), 16.f / 9.f, 1, 100);
+	const Frustum frustum = billboard_frustum(camera.view_mat(), proj);
+
+	std::cout << "Culling " << n << " instances, " << iters << " iterations\n"
+		<< std::left << std::setw(10) << "ISA" << std::setw(12) << "visible"
+		<< std::setw(20) << "spheres (M inst/s)" << "cull + compact (M inst/s)\n"
+		<< std::fixed << std::setprecision(1);
+	for (CullISA isa : {CullISA::SCALAR, CullISA::SSE, CullISA::AVX}){
+		if (!cull_isa_supported(isa)){
+			std::cout << std::setw(10) << cull_isa_name(isa) << "not supported\n";
+			continue;
+		}
+		size_t visible = 0;
+		bench::Timer timer;
+		for (int it = 0; it < iters; ++it){
+			visible = cull_spheres(frustum, spheres, 0, n, indices.data(), isa);
+		}
+		const double sphere_ms = timer.elapsed_ms() / iters;
+		timer.reset();
+		for (int it = 0; it < iters; ++it){
+			cull_instances(frustum, spheres, instances.data(), 0, n, out.data(), isa);
+		}
+		const double compact_ms = timer.elapsed_ms() / iters;
+		std::cout << std::setw(10) << cull_isa_name(isa) << std::setw(12) << visible
+			<< std::setw(20) << n / (sphere_ms * 1e3) << n / (compact_ms * 1e3) << "\n";
+	}
+	return 0;
+}
+
@@ -0,0 +1,84 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <glm/glm.hpp>
+#include "instance.h"
+#include "camera.h"
+#include "job_system.h"
+#include "bvh.h"
+#include "depth_sort.h"
+#include "bench_util.h"
+
+/*
+ * Time sorting instances by view depth with the parallel radix sort for
+ * 1M, 10M and 50M instances, or a single count passed with --instances.
+ * Then compares incremental sorting against full sorts each frame with the camera
+ * moving in the same steps move_camera takes for --frames frames
+ * usage: bench_depth_sort [--instances N] [--iters N] [--frames N]
+ */
+int main(int argc, char **argv){
+	std::vector<size_t> counts = {1000000, 10000000, 50000000};
+	const long long count_arg = bench::arg_int(argc, argv, "--instances", 0);
+	if (count_arg > 0){
+		counts = {static_cast<size_t>(count_arg)};
+	}
+	const int iters = bench::arg_int(argc, argv, "--iters", 5);
+	const int frames = bench::arg_int(argc, argv, "--frames", 60);
+
+	JobSystem jobs;
+	DepthSorter sorter{false};
+	Camera camera{glm::vec3{0, 0, 5}, glm::vec3{0, 0, 0}, glm::vec3{0, 1, 0}};
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> pos_dist(-100.f, 100.f);
+
+	std::cout << "Depth sorting on " << jobs.size() << " threads, " << iters << " iterations\n"
+		<< std::left << std::setw(12) << "instances" << std::setw(16) << "order" << std::setw(12)
+		<< "time (ms)" << "M inst/s\n" << std::fixed << std::setprecision(2);
+	for (size_t n : counts){
+		std::vector<Instance> instances(n);
+		for (Instance &i : instances){
+			i = Instance{glm::vec3{pos_dist(rng), pos_dist(rng), pos_dist(rng)}, 0, 1,
+				pack_rgba8(glm::vec4{1}), 0};
+		}
+		std::vector<Instance> out(n);
+		const std::vector<DrawRange> ranges = {DrawRange{0, static_cast<uint32_t>(n)}};
+		for (SortOrder order : {SortOrder::NONE, SortOrder::FRONT_TO_BACK, SortOrder::BACK_TO_FRONT}){
+			sorter.sort(jobs, camera.view_mat(), instances.data(), ranges, order, out.data());
+			bench::Timer timer;
+			for (int it = 0; it < iters; ++it){
+				sorter.sort(jobs, camera.view_mat(), instances.data(), ranges, order, out.data());
+			}
+			const double ms = timer.elapsed_ms() / iters;
+			std::cout << std::setw(12) << n << std::setw(16) << sort_order_name(order) << std::setw(12) << ms
+				<< n / (ms * 1e3) << "\n";
+		}
+
+		//Fly the camera forward and to the side a step each frame, sorting incrementally
+		//and fully for each frame
+		DepthSorter incremental{true};
+		Camera moving = camera;
+		double full_ms = 0;
+		for (int f = 0; f < frames; ++f){
+			if (f % 2 == 0){
+				moving.zoom(0.3f);
+			}
+			else {
+				moving.strafe_horiz(0.3f);
+			}
+			incremental.sort(jobs, moving.view_mat(), instances.data(), ranges, SortOrder::FRONT_TO_BACK,
+				out.data());
+			bench::Timer timer;
+			sorter.sort(jobs, moving.view_mat(), instances.data(), ranges, SortOrder::FRONT_TO_BACK, out.data());
+			full_ms += timer.elapsed_ms();
+		}
+		const DepthSortStats &stats = incremental.total_stats();
+		std::cout << std::setw(12) << n << std::setw(16) << "incremental" << std::setw(12)
+			<< stats.sort_ms / frames << n / (stats.sort_ms / frames * 1e3) << "\n"
+			<< "\tfull sort: " << full_ms / frames << "ms/frame, incremental: "
+			<< stats.inversions_fixed / frames << " inversions fixed/frame, " << stats.full
+			<< " full sorts of " << frames << " frames, " << stats.saved_ms / frames << "ms/frame saved\n";
+	}
+	return 0;
+}
+
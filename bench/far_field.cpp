@@ -0,0 +1,173 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <array>
+#include <random>
+#include <algorithm>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include "util.h"
+#include "instance.h"
+#include "job_system.h"
+#include "cull.h"
+#include "bvh.h"
+#include "program_cache.h"
+#include "far_field.h"
+#include "frame_stats.h"
+#include "bench_util.h"
+
+/*
+ * Draw a dense field of billboards stretching far away from the camera with
+ * every visible billboard drawn as a quad, then with the ones beyond a few
+ * distances splatted into the far field at full and half resolution instead.
+ * Reports the frame times, the far field's splatting throughput and the image
+ * error against drawing every billboard, both per pixel and after averaging
+ * 4x4 blocks of pixels since the splat matches the billboards' coverage on
+ * average rather than exactly which pixels they hit
+ * usage: bench_far_field [--instances N] [--frames N] [--headless]
+ */
+namespace {
+	struct Mode {
+		std::string name;
+		float distance;
+		int grid_div;
+	};
+	struct ImageError {
+		//Mean absolute error per channel in [0, 255], per pixel and over 4x4 blocks
+		double pixel, block;
+	};
+
+	ImageError image_error(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b, int width, int height){
+		ImageError err{0, 0};
+		for (size_t i = 0; i < a.size(); i += 4){
+			for (size_t c = 0; c < 3; ++c){
+				err.pixel += std::abs(static_cast<int>(a[i + c]) - static_cast<int>(b[i + c]));
+			}
+		}
+		err.pixel /= 3.0 * width * height;
+		for (int by = 0; by < height / 4; ++by){
+			for (int bx = 0; bx < width / 4; ++bx){
+				for (size_t c = 0; c < 3; ++c){
+					int sum_a = 0, sum_b = 0;
+					for (int y = by * 4; y < by * 4 + 4; ++y){
+						for (int x = bx * 4; x < bx * 4 + 4; ++x){
+							sum_a += a[(y * width + x) * 4 + c];
+							sum_b += b[(y * width + x) * 4 + c];
+						}
+					}
+					err.block += std::abs(sum_a - sum_b) / 16.0;
+				}
+			}
+		}
+		err.block /= 3.0 * (width / 4) * (height / 4);
+		return err;
+	}
+}
+
+int main(int argc, char **argv){
+	const size_t n = bench::arg_int(argc, argv, "--instances", 8000000);
+	const int frames = bench::arg_int(argc, argv, "--frames", 30);
+	const int width = 640, height = 480;
+	bench::GLContext ctx;
+	if (!ctx.create(width, height, bench::arg_flag(argc, argv, "--headless"))){
+		return 1;
+	}
+	bench::BillboardPipeline pipeline;
+	if (!pipeline.create()){
+		return 1;
+	}
+	//Colored billboards spread evenly over the frustum from just in front of the camera out
+	//to 200 units away, so most of them are far away like in a large scene
+	std::mt19937 rng(9);
+	std::uniform_real_distribution<float> unit_dist(0.f, 1.f);
+	std::uniform_int_distribution<int> id_dist(0, 3);
+	std::vector<Instance> instances(n);
+	for (Instance &i : instances){
+		const float z = -std::max(200 * std::cbrt(unit_dist(rng)), 2.f);
+		const float extent = -z * 0.8f;
+		i = Instance{glm::vec3{extent * (2 * unit_dist(rng) - 1), extent * (2 * unit_dist(rng) - 1), z},
+			id_dist(rng), 0.1f, pack_rgba8(glm::vec4{unit_dist(rng), unit_dist(rng), unit_dist(rng), 1}),
+			unit_dist(rng)};
+	}
+	JobSystem jobs;
+	BVH bvh;
+	bvh.build(jobs, instances);
+	InstanceSoA spheres;
+	spheres.assign(instances.data(), n);
+	const CullISA isa = best_cull_isa();
+	//The pipeline's sprite colors are all white
+	std::array<glm::vec4, 16> colors;
+	colors.fill(glm::vec4{1});
+
+	GLuint instance_buf;
+	glGenBuffers(1, &instance_buf);
+	glBindBuffer(GL_ARRAY_BUFFER, instance_buf);
+	glBufferData(GL_ARRAY_BUFFER, n * sizeof(Instance), NULL, GL_STREAM_DRAW);
+	std::vector<Instance> visible(n);
+	std::vector<DrawRange> ranges, near;
+	std::vector<uint8_t> reference(width * height * 4), image(width * height * 4);
+
+	const glm::mat4 proj = glm::perspective<float>(util::deg_to_rad(75.f), static_cast<float>(width) / height,
+		1, 1000);
+	const glm::mat4 view = glm::lookAt(glm::vec3{0}, glm::vec3{0, 0, -1}, glm::vec3{0, 1, 0});
+	const Frustum frustum = billboard_frustum(view, proj);
+	pipeline.set_view(view, proj, glm::vec3{0});
+	const std::vector<Mode> modes = {
+		Mode{"all billboards", 0, 1}, Mode{"far > 100", 100, 1}, Mode{"far > 50", 50, 1},
+		Mode{"far > 25", 25, 1}, Mode{"far > 50, half res", 50, 2}, Mode{"far > 25, half res", 25, 2}
+	};
+	std::cout << "Drawing " << n << " instances at " << width << "x" << height << " over " << frames
+		<< " frames on " << jobs.size() << " threads\n" << std::left << std::setw(22) << "mode"
+		<< std::setw(11) << "near" << std::setw(11) << "far" << std::setw(10) << "p50 ms" << std::setw(10)
+		<< "p99 ms" << std::setw(11) << "splat ms" << std::setw(13) << "resolve ms" << std::setw(12)
+		<< "M splats/s" << std::setw(12) << "pixel err" << "4x4 err\n" << std::fixed << std::setprecision(3);
+	//Build the compositing shaders each time, the cache isn't what we're measuring
+	ProgramCache program_cache{""};
+	for (size_t m = 0; m < modes.size(); ++m){
+		const Mode &mode = modes[m];
+		FarFieldSplat far_field{static_cast<size_t>(width / mode.grid_div), static_cast<size_t>(height / mode.grid_div),
+			mode.distance};
+		if (mode.distance > 0 && !far_field.create(program_cache, VSB_RES_DIR)){
+			return 1;
+		}
+		glUseProgram(pipeline.program);
+		std::vector<double> times;
+		size_t n_near = 0;
+		for (int f = 0; f < frames; ++f){
+			bench::Timer timer;
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			bvh.cull(frustum, spheres, ranges, isa);
+			if (mode.distance > 0){
+				far_field.split(ranges, spheres, view, near);
+				far_field.splat(jobs, instances.data(), view, proj, colors);
+				far_field.draw();
+				glDisable(GL_BLEND);
+				glEnable(GL_DEPTH_TEST);
+				glUseProgram(pipeline.program);
+				glBindVertexArray(pipeline.vao);
+			}
+			n_near = copy_ranges(jobs, mode.distance > 0 ? near : ranges, instances.data(), visible.data());
+			glBindBuffer(GL_ARRAY_BUFFER, instance_buf);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, n_near * sizeof(Instance), visible.data());
+			setup_instance_attribs(instance_buf);
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, n_near);
+			glFinish();
+			times.push_back(timer.elapsed_ms());
+		}
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, m == 0 ? reference.data() : image.data());
+		const ImageError err = m == 0 ? ImageError{0, 0} : image_error(reference, image, width, height);
+		const StatSummary s = summarize(times);
+		const FarFieldStats &stats = far_field.total_stats();
+		const double splat_ms = (stats.split_ms + stats.splat_ms) / frames;
+		std::cout << std::setw(22) << mode.name << std::setw(11) << n_near << std::setw(11) << stats.far / frames
+			<< std::setw(10) << s.p50 << std::setw(10) << s.p99 << std::setw(11) << splat_ms << std::setw(13)
+			<< stats.resolve_ms / frames << std::setw(12)
+			<< (splat_ms > 0 ? stats.far / frames / (splat_ms * 1000) : 0.0) << std::setw(12) << err.pixel
+			<< err.block << "\n";
+	}
+	glDeleteBuffers(1, &instance_buf);
+	return 0;
+}
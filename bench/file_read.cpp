@@ -0,0 +1,109 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <random>
+#include <string>
+#include <iterator>
+#include <algorithm>
+#include <cstdio>
+#include "util.h"
+#include "file_view.h"
+#include "frame_stats.h"
+#include "bench_util.h"
+
+/*
+ * Compare reading a large file the way util::read_file used to, copying it
+ * through istreambuf_iterators into a string, against util::read_file's single
+ * sized read and reading a FileView in place front to back and at
+ * random pages. The file is written to --dir and is in the page cache after
+ * it's written, so this measures the cost of the reading path itself and not
+ * the disk. Drop the page cache between runs to include the disk
+ * usage: bench_file_read [--mb N] [--iters N] [--dir path]
+ */
+namespace {
+	//Sum a byte from every cache line so all of the data is read and the reads can't be optimized out
+	uint64_t checksum(const char *data, size_t len){
+		uint64_t sum = 0;
+		for (size_t i = 0; i < len; i += 64){
+			sum += static_cast<unsigned char>(data[i]);
+		}
+		return sum;
+	}
+}
+
+int main(int argc, char **argv){
+	const size_t mb = bench::arg_int(argc, argv, "--mb", 256);
+	const int iters = bench::arg_int(argc, argv, "--iters", 5);
+	std::string dir = "./";
+	for (int i = 1; i < argc - 1; ++i){
+		if (std::string{argv[i]} == "--dir"){
+			dir = argv[i + 1];
+		}
+	}
+	const std::string file = dir + "bench_file_read.bin";
+	const size_t size = mb * 1024 * 1024;
+	{
+		std::mt19937 rng(42);
+		std::vector<uint32_t> chunk(1024 * 1024 / sizeof(uint32_t));
+		std::ofstream out(file, std::ios::binary);
+		for (size_t i = 0; i < mb; ++i){
+			for (uint32_t &c : chunk){
+				c = rng();
+			}
+			out.write(reinterpret_cast<const char*>(chunk.data()), chunk.size() * sizeof(uint32_t));
+		}
+		if (!out){
+			std::cerr << "Failed to write " << file << "\n";
+			return 1;
+		}
+	}
+	const size_t page = 4096;
+	std::vector<size_t> random_pages(size / page);
+	for (size_t i = 0; i < random_pages.size(); ++i){
+		random_pages[i] = i * page;
+	}
+	std::shuffle(random_pages.begin(), random_pages.end(), std::mt19937(7));
+
+	std::cout << "Reading a " << mb << "MB file " << iters << " times\n" << std::left << std::setw(22) << "path"
+		<< std::setw(12) << "p50 (ms)" << std::setw(12) << "max (ms)" << "GB/s\n" << std::fixed << std::setprecision(3);
+	const char *names[] = {"istreambuf_iterator", "util::read_file", "FileView sequential", "FileView random"};
+	uint64_t sums[4] = {0};
+	for (int mode = 0; mode < 4; ++mode){
+		std::vector<double> times;
+		for (int i = 0; i < iters; ++i){
+			bench::Timer timer;
+			if (mode == 0){
+				std::ifstream in(file, std::ios::binary);
+				const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+				sums[mode] = checksum(data.data(), data.size());
+			}
+			else if (mode == 1){
+				const std::string data = util::read_file(file);
+				sums[mode] = checksum(data.data(), data.size());
+			}
+			else if (mode == 2){
+				FileView view{file, FileAccess::SEQUENTIAL};
+				sums[mode] = checksum(view.data(), view.size());
+			}
+			else {
+				FileView view{file, FileAccess::RANDOM};
+				uint64_t sum = 0;
+				for (size_t p : random_pages){
+					sum += checksum(view.data() + p, page);
+				}
+				sums[mode] = sum;
+			}
+			times.push_back(timer.elapsed_ms());
+		}
+		const StatSummary s = summarize(times);
+		std::cout << std::setw(22) << names[mode] << std::setw(12) << s.p50 << std::setw(12) << s.max
+			<< size / (s.p50 * 1e6) << "\n";
+	}
+	if (sums[0] != sums[1] || sums[0] != sums[2] || sums[0] != sums[3]){
+		std::cerr << "Checksums of the reads don't match\n";
+	}
+	std::remove(file.c_str());
+	return 0;
+}
+
@@ -0,0 +1,172 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include "util.h"
+#include "instance.h"
+#include "camera.h"
+#include "frame_scheduler.h"
+#include "frame_stats.h"
+#include "bench_util.h"
+
+/*
+ * Compare drawing a static scene continuously against drawing it on demand with
+ * the FrameScheduler. Reports the frames drawn and CPU used over a few idle seconds,
+ * how long it takes a notification from another thread to wake up the waiting
+ * render thread and how long full and partial scissored redraws of the scene take
+ * for a few sizes of changed rect
+ * usage: bench_frame_scheduler [--instances N] [--seconds N] [--wakeups N] [--frames N] [--headless]
+ */
+namespace {
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double cpu_ms(std::clock_t start){
+		return 1000.0 * (std::clock() - start) / CLOCKS_PER_SEC;
+	}
+}
+
+int main(int argc, char **argv){
+	const size_t n = bench::arg_int(argc, argv, "--instances", 200000);
+	const int seconds = bench::arg_int(argc, argv, "--seconds", 2);
+	const int wakeups = bench::arg_int(argc, argv, "--wakeups", 100);
+	const int frames = bench::arg_int(argc, argv, "--frames", 20);
+	const int width = 640, height = 480;
+	bench::GLContext ctx;
+	if (!ctx.create(width, height, bench::arg_flag(argc, argv, "--headless"))){
+		return 1;
+	}
+	bench::BillboardPipeline pipeline;
+	if (!pipeline.create()){
+		return 1;
+	}
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> pos_dist(-50.f, 50.f);
+	std::uniform_real_distribution<float> unit_dist(0.f, 1.f);
+	std::uniform_int_distribution<int> id_dist(0, 3);
+	std::vector<Instance> instances(n);
+	for (Instance &i : instances){
+		i = Instance{glm::vec3{pos_dist(rng), pos_dist(rng), pos_dist(rng) - 100}, id_dist(rng), 0.2f,
+			pack_rgba8(glm::vec4{unit_dist(rng), unit_dist(rng), unit_dist(rng), 1}), unit_dist(rng)};
+	}
+	GLuint instance_buf;
+	glGenBuffers(1, &instance_buf);
+	glBindBuffer(GL_ARRAY_BUFFER, instance_buf);
+	glBufferData(GL_ARRAY_BUFFER, n * sizeof(Instance), instances.data(), GL_STATIC_DRAW);
+	setup_instance_attribs(instance_buf);
+	const Camera camera{glm::vec3{0}, glm::vec3{0, 0, -1}, glm::vec3{0, 1, 0}};
+	const glm::mat4 proj = glm::perspective<float>(util::deg_to_rad(75.f), static_cast<float>(width) / height,
+		1, 400);
+	pipeline.set_view(camera.view_mat(), proj, glm::vec3{0});
+	//The context may render to a window, whose back buffer isn't kept, so draw to the scheduler's canvas
+	GLint target = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+	FrameScheduler scheduler{width, height, static_cast<GLuint>(target), false};
+	auto draw_scene = [&](){
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, n);
+	};
+	std::cout << "Drawing " << n << " instances at " << width << "x" << height << "\n" << std::fixed
+		<< std::setprecision(3);
+
+	//Idle: nothing changes after the first frame, continuous drawing keeps redrawing it anyway
+	{
+		std::cout << std::left << std::setw(14) << "idle mode" << std::setw(10) << "frames" << std::setw(12)
+			<< "CPU ms/s" << "% of a core\n";
+		const char *names[] = {"continuous", "on demand"};
+		for (int mode = 0; mode < 2; ++mode){
+			//Both draw the first frame before we start measuring
+			scheduler.mark_dirty();
+			scheduler.begin_frame();
+			draw_scene();
+			scheduler.end_frame();
+			glFinish();
+			size_t drawn = 0;
+			const std::clock_t cpu_start = std::clock();
+			const auto start = Clock::now();
+			while (Clock::now() - start < std::chrono::seconds(seconds)){
+				if (mode == 1){
+					scheduler.wait();
+					if (!scheduler.is_dirty()){
+						scheduler.skip_frame();
+						continue;
+					}
+				}
+				scheduler.begin_frame();
+				draw_scene();
+				scheduler.end_frame();
+				glFinish();
+				++drawn;
+			}
+			const double cpu = cpu_ms(cpu_start) / seconds;
+			std::cout << std::setw(14) << names[mode] << std::setw(10) << drawn << std::setw(12) << cpu
+				<< cpu / 10 << "%\n";
+		}
+	}
+
+	//Wakeups: another thread notifies the waiting render thread at random intervals
+	{
+		std::atomic<int64_t> notify_time(0);
+		std::atomic<bool> done(false);
+		std::thread notifier([&](){
+			std::mt19937 rng(9);
+			std::uniform_int_distribution<int> delay_dist(2, 10);
+			while (!done){
+				std::this_thread::sleep_for(std::chrono::milliseconds(delay_dist(rng)));
+				notify_time = Clock::now().time_since_epoch().count();
+				scheduler.notify();
+			}
+		});
+		std::vector<double> latency;
+		while (static_cast<int>(latency.size()) < wakeups){
+			scheduler.wait();
+			const int64_t sent = notify_time.exchange(0);
+			if (sent != 0){
+				latency.push_back(std::chrono::duration<double, std::milli>(Clock::now().time_since_epoch()
+					- Clock::duration{sent}).count());
+			}
+		}
+		done = true;
+		notifier.join();
+		const StatSummary s = summarize(latency);
+		std::cout << "Notify to wakeup over " << wakeups << " notifications: p50 " << s.p50 << "ms, p99 " << s.p99
+			<< "ms, max " << s.max << "ms\n";
+	}
+
+	//Redraws: the whole frame against centered rects of a fraction of it
+	{
+		std::cout << std::left << std::setw(14) << "redraw" << std::setw(10) << "pixels" << std::setw(10)
+			<< "p50 ms" << "p99 ms\n";
+		const int divisors[] = {1, 2, 4, 8};
+		for (int d : divisors){
+			const ScreenRect rect{width / 2 - width / (2 * d), height / 2 - height / (2 * d), width / d, height / d};
+			std::vector<double> times;
+			for (int f = 0; f < frames; ++f){
+				bench::Timer timer;
+				if (d == 1){
+					scheduler.mark_dirty();
+				}
+				else {
+					scheduler.mark_dirty(rect);
+				}
+				scheduler.begin_frame();
+				draw_scene();
+				scheduler.end_frame();
+				glFinish();
+				times.push_back(timer.elapsed_ms());
+			}
+			const StatSummary s = summarize(times);
+			const std::string name = d == 1 ? "full" : "1/" + std::to_string(d * d) + " rect";
+			std::cout << std::setw(14) << name << std::setw(10) << rect.width * rect.height << std::setw(10)
+				<< s.p50 << s.p99 << "\n";
+		}
+	}
+	glDeleteBuffers(1, &instance_buf);
+	return 0;
+}
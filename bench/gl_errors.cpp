@@ -0,0 +1,119 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <string>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include "util.h"
+#include "instance.h"
+#include "frame_stats.h"
+#include "bench_util.h"
+
+/*
+ * Compare frame times with different glGetError checking policies: never
+ * checking (what the off and callback modes do), checking every N frames as
+ * sampled mode does, checking every frame like the render loop used to and
+ * checking after every GL call as util::log_glerror encourages. Each frame
+ * streams the instances, draws them in --batches draws and flushes without
+ * waiting on the GPU, so any stall comes from the error checks
+ * usage: bench_gl_errors [--instances N] [--frames N] [--batches N] [--interval N] [--headless]
+ */
+struct Policy {
+	std::string name;
+	//Check after every interval frames, 0 never checks
+	int frame_interval;
+	bool every_call;
+};
+
+int main(int argc, char **argv){
+	const size_t n = bench::arg_int(argc, argv, "--instances", 100000);
+	const int frames = bench::arg_int(argc, argv, "--frames", 300);
+	const size_t batches = std::max(bench::arg_int(argc, argv, "--batches", 64), 1ll);
+	const int interval = bench::arg_int(argc, argv, "--interval", 120);
+
+	bench::GLContext ctx;
+	bench::BillboardPipeline pipeline;
+	if (!ctx.create(1280, 720, bench::arg_flag(argc, argv, "--headless")) || !pipeline.create()){
+		return 1;
+	}
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> pos_dist(-20.f, 20.f);
+	std::uniform_int_distribution<int> id_dist(0, 3);
+	std::vector<Instance> instances(n);
+	for (Instance &i : instances){
+		i = Instance{glm::vec3{pos_dist(rng), pos_dist(rng), pos_dist(rng)}, id_dist(rng), 0.2f,
+			pack_rgba8(glm::vec4{1}), 0};
+	}
+	GLuint instance_buf;
+	glGenBuffers(1, &instance_buf);
+	glBindBuffer(GL_ARRAY_BUFFER, instance_buf);
+	glBufferData(GL_ARRAY_BUFFER, n * sizeof(Instance), NULL, GL_STREAM_DRAW);
+	const glm::mat4 proj = glm::perspective<float>(util::deg_to_rad(75.f), 16.f / 9.f, 1, 100);
+	const size_t batch_size = (n + batches - 1) / batches;
+
+	const std::vector<Policy> policies = {
+		Policy{"never", 0, false},
+		Policy{"every " + std::to_string(interval) + " frames", interval, false},
+		Policy{"every frame", 1, false},
+		Policy{"every call", 1, true}
+	};
+	std::cout << "Drawing " << n << " instances in " << batches << " batches for " << frames << " frames\n"
+		<< std::left << std::setw(20) << "glGetError" << std::setw(12) << "checks" << std::setw(12)
+		<< "mean (ms)" << std::setw(12) << "p50 (ms)" << std::setw(12) << "p99 (ms)" << "total (ms)\n"
+		<< std::fixed << std::setprecision(3);
+	size_t checks = 0;
+	auto check = [&](){
+		++checks;
+		util::log_glerror("bench");
+	};
+	auto draw_frame = [&](const Policy &p, int f){
+		const float angle = 0.01f * f;
+		const glm::vec3 eye{30.f * std::cos(angle), 5, 30.f * std::sin(angle)};
+		pipeline.set_view(glm::lookAt(eye, glm::vec3{0}, glm::vec3{0, 1, 0}), proj, eye);
+		if (p.every_call){
+			check();
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, instance_buf);
+		glBufferData(GL_ARRAY_BUFFER, n * sizeof(Instance), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, n * sizeof(Instance), instances.data());
+		if (p.every_call){
+			check();
+		}
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		for (size_t b = 0; b < n; b += batch_size){
+			setup_instance_attribs(instance_buf, b * sizeof(Instance));
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, std::min(batch_size, n - b));
+			if (p.every_call){
+				check();
+			}
+		}
+		glFlush();
+		if (p.frame_interval > 0 && f % p.frame_interval == 0){
+			check();
+		}
+	};
+	//Warm up the driver's shader and buffer caches so the first policy isn't penalized
+	for (int f = 0; f < std::min(frames, 30); ++f){
+		draw_frame(policies[0], f);
+	}
+	for (const Policy &p : policies){
+		checks = 0;
+		std::vector<double> frame_ms;
+		glFinish();
+		bench::Timer total;
+		for (int f = 0; f < frames; ++f){
+			bench::Timer timer;
+			draw_frame(p, f);
+			frame_ms.push_back(timer.elapsed_ms());
+		}
+		glFinish();
+		const double total_ms = total.elapsed_ms();
+		const StatSummary s = summarize(frame_ms);
+		std::cout << std::setw(20) << p.name << std::setw(12) << checks << std::setw(12) << s.mean
+			<< std::setw(12) << s.p50 << std::setw(12) << s.p99 << total_ms << "\n";
+	}
+	glDeleteBuffers(1, &instance_buf);
+	return 0;
+}
@@ -0,0 +1,94 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <string>
+#include <glm/glm.hpp>
+#include "gl_core_3_3.h"
+#include "instance.h"
+#include "bench_util.h"
+
+/*
+ * Compare the bytes per instance and upload time of the old two buffer
+ * layout (positions in one VBO, sprite ids in another) against the
+ * interleaved Instance buffer. The same attributes split across one buffer
+ * each is also timed to show the cost of the extra buffers alone
+ * usage: bench_instance_upload [--instances N] [--iters N] [--headless]
+ */
+struct Layout {
+	std::string name;
+	std::vector<const char*> data;
+	std::vector<size_t> sizes;
+};
+
+double time_upload(const Layout &layout, const std::vector<GLuint> &bufs, int iters){
+	bench::Timer timer;
+	for (int it = 0; it < iters; ++it){
+		for (size_t i = 0; i < bufs.size(); ++i){
+			glBindBuffer(GL_ARRAY_BUFFER, bufs[i]);
+			//Orphan the old storage so we time the upload, not waiting on the GPU
+			glBufferData(GL_ARRAY_BUFFER, layout.sizes[i], NULL, GL_STREAM_DRAW);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, layout.sizes[i], layout.data[i]);
+		}
+		glFinish();
+	}
+	return timer.elapsed_ms() / iters;
+}
+int main(int argc, char **argv){
+	const size_t n = bench::arg_int(argc, argv, "--instances", 4000000);
+	const int iters = bench::arg_int(argc, argv, "--iters", 20);
+	bench::GLContext ctx;
+	if (!ctx.create(640, 480, bench::arg_flag(argc, argv, "--headless"))){
+		return 1;
+	}
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> pos_dist(-100.f, 100.f);
+	std::uniform_int_distribution<int> id_dist(0, 3);
+	std::vector<glm::vec3> pos(n);
+	std::vector<GLint> ids(n);
+	std::vector<GLfloat> sizes(n, 1.f);
+	std::vector<GLuint> colors(n, pack_rgba8(glm::vec4{1}));
+	std::vector<GLfloat> rotations(n, 0.f);
+	std::vector<Instance> instances(n);
+	for (size_t i = 0; i < n; ++i){
+		pos[i] = glm::vec3{pos_dist(rng), pos_dist(rng), pos_dist(rng)};
+		ids[i] = id_dist(rng);
+		instances[i] = Instance{pos[i], ids[i], sizes[i], colors[i], rotations[i]};
+	}
+
+	std::vector<Layout> layouts;
+	layouts.push_back(Layout{"two buffers (pos + id)",
+		{reinterpret_cast<const char*>(pos.data()), reinterpret_cast<const char*>(ids.data())},
+		{n * sizeof(glm::vec3), n * sizeof(GLint)}});
+	layouts.push_back(Layout{"buffer per attribute",
+		{reinterpret_cast<const char*>(pos.data()), reinterpret_cast<const char*>(ids.data()),
+			reinterpret_cast<const char*>(sizes.data()), reinterpret_cast<const char*>(colors.data()),
+			reinterpret_cast<const char*>(rotations.data())},
+		{n * sizeof(glm::vec3), n * sizeof(GLint), n * sizeof(GLfloat), n * sizeof(GLuint),
+			n * sizeof(GLfloat)}});
+	layouts.push_back(Layout{"interleaved Instance",
+		{reinterpret_cast<const char*>(instances.data())}, {n * sizeof(Instance)}});
+
+	std::cout << "Uploading " << n << " instances, " << iters << " iterations\n"
+		<< std::left << std::setw(26) << "layout" << std::setw(10) << "buffers"
+		<< std::setw(16) << "bytes/instance" << std::setw(14) << "upload (ms)"
+		<< "GB/s\n" << std::fixed << std::setprecision(3);
+	for (const Layout &l : layouts){
+		std::vector<GLuint> bufs(l.data.size());
+		glGenBuffers(bufs.size(), bufs.data());
+		size_t total = 0;
+		for (size_t s : l.sizes){
+			total += s;
+		}
+		//Warm up the driver's allocation paths before timing
+		time_upload(l, bufs, 2);
+		double ms = time_upload(l, bufs, iters);
+		std::cout << std::setw(26) << l.name << std::setw(10) << bufs.size()
+			<< std::setw(16) << static_cast<double>(total) / n << std::setw(14) << ms
+			<< total / (ms * 1e6) << "\n";
+		glDeleteBuffers(bufs.size(), bufs.data());
+	}
+	return 0;
+}
+
@@ -0,0 +1,68 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <thread>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include "util.h"
+#include "instance.h"
+#include "camera.h"
+#include "job_system.h"
+#include "cull.h"
+#include "bench_util.h"
+
+/*
+ * Measure how parallel culling and compaction scales from 1 to N threads.
+ * Doesn't need a GL context so it can be run on headless machines
+ * usage: bench_job_scaling [--instances N] [--iters N] [--max-threads N] [--chunk N]
+ */
+int main(int argc, char **argv){
+	const size_t n = bench::arg_int(argc, argv, "--instances", 10000000);
+	const int iters = bench::arg_int(argc, argv, "--iters", 10);
+	const unsigned max_threads = bench::arg_int(argc, argv, "--max-threads",
+		std::max(std::thread::hardware_concurrency(), 1u));
+	const size_t chunk = bench::arg_int(argc, argv, "--chunk", 16384);
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> pos_dist(-100.f, 100.f);
+	std::vector<Instance> instances(n);
+	for (Instance &i : instances){
+		i = Instance{glm::vec3{pos_dist(rng), pos_dist(rng), pos_dist(rng)}, 0, 1,
+			pack_rgba8(glm::vec4{1}), 0};
+	}
+	InstanceSoA spheres;
+	spheres.assign(instances.data(), n);
+	std::vector<Instance> out(n);
+
+	Camera camera{glm::vec3{0, 0, 5}, glm::vec3{0, 0, 0}, glm::vec3{0, 1, 0}};
+	const glm::mat4 proj = glm::perspective<float>(util::deg_to_rad(75.f), 16.f / 9.f, 1, 100);
+	const Frustum frustum = billboard_frustum(camera.view_mat(), proj);
+	const CullISA isa = best_cull_isa();
+
+	std::cout << "Culling " << n << " instances with the " << cull_isa_name(isa) << " kernel, chunks of "
+		<< chunk << ", " << iters << " iterations\n"
+		<< std::left << std::setw(10) << "threads" << std::setw(12) << "time (ms)"
+		<< std::setw(14) << "M inst/s" << std::setw(10) << "speedup" << "visible\n"
+		<< std::fixed << std::setprecision(2);
+	double base_ms = 0;
+	for (unsigned t = 1; t <= max_threads; ++t){
+		JobSystem jobs{t};
+		ParallelCuller culler{jobs, chunk};
+		//Warm up the threads and scratch allocations
+		size_t visible = culler.cull(frustum, spheres, instances.data(), n, out.data(), isa);
+		bench::Timer timer;
+		for (int it = 0; it < iters; ++it){
+			visible = culler.cull(frustum, spheres, instances.data(), n, out.data(), isa);
+		}
+		const double ms = timer.elapsed_ms() / iters;
+		if (t == 1){
+			base_ms = ms;
+		}
+		std::cout << std::setw(10) << t << std::setw(12) << ms << std::setw(14) << n / (ms * 1e3)
+			<< std::setw(10) << base_ms / ms << visible << "\n";
+	}
+	return 0;
+}
+
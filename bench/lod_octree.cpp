@@ -0,0 +1,144 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <string>
+#include <cstdio>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include "instance.h"
+#include "cull.h"
+#include "job_system.h"
+#include "scene_file.h"
+#include "chunk_stream.h"
+#include "lod_octree.h"
+#include "frame_stats.h"
+#include "bench_util.h"
+
+/*
+ * Build a level of detail octree out of a scene of gaussian clusters of
+ * billboards with 1 up to --threads workers and report the time each phase
+ * of the build takes, then fly the camera from outside the scene into one of
+ * the clusters and compare streaming every chunk in the frustum against
+ * drawing the octree at a few instance budgets. Reports the frame times and
+ * the nodes traversed, selected, loaded and drawn per frame
+ * usage: bench_lod_octree [--instances N] [--threads N] [--pool-mb N] [--frames N] [--dir path] [--headless]
+ */
+int main(int argc, char **argv){
+	const size_t n = bench::arg_int(argc, argv, "--instances", 8000000);
+	const unsigned max_threads = bench::arg_int(argc, argv, "--threads", 8);
+	const size_t pool_mb = bench::arg_int(argc, argv, "--pool-mb", 256);
+	const int frames = bench::arg_int(argc, argv, "--frames", 300);
+	std::string dir = "./";
+	for (int i = 1; i < argc - 1; ++i){
+		if (std::string{argv[i]} == "--dir"){
+			dir = argv[i + 1];
+		}
+	}
+	bench::GLContext ctx;
+	if (!ctx.create(640, 480, bench::arg_flag(argc, argv, "--headless"))){
+		return 1;
+	}
+	bench::BillboardPipeline pipeline;
+	if (!pipeline.create()){
+		return 1;
+	}
+	const std::string scene_file = dir + "bench_lod_octree.vsbs";
+	const std::string lod_file = dir + "bench_lod_octree_lod.vsbs";
+	glm::vec3 target;
+	{
+		std::mt19937 rng(11);
+		std::uniform_real_distribution<float> center_dist(-100, 100);
+		std::uniform_real_distribution<float> unit_dist(0.f, 1.f);
+		std::normal_distribution<float> offset_dist(0, 4);
+		std::uniform_int_distribution<int> id_dist(0, 3);
+		std::vector<glm::vec3> centers(64);
+		for (glm::vec3 &c : centers){
+			c = glm::vec3{center_dist(rng), center_dist(rng), center_dist(rng)};
+		}
+		target = centers[0];
+		std::vector<Instance> instances(n);
+		for (size_t i = 0; i < n; ++i){
+			const glm::vec3 pos = centers[i % centers.size()]
+				+ glm::vec3{offset_dist(rng), offset_dist(rng), offset_dist(rng)};
+			instances[i] = Instance{pos, id_dist(rng), 0.05f,
+				pack_rgba8(glm::vec4{unit_dist(rng), unit_dist(rng), unit_dist(rng), 1}), unit_dist(rng)};
+		}
+		if (!write_scene_file(scene_file, instances)){
+			return 1;
+		}
+	}
+	std::cout << "Building an octree of " << n << " instances (" << n * sizeof(Instance) / 1e6 << "MB)\n"
+		<< std::left << std::setw(10) << "threads" << std::setw(10) << "nodes" << std::setw(10) << "depth"
+		<< std::setw(12) << "count ms" << std::setw(15) << "distribute ms" << std::setw(12) << "index ms"
+		<< std::setw(12) << "write ms" << "total ms\n" << std::fixed << std::setprecision(3);
+	for (unsigned threads = 1; threads <= max_threads; threads *= 2){
+		JobSystem jobs{threads};
+		LodBuildStats stats;
+		LodBuildOptions options;
+		//Use several cells so the index phase has work to split over the threads
+		options.cell_instances = n / 16;
+		bench::Timer timer;
+		if (!build_lod_octree(jobs, scene_file, lod_file, options, &stats)){
+			return 1;
+		}
+		const double total_ms = timer.elapsed_ms();
+		std::cout << std::setw(10) << threads << std::setw(10) << stats.nodes << std::setw(10) << stats.max_depth
+			<< std::setw(12) << stats.count_ms << std::setw(15) << stats.distribute_ms << std::setw(12)
+			<< stats.index_ms << std::setw(12) << stats.write_ms << total_ms << "\n";
+	}
+
+	SceneFile scene;
+	LodOctree lod;
+	if (!scene.open(scene_file, FileAccess::RANDOM) || !lod.open(lod_file)){
+		return 1;
+	}
+	const glm::mat4 proj = glm::perspective<GLfloat>(util::deg_to_rad(75.f), 640.f / 480.f, 0.1f, 1000);
+	const glm::vec3 start{0, 0, 400};
+	std::cout << "Flying into a cluster over " << frames << " frames with a " << pool_mb << "MB pool\n"
+		<< std::setw(16) << "mode" << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms"
+		<< std::setw(13) << "instances" << std::setw(12) << "traversed" << std::setw(11) << "selected"
+		<< std::setw(8) << "loads" << "drawn\n";
+	const size_t budgets[] = {0, 4000000, 1000000, 250000};
+	for (size_t budget : budgets){
+		ChunkStreamer streamer{budget == 0 ? scene : lod.scene(), pool_mb * 1024 * 1024};
+		std::vector<StreamChunk> nodes;
+		LodSelectStats lod_total;
+		std::vector<double> times;
+		size_t drawn = 0;
+		for (int f = 0; f < frames; ++f){
+			const glm::vec3 eye = glm::mix(start, target + glm::vec3{0, 0, 2}, f / static_cast<float>(frames));
+			const glm::mat4 view = glm::lookAt(eye, target, glm::vec3{0, 1, 0});
+			const Frustum frustum = billboard_frustum(view, proj);
+			bench::Timer timer;
+			pipeline.set_view(view, proj, eye);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			if (budget == 0){
+				streamer.update(eye, glm::normalize(target - eye), frustum);
+			}
+			else {
+				const LodSelectStats stats = lod.select(eye, frustum, proj, 480, budget, 1.5f, nodes);
+				streamer.update(nodes);
+				lod_total.traversed += stats.traversed;
+				lod_total.selected += stats.selected;
+			}
+			streamer.upload();
+			drawn += streamer.draw();
+			glFinish();
+			times.push_back(timer.elapsed_ms());
+		}
+		const StatSummary s = summarize(times);
+		const ChunkStreamStats &stats = streamer.total_stats();
+		const std::string name = budget == 0 ? "all chunks" : "lod " + std::to_string(budget);
+		std::cout << std::setw(16) << name << std::setw(10) << s.p50 << std::setw(10) << s.p99
+			<< std::setw(13) << drawn / frames << std::setw(12) << lod_total.traversed / static_cast<double>(frames)
+			<< std::setw(11) << lod_total.selected / static_cast<double>(frames)
+			<< std::setw(8) << stats.loads << stats.drawn / static_cast<double>(frames) << "\n";
+	}
+	scene.close();
+	lod.close();
+	std::remove(scene_file.c_str());
+	std::remove(lod_file.c_str());
+	std::remove((lod_file + ".lod").c_str());
+	return 0;
+}
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include "util.h"
+#include "instance.h"
+#include "camera.h"
+#include "job_system.h"
+#include "cull.h"
+#include "morton.h"
+#include "bench_util.h"
+
+/*
+ * Compare culling and draw throughput with the instances in random order
+ * against 30 and 63 bit Morton order. Pass --no-gl to skip the draw timings
+ * on machines without a GL context
+ * usage: bench_morton_order [--instances N] [--iters N] [--no-gl 1] [--headless]
+ */
+struct Ordering {
+	std::string name;
+	std::vector<Instance> instances;
+	double reorder_ms;
+};
+
+int main(int argc, char **argv){
+	const size_t n = bench::arg_int(argc, argv, "--instances", 10000000);
+	const int iters = bench::arg_int(argc, argv, "--iters", 10);
+	const bool use_gl = bench::arg_int(argc, argv, "--no-gl", 0) == 0;
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> pos_dist(-100.f, 100.f);
+	std::uniform_int_distribution<int> id_dist(0, 3);
+	std::vector<Instance> random(n);
+	for (Instance &i : random){
+		i = Instance{glm::vec3{pos_dist(rng), pos_dist(rng), pos_dist(rng)}, id_dist(rng), 0.2f,
+			pack_rgba8(glm::vec4{1}), 0};
+	}
+
+	JobSystem jobs;
+	std::vector<Ordering> orders;
+	orders.push_back(Ordering{"random", random, 0});
+	for (MortonBits bits : {MortonBits::BITS_30, MortonBits::BITS_63}){
+		Ordering o{bits == MortonBits::BITS_30 ? "morton 30" : "morton 63", random, 0};
+		InstanceRemap remap;
+		remap.reset(n);
+		bench::Timer timer;
+		morton_reorder(jobs, o.instances, bits, &remap);
+		o.reorder_ms = timer.elapsed_ms();
+		orders.push_back(o);
+	}
+
+	bench::GLContext ctx;
+	bench::BillboardPipeline pipeline;
+	GLuint instance_buf = 0;
+	if (use_gl){
+		if (!ctx.create(1280, 720, bench::arg_flag(argc, argv, "--headless")) || !pipeline.create()){
+			return 1;
+		}
+		glGenBuffers(1, &instance_buf);
+		glBindBuffer(GL_ARRAY_BUFFER, instance_buf);
+		glBufferData(GL_ARRAY_BUFFER, n * sizeof(Instance), NULL, GL_STREAM_DRAW);
+		setup_instance_attribs(instance_buf);
+	}
+
+	Camera camera{glm::vec3{0, 0, 5}, glm::vec3{0, 0, 0}, glm::vec3{0, 1, 0}};
+	const glm::mat4 proj = glm::perspective<float>(util::deg_to_rad(75.f), 16.f / 9.f, 1, 100);
+	const Frustum frustum = billboard_frustum(camera.view_mat(), proj);
+	const CullISA isa = best_cull_isa();
+	ParallelCuller culler{jobs};
+	InstanceSoA spheres;
+	std::vector<Instance> visible(n);
+	if (use_gl){
+		pipeline.set_view(camera.view_mat(), proj, camera.eye_pos());
+	}
+
+	std::cout << "Ordering " << n << " instances on " << jobs.size() << " threads, "
+		<< iters << " iterations\n" << std::left << std::setw(12) << "order" << std::setw(14)
+		<< "reorder (ms)" << std::setw(12) << "cull (ms)" << std::setw(18) << "cull (M inst/s)"
+		<< std::setw(12) << "draw (ms)" << "draw (M inst/s)\n" << std::fixed << std::setprecision(2);
+	for (const Ordering &o : orders){
+		spheres.assign(o.instances.data(), n);
+		size_t n_visible = culler.cull(frustum, spheres, o.instances.data(), n, visible.data(), isa);
+		bench::Timer timer;
+		for (int it = 0; it < iters; ++it){
+			n_visible = culler.cull(frustum, spheres, o.instances.data(), n, visible.data(), isa);
+		}
+		const double cull_ms = timer.elapsed_ms() / iters;
+		std::cout << std::setw(12) << o.name << std::setw(14) << o.reorder_ms << std::setw(12) << cull_ms
+			<< std::setw(18) << n / (cull_ms * 1e3);
+		if (use_gl){
+			//Draw the visible instances in the order culling packed them
+			glBindBuffer(GL_ARRAY_BUFFER, instance_buf);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, n_visible * sizeof(Instance), visible.data());
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, n_visible);
+			glFinish();
+			timer.reset();
+			for (int it = 0; it < iters; ++it){
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, n_visible);
+				glFinish();
+			}
+			const double draw_ms = timer.elapsed_ms() / iters;
+			std::cout << std::setw(12) << draw_ms << n_visible / (draw_ms * 1e3);
+		}
+		std::cout << "\n";
+	}
+	if (instance_buf){
+		glDeleteBuffers(1, &instance_buf);
+	}
+	return 0;
+}
+
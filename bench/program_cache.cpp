@@ -0,0 +1,87 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <tuple>
+#include "util.h"
+#include "program_cache.h"
+#include "shader_preprocessor.h"
+#include "shader_variants.h"
+#include "frame_stats.h"
+#include "bench_util.h"
+
+/*
+ * Time loading the billboard program without the program cache, with the cache
+ * cold (the entry is evicted before each load) and with it warm. The cache lives
+ * in --dir, or the default preference path if it's not given. Note that drivers
+ * may have their own shader cache, e.g. set MESA_SHADER_CACHE_DISABLE=true to
+ * see the full compile cost on Mesa
+ * usage: bench_program_cache [--iters N] [--dir path] [--headless]
+ */
+int main(int argc, char **argv){
+	const int iters = bench::arg_int(argc, argv, "--iters", 20);
+	std::string dir;
+	for (int i = 1; i < argc - 1; ++i){
+		if (std::string{argv[i]} == "--dir"){
+			dir = argv[i + 1];
+		}
+	}
+
+	bench::GLContext ctx;
+	if (!ctx.create(640, 480, bench::arg_flag(argc, argv, "--headless"))){
+		return 1;
+	}
+	const std::string res_path = VSB_RES_DIR;
+	const std::vector<std::string> defines = variant_defines(feature_bit(ShaderFeature::SIZE)
+		| feature_bit(ShaderFeature::ROTATION));
+	ShaderSource vert, frag;
+	if (!preprocess_shader(res_path + "vertex.glsl", defines, vert)
+		|| !preprocess_shader(res_path + "fragment.glsl", defines, frag))
+	{
+		return 1;
+	}
+	const std::vector<std::tuple<GLenum, std::string>> sources = {
+		std::make_tuple(GL_VERTEX_SHADER, vert.source),
+		std::make_tuple(GL_FRAGMENT_SHADER, frag.source)
+	};
+	const std::string name = ProgramCache::program_name({std::make_tuple(GL_VERTEX_SHADER, res_path + "vertex.glsl"),
+		std::make_tuple(GL_FRAGMENT_SHADER, res_path + "fragment.glsl")}, defines);
+	ProgramCache uncached{""};
+	ProgramCache cache{dir.empty() ? ProgramCache::default_dir() : dir};
+	if (!cache.enabled()){
+		std::cout << "The driver doesn't support program binaries, only timing compilation\n";
+	}
+
+	std::cout << "Loading the billboard program " << iters << " times\n" << std::left << std::setw(12)
+		<< "cache" << std::setw(12) << "mean (ms)" << std::setw(12) << "p50 (ms)" << std::setw(12)
+		<< "max (ms)" << std::setw(8) << "hits" << "rejected\n" << std::fixed << std::setprecision(3);
+	const char *names[] = {"none", "cold", "warm"};
+	for (int mode = 0; mode < 3; ++mode){
+		ProgramCache &c = mode == 0 ? uncached : cache;
+		if (mode == 2){
+			//Make sure the entry is there for the warm loads
+			glDeleteProgram(c.load_program_sources(name, sources));
+		}
+		const size_t hits = c.cache_stats().hits;
+		const size_t rejected = c.cache_stats().rejected;
+		std::vector<double> times;
+		for (int i = 0; i < iters; ++i){
+			if (mode == 1){
+				c.evict(name);
+			}
+			bench::Timer timer;
+			const GLint program = c.load_program_sources(name, sources);
+			//Drivers can defer the real work until the program is used, so wait for it
+			glUseProgram(program);
+			glFinish();
+			times.push_back(timer.elapsed_ms());
+			glUseProgram(0);
+			glDeleteProgram(program);
+		}
+		const StatSummary s = summarize(times);
+		std::cout << std::setw(12) << names[mode] << std::setw(12) << s.mean << std::setw(12) << s.p50
+			<< std::setw(12) << s.max << std::setw(8) << c.cache_stats().hits - hits
+			<< c.cache_stats().rejected - rejected << "\n";
+	}
+	return 0;
+}
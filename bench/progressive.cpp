@@ -0,0 +1,164 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <string>
+#include <memory>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include "util.h"
+#include "instance.h"
+#include "camera.h"
+#include "job_system.h"
+#include "cull.h"
+#include "bvh.h"
+#include "depth_sort.h"
+#include "progressive.h"
+#include "frame_stats.h"
+#include "bench_util.h"
+
+/*
+ * Move the camera through a large scene for a while then stop it, drawing
+ * every visible instance each frame compared to progressive rendering at a
+ * few budgets. Reports the frame times while moving and how much of them was
+ * spent culling, sorting and uploading, how many frames and how
+ * long it takes the progressive image to complete once the camera stops, the
+ * frame time once it's complete and the pixels that differ between the final
+ * progressive image and drawing everything at once
+ * usage: bench_progressive [--instances N] [--moving N] [--idle N] [--headless]
+ */
+int main(int argc, char **argv){
+	const size_t n = bench::arg_int(argc, argv, "--instances", 20000000);
+	const int moving_frames = bench::arg_int(argc, argv, "--moving", 30);
+	const int idle_frames = bench::arg_int(argc, argv, "--idle", 60);
+	const int width = 640, height = 480;
+	bench::GLContext ctx;
+	if (!ctx.create(width, height, bench::arg_flag(argc, argv, "--headless"))){
+		return 1;
+	}
+	bench::BillboardPipeline pipeline;
+	if (!pipeline.create()){
+		return 1;
+	}
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> pos_dist(-100.f, 100.f);
+	std::uniform_real_distribution<float> unit_dist(0.f, 1.f);
+	std::uniform_int_distribution<int> id_dist(0, 3);
+	std::vector<Instance> instances(n);
+	for (Instance &i : instances){
+		i = Instance{glm::vec3{pos_dist(rng), pos_dist(rng), pos_dist(rng)}, id_dist(rng), 0.1f,
+			pack_rgba8(glm::vec4{unit_dist(rng), unit_dist(rng), unit_dist(rng), 1}), unit_dist(rng)};
+	}
+	JobSystem jobs;
+	BVH bvh;
+	bvh.build(jobs, instances);
+	InstanceSoA spheres;
+	spheres.assign(instances.data(), n);
+	const CullISA isa = best_cull_isa();
+
+	GLuint instance_buf;
+	glGenBuffers(1, &instance_buf);
+	glBindBuffer(GL_ARRAY_BUFFER, instance_buf);
+	glBufferData(GL_ARRAY_BUFFER, n * sizeof(Instance), NULL, GL_STREAM_DRAW);
+	std::vector<Instance> visible(n);
+	std::vector<DrawRange> ranges, sample;
+	std::vector<uint8_t> reference(width * height * 4), image(width * height * 4);
+	const glm::mat4 proj = glm::perspective<float>(util::deg_to_rad(75.f), static_cast<float>(width) / height,
+		1, 400);
+	//The progressive images are blitted to whatever framebuffer the context renders to
+	GLint target = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+
+	std::cout << "Moving through " << n << " instances for " << moving_frames << " frames then stopping for "
+		<< idle_frames << " frames at " << width << "x" << height << "\n" << std::left << std::setw(20) << "mode"
+		<< std::setw(16) << "moving p50 ms" << std::setw(16) << "moving p99 ms" << std::setw(16) << "moving prep ms" << std::setw(10) << "slices"
+		<< std::setw(18) << "frames to done" << std::setw(14) << "ms to done" << std::setw(14) << "done p50 ms"
+		<< "pixels changed\n" << std::fixed << std::setprecision(3);
+	const size_t budgets[] = {0, 2000000, 500000, 100000};
+	for (size_t budget : budgets){
+		std::unique_ptr<ProgressiveRenderer> progressive;
+		if (budget > 0){
+			progressive.reset(new ProgressiveRenderer{width, height, budget, static_cast<GLuint>(target)});
+		}
+		DepthSorter sorter, rest_sorter{false};
+		std::vector<double> moving, moving_prep, done;
+		int frames_to_done = 0;
+		double ms_to_done = 0;
+		for (int f = 0; f < moving_frames + idle_frames; ++f){
+			const int path_frame = std::min(f, moving_frames - 1);
+			const glm::vec3 eye{0, 0, 150 - 100.f * path_frame / moving_frames};
+			const Camera camera{eye, eye + glm::vec3{0.2f, 0, -1}, glm::vec3{0, 1, 0}};
+			const bool view_changed = f < moving_frames;
+			bench::Timer timer;
+			pipeline.set_view(camera.view_mat(), proj, eye);
+			//Drawing everything culls, sorts and uploads every frame, progressive rendering only the
+			//sample while moving and the rest of the instances once when the camera stops
+			size_t n_visible = 0;
+			if (!progressive || view_changed){
+				bvh.cull(billboard_frustum(camera.view_mat(), proj), spheres, ranges, isa);
+				if (progressive){
+					progressive->select(ranges, sample);
+				}
+				n_visible = sorter.sort(jobs, camera.view_mat(), instances.data(), progressive ? sample : ranges,
+					SortOrder::FRONT_TO_BACK, visible.data());
+				glBindBuffer(GL_ARRAY_BUFFER, instance_buf);
+				glBufferSubData(GL_ARRAY_BUFFER, 0, n_visible * sizeof(Instance), visible.data());
+			}
+			else if (progressive->needs_rest()){
+				Instance *rest = progressive->map_rest();
+				progressive->unmap_rest(rest_sorter.sort(jobs, camera.view_mat(), instances.data(),
+					progressive->rest_ranges(), SortOrder::FRONT_TO_BACK, rest));
+			}
+			const double prep_ms = timer.elapsed_ms();
+			const bool draw_frame = progressive ? progressive->begin(view_changed) : true;
+			if (!progressive){
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				setup_instance_attribs(instance_buf);
+				glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, n_visible);
+			}
+			else if (view_changed){
+				progressive->draw_sample(instance_buf, 0, n_visible);
+			}
+			else if (draw_frame){
+				progressive->draw_slice();
+			}
+			if (progressive){
+				progressive->end();
+			}
+			glFinish();
+			const double ms = timer.elapsed_ms();
+			if (view_changed){
+				moving.push_back(ms);
+				moving_prep.push_back(prep_ms);
+			}
+			else if (!progressive || !draw_frame){
+				done.push_back(ms);
+			}
+			//Drawing everything is done on the first frame after stopping
+			if (!view_changed && draw_frame && frames_to_done == 0){
+				ms_to_done += ms;
+				if (!progressive || progressive->is_complete()){
+					frames_to_done = f - moving_frames + 1;
+				}
+			}
+		}
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, budget == 0 ? reference.data() : image.data());
+		size_t changed = 0;
+		if (budget > 0){
+			for (size_t i = 0; i < image.size(); i += 4){
+				if (image[i] != reference[i] || image[i + 1] != reference[i + 1] || image[i + 2] != reference[i + 2]){
+					++changed;
+				}
+			}
+		}
+		const StatSummary m = summarize(moving);
+		const StatSummary mp = summarize(moving_prep);
+		const StatSummary d = summarize(done);
+		const std::string name = budget == 0 ? "everything" : "progressive " + std::to_string(budget);
+		std::cout << std::setw(20) << name << std::setw(16) << m.p50 << std::setw(16) << m.p99 << std::setw(16) << mp.p50 << std::setw(10)
+			<< (progressive ? progressive->slice_count() : 1) << std::setw(18) << frames_to_done << std::setw(14)
+			<< ms_to_done << std::setw(14) << d.p50 << 100.0 * changed / (width * height) << "%\n";
+	}
+	glDeleteBuffers(1, &instance_buf);
+	return 0;
+}
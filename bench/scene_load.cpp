@@ -0,0 +1,121 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <random>
+#include <string>
+#include <cstdio>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "instance.h"
+#include "scene_file.h"
+#include "scene_import.h"
+#include "frame_stats.h"
+#include "bench_util.h"
+
+/*
+ * Time loading a scene of billboards from a CSV file, from a binary scene file
+ * into the instance vector, and from a scene file straight into a GL buffer,
+ * both copying the chunks into a mapped buffer and passing the mapped file to
+ * glBufferSubData. Throughput is reported in GB/s of instance data. The files
+ * are written to --dir and are in the page cache when they're read, drop the
+ * page cache to include the disk. The CSV file only has --csv-instances since
+ * it's much slower to load
+ * usage: bench_scene_load [--instances N] [--csv-instances N] [--iters N] [--dir path] [--headless]
+ */
+int main(int argc, char **argv){
+	const size_t n = bench::arg_int(argc, argv, "--instances", 4000000);
+	const size_t n_csv = std::min(static_cast<size_t>(bench::arg_int(argc, argv, "--csv-instances", 500000)), n);
+	const int iters = bench::arg_int(argc, argv, "--iters", 5);
+	std::string dir = "./";
+	for (int i = 1; i < argc - 1; ++i){
+		if (std::string{argv[i]} == "--dir"){
+			dir = argv[i + 1];
+		}
+	}
+	bench::GLContext ctx;
+	if (!ctx.create(640, 480, bench::arg_flag(argc, argv, "--headless"))){
+		return 1;
+	}
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> pos_dist(-100.f, 100.f);
+	std::uniform_real_distribution<float> unit_dist(0.f, 1.f);
+	std::uniform_int_distribution<int> id_dist(0, 3);
+	std::vector<Instance> instances(n);
+	for (Instance &i : instances){
+		i = Instance{glm::vec3{pos_dist(rng), pos_dist(rng), pos_dist(rng)}, id_dist(rng), 0.2f,
+			pack_rgba8(glm::vec4{unit_dist(rng), unit_dist(rng), unit_dist(rng), 1}), unit_dist(rng)};
+	}
+	const std::string scene_file = dir + "bench_scene.vsbs";
+	const std::string csv_file = dir + "bench_scene.csv";
+	if (!write_scene_file(scene_file, instances)){
+		return 1;
+	}
+	{
+		std::ofstream csv(csv_file);
+		csv << "x,y,z,sprite_id,size,r,g,b,a,rotation\n";
+		for (size_t i = 0; i < n_csv; ++i){
+			const Instance &p = instances[i];
+			csv << p.pos.x << "," << p.pos.y << "," << p.pos.z << "," << p.sprite_id << "," << p.size << ","
+				<< (p.color & 0xff) / 255.f << "," << ((p.color >> 8) & 0xff) / 255.f << ","
+				<< ((p.color >> 16) & 0xff) / 255.f << ",1," << p.rotation << "\n";
+		}
+	}
+	GLuint buf;
+	glGenBuffers(1, &buf);
+	glBindBuffer(GL_ARRAY_BUFFER, buf);
+	glBufferData(GL_ARRAY_BUFFER, n * sizeof(Instance), NULL, GL_STATIC_DRAW);
+
+	std::cout << "Loading " << n << " instances (" << n * sizeof(Instance) / 1e6 << "MB), " << n_csv
+		<< " from CSV\n" << std::left << std::setw(26) << "path" << std::setw(12) << "p50 (ms)"
+		<< std::setw(12) << "max (ms)" << "GB/s\n" << std::fixed << std::setprecision(3);
+	const char *names[] = {"csv -> vector", "vsbs -> vector", "vsbs -> mapped buffer", "vsbs -> glBufferSubData"};
+	const Instance defaults{glm::vec3{0}, 0, 1, pack_rgba8(glm::vec4{1}), 0};
+	for (int mode = 0; mode < 4; ++mode){
+		std::vector<double> times;
+		size_t loaded = 0;
+		for (int i = 0; i < iters; ++i){
+			std::vector<Instance> out;
+			bench::Timer timer;
+			if (mode == 0){
+				if (!import_csv(csv_file, defaults, out)){
+					return 1;
+				}
+				loaded = out.size();
+			}
+			else {
+				SceneFile scene;
+				if (!scene.open(scene_file)){
+					return 1;
+				}
+				loaded = scene.size();
+				if (mode == 1){
+					scene.read_instances(out);
+				}
+				else if (mode == 2){
+					void *dst = glMapBufferRange(GL_ARRAY_BUFFER, 0, loaded * sizeof(Instance),
+						GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+					scene.copy_instances(dst);
+					glUnmapBuffer(GL_ARRAY_BUFFER);
+				}
+				else {
+					size_t offset = 0;
+					for (size_t c = 0; c < scene.chunk_count(); ++c){
+						glBufferSubData(GL_ARRAY_BUFFER, offset, scene.chunk(c).bytes, scene.chunk_instances(c));
+						offset += scene.chunk(c).bytes;
+					}
+				}
+				glFinish();
+			}
+			times.push_back(timer.elapsed_ms());
+		}
+		const StatSummary s = summarize(times);
+		std::cout << std::setw(26) << names[mode] << std::setw(12) << s.p50 << std::setw(12) << s.max
+			<< loaded * sizeof(Instance) / (s.p50 * 1e6) << "\n";
+	}
+	glDeleteBuffers(1, &buf);
+	std::remove(scene_file.c_str());
+	std::remove(csv_file.c_str());
+	return 0;
+}
+
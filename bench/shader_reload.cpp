@@ -0,0 +1,159 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <random>
+#include <string>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include "util.h"
+#include "instance.h"
+#include "program_cache.h"
+#include "shader_reload.h"
+#include "shader_preprocessor.h"
+#include "shader_variants.h"
+#include "frame_stats.h"
+#include "bench_util.h"
+
+/*
+ * Measure the frame hitch caused by hot reloading the billboard shaders,
+ * reloading synchronously on the render thread like we used to and through the
+ * background ShaderReloader. The shaders are copied to --dir and edited before
+ * each reload so every reload really compiles, --pad adds that many unused
+ * functions to the vertex shader to stand in for a larger shader. The program
+ * cache is off so it doesn't hide the compiles
+ * usage: bench_shader_reload [--instances N] [--reloads N] [--pad N] [--dir path] [--headless]
+ */
+namespace {
+	std::string padding(int n){
+		std::string pad;
+		for (int i = 0; i < n; ++i){
+			const std::string f = std::to_string(i);
+			pad += "vec4 pad" + f + "(vec4 x){ for (int i = 0; i < " + f + "; ++i){ x = sin(x * "
+				+ f + ".5) + cos(x.yzwx); } return normalize(x) * " + f + ".0; }\n";
+		}
+		return pad;
+	}
+	//Write the shader with a comment making it unique so drivers can't reuse an old compile
+	void write_shader(const std::string &file, const std::string &src, const std::string &pad, int version){
+		std::ofstream out(file);
+		//The #version line has to come first
+		const size_t line_end = src.find('\n');
+		out << src.substr(0, line_end + 1) << "// reload " << version << "\n" << pad << src.substr(line_end + 1);
+	}
+}
+
+int main(int argc, char **argv){
+	const size_t n = bench::arg_int(argc, argv, "--instances", 20000);
+	const int reloads = bench::arg_int(argc, argv, "--reloads", 5);
+	const int pad_fns = bench::arg_int(argc, argv, "--pad", 200);
+	std::string dir = "./";
+	for (int i = 1; i < argc - 1; ++i){
+		if (std::string{argv[i]} == "--dir"){
+			dir = argv[i + 1];
+		}
+	}
+
+	bench::GLContext ctx;
+	bench::BillboardPipeline pipeline;
+	if (!ctx.create(1280, 720, bench::arg_flag(argc, argv, "--headless")) || !pipeline.create()){
+		return 1;
+	}
+	//The copies are flattened so their includes don't need copying too
+	const std::string res_path = VSB_RES_DIR;
+	const std::vector<std::string> defines = variant_defines(feature_bit(ShaderFeature::SIZE)
+		| feature_bit(ShaderFeature::ROTATION));
+	ShaderSource vert, frag;
+	if (!preprocess_shader(res_path + "vertex.glsl", defines, vert)
+		|| !preprocess_shader(res_path + "fragment.glsl", defines, frag))
+	{
+		return 1;
+	}
+	const std::string &vert_src = vert.source;
+	const std::string &frag_src = frag.source;
+	const std::string pad = padding(pad_fns);
+	const ShaderReloader::ShaderList files = {std::make_tuple(GL_VERTEX_SHADER, dir + "bench_vertex.glsl"),
+		std::make_tuple(GL_FRAGMENT_SHADER, dir + "bench_fragment.glsl")};
+	int version = 0;
+	write_shader(dir + "bench_vertex.glsl", vert_src, pad, version++);
+	write_shader(dir + "bench_fragment.glsl", frag_src, "", 0);
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> pos_dist(-20.f, 20.f);
+	std::vector<Instance> instances(n);
+	for (Instance &i : instances){
+		i = Instance{glm::vec3{pos_dist(rng), pos_dist(rng), pos_dist(rng)}, 0, 0.2f, pack_rgba8(glm::vec4{1}), 0};
+	}
+	GLuint instance_buf;
+	glGenBuffers(1, &instance_buf);
+	glBindBuffer(GL_ARRAY_BUFFER, instance_buf);
+	glBufferData(GL_ARRAY_BUFFER, n * sizeof(Instance), instances.data(), GL_STATIC_DRAW);
+	setup_instance_attribs(instance_buf);
+	const glm::vec3 eye{0, 0, 30};
+	pipeline.set_view(glm::lookAt(eye, glm::vec3{0}, glm::vec3{0, 1, 0}),
+		glm::perspective<float>(util::deg_to_rad(75.f), 16.f / 9.f, 1, 100), eye);
+
+	ProgramCache no_cache{""};
+	std::cout << "Reloading a shader with " << pad_fns << " extra functions " << reloads << " times while drawing "
+		<< n << " instances\n" << std::left << std::setw(8) << "reload" << std::setw(10) << "parallel"
+		<< std::setw(14) << "frame (ms)" << std::setw(16) << "latency (ms)" << std::setw(20)
+		<< "render thread (ms)" << "max hitch (ms)\n" << std::fixed << std::setprecision(3);
+	for (bool async : {false, true}){
+		ShaderReloader reloader{no_cache, files, {}, async};
+		GLint program = pipeline.program;
+		std::vector<double> idle_frames;
+		double latency = 0, render = 0, last_frame_ms = 0;
+		for (int r = 0; r < reloads; ++r){
+			//Draw some frames without a reload in flight for a baseline frame time
+			for (int f = 0; f < 10; ++f){
+				bench::Timer timer;
+				reloader.update(last_frame_ms);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, n);
+				glFinish();
+				last_frame_ms = timer.elapsed_ms();
+				idle_frames.push_back(last_frame_ms);
+			}
+			write_shader(std::get<1>(files[0]), vert_src, pad, version++);
+			reloader.request();
+			while (reloader.busy()){
+				bench::Timer timer;
+				const GLint new_program = reloader.update(last_frame_ms);
+				if (new_program != -1){
+					if (program != pipeline.program){
+						glDeleteProgram(program);
+					}
+					program = new_program;
+					glUseProgram(program);
+					glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Viewing"), 0);
+					glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Colors"), 1);
+				}
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, n);
+				glFinish();
+				last_frame_ms = timer.elapsed_ms();
+			}
+			latency += reloader.reload_stats().last_latency_ms;
+			render += reloader.reload_stats().last_render_ms;
+		}
+		//Let it record the hitch of the frame the last program was swapped in on
+		reloader.update(last_frame_ms);
+		const ShaderReloadStats &stats = reloader.reload_stats();
+		std::cout << std::setw(8) << (async ? "async" : "sync") << std::setw(10)
+			<< (reloader.is_parallel() ? "yes" : "no") << std::setw(14) << summarize(idle_frames).p50
+			<< std::setw(16) << latency / reloads << std::setw(20) << render / reloads << stats.max_hitch_ms
+			<< "\n";
+		if (stats.failed > 0){
+			std::cout << stats.failed << " reloads failed to compile\n";
+		}
+		glUseProgram(pipeline.program);
+		if (program != pipeline.program){
+			glDeleteProgram(program);
+		}
+	}
+	std::remove(std::get<1>(files[0]).c_str());
+	std::remove(std::get<1>(files[1]).c_str());
+	glDeleteBuffers(1, &instance_buf);
+	return 0;
+}
@@ -0,0 +1,130 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <string>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include "util.h"
+#include "instance.h"
+#include "job_system.h"
+#include "program_cache.h"
+#include "shader_variants.h"
+#include "frame_stats.h"
+#include "bench_util.h"
+
+/*
+ * Time building every variant of the billboard shaders one at a time, compiling
+ * and waiting on each like load_program does, against ShaderVariants::build
+ * which preprocesses them on the job system and issues all the compiles before
+ * waiting on any. Then time drawing with some of the variants to see what the
+ * features we can leave out cost. The instances all have unit size and no
+ * rotation so each variant draws the same image. The program cache is off, on
+ * Mesa set MESA_SHADER_CACHE_DISABLE=true to keep its own cache out of the way
+ * usage: bench_shader_variants [--iters N] [--instances N] [--frames N] [--headless]
+ */
+int main(int argc, char **argv){
+	const int iters = bench::arg_int(argc, argv, "--iters", 3);
+	const size_t n = bench::arg_int(argc, argv, "--instances", 100000);
+	const int frames = bench::arg_int(argc, argv, "--frames", 60);
+
+	bench::GLContext ctx;
+	bench::BillboardPipeline pipeline;
+	if (!ctx.create(1280, 720, bench::arg_flag(argc, argv, "--headless")) || !pipeline.create()){
+		return 1;
+	}
+	const std::string res_path = VSB_RES_DIR;
+	const ShaderVariants::ShaderList files = {std::make_tuple(GL_VERTEX_SHADER, res_path + "vertex.glsl"),
+		std::make_tuple(GL_FRAGMENT_SHADER, res_path + "fragment.glsl")};
+	const std::vector<VariantKey> keys = all_variants();
+	ProgramCache no_cache{""};
+	JobSystem jobs;
+
+	std::cout << "Building " << keys.size() << " shader variants " << iters << " times, "
+		<< (ogl_ext_KHR_parallel_shader_compile == ogl_LOAD_SUCCEEDED ? "with" : "without")
+		<< " KHR_parallel_shader_compile\n" << std::left << std::setw(12) << "build" << std::setw(12)
+		<< "mean (ms)" << "max (ms)\n" << std::fixed << std::setprecision(3);
+	for (bool batched : {false, true}){
+		std::vector<double> times;
+		for (int i = 0; i < iters; ++i){
+			ShaderVariants variants{no_cache, files};
+			bench::Timer timer;
+			if (batched){
+				variants.build(jobs, keys);
+			}
+			else {
+				for (VariantKey k : keys){
+					variants.get(k);
+				}
+			}
+			//Make sure the driver has really finished the programs
+			for (VariantKey k : keys){
+				glUseProgram(variants.get(k));
+			}
+			glFinish();
+			times.push_back(timer.elapsed_ms());
+			if (variants.variant_stats().failed > 0){
+				std::cout << variants.variant_stats().failed << " variants failed to build\n";
+			}
+		}
+		const StatSummary s = summarize(times);
+		std::cout << std::setw(12) << (batched ? "batched" : "serial") << std::setw(12) << s.mean << s.max << "\n";
+	}
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> pos_dist(-20.f, 20.f);
+	std::uniform_int_distribution<int> id_dist(0, 3);
+	std::vector<Instance> instances(n);
+	for (Instance &i : instances){
+		i = Instance{glm::vec3{pos_dist(rng), pos_dist(rng), pos_dist(rng)}, id_dist(rng), 1,
+			pack_rgba8(glm::vec4{1}), 0};
+	}
+	GLuint instance_buf;
+	glGenBuffers(1, &instance_buf);
+	glBindBuffer(GL_ARRAY_BUFFER, instance_buf);
+	glBufferData(GL_ARRAY_BUFFER, n * sizeof(Instance), instances.data(), GL_STATIC_DRAW);
+	setup_instance_attribs(instance_buf);
+	const glm::vec3 eye{0, 0, 60};
+	pipeline.set_view(glm::lookAt(eye, glm::vec3{0}, glm::vec3{0, 1, 0}),
+		glm::perspective<float>(util::deg_to_rad(75.f), 16.f / 9.f, 1, 100), eye);
+	//An opaque white atlas so the textured variants draw the same image too
+	std::vector<uint8_t> white(64 * 64 * 4, 255);
+	GLuint atlas;
+	glGenTextures(1, &atlas);
+	glBindTexture(GL_TEXTURE_2D, atlas);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 64, 64, 0, GL_RGBA, GL_UNSIGNED_BYTE, white.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+	const VariantKey size_rot = feature_bit(ShaderFeature::SIZE) | feature_bit(ShaderFeature::ROTATION);
+	const VariantKey atlas_alpha = feature_bit(ShaderFeature::ATLAS) | feature_bit(ShaderFeature::ALPHA_TEST);
+	const std::vector<VariantKey> draw_keys = {0, feature_bit(ShaderFeature::SIZE),
+		feature_bit(ShaderFeature::ROTATION), size_rot, atlas_alpha, size_rot | atlas_alpha};
+	ShaderVariants variants{no_cache, files};
+	variants.build(jobs, draw_keys);
+	std::cout << "Drawing " << n << " instances for " << frames << " frames\n" << std::setw(32) << "variant"
+		<< std::setw(12) << "p50 (ms)" << "p95 (ms)\n";
+	for (VariantKey k : draw_keys){
+		const GLint program = variants.get(k);
+		glUseProgram(program);
+		glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Viewing"), 0);
+		glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Colors"), 1);
+		//Warm up so the driver's first use of the program isn't counted
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, n);
+		glFinish();
+		std::vector<double> times;
+		for (int f = 0; f < frames; ++f){
+			bench::Timer timer;
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, n);
+			glFinish();
+			times.push_back(timer.elapsed_ms());
+		}
+		const StatSummary s = summarize(times);
+		std::cout << std::setw(32) << variant_name(k) << std::setw(12) << s.p50 << s.p95 << "\n";
+	}
+	glUseProgram(pipeline.program);
+	glDeleteTextures(1, &atlas);
+	glDeleteBuffers(1, &instance_buf);
+	return 0;
+}
+
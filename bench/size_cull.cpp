@@ -0,0 +1,124 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <string>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include "util.h"
+#include "instance.h"
+#include "job_system.h"
+#include "cull.h"
+#include "bvh.h"
+#include "frame_stats.h"
+#include "bench_util.h"
+
+/*
+ * Draw a dense field of small billboards stretching far away from the camera,
+ * where most of them are well under a pixel, and compare drawing everything in
+ * the frustum against also culling the billboards under a few pixel thresholds,
+ * with and without the MIN_SIZE shader growing what's left to at least a pixel.
+ * Reports the instances culled for their size, the cull and frame times and the
+ * fraction of pixels that differ from the image drawn without size culling
+ * usage: bench_size_cull [--instances N] [--frames N] [--headless]
+ */
+namespace {
+	struct Mode {
+		std::string name;
+		float min_px, clamp_px;
+	};
+}
+
+int main(int argc, char **argv){
+	const size_t n = bench::arg_int(argc, argv, "--instances", 8000000);
+	const int frames = bench::arg_int(argc, argv, "--frames", 30);
+	const int width = 640, height = 480;
+	bench::GLContext ctx;
+	if (!ctx.create(width, height, bench::arg_flag(argc, argv, "--headless"))){
+		return 1;
+	}
+	//A slab from just in front of the camera out to 1000 units away, spread out so
+	//there's as many billboards at each depth
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> unit_dist(0.f, 1.f);
+	std::uniform_int_distribution<int> id_dist(0, 3);
+	std::vector<Instance> instances(n);
+	for (Instance &i : instances){
+		const float z = -2 - 998 * unit_dist(rng);
+		const float extent = -z * 0.8f;
+		i = Instance{glm::vec3{extent * (2 * unit_dist(rng) - 1), extent * (2 * unit_dist(rng) - 1), z},
+			id_dist(rng), 0.05f, pack_rgba8(glm::vec4{unit_dist(rng), unit_dist(rng), unit_dist(rng), 1}),
+			unit_dist(rng)};
+	}
+	JobSystem jobs;
+	BVH bvh;
+	bvh.build(jobs, instances);
+	InstanceSoA spheres;
+	spheres.assign(instances.data(), n);
+	const CullISA isa = best_cull_isa();
+
+	GLuint instance_buf;
+	glGenBuffers(1, &instance_buf);
+	glBindBuffer(GL_ARRAY_BUFFER, instance_buf);
+	glBufferData(GL_ARRAY_BUFFER, n * sizeof(Instance), NULL, GL_STREAM_DRAW);
+	std::vector<Instance> visible(n);
+	std::vector<DrawRange> ranges;
+	std::vector<uint8_t> reference(width * height * 4), image(width * height * 4);
+
+	const glm::mat4 proj = glm::perspective<float>(util::deg_to_rad(75.f), static_cast<float>(width) / height,
+		1, 1000);
+	const glm::mat4 view = glm::lookAt(glm::vec3{0}, glm::vec3{0, 0, -1}, glm::vec3{0, 1, 0});
+	const Frustum frustum = billboard_frustum(view, proj);
+	const std::vector<Mode> modes = {
+		Mode{"no size culling", 0, 0}, Mode{"cull < 0.5px", 0.5f, 0}, Mode{"cull < 1px", 1, 0},
+		Mode{"cull < 2px", 2, 0}, Mode{"cull < 1px, grow to 1px", 1, 1}
+	};
+	std::cout << "Drawing " << n << " instances at " << width << "x" << height << " over " << frames
+		<< " frames\n" << std::left << std::setw(26) << "mode" << std::setw(12) << "drawn" << std::setw(14)
+		<< "size culled" << std::setw(10) << "cull ms" << std::setw(10) << "p50 ms" << std::setw(10)
+		<< "p99 ms" << "pixels changed\n" << std::fixed << std::setprecision(3);
+	for (size_t m = 0; m < modes.size(); ++m){
+		const Mode &mode = modes[m];
+		bench::BillboardPipeline pipeline;
+		VariantKey variant = feature_bit(ShaderFeature::SIZE) | feature_bit(ShaderFeature::ROTATION);
+		if (mode.clamp_px > 0){
+			variant |= feature_bit(ShaderFeature::MIN_SIZE);
+		}
+		if (!pipeline.create(variant)){
+			return 1;
+		}
+		pipeline.set_view(view, proj, glm::vec3{0}, glm::vec4{width, height, mode.clamp_px, 0});
+		const ScreenSizeCull size_cull = screen_size_cull(view, proj, height, mode.min_px);
+		std::vector<double> times;
+		double cull_ms = 0;
+		BVHCullStats stats;
+		for (int f = 0; f < frames; ++f){
+			bench::Timer timer;
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			bvh.cull(frustum, spheres, ranges, isa, &stats, mode.min_px > 0 ? &size_cull : nullptr);
+			const size_t n_visible = copy_ranges(jobs, ranges, instances.data(), visible.data());
+			cull_ms += timer.elapsed_ms();
+			glBindBuffer(GL_ARRAY_BUFFER, instance_buf);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, n_visible * sizeof(Instance), visible.data());
+			setup_instance_attribs(instance_buf);
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, n_visible);
+			glFinish();
+			times.push_back(timer.elapsed_ms());
+		}
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, m == 0 ? reference.data() : image.data());
+		size_t changed = 0;
+		if (m > 0){
+			for (size_t i = 0; i < image.size(); i += 4){
+				if (image[i] != reference[i] || image[i + 1] != reference[i + 1] || image[i + 2] != reference[i + 2]){
+					++changed;
+				}
+			}
+		}
+		const StatSummary s = summarize(times);
+		std::cout << std::setw(26) << mode.name << std::setw(12) << stats.visible << std::setw(14)
+			<< stats.size_culled << std::setw(10) << cull_ms / frames << std::setw(10) << s.p50
+			<< std::setw(10) << s.p99 << 100.0 * changed / (width * height) << "%\n";
+	}
+	glDeleteBuffers(1, &instance_buf);
+	return 0;
+}
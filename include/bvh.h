@@ -0,0 +1,98 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "instance.h"
+#include "job_system.h"
+#include "cull.h"
+
+/*
+ * A contiguous range of instances [first, first + count)
+ */
+struct DrawRange {
+	uint32_t first, count;
+};
+/*
+ * Append the range to the list, merging it into the last range if it continues it
+ */
+void push_range(std::vector<DrawRange> &ranges, uint32_t first, uint32_t count);
+
+/*
+ * A node in the BVH, every node covers a contiguous range of the Morton
+ * ordered instances. Leaves have left == right == 0 since the root can't
+ * be a child of any node
+ */
+struct BVHNode {
+	glm::vec3 lower, upper;
+	//Smallest and largest bounding sphere radius of the node's instances, for size culling
+	float min_radius, max_radius;
+	uint32_t first, count;
+	uint32_t left, right;
+
+	bool is_leaf() const {
+		return left == 0;
+	}
+};
+
+/*
+ * Counters for a hierarchical culling traversal of the BVH
+ */
+struct BVHCullStats {
+	size_t nodes_visited;
+	//Nodes completely inside the frustum that were emitted as a single range
+	size_t nodes_inside;
+	//Instances in partially visible leaves that had to be tested individually
+	size_t instances_tested;
+	size_t visible;
+	//Instances culled for being too small on screen. Whole nodes are culled by their largest
+	//instance before testing their instances so this can include some outside the frustum
+	size_t size_culled;
+
+	BVHCullStats() : nodes_visited(0), nodes_inside(0), instances_tested(0), visible(0), size_culled(0){}
+};
+
+/*
+ * A static linear BVH (LBVH) over the billboard instances. Building sorts the
+ * instances by the Morton code of their position so every subtree covers a
+ * contiguous range of instances and then splits the ranges on the highest
+ * differing Morton code bit. Culling walks the tree and emits the ranges of
+ * nodes completely inside the frustum directly, only testing the instances of
+ * leaves straddling its boundary
+ */
+class BVH {
+	std::vector<BVHNode> nodes;
+
+public:
+	/*
+	 * Build the BVH over the instances in parallel, the instances are reordered in
+	 * place. If order is not null it's filled with the original index of each
+	 * reordered instance. Leaves will hold at most leaf_size instances unless
+	 * more than that many share the same Morton code
+	 */
+	void build(JobSystem &jobs, std::vector<Instance> &instances, std::vector<uint32_t> *order = nullptr,
+		size_t leaf_size = 64);
+	/*
+	 * Cull the BVH against the frustum and write the visible ranges of instances
+	 * to ranges, adjacent ranges are merged. spheres are the SoA bounds of the
+	 * reordered instances and are used to test instances in partially visible leaves.
+	 * If size_cull is set instances too small on screen are culled as well, nodes
+	 * whose largest instance is too small are skipped without visiting their instances
+	 */
+	void cull(const Frustum &frustum, const InstanceSoA &spheres, std::vector<DrawRange> &ranges,
+		CullISA isa, BVHCullStats *stats = nullptr, const ScreenSizeCull *size_cull = nullptr) const;
+	const std::vector<BVHNode>& node_list() const;
+	size_t memory_bytes() const;
+};
+
+/*
+ * Copy the instances in the ranges from src to be packed contiguously in dst,
+ * the copies are split over the job system. Returns the number of instances copied
+ */
+size_t copy_ranges(JobSystem &jobs, const std::vector<DrawRange> &ranges, const Instance *src,
+	Instance *dst);
+
+#endif
+
@@ -0,0 +1,183 @@
+#ifndef CHUNK_STREAM_H
+#define CHUNK_STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include "gl_core_3_3.h"
+#include "instance.h"
+#include "cull.h"
+#include "scene_file.h"
+
+/*
+ * Counters for the chunk streaming, per frame or summed over all frames
+ */
+struct ChunkStreamStats {
+	//Chunks in the GPU pool and chunks being read or waiting to be uploaded
+	size_t resident, pending;
+	//Chunks in the frustum, how many of those weren't resident yet so couldn't be drawn
+	//and how many were drawn
+	size_t visible, missing, drawn;
+	//Chunks uploaded to the pool, evicted from it and read before they were visible
+	size_t loads, evictions, prefetches;
+	//Uploads put off because the only chunks we could evict were still being drawn by the GPU
+	size_t deferred;
+	size_t upload_bytes;
+	//Time spent uploading chunks on the render thread
+	double upload_ms;
+
+	ChunkStreamStats() : resident(0), pending(0), visible(0), missing(0), drawn(0), loads(0), evictions(0),
+		prefetches(0), deferred(0), upload_bytes(0), upload_ms(0)
+	{}
+};
+
+/*
+ * A chunk to stream, visible chunks are drawn once they're resident while the
+ * others are only read ahead of being needed
+ */
+struct StreamChunk {
+	uint32_t chunk;
+	bool visible;
+};
+
+/*
+ * Streams the chunks of a scene file too big to keep in memory or on the GPU
+ * through a fixed pool of chunk slots in one GL buffer, allocated once. Each
+ * frame the chunks in the frustum are wanted nearest to the eye first, followed
+ * by chunks around a point ahead of the camera along the view direction so we
+ * read them before they come into view. Wanted chunks that aren't resident are
+ * read from the mapped file by a pool of I/O threads into CPU staging buffers,
+ * so the page faults happen off the render thread, and the render thread uploads
+ * staged chunks up to a byte budget per frame. When the pool is full the least
+ * recently wanted chunk is evicted, as long as the GPU is done with the frames
+ * that drew it, so we never write over a slot a draw may still be reading and
+ * make the driver stall or copy the buffer. Visible chunks that aren't resident yet are
+ * skipped until they arrive instead of stalling the frame. Other ways of picking
+ * the chunks, like the level of detail selection in LodOctree, can pass the
+ * chunks they want in priority order instead.
+ *
+ * Usage each frame: update() with the camera, upload() then draw()
+ */
+class ChunkStreamer {
+	enum class ChunkState : uint8_t { ON_DISK, READING, STAGED, RESIDENT };
+	struct ChunkEntry {
+		ChunkState state;
+		bool visible;
+		//Slot in the pool when resident, staging buffer while reading or staged
+		int32_t slot, staging;
+		//Last frame the chunk was wanted, for LRU eviction, and its place in the wanted list then
+		uint32_t last_wanted, rank;
+
+		ChunkEntry() : state(ChunkState::ON_DISK), visible(false), slot(-1), staging(-1), last_wanted(0), rank(0){}
+	};
+	struct ReadRequest {
+		uint32_t chunk;
+		int32_t staging;
+	};
+	//Signalled once the GPU has finished the draws of the frame
+	struct DrawFence {
+		uint32_t frame;
+		GLsync fence;
+	};
+
+	SceneFile &scene;
+	size_t slot_bytes, upload_budget;
+	float prefetch_distance;
+	GLuint pool;
+	//The chunk in each slot of the pool or -1 if it's free
+	std::vector<int64_t> slots;
+	//The last frame each slot was drawn in, 0 if it hasn't been
+	std::vector<uint32_t> slot_drawn;
+	//Fences after each frame's draws that the GPU hasn't finished yet, oldest first,
+	//and the last frame the GPU has finished drawing
+	std::deque<DrawFence> draw_fences;
+	uint32_t gpu_done_frame;
+	std::vector<ChunkEntry> chunks;
+	std::vector<std::vector<Instance>> staging;
+	std::vector<int32_t> free_staging;
+	//The chunks wanted this frame in priority order and the resident visible ones to draw
+	std::vector<StreamChunk> wanted;
+	std::vector<uint32_t> draw_list;
+	//The visible chunks uploaded this frame, which change what's drawn
+	std::vector<uint32_t> uploads;
+	uint32_t frame;
+	size_t n_resident, n_pending;
+	ChunkStreamStats frame_counters, total;
+
+	//I/O thread state, protected by the mutex
+	std::vector<std::thread> io_threads;
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	std::deque<ReadRequest> requests;
+	std::vector<uint32_t> finished;
+	std::function<void()> read_callback;
+	bool quit;
+
+public:
+	/*
+	 * Stream the scene's chunks through a GPU pool of pool_bytes, rounded down to
+	 * a whole number of chunks. Chunks are read by io_threads threads, with no I/O
+	 * threads they're read and uploaded on the render thread in update() as soon
+	 * as they're wanted. Uploads are capped at upload_budget bytes per frame, 0
+	 * doesn't limit them. Chunks within prefetch_distance of the point
+	 * prefetch_distance ahead of the eye are read before they're visible
+	 */
+	ChunkStreamer(SceneFile &scene, size_t pool_bytes, unsigned io_threads = 2,
+		size_t upload_budget = 8 * 1024 * 1024, float prefetch_distance = 10);
+	~ChunkStreamer();
+	ChunkStreamer(const ChunkStreamer&) = delete;
+	ChunkStreamer& operator=(const ChunkStreamer&) = delete;
+	/*
+	 * Pick the chunks to keep resident for the camera and request reads of the
+	 * ones that aren't, in priority order
+	 */
+	void update(const glm::vec3 &eye, const glm::vec3 &view_dir, const Frustum &frustum);
+	/*
+	 * Stream the chunks in the list, which is in priority order, instead of picking them for a camera
+	 */
+	void update(const std::vector<StreamChunk> &chunk_list);
+	/*
+	 * Upload the chunks that finished reading to the pool, evicting the least
+	 * recently wanted chunks to make room, then pick the resident visible chunks to draw
+	 */
+	void upload();
+	/*
+	 * Draw the resident visible chunks front to back, the billboard shader and VAO
+	 * should be bound. Returns the number of instances drawn
+	 */
+	size_t draw();
+	/*
+	 * Call the callback from the I/O threads each time they finish reading a chunk, e.g.
+	 * to wake up a render loop waiting for something new to draw. Set it before the first update
+	 */
+	void set_read_callback(std::function<void()> callback);
+	/*
+	 * The visible chunks uploaded this frame, the parts of the frame that changed if the camera didn't move
+	 */
+	const std::vector<uint32_t>& frame_uploads() const;
+	size_t pool_slots() const;
+	const ChunkStreamStats& frame_stats() const;
+	const ChunkStreamStats& total_stats() const;
+
+private:
+	void io_loop();
+	//Copy the chunk out of the mapped file into the staging buffer, this is where it's read from disk
+	void read_chunk(uint32_t chunk, std::vector<Instance> &buf);
+	//Copy the staged chunk into a slot in the pool, which must be bound to GL_ARRAY_BUFFER.
+	//Returns the bytes uploaded or 0 if there was no slot to put it in
+	size_t upload_chunk(uint32_t chunk);
+	//Find a free slot or evict the least recently wanted chunk not wanted this frame and
+	//not drawn in a frame the GPU may still be working on, returns -1 if there's none
+	int64_t find_slot();
+	//Check which frames' draws the GPU has finished without waiting on it
+	void retire_fences();
+};
+
+#endif
+
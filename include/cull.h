@@ -0,0 +1,144 @@
+#ifndef CULL_H
+#define CULL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <glm/glm.hpp>
+#include "instance.h"
+#include "job_system.h"
+
+/*
+ * The six planes of a view frustum, stored as (normal, distance) with the
+ * normals pointing in to the frustum and normalized so the distance of a
+ * point p to the plane is dot(plane.xyz, p) + plane.w
+ */
+struct Frustum {
+	std::array<glm::vec4, 6> planes;
+};
+
+/*
+ * How a bounding volume overlaps the frustum
+ */
+enum class Overlap { OUTSIDE, INTERSECTS, INSIDE };
+
+/*
+ * Instance bounding spheres in SoA layout so the culling kernels can
+ * load a full SIMD register of each component at once
+ */
+struct InstanceSoA {
+	std::vector<float> x, y, z, radius;
+
+	/*
+	 * Fill the SoA arrays with the bounding spheres of the instances
+	 */
+	void assign(const Instance *instances, size_t n);
+	size_t size() const;
+};
+
+/*
+ * Culls billboards too small on screen to be worth drawing. The billboards are
+ * drawn with only the view's translation (see billboard_view) so how big one is
+ * on screen only depends on its radius and how far it is in front of the eye along -z
+ */
+struct ScreenSizeCull {
+	//Pixels a unit of world size covers one unit in front of the eye
+	float px_per_unit;
+	//The eye's z, a point at z is eye_z - z in front of it
+	float eye_z;
+	//Billboards whose bounding sphere is less than this many pixels across are culled
+	float min_px;
+
+	/*
+	 * Check if a bounding sphere of the radius with its nearest point at z is at least
+	 * min_px pixels across. Spheres reaching the eye are kept, the frustum culls those
+	 */
+	bool large_enough(float radius, float z) const {
+		const float depth = eye_z - z;
+		return depth <= 0 || 2 * radius * px_per_unit >= min_px * depth;
+	}
+};
+
+/*
+ * The instruction sets we have culling kernels for
+ */
+enum class CullISA { SCALAR, SSE, AVX };
+
+/*
+ * Extract the frustum planes from a combined projection * view matrix
+ */
+Frustum extract_frustum(const glm::mat4 &proj_view);
+/*
+ * Get the view matrix the billboards are actually rendered with. vertex.glsl
+ * drops the rotation from the view matrix and only keeps its translation
+ * so we do the same here to work with what ends up on screen
+ */
+glm::mat4 billboard_view(const glm::mat4 &view);
+/*
+ * Get the frustum the billboards are rendered with, see billboard_view
+ */
+Frustum billboard_frustum(const glm::mat4 &view, const glm::mat4 &proj);
+/*
+ * Setup culling billboards smaller than min_px pixels across for the view and projection
+ * they're drawn with and the height of the viewport in pixels
+ */
+ScreenSizeCull screen_size_cull(const glm::mat4 &view, const glm::mat4 &proj, float viewport_height, float min_px);
+/*
+ * Test an axis aligned box against the frustum
+ */
+Overlap test_aabb(const Frustum &frustum, const glm::vec3 &lower, const glm::vec3 &upper);
+/*
+ * Radius of the bounding sphere of an instance's quad
+ */
+float instance_radius(const Instance &instance);
+/*
+ * Check if the ISA is supported by the CPU we're running on and was compiled in
+ */
+bool cull_isa_supported(CullISA isa);
+/*
+ * Get the best supported ISA to cull with
+ */
+CullISA best_cull_isa();
+const char* cull_isa_name(CullISA isa);
+/*
+ * Test the bounding spheres in [begin, end) against the frustum and write the
+ * indices of the ones that are at least partially inside to out, which must
+ * have room for end - begin indices. Returns the number of visible spheres
+ */
+size_t cull_spheres(const Frustum &frustum, const InstanceSoA &spheres, size_t begin, size_t end,
+	uint32_t *out, CullISA isa);
+/*
+ * Cull the instances in [begin, end) and compact the visible ones into out, which
+ * can point directly into a mapped instance buffer. The spheres should be the SoA
+ * bounds of the instances. Returns the number of instances written
+ */
+size_t cull_instances(const Frustum &frustum, const InstanceSoA &spheres, const Instance *instances,
+	size_t begin, size_t end, Instance *out, CullISA isa);
+
+/*
+ * Culls and compacts instances across the workers of a job system. The
+ * instances are split into chunks which are culled in parallel, a prefix sum
+ * over the per-chunk visible counts then gives each chunk a disjoint range of
+ * the output that it copies its visible instances into
+ */
+class ParallelCuller {
+	JobSystem &jobs;
+	size_t chunk_size;
+	//Indices of the visible instances, each chunk writes to its own range
+	std::vector<uint32_t> visible;
+	//Offset of each chunk's visible instances in the output
+	std::vector<size_t> chunk_offsets;
+
+public:
+	ParallelCuller(JobSystem &jobs, size_t chunk_size = 16384);
+	/*
+	 * Cull the n instances and write the visible ones to out, returns the
+	 * number of instances written
+	 */
+	size_t cull(const Frustum &frustum, const InstanceSoA &spheres, const Instance *instances, size_t n,
+		Instance *out, CullISA isa);
+};
+
+#endif
+
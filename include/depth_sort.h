@@ -0,0 +1,116 @@
+#ifndef DEPTH_SORT_H
+#define DEPTH_SORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "instance.h"
+#include "job_system.h"
+#include "radix_sort.h"
+#include "bvh.h"
+
+/*
+ * The order to draw the visible instances in. Alpha blended sprites must be
+ * drawn back to front, opaque ones are best drawn front to back so early-z
+ * can reject the hidden ones
+ */
+enum class SortOrder { NONE, BACK_TO_FRONT, FRONT_TO_BACK };
+
+const char* sort_order_name(SortOrder order);
+/*
+ * Map a float to a 32 bit key whose unsigned integer order matches the
+ * float's order, including negative values
+ */
+uint32_t float_sort_key(float f);
+
+/*
+ * Counters for the depth sorts run by a DepthSorter
+ */
+struct DepthSortStats {
+	size_t sorted;
+	//Sorts that started from the previous order and ones that ran the full radix sort,
+	//an incremental sort that hit the disorder limit counts as both
+	size_t incremental, full;
+	//Inversions fixed by the insertion passes of incremental sorts
+	size_t inversions_fixed;
+	double sort_ms;
+	//Estimated time saved by sorting incrementally instead of with the full radix sort,
+	//negative if the incremental sort had to fall back
+	double saved_ms;
+
+	DepthSortStats() : sorted(0), incremental(0), full(0), inversions_fixed(0), sort_ms(0), saved_ms(0){}
+};
+
+/*
+ * Sorts the visible instances by their view space depth each frame. The
+ * depths are converted to sortable 32 bit keys and the instance indices
+ * sorted by them with the parallel radix sort, the instances are then
+ * gathered in sorted order into the output which can be a mapped buffer.
+ *
+ * The camera only moves a little each frame so the order barely changes between
+ * frames. When sorting incrementally we start from the previous frame's order,
+ * drop the instances that are no longer visible, append the newly visible ones
+ * and fix the order up with insertion sort passes, which take linear time plus
+ * one step per inversion. If there are more than disorder_limit inversions per
+ * instance the insertion passes give up and we fall back to the full radix sort
+ */
+class DepthSorter {
+	RadixSorter<uint32_t> sorter;
+	std::vector<uint32_t> keys, order, new_keys, new_order;
+	std::vector<size_t> offsets, chunk_inversions;
+	//Marks which instances are visible this frame and which of those were kept from the last
+	std::vector<uint32_t> stamps;
+	uint32_t stamp;
+	bool incremental;
+	float disorder_limit;
+	SortOrder prev_order;
+	//Running average of the full radix sort's cost, to estimate the time saved
+	double full_ms_per_instance;
+	DepthSortStats frame, total;
+
+	/*
+	 * Rebuild the order from the previous frame's sorted order for the instances
+	 * in the visible ranges, the ones that weren't visible last frame are appended
+	 * to the end. Returns the number of instances kept from last frame
+	 */
+	size_t coherent_order(const std::vector<DrawRange> &ranges);
+	/*
+	 * Merge the sorted newly visible instances in new_keys and new_order with
+	 * the sorted n_kept instances at the front of keys and order
+	 */
+	void merge_sorted(size_t n_kept);
+	/*
+	 * Insertion sort the keys and order in [begin, end), stopping once more than
+	 * max_inversions have been fixed. Returns the number of inversions fixed
+	 */
+	static size_t insertion_sort(std::vector<uint32_t> &keys, std::vector<uint32_t> &order,
+		size_t begin, size_t end, size_t max_inversions);
+
+public:
+	DepthSorter(bool incremental = true, float disorder_limit = 2);
+	/*
+	 * Sort the instances in the visible ranges by their depth under the view
+	 * matrix and write them to out in sorted order. With SortOrder::NONE the
+	 * instances are just copied. Returns the number of instances written
+	 */
+	size_t sort(JobSystem &jobs, const glm::mat4 &view, const Instance *instances,
+		const std::vector<DrawRange> &ranges, SortOrder sort_order, Instance *out);
+	/*
+	 * The sorted instance indices from the last call to sort
+	 */
+	const std::vector<uint32_t>& sorted_indices() const;
+	/*
+	 * Enable or disable incremental sorting, the next sort will always be a full sort
+	 */
+	void set_incremental(bool incremental);
+	bool is_incremental() const;
+	/*
+	 * Get the stats of the last sort or the totals of all sorts run
+	 */
+	const DepthSortStats& frame_stats() const;
+	const DepthSortStats& total_stats() const;
+};
+
+#endif
+
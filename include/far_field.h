@@ -0,0 +1,111 @@
+#ifndef FAR_FIELD_H
+#define FAR_FIELD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <glm/glm.hpp>
+#include "gl_core_3_3.h"
+#include "instance.h"
+#include "job_system.h"
+#include "cull.h"
+#include "bvh.h"
+#include "program_cache.h"
+
+/*
+ * Counters for the far field, per frame or summed over all frames
+ */
+struct FarFieldStats {
+	//Visible instances drawn as billboards and splatted into the far field
+	size_t near, far;
+	//Time spent splitting the visible instances, binning the far ones into
+	//the grids and resolving the grids into the texture
+	double split_ms, splat_ms, resolve_ms;
+
+	FarFieldStats() : near(0), far(0), split_ms(0), splat_ms(0), resolve_ms(0){}
+};
+
+/*
+ * Draws the billboards further than far_distance from the eye as a density
+ * splat instead of one quad each. Millions of far away billboards land on
+ * a handful of pixels, so drawing them is mostly overdraw. The far
+ * instances are binned into a screen space grid of their color weighted by how
+ * much of a cell each covers, each worker bins into its own grid so there's no
+ * atomics or locking, and the grids are summed into a texture drawn as a single
+ * full screen layer behind the near billboards. A cell's opacity is the chance
+ * a cell is covered by billboards of that total area spread randomly over it,
+ * 1 - e^-coverage, and its color the coverage weighted average of theirs.
+ * Occlusion between far billboards is lost, they're blended by coverage instead
+ *
+ * Usage each frame: split() the visible ranges, splat() then draw() before drawing the near instances
+ */
+class FarFieldSplat {
+public:
+	typedef std::vector<std::tuple<GLenum, std::string>> ShaderList;
+
+private:
+	size_t width, height;
+	float far_distance;
+	//A grid per worker of the premultiplied color and coverage of the far instances in each cell
+	std::vector<std::vector<glm::vec4>> grids;
+	std::vector<uint8_t> pixels;
+	//The visible ranges beyond far_distance and where each starts in the far instances
+	std::vector<DrawRange> far_ranges;
+	std::vector<size_t> far_offsets;
+	GLint program;
+	GLuint texture, vao;
+	FarFieldStats frame_counters, total;
+
+public:
+	/*
+	 * Splat the billboards further than far_distance into a width x height grid, which
+	 * is stretched over the viewport. Call create to make the GL objects
+	 */
+	FarFieldSplat(size_t width, size_t height, float far_distance);
+	~FarFieldSplat();
+	FarFieldSplat(const FarFieldSplat&) = delete;
+	FarFieldSplat& operator=(const FarFieldSplat&) = delete;
+	/*
+	 * Get the compositing shaders in the resource path, e.g. to watch them with a ShaderReloader
+	 */
+	static ShaderList shader_files(const std::string &res_path);
+	/*
+	 * Create the texture and load the compositing shaders from the resource path through
+	 * the program cache, returns false if the shaders couldn't be built. The compositing
+	 * program is left bound, see set_program
+	 */
+	bool create(ProgramCache &cache, const std::string &res_path);
+	/*
+	 * Swap in a rebuilt compositing program, e.g. from a ShaderReloader, and delete the old
+	 * one. The program is left bound so its sampler can be set, rebind yours after
+	 */
+	void set_program(GLint program);
+	/*
+	 * Split the visible ranges into the near ones to draw as billboards, which are
+	 * written to near, and the far ones to splat. spheres are the bounds of the
+	 * instances, an instance is far if its bounding sphere is entirely beyond far_distance
+	 */
+	void split(const std::vector<DrawRange> &visible, const InstanceSoA &spheres, const glm::mat4 &view,
+		std::vector<DrawRange> &near);
+	/*
+	 * Bin the far instances into the grids in parallel, sum them and upload the result to the
+	 * texture. sprite_colors are the colors of each sprite's vertices, like the Colors block
+	 */
+	void splat(JobSystem &jobs, const Instance *instances, const glm::mat4 &view, const glm::mat4 &proj,
+		const std::array<glm::vec4, 16> &sprite_colors);
+	/*
+	 * Draw the far field over the viewport with blending and without the depth test.
+	 * Its program, VAO, blending and depth test are left as they were for the draw,
+	 * the caller knows what it had set and restores its own state after
+	 */
+	void draw();
+	float distance() const;
+	const FarFieldStats& frame_stats() const;
+	const FarFieldStats& total_stats() const;
+};
+
+#endif
+
@@ -0,0 +1,72 @@
+#ifndef FILE_VIEW_H
+#define FILE_VIEW_H
+
+#include <cstddef>
+#include <string>
+
+/*
+ * How a file view will be read, passed to the OS as a hint so it can
+ * read ahead aggressively or skip read ahead entirely
+ *  NORMAL: no hint, the OS default read ahead
+ *  SEQUENTIAL: read front to back, read ahead aggressively and drop pages behind us
+ *  RANDOM: read in no particular order, don't read ahead
+ */
+enum class FileAccess { NORMAL, SEQUENTIAL, RANDOM };
+
+/*
+ * A read-only memory mapped view of a file. The file's contents are paged in
+ * from the page cache as they're touched instead of being copied into a buffer,
+ * so large files can be read without a copy or holding all of them in memory.
+ * On POSIX systems the access hint is passed to madvise, on Windows it's passed
+ * to CreateFile as the sequential scan or random access flag
+ */
+class FileView {
+	const char *ptr;
+	size_t len;
+	bool opened;
+#ifdef _WIN32
+	void *file, *mapping;
+#endif
+
+public:
+	FileView();
+	/*
+	 * Map the file, check is_open to see if it succeeded
+	 */
+	FileView(const std::string &file, FileAccess access = FileAccess::SEQUENTIAL);
+	~FileView();
+	FileView(FileView &&other);
+	FileView& operator=(FileView &&other);
+	FileView(const FileView&) = delete;
+	FileView& operator=(const FileView&) = delete;
+	/*
+	 * Map the file, unmapping the file we had open. Returns false and logs why
+	 * if the file couldn't be mapped. Empty files open with a null data pointer
+	 */
+	bool open(const std::string &file, FileAccess access = FileAccess::SEQUENTIAL);
+	void close();
+	/*
+	 * Change the access hint for the bytes [offset, offset + count) of the view,
+	 * a count of 0 goes to the end of the file. Does nothing on Windows
+	 */
+	void advise(FileAccess access, size_t offset = 0, size_t count = 0);
+	/*
+	 * Ask the OS to start paging in the bytes [offset, offset + count) since
+	 * we'll read them soon. Does nothing on Windows
+	 */
+	void prefetch(size_t offset, size_t count);
+	/*
+	 * Tell the OS we're done with the bytes [offset, offset + count) for now so
+	 * their pages can be dropped from the mapping, reading them again pages them
+	 * back in from the file. Does nothing on Windows
+	 */
+	void release(size_t offset, size_t count);
+	bool is_open() const;
+	const char* data() const;
+	size_t size() const;
+	const char* begin() const;
+	const char* end() const;
+};
+
+#endif
+
@@ -0,0 +1,86 @@
+#ifndef FLYTHROUGH_H
+#define FLYTHROUGH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "instance.h"
+#include "camera.h"
+
+/*
+ * A keyframe on a camera path, time is in whatever units the path
+ * uses and just needs to increase along the path
+ */
+struct CameraKey {
+	float time;
+	glm::vec3 eye, center, up;
+};
+
+/*
+ * A camera path through a list of keyframes sorted by time, the camera
+ * is linearly interpolated between the keys
+ */
+struct CameraPath {
+	std::vector<CameraKey> keys;
+
+	/*
+	 * Get the camera at time t, times before the first key or after
+	 * the last one are clamped to them
+	 */
+	Camera camera_at(float t) const;
+	float duration() const;
+};
+
+enum class SceneDistribution { UNIFORM, CLUSTERED };
+
+/*
+ * A procedurally generated scene of billboards
+ */
+struct SceneDesc {
+	size_t instances;
+	SceneDistribution distribution;
+	//Instances are placed in the box [-extent, extent]
+	float extent;
+	//Number of gaussian clusters for the clustered distribution
+	int clusters;
+	float size;
+	uint32_t seed;
+
+	SceneDesc() : instances(100000), distribution(SceneDistribution::UNIFORM), extent(50),
+		clusters(16), size(0.2f), seed(42){}
+};
+
+/*
+ * A benchmark run: the scene to render and the camera path to play
+ * back over a fixed number of frames
+ */
+struct Flythrough {
+	SceneDesc scene;
+	CameraPath path;
+	int frames;
+
+	Flythrough() : frames(600){}
+	/*
+	 * Get the camera for frame, the path is stretched over all the frames
+	 */
+	Camera camera_at_frame(int frame) const;
+};
+
+/*
+ * Load a flythrough from a text file, each line is a directive followed by its values:
+ *	scene <instances> <uniform|clustered> [extent] [clusters] [size] [seed]
+ *	frames <count>
+ *	key <time> <eye x y z> <center x y z> <up x y z>
+ * blank lines and lines starting with # are ignored. Returns false and logs
+ * the problem if the file can't be read or has errors
+ */
+bool load_flythrough(const std::string &file, Flythrough &flythrough);
+/*
+ * Generate the instances for the scene, the same description always gives the same instances
+ */
+void generate_scene(const SceneDesc &desc, std::vector<Instance> &instances);
+
+#endif
+
@@ -0,0 +1,119 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <glm/glm.hpp>
+#include "gl_core_3_3.h"
+#include "util.h"
+
+/*
+ * A rectangle of the framebuffer in pixels with its origin at the lower left, like glScissor
+ */
+struct ScreenRect {
+	int x, y, width, height;
+
+	bool empty() const {
+		return width <= 0 || height <= 0;
+	}
+};
+
+/*
+ * Get the smallest rect containing both rects, empty rects add nothing
+ */
+ScreenRect rect_union(const ScreenRect &a, const ScreenRect &b);
+/*
+ * Project the box to the smallest rect of a width x height framebuffer covering it, grown
+ * by pad_px pixels on each side for things drawn past the box's edges on screen.
+ * Boxes reaching behind the eye cover the whole framebuffer
+ */
+ScreenRect project_box(const glm::mat4 &proj_view, const glm::vec3 &lower, const glm::vec3 &upper,
+	int width, int height, float pad_px = 0);
+
+/*
+ * Counters for the frame scheduling, summed over all frames
+ */
+struct SchedulerStats {
+	//Frames redrawn in full, frames redrawn within the rect that changed and
+	//times we woke up and found nothing to draw
+	size_t full, partial, idle_wakeups;
+	//Pixels redrawn by partial frames
+	size_t partial_pixels;
+	//Wall time spent waiting for something to draw and the CPU time the whole process
+	//used meanwhile, which is how busy we are while idle
+	double wait_ms, wait_cpu_ms;
+
+	SchedulerStats() : full(0), partial(0), idle_wakeups(0), partial_pixels(0), wait_ms(0), wait_cpu_ms(0){}
+};
+
+/*
+ * Schedules frames on demand for displays showing the same thing most of the time,
+ * instead of clearing, redrawing and swapping every frame. The render loop blocks in
+ * wait() until there's an SDL event, a notify() from another thread saying new data
+ * arrived or a timeout so sources we poll, like the file watcher, are still checked.
+ * Changes mark the whole frame or a rect of it dirty and only dirty frames are drawn.
+ * When just a rect changed the frame is cleared and drawn within it using the scissor
+ * test. A swapped back buffer doesn't keep its contents, so when the target isn't
+ * preserved between frames the frames are drawn to a persistent canvas framebuffer
+ * that's blitted to the target.
+ *
+ * Usage each frame: wait(), mark what's dirty, if is_dirty() begin_frame(), draw then end_frame()
+ */
+class FrameScheduler {
+	GLuint target;
+	util::OffscreenFramebuffer canvas;
+	int timeout_ms;
+	uint32_t notify_event;
+	//Set while a notification is queued so other threads don't flood the event queue
+	std::atomic<bool> notify_pending;
+	bool full_damage;
+	ScreenRect damage;
+	bool partial_frame;
+	SchedulerStats total;
+
+public:
+	/*
+	 * Schedule width x height frames presented to the target framebuffer, 0 for the window.
+	 * If target_preserved is false the frames are drawn to a canvas framebuffer and blitted
+	 * to the target. wait() wakes up at least every timeout_ms to poll for changes
+	 */
+	FrameScheduler(int width, int height, GLuint target, bool target_preserved, int timeout_ms = 100);
+	FrameScheduler(const FrameScheduler&) = delete;
+	FrameScheduler& operator=(const FrameScheduler&) = delete;
+	/*
+	 * Wake up the render thread if it's waiting, safe to call from any thread
+	 */
+	void notify();
+	/*
+	 * Block until there's an SDL event, a notification or the timeout passes. Returns right
+	 * away if something's already dirty. The SDL events are left in the queue to poll
+	 */
+	void wait();
+	/*
+	 * Mark the whole frame or just the rect dirty
+	 */
+	void mark_dirty();
+	void mark_dirty(const ScreenRect &rect);
+	bool is_dirty() const;
+	/*
+	 * Count a wakeup that found nothing to draw
+	 */
+	void skip_frame();
+	/*
+	 * Bind the framebuffer to draw the frame to and if only a rect is dirty limit the
+	 * drawing and clearing to it with the scissor test. Clears the dirty state
+	 */
+	void begin_frame();
+	/*
+	 * Disable the scissor test and blit the canvas to the target if there is one,
+	 * leaving the target bound to present
+	 */
+	void end_frame();
+	//The framebuffer frames are drawn to, the canvas or the target
+	GLuint framebuffer() const;
+	const SchedulerStats& total_stats() const;
+};
+
+#endif
+
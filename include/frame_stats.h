@@ -0,0 +1,82 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <cstddef>
+#include <array>
+#include <string>
+#include <vector>
+#include <ostream>
+
+/*
+ * The parts of a frame we time on the CPU and GPU, see FrameProfiler
+ */
+enum class FrameScope { EVENTS, CLEAR, CULL, SORT_UPLOAD, DRAW, SWAP };
+const size_t FRAME_SCOPE_COUNT = 6;
+
+const char* frame_scope_name(FrameScope scope);
+
+/*
+ * Performance counters recorded for a single frame
+ */
+struct FrameRecord {
+	int frame;
+	double cpu_ms;
+	//GPU times aren't known until a few frames later, they're negative until then
+	double gpu_ms;
+	size_t visible;
+	size_t upload_bytes;
+	//Time spent in each scope, indexed by FrameScope. Scopes that weren't entered are negative
+	std::array<double, FRAME_SCOPE_COUNT> cpu_scope_ms, gpu_scope_ms;
+
+	FrameRecord() : frame(0), cpu_ms(0), gpu_ms(-1), visible(0), upload_bytes(0){
+		cpu_scope_ms.fill(-1);
+		gpu_scope_ms.fill(-1);
+	}
+};
+
+/*
+ * Percentiles of one of the per-frame counters
+ */
+struct StatSummary {
+	double mean, min, max, p50, p95, p99;
+
+	StatSummary() : mean(0), min(0), max(0), p50(0), p95(0), p99(0){}
+};
+
+/*
+ * The records of all the frames in a benchmark run, with summaries and
+ * export to CSV and JSON
+ */
+class FrameLog {
+	std::vector<FrameRecord> records;
+
+public:
+	void add(const FrameRecord &record);
+	const std::vector<FrameRecord>& frames() const;
+	StatSummary cpu_ms() const;
+	StatSummary gpu_ms() const;
+	StatSummary cpu_scope_ms(FrameScope scope) const;
+	StatSummary gpu_scope_ms(FrameScope scope) const;
+	StatSummary visible() const;
+	StatSummary upload_bytes() const;
+	/*
+	 * Write the per-frame records as CSV with a header row
+	 */
+	bool write_csv(const std::string &file) const;
+	/*
+	 * Write the summaries and per-frame records as JSON
+	 */
+	bool write_json(const std::string &file) const;
+	/*
+	 * Print a table of the summaries
+	 */
+	void print_summary(std::ostream &os) const;
+};
+
+/*
+ * Summarize the values, percentiles use the nearest rank
+ */
+StatSummary summarize(std::vector<double> values);
+
+#endif
+
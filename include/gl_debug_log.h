@@ -0,0 +1,132 @@
+#ifndef GL_DEBUG_LOG_H
+#define GL_DEBUG_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+#include <iostream>
+#include "gl_core_3_3.h"
+
+/*
+ * A GL debug message or error copied out of the callback, messages longer
+ * than MAX_MSG are truncated
+ */
+struct GLDebugRecord {
+	static const size_t MAX_MSG = 256;
+	//Milliseconds since the log was created
+	uint32_t time_ms;
+	GLenum src, type, severity;
+	GLuint id;
+	char msg[MAX_MSG];
+};
+
+/*
+ * Fill out a record for the message, len is the message length or negative if
+ * it's null terminated
+ */
+GLDebugRecord make_gldebug_record(uint32_t time_ms, GLenum src, GLenum type, GLuint id, GLenum severity,
+	GLsizei len, const char *msg);
+/*
+ * Write the record out in the same format gldebug_callback has always printed
+ */
+void write_gldebug_record(std::ostream &os, const GLDebugRecord &record);
+/*
+ * Get a readable name for an error code returned by glGetError
+ */
+const char* gl_error_name(GLenum err);
+
+/*
+ * Logs GL debug messages and errors without stalling the thread that hit them.
+ * The debug callback copies each message into a fixed-size record in a bounded
+ * lock-free multi-producer single-consumer ring (Vyukov's bounded queue) and
+ * returns, a background thread drains the ring and does the formatting and
+ * printing. If the ring is full the message is dropped and counted rather than
+ * blocking the driver. Repeats of the same message are printed at most once per
+ * rate_limit_ms with a count of how many were suppressed in between. In
+ * synchronous mode messages are formatted on the calling thread instead, which
+ * together with GL_DEBUG_OUTPUT_SYNCHRONOUS gives useful stack traces
+ */
+class GLDebugLog {
+	struct Slot {
+		std::atomic<size_t> seq;
+		GLDebugRecord record;
+	};
+	//A message we've printed and how many repeats of it we've held back since
+	struct Repeat {
+		uint32_t last_print_ms;
+		size_t suppressed;
+		GLDebugRecord record;
+	};
+
+	std::unique_ptr<Slot[]> slots;
+	size_t mask;
+	unsigned rate_limit_ms;
+	std::ostream &os;
+	std::chrono::steady_clock::time_point start;
+	std::atomic<size_t> head;
+	//Only read and written by whoever holds the consumer mutex
+	size_t tail;
+	std::atomic<bool> running, synchronous;
+	std::atomic<size_t> n_dropped, n_suppressed;
+	std::unordered_map<uint64_t, Repeat> repeats;
+	//Held while draining and printing so synchronous mode and the thread don't interleave
+	std::mutex consumer_mutex;
+	std::mutex wake_mutex;
+	std::condition_variable wake;
+	//Set under the wake mutex when a burst wants the ring drained before the interval is up
+	bool drain_requested;
+	std::thread thread;
+
+public:
+	/*
+	 * Create the log with room for capacity pending messages, rounded up to a
+	 * power of two, printing to os from a background thread
+	 */
+	GLDebugLog(size_t capacity = 1024, unsigned rate_limit_ms = 1000, std::ostream &os = std::cerr);
+	/*
+	 * Stops the thread after printing everything still pending and a summary of
+	 * the repeats that were suppressed
+	 */
+	~GLDebugLog();
+	GLDebugLog(const GLDebugLog&) = delete;
+	GLDebugLog& operator=(const GLDebugLog&) = delete;
+	/*
+	 * Queue a message from the debug callback, returns false if it was dropped
+	 * because the ring is full. Safe to call from any thread
+	 */
+	bool push(GLenum src, GLenum type, GLuint id, GLenum severity, GLsizei len, const char *msg);
+	/*
+	 * Queue an error returned by glGetError, where says what we were doing when it was checked
+	 */
+	bool push_error(GLenum err, const char *where);
+	/*
+	 * Print messages on the thread pushing them instead of the background thread
+	 */
+	void set_synchronous(bool sync);
+	bool is_synchronous() const;
+	/*
+	 * Print everything queued so far and wait until it's written
+	 */
+	void flush();
+	//Messages dropped because the ring was full
+	size_t dropped() const;
+	//Repeated messages held back by the rate limit
+	size_t suppressed() const;
+
+private:
+	uint32_t elapsed_ms() const;
+	bool enqueue(const GLDebugRecord &record);
+	void drain();
+	void print(const GLDebugRecord &record);
+	void print_suppressed();
+	void thread_loop();
+};
+
+#endif
+
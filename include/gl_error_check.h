@@ -0,0 +1,81 @@
+#ifndef GL_ERROR_CHECK_H
+#define GL_ERROR_CHECK_H
+
+#include <cstddef>
+#include <string>
+#include "gl_core_3_3.h"
+#include "gl_debug_log.h"
+
+/*
+ * How often we ask the driver for errors. glGetError has to wait for the
+ * driver to catch up with the commands we've sent it so far, on a lot of
+ * drivers this flushes the pipeline and calling it every frame (or worse after
+ * every call) shows up in the frame times
+ *  OFF: never check and turn off debug messages
+ *  DEBUG_CALLBACK: only report what the driver sends to the debug callback
+ *  SAMPLED: the debug callback plus glGetError every N frames and at the end
+ *           of explicitly instrumented scopes, see GLErrorScope
+ */
+enum class GLErrorMode { OFF, DEBUG_CALLBACK, SAMPLED };
+
+const char* gl_error_mode_name(GLErrorMode mode);
+/*
+ * Parse an error mode of the form off, callback or sampled[:N] where N is the
+ * frame interval to check at, returns false if it's not a valid mode
+ */
+bool parse_gl_error_mode(const std::string &str, GLErrorMode &mode, unsigned &interval);
+
+/*
+ * Applies an error checking policy, errors found are reported through the
+ * debug log so reporting them doesn't stall the frame either
+ */
+class GLErrorChecker {
+	GLDebugLog &log;
+	GLErrorMode mode;
+	unsigned interval;
+	size_t n_checks, n_errors;
+
+public:
+	/*
+	 * Check every interval frames in sampled mode, an interval of 0 only
+	 * checks in instrumented scopes
+	 */
+	GLErrorChecker(GLDebugLog &log, GLErrorMode mode = GLErrorMode::SAMPLED, unsigned interval = 120);
+	/*
+	 * Turn the driver's debug messages on or off to match the mode, needs a current context
+	 */
+	void apply() const;
+	/*
+	 * Check for errors at the end of the frame if it's one we sample
+	 */
+	void end_frame(size_t frame);
+	/*
+	 * Check for errors now if we're sampling, where is reported along with any
+	 * errors found. Returns true if there were errors
+	 */
+	bool check(const char *where);
+	GLErrorMode error_mode() const;
+	unsigned sample_interval() const;
+	//Number of times glGetError was called and the errors it returned
+	size_t checks() const;
+	size_t errors() const;
+};
+
+/*
+ * Checks for errors when leaving the scope, for the rare heavy operations like
+ * reloading shaders that are worth a sync point in sampled mode. Errors from
+ * before the scope since the last check are reported here as well
+ */
+class GLErrorScope {
+	GLErrorChecker &checker;
+	const char *where;
+
+public:
+	GLErrorScope(GLErrorChecker &checker, const char *where) : checker(checker), where(where){}
+	~GLErrorScope(){
+		checker.check(where);
+	}
+};
+
+#endif
+
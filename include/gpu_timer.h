@@ -0,0 +1,44 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include "gl_core_3_3.h"
+
+/*
+ * Times a span of GL commands with a pair of GL_TIMESTAMP queries. The result is
+ * read back later once the GPU has finished with them instead of stalling on it,
+ * so callers keep a few frames of timers in flight, like the FrameProfiler's ring.
+ * Timestamps are used instead of GL_TIME_ELAPSED since they can't conflict with
+ * other timers running at the same time and llvmpipe reports a bogus time for the
+ * first elapsed query made in a context
+ */
+class GPUTimer {
+	GLuint queries[2];
+	bool issued;
+
+	GPUTimer(const GPUTimer&) = delete;
+	GPUTimer& operator=(const GPUTimer&) = delete;
+
+public:
+	GPUTimer();
+	~GPUTimer();
+	void begin();
+	void end();
+	/*
+	 * Forget the span so the timer can be reused, any result not read is lost
+	 */
+	void reset();
+	//Check if begin was called since the last reset
+	bool is_issued() const;
+	/*
+	 * Check if the result is ready without blocking, the span must have ended
+	 */
+	bool is_available() const;
+	/*
+	 * Read the GPU timestamps of the start and end of the span in nanoseconds,
+	 * blocking until they're ready
+	 */
+	void read(GLuint64 &begin, GLuint64 &end) const;
+};
+
+#endif
+
@@ -0,0 +1,43 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "gl_core_3_3.h"
+#include "util.h"
+
+/*
+ * An offscreen GL 3.3 core context for rendering without a display. The
+ * context is made through EGL on the surfaceless platform (or the default
+ * display if that isn't available), which Mesa's llvmpipe supports so it
+ * also works on machines with no GPU. Since there's no window to render to
+ * we render into a framebuffer object with a color and depth renderbuffer.
+ * Only available if we were built with EGL, otherwise create always fails
+ */
+class HeadlessContext {
+	void *display, *context;
+	util::OffscreenFramebuffer fbo;
+	int width, height;
+
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+public:
+	HeadlessContext();
+	~HeadlessContext();
+	/*
+	 * Create the context, load the GL functions and setup a width x height
+	 * framebuffer to render into, which is left bound. Returns false and logs
+	 * the error if any of this fails
+	 */
+	bool create(int width, int height, bool debug = false);
+	/*
+	 * End the frame, there's nothing to present so we just flush the commands
+	 * issued to the driver so it works on them like a swap would
+	 */
+	void present();
+	GLuint framebuffer() const;
+	int fb_width() const;
+	int fb_height() const;
+};
+
+#endif
+
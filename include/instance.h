@@ -0,0 +1,69 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <glm/glm.hpp>
+#include "gl_core_3_3.h"
+
+/*
+ * The per-instance attributes for a billboard, interleaved into a single
+ * tightly packed struct so all instance data lives in one buffer and is
+ * fetched with a single stride
+ */
+struct Instance {
+	glm::vec3 pos;
+	GLint sprite_id;
+	//Half-width of the billboard quad in world units
+	GLfloat size;
+	//RGBA8 tint packed with red in the lowest byte, see pack_rgba8
+	GLuint color;
+	//Rotation of the quad about the view direction in radians
+	GLfloat rotation;
+};
+static_assert(sizeof(Instance) == 28, "Instance must stay tightly packed");
+
+/*
+ * Description of a single vertex attribute within an interleaved buffer.
+ * integer attributes are setup with glVertexAttribIPointer, others with
+ * glVertexAttribPointer and the normalized flag
+ */
+struct VertexAttrib {
+	GLuint index;
+	GLint components;
+	GLenum type;
+	GLboolean normalized;
+	bool integer;
+	size_t offset;
+};
+
+/*
+ * The attribute layout of Instance, the indices match the
+ * layout(location = ...) qualifiers in vertex.glsl
+ */
+extern const std::array<VertexAttrib, 5> INSTANCE_LAYOUT;
+
+/*
+ * Pack a [0, 1] RGBA color into the RGBA8 format used by Instance::color
+ */
+GLuint pack_rgba8(const glm::vec4 &color);
+/*
+ * Unpack an RGBA8 color from Instance::color to [0, 1]
+ */
+glm::vec4 unpack_rgba8(GLuint color);
+/*
+ * Setup the attribute pointers for the layout on the currently bound VAO
+ * to read from buf with the stride passed. base is an offset in bytes
+ * added to each attribute's offset, letting the same layout be pointed
+ * at different regions of a buffer. divisor is applied to every attribute
+ */
+void setup_vertex_attribs(GLuint buf, const VertexAttrib *attribs, size_t n_attribs,
+	GLsizei stride, GLintptr base = 0, GLuint divisor = 1);
+/*
+ * Setup the Instance layout reading from buf starting at base bytes
+ */
+void setup_instance_attribs(GLuint buf, GLintptr base = 0);
+
+#endif
+
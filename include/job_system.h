@@ -0,0 +1,73 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <cstddef>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+/*
+ * A small fork-join job system with one worker per core. Each worker has its
+ * own deque of jobs, it pops work from the back of its own deque and when that
+ * runs dry steals from the front of the other workers' deques. The thread
+ * calling parallel_for participates as worker 0 so a system with n workers
+ * only spawns n - 1 threads.
+ */
+class JobSystem {
+public:
+	/*
+	 * The function run for each chunk of a parallel_for, it's passed the
+	 * [begin, end) range of the chunk and the index of the worker running it
+	 * which can be used to index per-worker scratch data
+	 */
+	typedef std::function<void(size_t begin, size_t end, unsigned worker)> ChunkFn;
+
+private:
+	struct Job {
+		const ChunkFn *fn;
+		size_t begin, end;
+		std::atomic<size_t> *remaining;
+	};
+	struct WorkQueue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	std::vector<std::thread> threads;
+	std::mutex sleep_mutex;
+	std::condition_variable wakeup;
+	std::atomic<size_t> queued;
+	bool quit;
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	void worker_loop(unsigned worker);
+	//Pop a job from our own queue or steal one from another worker's
+	bool find_job(unsigned worker, Job &job);
+	void run_job(const Job &job, unsigned worker);
+
+public:
+	/*
+	 * Create a job system with n_workers workers, if 0 one worker
+	 * per hardware thread is used
+	 */
+	explicit JobSystem(unsigned n_workers = 0);
+	~JobSystem();
+	unsigned size() const;
+	/*
+	 * Split [0, count) into chunks of chunk_size elements and run fn on each
+	 * chunk across the workers. Returns once all chunks have completed.
+	 * Must only be called from the thread that created the job system
+	 */
+	void parallel_for(size_t count, size_t chunk_size, const ChunkFn &fn);
+};
+
+#endif
+
@@ -0,0 +1,136 @@
+#ifndef LOD_OCTREE_H
+#define LOD_OCTREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "cull.h"
+#include "file_view.h"
+#include "scene_file.h"
+#include "chunk_stream.h"
+#include "job_system.h"
+
+/*
+ * Multi-resolution octrees of billboards for scenes with far more billboards
+ * than we can draw each frame, along the lines of Potree. Each node holds a
+ * subsample of the billboards in its cube taken on a sample_grid^3 grid, the
+ * rest are passed down to its children so every billboard is in exactly one
+ * node and drawing a node and its ancestors adds detail instead of replacing it.
+ * The octree is stored as two files:
+ *	<name>.vsbs: a scene file with a chunk for each node in breadth first order,
+ *		so it's still a valid scene file with all the billboards
+ *	<name>.vsbs.lod: a LodHeader followed by a LodNode for each node
+ * The children of a node are contiguous in breadth first order, so a node only
+ * stores its first child and a mask of which octants it has children in
+ */
+const uint32_t LOD_FILE_VERSION = 1;
+
+struct LodHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t n_nodes;
+	uint32_t sample_grid;
+	uint64_t n_instances;
+	//The root cube, padded by the radius of the largest billboard
+	float bounds_min[3], bounds_max[3];
+};
+static_assert(sizeof(LodHeader) == 48, "LodHeader must stay tightly packed");
+
+struct LodNode {
+	//The node's cube, padded by the radius of the largest billboard
+	float bounds_min[3], bounds_max[3];
+	//Distance between the node's samples, the size of its cube over the sample grid
+	float spacing;
+	//Instances in the node, the node's chunk in the scene file has the same index
+	uint32_t count;
+	uint32_t first_child;
+	//Bit i is set if there's a child in octant i, octant bits are x = 1, y = 2, z = 4
+	uint8_t child_mask;
+	uint8_t level;
+	uint16_t reserved;
+};
+static_assert(sizeof(LodNode) == 40, "LodNode must stay tightly packed");
+
+/*
+ * Parameters for building an octree
+ */
+struct LodBuildOptions {
+	//Resolution of the grid each node takes its samples on
+	uint32_t sample_grid;
+	//Nodes with at most this many instances become leaves and keep them all
+	uint32_t max_leaf;
+	//The scene is split into cells of about this many instances to build in memory
+	size_t cell_instances;
+	//Directory to write the temporary files to, defaults to the output file's
+	std::string temp_dir;
+
+	LodBuildOptions() : sample_grid(32), max_leaf(16384), cell_instances(4 * 1024 * 1024){}
+};
+
+struct LodBuildStats {
+	size_t instances, nodes, cells, max_depth;
+	double count_ms, distribute_ms, index_ms, write_ms;
+
+	LodBuildStats() : instances(0), nodes(0), cells(0), max_depth(0), count_ms(0), distribute_ms(0), index_ms(0),
+		write_ms(0)
+	{}
+};
+
+/*
+ * Build an octree from the billboards in a scene file, out of core. The instances are
+ * counted into a grid of cells in parallel, then copied into a temporary file grouped
+ * by cell so each cell's subtree can be built in memory in parallel, one cell at a time
+ * per worker. The roots of the cells' subtrees are kept in memory to build the levels
+ * above them. Returns false and logs why if the octree couldn't be built
+ */
+bool build_lod_octree(JobSystem &jobs, const std::string &in_file, const std::string &out_file,
+	const LodBuildOptions &options = LodBuildOptions{}, LodBuildStats *stats = nullptr);
+
+/*
+ * Counters from selecting the nodes to draw for a frame
+ */
+struct LodSelectStats {
+	//Nodes tested against the frustum, selected to draw and their instances
+	size_t traversed, selected, instances;
+
+	LodSelectStats() : traversed(0), selected(0), instances(0){}
+};
+
+/*
+ * An octree opened for rendering, the nodes' instances are read from the
+ * mapped scene file by a ChunkStreamer
+ */
+class LodOctree {
+	SceneFile scene_file;
+	FileView hierarchy;
+	const LodHeader *head;
+	const LodNode *node_list;
+
+public:
+	LodOctree();
+	/*
+	 * Open the octree's scene file and its .lod hierarchy file.
+	 * Returns false and logs why if they're not an octree we can read
+	 */
+	bool open(const std::string &file);
+	void close();
+	bool is_open() const;
+	const LodHeader& header() const;
+	size_t node_count() const;
+	const LodNode& node(size_t i) const;
+	SceneFile& scene();
+	/*
+	 * Select the nodes to draw for the camera, largest on screen first, without going over
+	 * the budget of instances. The root is always selected if it's visible, even when it's
+	 * over the budget, so there's something to draw. Nodes are refined until their sample spacing is at most
+	 * max_spacing_px pixels on screen. The nodes are written to selected in priority order
+	 * to pass to a ChunkStreamer, along with the children we'd refine into next to prefetch
+	 */
+	LodSelectStats select(const glm::vec3 &eye, const Frustum &frustum, const glm::mat4 &proj, float viewport_height,
+		size_t budget, float max_spacing_px, std::vector<StreamChunk> &selected) const;
+};
+
+#endif
+
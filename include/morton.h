@@ -0,0 +1,66 @@
+#ifndef MORTON_H
+#define MORTON_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "instance.h"
+#include "job_system.h"
+
+/*
+ * Morton code precision, 30 bit codes quantize each axis to 10 bits
+ * while 63 bit codes use 21 bits per axis
+ */
+enum class MortonBits { BITS_30 = 30, BITS_63 = 63 };
+
+/*
+ * Compute the Morton code of a point in the [0, 1] unit cube
+ */
+uint32_t morton3_30(const glm::vec3 &p);
+uint64_t morton3_63(const glm::vec3 &p);
+
+/*
+ * Maps between the ids instances were created with and their current index
+ * in the instance list so external handles still resolve after reordering
+ */
+class InstanceRemap {
+	std::vector<uint32_t> id_to_index, index_to_id;
+
+public:
+	/*
+	 * Reset to the identity mapping for n instances
+	 */
+	void reset(size_t n);
+	/*
+	 * Apply a reordering of the instances, order[i] is the previous index of
+	 * the instance now at index i
+	 */
+	void apply(const std::vector<uint32_t> &order);
+	uint32_t index(uint32_t id) const;
+	uint32_t id(uint32_t index) const;
+	size_t size() const;
+};
+
+/*
+ * Compute the Morton codes of the instances' positions quantized within their
+ * bounds and sort them with a parallel radix sort. codes is filled with the
+ * sorted codes and order with the index of the instance each code belongs to
+ */
+void morton_sort(JobSystem &jobs, const std::vector<Instance> &instances, MortonBits bits,
+	std::vector<uint64_t> &codes, std::vector<uint32_t> &order);
+/*
+ * Reorder the instances in place into Morton order. If remap is not null the
+ * reordering is applied to it, it should already hold the mapping for the
+ * current order of the instances
+ */
+void morton_reorder(JobSystem &jobs, std::vector<Instance> &instances, MortonBits bits,
+	InstanceRemap *remap = nullptr);
+/*
+ * Gather src into dst following order, dst[i] = src[order[i]]
+ */
+void permute_instances(JobSystem &jobs, const std::vector<Instance> &src, const std::vector<uint32_t> &order,
+	std::vector<Instance> &dst);
+
+#endif
+
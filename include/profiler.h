@@ -0,0 +1,104 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "gl_core_3_3.h"
+#include "frame_stats.h"
+#include "gpu_timer.h"
+
+/*
+ * Times the scopes of each frame on the CPU and GPU and produces a FrameRecord
+ * for each frame. The GPU side puts GL_TIMESTAMP queries at the start and end
+ * of each scope with a GPUTimer. The timers for each frame are kept in a
+ * ring deep enough to cover how far the GPU lags behind so their results can
+ * be read back a few frames later without stalling.
+ *
+ * Usage: begin_frame(), wrap the parts of the frame in begin/end or a
+ * ProfileScope, fill in the rest of current() and call end_frame(). Finished
+ * records with their GPU times are then read back with poll(). If tracing is
+ * enabled the frame and its scopes are also recorded as trace spans, with the
+ * GPU spans added once their results are read back
+ */
+class FrameProfiler {
+	typedef std::chrono::high_resolution_clock Clock;
+
+	struct PendingFrame {
+		FrameRecord record;
+		std::array<GPUTimer, FRAME_SCOPE_COUNT> scopes;
+		bool pending;
+
+		PendingFrame() : pending(false){}
+	};
+	std::vector<PendingFrame> ring;
+	//Records whose GPU times we had to wait on to reuse their queries
+	std::deque<FrameRecord> finished;
+	FrameRecord last;
+	int cur;
+	bool in_frame;
+	Clock::time_point frame_start;
+	std::array<Clock::time_point, FRAME_SCOPE_COUNT> scope_start;
+	//Start times of the frame and scopes on the trace clock if we're tracing
+	uint64_t frame_trace_start;
+	std::array<uint64_t, FRAME_SCOPE_COUNT> scope_trace_start;
+
+	FrameProfiler(const FrameProfiler&) = delete;
+	FrameProfiler& operator=(const FrameProfiler&) = delete;
+	/*
+	 * Try to read back the GPU times of the pending frame, returns false if they
+	 * aren't ready. If wait is true we block until they are
+	 */
+	bool resolve(PendingFrame &pf, bool wait);
+
+public:
+	/*
+	 * Create a profiler that can have up to latency frames waiting on GPU results
+	 */
+	FrameProfiler(int latency = 4);
+	~FrameProfiler();
+	void begin_frame(int frame);
+	void begin(FrameScope scope);
+	void end(FrameScope scope);
+	/*
+	 * The record for the frame being profiled, to fill in the counters the
+	 * profiler doesn't know about (visible instances, upload bytes)
+	 */
+	FrameRecord& current();
+	void end_frame();
+	/*
+	 * Drop the frame being profiled without recording it, for frames that turn
+	 * out to have nothing to draw
+	 */
+	void cancel_frame();
+	/*
+	 * Get the oldest record whose GPU times are ready, returns false if there
+	 * isn't one. If wait is true we block until the oldest pending frame is done
+	 */
+	bool poll(FrameRecord &record, bool wait = false);
+	/*
+	 * The most recent record with its GPU times, for displaying live stats
+	 */
+	const FrameRecord& latest() const;
+};
+
+/*
+ * Times a scope of the frame for as long as it's alive
+ */
+class ProfileScope {
+	FrameProfiler &profiler;
+	FrameScope scope;
+
+public:
+	ProfileScope(FrameProfiler &profiler, FrameScope scope) : profiler(profiler), scope(scope){
+		profiler.begin(scope);
+	}
+	~ProfileScope(){
+		profiler.end(scope);
+	}
+};
+
+#endif
+
@@ -0,0 +1,133 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "gl_core_3_3.h"
+
+/*
+ * How the last program was loaded and counters over all the loads
+ */
+struct ProgramCacheStats {
+	size_t hits, misses;
+	//Cached binaries the driver refused to load, usually after a driver update
+	size_t rejected;
+	//Time taken by the last load, including reading and writing the cache
+	double last_load_ms;
+	bool last_hit;
+
+	ProgramCacheStats() : hits(0), misses(0), rejected(0), last_load_ms(0), last_hit(false){}
+};
+
+/*
+ * A program whose compile and link were issued without waiting on them, see ProgramCache::begin_build
+ */
+struct PendingProgram {
+	//The program's name in the cache, its shader types and sources and the shaders' names for error logs
+	std::string name;
+	std::vector<std::tuple<GLenum, std::string>> sources;
+	std::vector<std::string> shader_names;
+	GLint program;
+	//The shaders being compiled, empty if the program was loaded from the cache
+	std::vector<GLuint> shaders;
+
+	PendingProgram() : program(-1){}
+	bool cached() const {
+		return program != -1 && shaders.empty();
+	}
+};
+
+/*
+ * An on-disk cache of linked shader programs built on ARB_get_program_binary.
+ * Each program has one entry, named by the program's files and defines (see
+ * program_name), which holds the binary and a key hashing the shader sources and
+ * the GL_RENDERER and GL_VERSION strings. Editing a shader or updating the driver
+ * changes the key, so the entry misses and is replaced by the rebuilt program
+ * instead of piling up a new file for each edit. When the key matches the binary
+ * is loaded with glProgramBinary instead of compiling and linking, if the driver
+ * rejects it we fall back to compiling the sources and replace the entry. If the
+ * extension isn't available or the driver has no binary formats it just compiles
+ */
+class ProgramCache {
+	std::string dir;
+	std::string driver;
+	bool supported;
+	ProgramCacheStats stats;
+
+public:
+	/*
+	 * Cache programs in dir, which must exist and end with a path separator.
+	 * An empty dir disables the cache. Needs a current GL context
+	 */
+	ProgramCache(const std::string &dir);
+	/*
+	 * Load a program from the list of shader types and files like util::load_program,
+	 * returns -1 if the program couldn't be built. Programs are keyed on the
+	 * preprocessed sources so each variant gets its own entry
+	 */
+	GLint load_program(const std::vector<std::tuple<GLenum, std::string>> &shaders,
+		const std::vector<std::string> &defines = {});
+	/*
+	 * Load the program named name from the shader types and their sources
+	 */
+	GLint load_program_sources(const std::string &name, const std::vector<std::tuple<GLenum, std::string>> &sources);
+	/*
+	 * Load the cached binary of the named program if it was built from the shader sources,
+	 * returns -1 if there isn't one, it's stale or the driver rejected it. For building
+	 * programs outside of load_program
+	 */
+	GLint find(const std::string &name, const std::vector<std::tuple<GLenum, std::string>> &sources);
+	/*
+	 * Start building the pending program, loading it from the cache if it's there and
+	 * otherwise issuing its compiles and link without asking for their status, so drivers
+	 * that compile in the background return right away. Issuing a batch of programs before
+	 * finishing any lets those drivers build them all at once. Returns false if there are no sources
+	 */
+	bool begin_build(PendingProgram &pending);
+	/*
+	 * Check if the driver is done building the program without blocking, always true
+	 * without KHR_parallel_shader_compile since there's no way to ask
+	 */
+	static bool build_done(const PendingProgram &pending);
+	/*
+	 * Wait for the program to finish building, logging why if it failed, and store it in the
+	 * cache. Returns the program, which the caller owns, or -1 if it failed to build
+	 */
+	GLint finish_build(PendingProgram &pending);
+	/*
+	 * Store the binary of a linked program built from the sources as the named program's
+	 * entry, replacing the entry for any older sources
+	 */
+	void store(GLuint program, const std::string &name, const std::vector<std::tuple<GLenum, std::string>> &sources);
+	/*
+	 * Remove the named program's entry if there is one
+	 */
+	void evict(const std::string &name);
+	bool enabled() const;
+	const ProgramCacheStats& cache_stats() const;
+	/*
+	 * Get the default cache directory, in the user's preference path from SDL
+	 */
+	static std::string default_dir();
+	/*
+	 * Get the name of the program built from the shader files with the defines,
+	 * which picks its entry in the cache
+	 */
+	static std::string program_name(const std::vector<std::tuple<GLenum, std::string>> &shaders,
+		const std::vector<std::string> &defines = {});
+
+private:
+	GLint load(PendingProgram &pending);
+	//Mark a program to be stored in the cache, must be called before linking it
+	void prepare(GLuint program) const;
+	std::string entry_file(const std::string &name) const;
+	uint64_t cache_key(const std::vector<std::tuple<GLenum, std::string>> &sources) const;
+	GLint load_binary(const std::string &file, uint64_t key);
+	void store_binary(GLuint program, const std::string &file, uint64_t key);
+};
+
+#endif
+
@@ -0,0 +1,118 @@
+#ifndef PROGRESSIVE_H
+#define PROGRESSIVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "gl_core_3_3.h"
+#include "instance.h"
+#include "bvh.h"
+#include "util.h"
+
+/*
+ * Counters for the progressive rendering, summed over all frames
+ */
+struct ProgressiveStats {
+	//Frames where the view changed and the image was restarted, frames adding
+	//a slice to it and frames where it was already complete
+	size_t restarts, accumulating, complete;
+	//Images of more than one slice that were finished and the frames it took to finish them
+	size_t images_completed, frames_to_complete;
+
+	ProgressiveStats() : restarts(0), accumulating(0), complete(0), images_completed(0), frames_to_complete(0){}
+};
+
+/*
+ * Progressive rendering for scenes with too many billboards to draw each frame
+ * while the camera moves. The visible instances are split into slices of up to
+ * budget instances, slice k has every slices-th instance starting at k so each
+ * slice is an even sample of the whole scene. The slices are drawn into a
+ * persistent framebuffer without clearing it in between, so with the depth test
+ * the image after all the slices is the same as drawing every instance at once.
+ *
+ * When the view changes the image is restarted and only its first slice is drawn,
+ * so a moving camera only sorts and uploads that sample of the visible instances.
+ * Once the camera stops the rest of the instances are sorted once into a persistent
+ * buffer and the following frames each draw the next slice of it with a stride
+ * between instances, without culling, sorting or uploading anything. The image is
+ * blitted to the target framebuffer each frame. Alpha blended back to front sorting
+ * blends each slice in order but not the slices with each other, so it's only exact
+ * for opaque sorting.
+ *
+ * Usage each frame: if the view changed select() the sample of the visible instances,
+ * sort and upload it, else if needs_rest() sort rest_ranges() into map_rest(). Then
+ * begin() with whether the view changed, if it returns true draw_sample() the uploaded
+ * sample on restarted frames or draw_slice() otherwise, then end()
+ */
+class ProgressiveRenderer {
+	size_t budget;
+	GLuint target;
+	util::OffscreenFramebuffer image;
+	//The instances not in the sample, sorted into rest_buf once the view stops changing
+	std::vector<DrawRange> rest;
+	size_t n_rest;
+	GLuint rest_buf;
+	bool rest_ready;
+	//The slices of the image being built and the next slice to add
+	size_t slices, next_slice;
+	size_t frames_in_image;
+	ProgressiveStats total;
+
+public:
+	/*
+	 * Render width x height images drawing up to budget instances a frame, the
+	 * images are blitted to the target framebuffer, 0 for the window
+	 */
+	ProgressiveRenderer(int width, int height, size_t budget, GLuint target = 0);
+	~ProgressiveRenderer();
+	ProgressiveRenderer(const ProgressiveRenderer&) = delete;
+	ProgressiveRenderer& operator=(const ProgressiveRenderer&) = delete;
+	/*
+	 * Pick the slices for the visible ranges of a restarted image, writing the ranges
+	 * of the first slice's sample to sample. The other instances are kept for the
+	 * following slices, see needs_rest
+	 */
+	void select(const std::vector<DrawRange> &visible, std::vector<DrawRange> &sample);
+	/*
+	 * Check if the instances after the sample have to be sorted into the rest buffer
+	 * before the next slice can be drawn
+	 */
+	bool needs_rest() const;
+	const std::vector<DrawRange>& rest_ranges() const;
+	/*
+	 * Map the rest buffer to write the rest_ranges instances to in depth order,
+	 * then unmap it with the number written
+	 */
+	Instance* map_rest();
+	void unmap_rest(size_t n);
+	/*
+	 * Start the frame, restarting the image if the view changed. Returns true if
+	 * there's a slice to draw this frame, in which case the image's framebuffer is
+	 * bound for drawing it. If it returns false the image is complete and nothing
+	 * needs to be culled, sorted or drawn
+	 */
+	bool begin(bool view_changed);
+	/*
+	 * Draw the first slice of a restarted image, the n depth sorted sample instances read
+	 * from buf starting at base bytes. The billboard shader and VAO should be bound, the
+	 * VAO's instance attributes are pointed at the sample. Returns the number of instances drawn
+	 */
+	size_t draw_sample(GLuint buf, GLintptr base, size_t n);
+	/*
+	 * Draw the next slice from the rest buffer, the VAO's instance attributes are changed
+	 * to step over the slice. Returns the number of instances drawn
+	 */
+	size_t draw_slice();
+	/*
+	 * Blit the image to the target framebuffer and bind it back
+	 */
+	void end();
+	bool is_complete() const;
+	//The slice drawn this frame and how many slices the image has
+	size_t current_slice() const;
+	size_t slice_count() const;
+	const ProgressiveStats& total_stats() const;
+};
+
+#endif
+
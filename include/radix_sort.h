@@ -0,0 +1,82 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include "job_system.h"
+
+/*
+ * A parallel LSD radix sort of unsigned integer keys with a 32 bit value
+ * carried along with each key, typically an instance index. Each pass sorts
+ * on 8 bits of the key: the keys are split into one chunk per worker, each
+ * chunk builds a histogram of its digits in parallel, a prefix sum over the
+ * histograms gives every chunk its own output offsets for each digit and the
+ * chunks then scatter their keys in parallel. The sort is stable. The sorter
+ * keeps its scratch buffers around so sorting each frame doesn't allocate
+ */
+template<typename Key>
+class RadixSorter {
+	std::vector<Key> tmp_keys;
+	std::vector<uint32_t> tmp_values;
+	std::vector<size_t> histograms;
+
+public:
+	/*
+	 * Sort the keys and values by the low key_bits bits of the keys
+	 */
+	void sort(JobSystem &jobs, std::vector<Key> &keys, std::vector<uint32_t> &values,
+		int key_bits = 8 * sizeof(Key))
+	{
+		const size_t n = keys.size();
+		if (n < 2){
+			return;
+		}
+		const size_t chunk = std::max((n + jobs.size() - 1) / jobs.size(), size_t{16384});
+		const size_t n_chunks = (n + chunk - 1) / chunk;
+		tmp_keys.resize(n);
+		tmp_values.resize(n);
+		histograms.resize(n_chunks * 256);
+		for (int shift = 0; shift < key_bits; shift += 8){
+			std::fill(histograms.begin(), histograms.end(), 0);
+			jobs.parallel_for(n, chunk, [&](size_t begin, size_t end, unsigned){
+				size_t *hist = &histograms[(begin / chunk) * 256];
+				for (size_t i = begin; i < end; ++i){
+					++hist[(keys[i] >> shift) & 0xFF];
+				}
+			});
+			//If every key has the same digit this pass wouldn't change anything
+			size_t digit_total = 0;
+			for (size_t c = 0; c < n_chunks; ++c){
+				digit_total += histograms[c * 256 + ((keys[0] >> shift) & 0xFF)];
+			}
+			if (digit_total == n){
+				continue;
+			}
+			//Exclusive prefix sum ordered by digit then chunk so each chunk's
+			//keys for a digit land after the previous chunks', keeping it stable
+			size_t offset = 0;
+			for (size_t d = 0; d < 256; ++d){
+				for (size_t c = 0; c < n_chunks; ++c){
+					const size_t count = histograms[c * 256 + d];
+					histograms[c * 256 + d] = offset;
+					offset += count;
+				}
+			}
+			jobs.parallel_for(n, chunk, [&](size_t begin, size_t end, unsigned){
+				size_t *hist = &histograms[(begin / chunk) * 256];
+				for (size_t i = begin; i < end; ++i){
+					const size_t pos = hist[(keys[i] >> shift) & 0xFF]++;
+					tmp_keys[pos] = keys[i];
+					tmp_values[pos] = values[i];
+				}
+			});
+			keys.swap(tmp_keys);
+			values.swap(tmp_values);
+		}
+	}
+};
+
+#endif
+
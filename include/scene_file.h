@@ -0,0 +1,138 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "instance.h"
+#include "file_view.h"
+
+/*
+ * Binary billboard scene files (.vsbs), laid out so the file can be memory
+ * mapped and its instances used in place without any parsing:
+ *	SceneHeader
+ *	SceneAttrib[header.n_attribs]: the schema of the instance data
+ *	SceneChunk[header.n_chunks]: where each chunk is and its bounds
+ *	chunk data, each chunk starting on a SCENE_CHUNK_ALIGN boundary
+ * Chunks hold up to header.chunk_size instances interleaved in the Instance
+ * layout, so they can be memcpy'd straight into a mapped GL buffer or the
+ * instance vector. The schema lets the loader check the file matches our
+ * Instance layout. Everything is little endian
+ */
+const uint32_t SCENE_FILE_VERSION = 1;
+const size_t SCENE_CHUNK_ALIGN = 4096;
+
+/*
+ * How the instance data in the chunks is laid out, only interleaved Instances are written
+ * and read for now. SoA is reserved for splitting the attributes into their own streams
+ */
+enum class SceneLayout : uint32_t { INTERLEAVED = 0, SOA = 1 };
+/*
+ * Compression of a chunk's data, chunks are stored uncompressed for now so they can be used in place
+ */
+enum class SceneCompression : uint32_t { NONE = 0 };
+
+struct SceneHeader {
+	char magic[4];
+	uint32_t version;
+	SceneLayout layout;
+	uint32_t n_attribs;
+	uint64_t n_instances;
+	uint32_t chunk_size;
+	uint32_t n_chunks;
+	//Size in bytes of one instance
+	uint32_t stride;
+	uint32_t reserved;
+	//Bounds of all the billboards, including their quads
+	float bounds_min[3], bounds_max[3];
+};
+static_assert(sizeof(SceneHeader) == 64, "SceneHeader must stay tightly packed");
+
+/*
+ * An attribute of the instance data, matching a VertexAttrib in INSTANCE_LAYOUT
+ */
+struct SceneAttrib {
+	char name[16];
+	uint32_t index, components;
+	//GL type enum of the components
+	uint32_t type;
+	uint32_t normalized, integer;
+	uint32_t offset;
+};
+static_assert(sizeof(SceneAttrib) == 40, "SceneAttrib must stay tightly packed");
+
+struct SceneChunk {
+	//Offset of the chunk's data from the start of the file
+	uint64_t offset;
+	//Size of the chunk's data in the file, and once decompressed
+	uint64_t bytes, raw_bytes;
+	uint32_t count;
+	SceneCompression compression;
+	//Bounds of the chunk's billboards, including their quads
+	float bounds_min[3], bounds_max[3];
+};
+static_assert(sizeof(SceneChunk) == 56, "SceneChunk must stay tightly packed");
+
+/*
+ * A scene file mapped for reading, the header, schema and chunks point into the mapping
+ */
+class SceneFile {
+	FileView view;
+	const SceneHeader *head;
+	const SceneAttrib *attrib_list;
+	const SceneChunk *chunk_list;
+
+public:
+	SceneFile();
+	/*
+	 * Map the scene file and validate its header, schema and chunk table.
+	 * Returns false and logs why if it's not a scene file we can read
+	 */
+	bool open(const std::string &file, FileAccess access = FileAccess::SEQUENTIAL);
+	void close();
+	bool is_open() const;
+	const SceneHeader& header() const;
+	size_t size() const;
+	size_t chunk_count() const;
+	const SceneChunk& chunk(size_t i) const;
+	/*
+	 * Get the instances in the chunk, these point into the mapped file
+	 */
+	const Instance* chunk_instances(size_t i) const;
+	/*
+	 * Copy all the instances into the vector
+	 */
+	void read_instances(std::vector<Instance> &instances) const;
+	/*
+	 * Copy all the instances to dst, which must have room for size() instances.
+	 * Pass a buffer mapped with glMapBufferRange to upload the scene straight from the file
+	 */
+	void copy_instances(void *dst) const;
+	/*
+	 * Hint that the chunk will be read soon so the OS can start paging it in
+	 */
+	void prefetch(size_t i);
+	/*
+	 * Hint that we're done reading the chunk so its pages can be dropped
+	 */
+	void release(size_t i);
+};
+
+/*
+ * Write the instances to a scene file in chunks of chunk_size instances.
+ * Returns false and logs why if the file couldn't be written
+ */
+bool write_scene_file(const std::string &file, const std::vector<Instance> &instances, uint32_t chunk_size = 65536);
+/*
+ * Write a scene file made of chunks with the counts given, chunk_data(i) returns the instances of
+ * chunk i. It's called twice for each chunk, once to find its bounds and again to write it, so
+ * the chunks can be read out of another mapped file instead of being in memory all at once
+ */
+bool write_scene_file(const std::string &file, const std::vector<uint32_t> &counts,
+	const std::function<const Instance*(size_t)> &chunk_data);
+
+#endif
+
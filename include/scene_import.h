@@ -0,0 +1,31 @@
+#ifndef SCENE_IMPORT_H
+#define SCENE_IMPORT_H
+
+#include <string>
+#include <vector>
+#include "instance.h"
+
+/*
+ * Import billboards from a CSV file. If the first line names the columns they
+ * can come in any order, x, y and z are required and sprite_id, size, r, g, b,
+ * a and rotation are optional with colors in [0, 1]. Without a header the
+ * columns are x, y, z, sprite_id, size, r, g, b, a, rotation in that order and
+ * can stop after any of them. Attributes the file doesn't have are taken from
+ * defaults. Returns false and logs why if the file couldn't be read
+ */
+bool import_csv(const std::string &file, const Instance &defaults, std::vector<Instance> &instances);
+/*
+ * Import billboards from the vertex element of an ascii or binary PLY file,
+ * which must be the file's first element. x, y and z are required and red,
+ * green, blue, alpha (integer types are in [0, 255], float types in [0, 1]),
+ * sprite_id, size (or radius or scale) and rotation are used if present.
+ * Attributes the file doesn't have are taken from defaults
+ */
+bool import_ply(const std::string &file, const Instance &defaults, std::vector<Instance> &instances);
+/*
+ * Import a CSV or PLY file based on its extension
+ */
+bool import_scene(const std::string &file, const Instance &defaults, std::vector<Instance> &instances);
+
+#endif
+
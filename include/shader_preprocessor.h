@@ -0,0 +1,29 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include <string>
+#include <vector>
+
+/*
+ * A GLSL shader flattened by preprocess_shader, ready to be compiled
+ */
+struct ShaderSource {
+	std::string source;
+	//The files the source was built from, the shader's own file first followed by
+	//the files it included. Error logs refer to the files by their index in this list
+	std::vector<std::string> files;
+};
+
+/*
+ * Load the shader in file and resolve its #include "file" directives, the
+ * included path is relative to the file including it. Each file is only
+ * included once so headers don't need include guards, and #line directives are
+ * inserted so the driver's error logs point at the right file and line. The
+ * defines are injected after the #version line as #define <define>, e.g. "SIZE"
+ * or "ATLAS_GRID 4". Returns false if the file or one of its includes couldn't
+ * be read
+ */
+bool preprocess_shader(const std::string &file, const std::vector<std::string> &defines, ShaderSource &out);
+
+#endif
+
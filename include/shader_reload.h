@@ -0,0 +1,126 @@
+#ifndef SHADER_RELOAD_H
+#define SHADER_RELOAD_H
+
+#include <cstddef>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "gl_core_3_3.h"
+#include "program_cache.h"
+
+/*
+ * Counters for the reloads done so far
+ */
+struct ShaderReloadStats {
+	size_t reloads, failed;
+	//Longest frame from a reload being requested until the frame after the new program was
+	//swapped in, the stall the reload caused shows up here
+	double max_hitch_ms;
+	//Time from the last reload being requested until its program was ready
+	double last_latency_ms;
+	//Time spent on the render thread by the last reload, over all the frames it took
+	double last_render_ms;
+
+	ShaderReloadStats() : reloads(0), failed(0), max_hitch_ms(0), last_latency_ms(0), last_render_ms(0){}
+};
+
+/*
+ * Rebuilds a shader program in the background when its files change so the
+ * render thread doesn't stall on the compile. The sources are read on a loader
+ * thread, then the render thread looks them up in the program cache or issues
+ * the compile and link without waiting on them. With KHR_parallel_shader_compile
+ * the driver compiles on its own threads and we poll GL_COMPLETION_STATUS each
+ * frame, without it we give the driver a frame before checking the link status.
+ * The old program stays in use until the new one is ready. In synchronous mode
+ * the program is read and built on the render thread as soon as it's requested,
+ * which is how reloads used to work. The shaders are preprocessed with the
+ * variant's defines and the reloader keeps track of the files they include, so
+ * the file watcher can ask it if a change affects the program
+ */
+class ShaderReloader {
+public:
+	typedef std::vector<std::tuple<GLenum, std::string>> ShaderList;
+
+private:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	ShaderList files;
+	std::vector<std::string> defines;
+	ProgramCache &cache;
+	bool async, parallel;
+
+	//Loader thread state, protected by the mutex
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	bool read_requested, sources_ready, quit;
+	ShaderList loaded_sources;
+	std::vector<std::string> loaded_names;
+	//The shader files and everything they include as of the last read
+	std::vector<std::string> dependencies;
+
+	//Render thread state for the reload in flight
+	bool pending;
+	PendingProgram build;
+	int frames_waited;
+	//Frames after the new program was swapped in that we still count toward the hitch
+	int hitch_frames;
+	double reload_hitch_ms, reload_render_ms;
+	Clock::time_point request_time;
+	ShaderReloadStats stats;
+
+public:
+	/*
+	 * Reload the program made from the list of shader types and files built with
+	 * the defines, programs are built through the cache
+	 */
+	ShaderReloader(ProgramCache &cache, const ShaderList &files, const std::vector<std::string> &defines = {},
+		bool async = true);
+	~ShaderReloader();
+	ShaderReloader(const ShaderReloader&) = delete;
+	ShaderReloader& operator=(const ShaderReloader&) = delete;
+	/*
+	 * Request a reload, e.g. when the file watcher sees a shader change.
+	 * Must be called from the render thread
+	 */
+	void request();
+	/*
+	 * Check if the program is built from the file, either one of the shaders
+	 * or a file they include
+	 */
+	bool depends_on(const std::string &file);
+	/*
+	 * Advance the reload in flight, call once a frame on the render thread with the
+	 * duration of the previous frame. Returns the new program once it's ready or -1
+	 * otherwise, the caller takes ownership of it and should swap it in and re-apply
+	 * its uniform block bindings
+	 */
+	GLint update(double last_frame_ms);
+	/*
+	 * Check if a reload is in flight
+	 */
+	bool busy() const;
+	bool is_async() const;
+	bool is_parallel() const;
+	const ShaderReloadStats& reload_stats() const;
+
+private:
+	void loader_loop();
+	//Read and preprocess the shaders, the sources are left empty if one couldn't be read
+	void read_sources(ShaderList &read, std::vector<std::string> &read_names, std::vector<std::string> &deps) const;
+	//Take the sources the loader read if they're ready, returns false if they're not
+	bool take_sources();
+	//Start building the program, returns false if the sources couldn't be read
+	bool begin_build();
+	//Give up on the reload in flight, returns -1
+	GLint fail_build();
+	//Finish the build if the driver's done with it, returns the program or -1
+	GLint finish_build(bool wait);
+};
+
+#endif
+
@@ -0,0 +1,144 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "gl_core_3_3.h"
+#include "job_system.h"
+#include "program_cache.h"
+
+/*
+ * Optional features of the billboard shaders, each is a #define the shaders
+ * check so a scene that doesn't use a feature doesn't pay for it
+ *  SIZE: scale the quads by the instance size, otherwise they're unit size
+ *  ROTATION: rotate the quads by the instance rotation
+ *  ATLAS: texture the sprites from the sprite atlas
+ *  ALPHA_TEST: discard fragments with alpha below ALPHA_CUTOFF
+ *  MIN_SIZE: grow quads smaller than the Viewing block's minimum pixel size up to it
+ */
+enum class ShaderFeature { SIZE, ROTATION, ATLAS, ALPHA_TEST, MIN_SIZE };
+const size_t SHADER_FEATURE_COUNT = 5;
+
+/*
+ * A set of features, with the bit for each feature set, see feature_bit
+ */
+typedef uint32_t VariantKey;
+
+constexpr VariantKey feature_bit(ShaderFeature f){
+	return 1 << static_cast<uint32_t>(f);
+}
+const char* shader_feature_name(ShaderFeature f);
+/*
+ * Get the defines to build the variant with
+ */
+std::vector<std::string> variant_defines(VariantKey key);
+/*
+ * Get a readable name for the variant, e.g. SIZE|ROTATION or BASE without any features
+ */
+std::string variant_name(VariantKey key);
+/*
+ * Get the keys of every variant
+ */
+std::vector<VariantKey> all_variants();
+/*
+ * Get the keys of the variants a scene can end up drawn with. Alpha testing is only
+ * used with the atlas, so this skips the combinations with one and not the other
+ */
+std::vector<VariantKey> shipped_variants();
+
+/*
+ * Counters for the variants built so far
+ */
+struct ShaderVariantStats {
+	size_t built, cache_hits, failed;
+	//Time taken by the last call to build or get that built a variant
+	double last_build_ms;
+
+	ShaderVariantStats() : built(0), cache_hits(0), failed(0), last_build_ms(0){}
+};
+
+/*
+ * The variants of a shader program built so far, keyed by their feature set.
+ * Variants can be built ahead of time with build, which preprocesses all of them
+ * in parallel on the job system and then issues every compile and link before
+ * waiting on any, so drivers that compile on their own threads can work on them
+ * all at once. Variants that aren't needed yet can instead be queued with prebuild
+ * and built in the background a frame at a time by update, so they're ready (and in
+ * the program cache) without holding up startup. Programs are loaded through the
+ * program cache when possible
+ */
+class ShaderVariants {
+public:
+	typedef std::vector<std::tuple<GLenum, std::string>> ShaderList;
+
+private:
+	ProgramCache &cache;
+	ShaderList files;
+	std::unordered_map<VariantKey, GLint> programs;
+	//Variants queued by prebuild and the one being built in the background
+	std::deque<VariantKey> queued;
+	VariantKey building_key;
+	PendingProgram building;
+	ShaderVariantStats stats;
+
+public:
+	/*
+	 * Build variants of the program made from the list of shader types and files
+	 */
+	ShaderVariants(ProgramCache &cache, const ShaderList &files);
+	~ShaderVariants();
+	ShaderVariants(const ShaderVariants&) = delete;
+	ShaderVariants& operator=(const ShaderVariants&) = delete;
+	/*
+	 * Build the variants that aren't built yet, returns the number of variants
+	 * that failed to build. Must be called from the thread that owns the jobs
+	 * and has the GL context current
+	 */
+	size_t build(JobSystem &jobs, const std::vector<VariantKey> &keys);
+	/*
+	 * Get the program for the variant, building it if it's not built yet. The
+	 * program is owned by the variant set, returns -1 if it couldn't be built
+	 */
+	GLint get(VariantKey key);
+	/*
+	 * Queue variants that aren't built yet to be built in the background by update
+	 */
+	void prebuild(const std::vector<VariantKey> &keys);
+	/*
+	 * Pick up the variant being built in the background if the driver's done with it and
+	 * start on the next queued one, call once a frame on the thread with the GL context current.
+	 * Without KHR_parallel_shader_compile the driver still gets a frame to build each one
+	 * before we wait on it
+	 */
+	void update();
+	/*
+	 * Get the number of variants left to build in the background
+	 */
+	size_t queued_count() const;
+	/*
+	 * Replace the variant's program with one that was rebuilt, e.g. by the
+	 * ShaderReloader. The other variants are dropped since they were built from
+	 * the old sources and are rebuilt when they're next requested
+	 */
+	void replace(VariantKey key, GLint program);
+	/*
+	 * Delete all the variants built so far
+	 */
+	void clear();
+	size_t size() const;
+	const ShaderVariantStats& variant_stats() const;
+
+private:
+	//Read and preprocess the variant's shaders, the sources are left empty if one couldn't be read
+	void read_sources(VariantKey key, PendingProgram &pending) const;
+	//Keep the finished program of a variant, returns false if it failed to build
+	bool finish(VariantKey key, PendingProgram &pending);
+};
+
+#endif
+
@@ -0,0 +1,86 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <cstddef>
+#include <vector>
+#include "gl_core_3_3.h"
+
+/*
+ * Counters tracking how much data was streamed and how long we had to
+ * wait on the GPU to free up a region to write it into
+ */
+struct StreamStats {
+	size_t bytes_streamed;
+	double fence_wait_ms;
+	//Number of times the region we wanted to write was still in use by the GPU
+	int blocked;
+
+	StreamStats() : bytes_streamed(0), fence_wait_ms(0), blocked(0){}
+};
+
+/*
+ * A buffer for streaming data to the GPU each frame, split into a ring of
+ * regions that are each protected by a fence. While the GPU reads from the
+ * region written for frame N the CPU can fill the regions for the following
+ * frames without stalling the driver. If ARB_buffer_storage is available the
+ * buffer is persistently mapped once, otherwise each region is mapped
+ * unsynchronized since the fences already tell us it's safe to write.
+ *
+ * Usage: map() to move to the next region, write up to capacity() bytes,
+ * unmap(bytes), issue the draws reading from offset() then fence(). If the
+ * region keeps being read in later frames without new data being written
+ * fence() should be called again after those frames' draws as well
+ */
+class StreamBuffer {
+	GLenum target;
+	GLuint buf;
+	size_t region_size;
+	int cur_region;
+	std::vector<GLsync> fences;
+	char *persistent;
+	bool mapped;
+	StreamStats frame, last_frame, total;
+	int frames;
+
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+public:
+	/*
+	 * Create a ring of n_regions regions of at least region_size bytes each
+	 * on the buffer target. Regions are padded to a multiple of alignment so
+	 * their offsets can be used with glBindBufferRange. If allow_persistent is
+	 * false the unsynchronized map path is used even if buffer storage is supported
+	 */
+	StreamBuffer(GLenum target, size_t region_size, int n_regions = 3, size_t alignment = 4,
+		bool allow_persistent = true);
+	~StreamBuffer();
+	/*
+	 * Advance to the next region in the ring, wait until the GPU is done
+	 * with it and get a pointer to write capacity() bytes into it
+	 */
+	void* map();
+	/*
+	 * Finish writing into the mapped region, bytes is the amount of
+	 * data written and is tracked in the streaming stats
+	 */
+	void unmap(size_t bytes);
+	/*
+	 * Fence the current region once all commands reading from it have been
+	 * issued and finish the frame's stats
+	 */
+	void fence();
+	GLuint buffer() const;
+	//Byte offset of the current region in the buffer
+	GLintptr offset() const;
+	size_t capacity() const;
+	bool is_persistent() const;
+	//Stats for the last frame completed by fence()
+	const StreamStats& frame_stats() const;
+	//Stats accumulated over all frames
+	const StreamStats& total_stats() const;
+	int frame_count() const;
+};
+
+#endif
+
@@ -0,0 +1,71 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <string>
+
+/*
+ * Records timelines of spans on each thread and the GPU and writes them out in
+ * the Chrome trace event format, which can be viewed in chrome://tracing or
+ * Perfetto. Each thread records into its own buffer of fixed-size chunks that
+ * only it writes to, publishing the events with an atomic count so recording
+ * never takes a lock. Span names must be string literals (or otherwise outlive
+ * the trace) since only the pointer is stored. Tracing is off until enable()
+ * is called, spans are close to free while it's off
+ */
+namespace trace {
+	void enable();
+	bool enabled();
+	/*
+	 * Nanoseconds since tracing was enabled on the clock spans are recorded with
+	 */
+	uint64_t now_ns();
+	/*
+	 * Name the calling thread's track in the trace
+	 */
+	void set_thread_name(const std::string &name);
+	/*
+	 * Record a span on the calling thread's track
+	 */
+	void record(const char *name, uint64_t begin_ns, uint64_t end_ns);
+	/*
+	 * Record the value of a counter now, counters are shown as a graph of
+	 * their values over time. Only call this when tracing is enabled
+	 */
+	void counter(const char *name, int64_t value);
+	/*
+	 * Record a span on the GPU track from GL_TIMESTAMP query results, they're
+	 * moved on to the CPU clock using the offset measured by calibrate_gpu.
+	 * Must only be called from the thread owning the GL context
+	 */
+	void record_gpu(const char *name, uint64_t gpu_begin_ns, uint64_t gpu_end_ns);
+	/*
+	 * Measure the offset between the GPU and CPU clocks, needs a current GL context
+	 */
+	void calibrate_gpu();
+	/*
+	 * Write the events recorded so far to a JSON trace file. Threads can keep
+	 * recording while it's written, events they add during it may be left out
+	 */
+	bool write(const std::string &file);
+
+	/*
+	 * Records a span on the calling thread's track covering its lifetime
+	 */
+	class Span {
+		const char *name;
+		bool active;
+		uint64_t begin;
+
+	public:
+		Span(const char *name) : name(name), active(enabled()), begin(active ? now_ns() : 0){}
+		~Span(){
+			if (active){
+				record(name, begin, now_ns());
+			}
+		}
+	};
+}
+
+#endif
+
@@ -1,6 +1,9 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
 #include <vector>
 #include <array>
 #include <string>
@@ -12,23 +15,100 @@ namespace util {
 	constexpr float deg_to_rad(float deg){
 		return deg * 0.01745f;
 	}
+	/*
+	 * Hash the bytes with 64 bit FNV-1a, pass a previous hash to continue hashing from it
+	 */
+	uint64_t fnv1a(const void *data, size_t len, uint64_t hash = 14695981039346656037ull);
+	/*
+	 * Get the milliseconds elapsed since start
+	 */
+	double elapsed_ms(const std::chrono::high_resolution_clock::time_point &start);
+	/*
+	 * Get the distance from p to the closest point of the box, 0 if p is inside it
+	 */
+	float box_distance(const glm::vec3 &p, const float *lower, const float *upper);
+	/*
+	 * Get the directory part of the file path with its trailing separator, or
+	 * an empty string if the path has no directory
+	 */
+	std::string directory_of(const std::string &file);
 	/*
 	 * Get the resource path for resources located in res/sub_dir
 	 */
 	std::string get_resource_path(const std::string &sub_dir = "");
 	/*
 	* Read the entire contents of a file into a string, if an error occurs
-	* the string will be empty
+	* the string will be empty. The file is read in one go rather than mapped
+	* so it's safe to use on files that may be rewritten while we read them,
+	* like shaders being edited. Use a FileView to read large files that won't
+	* change without the copy
 	*/
 	std::string read_file(const std::string &fName);
 	/*
-	 * Load a GLSL shader from some file, returns -1 if loading failed
+	 * Load a GLSL shader from some file, returns -1 if loading failed. The file
+	 * is run through preprocess_shader with the defines so it can #include other
+	 * files and be built in variants
 	 */
-	GLint load_shader(GLenum type, const std::string &file);
+	GLint load_shader(GLenum type, const std::string &file, const std::vector<std::string> &defines = {});
 	/*
-	 * Build a shader program from the list of shaders passed
+	 * Compile a GLSL shader from its source, name identifies the shader in the
+	 * error log. Returns -1 if compilation failed
 	 */
-	GLint load_program(const std::vector<std::tuple<GLenum, std::string>> &shaders);
+	GLint compile_shader(GLenum type, const std::string &src, const std::string &name);
+	/*
+	 * Build a shader program from the list of shaders passed, each shader is
+	 * loaded with the defines
+	 */
+	GLint load_program(const std::vector<std::tuple<GLenum, std::string>> &shaders,
+		const std::vector<std::string> &defines = {});
+	/*
+	 * Attach the shaders to the program and link it, the shaders are detached and
+	 * deleted afterwards. Returns false and logs why if linking failed
+	 */
+	bool link_program(GLuint program, const std::vector<GLuint> &shaders);
+	/*
+	 * Let drivers with KHR_parallel_shader_compile compile on as many threads as they
+	 * like, call once after creating the context
+	 */
+	void setup_shader_compiler();
+	/*
+	 * Print the info log of a shader or program to stderr if it has one
+	 */
+	void print_info_log(GLuint obj, bool is_program);
+	/*
+	 * Name a preprocessed shader for error logs, listing the file each #line
+	 * source number refers to
+	 */
+	std::string shader_name(const std::vector<std::string> &files);
+	/*
+	 * A width x height framebuffer with an RGBA8 color and 24 bit depth renderbuffer
+	 * for drawing offscreen, e.g. when there's no window or to keep an image between frames
+	 */
+	class OffscreenFramebuffer {
+		GLuint fbo, color_rb, depth_rb;
+		int width, height;
+
+	public:
+		OffscreenFramebuffer();
+		~OffscreenFramebuffer();
+		OffscreenFramebuffer(const OffscreenFramebuffer&) = delete;
+		OffscreenFramebuffer& operator=(const OffscreenFramebuffer&) = delete;
+		/*
+		 * Create the framebuffer and its renderbuffers, the framebuffer is left bound.
+		 * Returns false if it's incomplete
+		 */
+		bool create(int width, int height);
+		/*
+		 * Delete the framebuffer, must be done while its context is still current
+		 */
+		void destroy();
+		/*
+		 * Blit the color to the same size target framebuffer and leave the target bound
+		 */
+		void blit(GLuint target) const;
+		//The framebuffer's id, 0 if it hasn't been created
+		GLuint framebuffer() const;
+	};
 	/*
 	 * Load an image into an OpenGL texture. SDL is used to read the image into
 	 * a surface which is then passed to OpenGL. A new texture id is created
@@ -41,7 +121,9 @@ namespace util {
 	GLuint load_texture(const std::string &file);
 	/*
 	 * Check for an OpenGL error and log it along with the message passed
-	 * if an error occured. Will return true if an error occured & was logged
+	 * if an error occured. Will return true if an error occured & was logged.
+	 * glGetError can stall the pipeline so avoid calling this every frame,
+	 * see GLErrorChecker for checking at a limited rate
 	 */
 	bool log_glerror(const std::string &msg);
 	/*
@@ -0,0 +1,37 @@
+//Shared by the billboard shaders, included after the variant's feature defines
+//so they can be checked here
+
+const vec2 quad[4] = vec2[4](
+	vec2(-1, -1),
+	vec2(1, -1),
+	vec2(-1, 1),
+	vec2(1, 1)
+);
+
+//Viewing matrices and eye pos
+//the eye pos is used to make the billboards face the camera
+//The viewport is its width and height in pixels and the smallest
+//size in pixels MIN_SIZE draws the billboards at
+layout(std140) uniform Viewing {
+	mat4 view;
+	mat4 proj;
+	vec4 eye_pos;
+	vec4 viewport;
+};
+
+//Colors for the vertices, indexed by sprite_id + glVertexID
+//This could be other sprite attributes that you need, eg. uv coordinates
+//for the sprite textures, etc.
+layout(std140) uniform Colors {
+	//We have "4" types of sprites and a color for each vertex per sprite
+	vec4 colors[16];
+};
+
+//The sprite atlas is a grid of ATLAS_GRID x ATLAS_GRID sprites, indexed by sprite_id
+#ifndef ATLAS_GRID
+#define ATLAS_GRID 2
+#endif
+//Fragments with an atlas alpha below this are discarded with ALPHA_TEST
+#ifndef ALPHA_CUTOFF
+#define ALPHA_CUTOFF 0.5
+#endif
@@ -1,10 +1,25 @@
 #version 330 core
 
+#include "common.glsl"
+
 in vec4 fcolor;
+#ifdef ATLAS
+in vec2 fuv;
+
+uniform sampler2D atlas;
+#endif
 
 out vec4 color;
 
 void main(void){
 	color = fcolor;
+#ifdef ATLAS
+	color *= texture(atlas, fuv);
+#endif
+#ifdef ALPHA_TEST
+	if (color.a < ALPHA_CUTOFF){
+		discard;
+	}
+#endif
 }
 
@@ -0,0 +1,13 @@
+#version 330 core
+
+//The far field's color and opacity, blended over what's behind it
+uniform sampler2D far_field;
+
+in vec2 uv;
+
+out vec4 color;
+
+void main(void){
+	color = texture(far_field, uv);
+}
+
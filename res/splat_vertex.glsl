@@ -0,0 +1,11 @@
+#version 330 core
+
+//A full screen quad for compositing the far field splat, see far_field.h.
+//It's drawn as a 4 vertex strip and the corners come from the vertex id
+out vec2 uv;
+
+void main(void){
+	uv = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+	gl_Position = vec4(uv * 2 - 1, 0, 1);
+}
+
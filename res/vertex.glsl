@@ -1,39 +1,51 @@
 #version 330 core
 
-const vec2 quad[4] = vec2[4](
-	vec2(-1, -1),
-	vec2(1, -1),
-	vec2(-1, 1),
-	vec2(1, 1)
-);
-
-//Viewing matrices and eye pos
-//the eye pos is used to make the billboards face the camera
-layout(std140) uniform Viewing {
-	mat4 view;
-	mat4 proj;
-	vec4 eye_pos;
-};
-
-//Colors for the vertices, indexed by sprite_id + glVertexID
-//This could be other sprite attributes that you need, eg. uv coordinates
-//for the sprite textures, etc.
-layout(std140) uniform Colors {
-	//We have "4" types of sprites and a color for each vertex per sprite
-	vec4 colors[16];
-};
-
+//The shader is built in variants with only the features the scene uses, see
+//shader_variants.h. SIZE scales the quads by their size, ROTATION rotates them,
+//ATLAS passes texture coordinates into the sprite atlas to the fragment shader
+//and MIN_SIZE keeps far away quads from shrinking below a few pixels
+#include "common.glsl"
+
+//Per-instance attributes, interleaved in a single buffer. See INSTANCE_LAYOUT
+//in instance.h for the matching buffer layout
 layout(location = 0) in vec3 pos;
 layout(location = 1) in int sprite_id;
+layout(location = 2) in float size;
+layout(location = 3) in vec4 tint;
+layout(location = 4) in float rotation;
 
 out vec4 fcolor;
+#ifdef ATLAS
+out vec2 fuv;
+#endif
 
 void main(void){
 	//Select the color (uv, w/e) for this sprite and vertex
-	fcolor = colors[sprite_id * 4 + gl_VertexID];
-
-	//Expand out this vertex to its point on the quad
-	gl_Position = vec4(pos.xy + quad[gl_VertexID], pos.z, 1);
+	fcolor = colors[sprite_id * 4 + gl_VertexID] * tint;
+#ifdef ATLAS
+	vec2 cell = vec2(sprite_id % ATLAS_GRID, sprite_id / ATLAS_GRID);
+	fuv = (cell + quad[gl_VertexID] * 0.5 + 0.5) / ATLAS_GRID;
+#endif
+
+	//Rotate and scale the quad corner then expand out this vertex to its point on the quad
+	vec2 corner = quad[gl_VertexID];
+#ifdef ROTATION
+	float c = cos(rotation);
+	float s = sin(rotation);
+	corner = mat2(c, s, -s, c) * corner;
+#endif
+	float half_size = 1;
+#ifdef SIZE
+	half_size = size;
+#endif
+#ifdef MIN_SIZE
+	//Only the view's translation is kept below so the depth is just along z. A quad reaching
+	//half_size out from its center is half_size * proj[1][1] * viewport.y / depth pixels tall
+	float depth = -(pos.z + view[3].z);
+	half_size = max(half_size, viewport.z * depth / (proj[1][1] * max(viewport.y, 1)));
+#endif
+	corner *= half_size;
+	gl_Position = vec4(pos.xy + corner, pos.z, 1);
 	//Transform and project the quad
 	mat4 modified_view = view;
 	modified_view[0] = vec4(1, 0, 0, 0);
@@ -0,0 +1,266 @@
+#include <cassert>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <glm/glm.hpp>
+#include "instance.h"
+#include "job_system.h"
+#include "cull.h"
+#include "morton.h"
+#include "bvh.h"
+
+namespace {
+	//Deferred build of the subtree rooted at node for the instances [first, last)
+	struct BuildTask {
+		uint32_t node, first, last;
+	};
+
+	const size_t CHUNK_SIZE = 16384;
+
+	int count_leading_zeros(uint64_t v){
+#if defined(__GNUC__) || defined(__clang__)
+		return v == 0 ? 64 : __builtin_clzll(v);
+#else
+		int n = 0;
+		for (uint64_t bit = 1ull << 63; bit && !(v & bit); bit >>= 1){
+			++n;
+		}
+		return n;
+#endif
+	}
+	/*
+	 * Find the index where the highest bit that differs between the codes in
+	 * [first, last) switches from 0 to 1, see Karras 2012 "Maximizing Parallelism
+	 * in the Construction of BVHs, Octrees, and k-d Trees"
+	 */
+	uint32_t find_split(const std::vector<uint64_t> &codes, uint32_t first, uint32_t last){
+		const uint64_t first_code = codes[first];
+		const int common = count_leading_zeros(first_code ^ codes[last - 1]);
+		uint32_t split = first;
+		uint32_t step = last - 1 - first;
+		do {
+			step = (step + 1) >> 1;
+			const uint32_t next = split + step;
+			if (next < last - 1 && count_leading_zeros(first_code ^ codes[next]) > common){
+				split = next;
+			}
+		} while (step > 1);
+		return split + 1;
+	}
+	/*
+	 * Build the subtree over [first, last) into nodes, returns the index of its root.
+	 * If deferred is not null subtrees with at most defer_size instances are
+	 * recorded to be built later instead
+	 */
+	uint32_t build_subtree(std::vector<BVHNode> &nodes, const std::vector<uint64_t> &codes,
+		const std::vector<Instance> &instances, uint32_t first, uint32_t last, size_t leaf_size,
+		std::vector<BuildTask> *deferred, size_t defer_size)
+	{
+		const uint32_t idx = nodes.size();
+		nodes.push_back(BVHNode{glm::vec3{0}, glm::vec3{0}, 0, 0, first, last - first, 0, 0});
+		if (last - first <= leaf_size || codes[first] == codes[last - 1]){
+			glm::vec3 lower{std::numeric_limits<float>::max()};
+			glm::vec3 upper{-std::numeric_limits<float>::max()};
+			float min_radius = std::numeric_limits<float>::max();
+			float max_radius = 0;
+			for (uint32_t i = first; i < last; ++i){
+				const float r = instance_radius(instances[i]);
+				lower = glm::min(lower, instances[i].pos - glm::vec3{r});
+				upper = glm::max(upper, instances[i].pos + glm::vec3{r});
+				min_radius = std::min(min_radius, r);
+				max_radius = std::max(max_radius, r);
+			}
+			nodes[idx].lower = lower;
+			nodes[idx].upper = upper;
+			nodes[idx].min_radius = min_radius;
+			nodes[idx].max_radius = max_radius;
+			return idx;
+		}
+		if (deferred && last - first <= defer_size){
+			deferred->push_back(BuildTask{idx, first, last});
+			return idx;
+		}
+		const uint32_t split = find_split(codes, first, last);
+		const uint32_t left = build_subtree(nodes, codes, instances, first, split, leaf_size,
+			deferred, defer_size);
+		const uint32_t right = build_subtree(nodes, codes, instances, split, last, leaf_size,
+			deferred, defer_size);
+		nodes[idx].left = left;
+		nodes[idx].right = right;
+		return idx;
+	}
+}
+
+void push_range(std::vector<DrawRange> &ranges, uint32_t first, uint32_t count){
+	if (!ranges.empty() && ranges.back().first + ranges.back().count == first){
+		ranges.back().count += count;
+	}
+	else {
+		ranges.push_back(DrawRange{first, count});
+	}
+}
+void BVH::build(JobSystem &jobs, std::vector<Instance> &instances, std::vector<uint32_t> *order,
+	size_t leaf_size)
+{
+	nodes.clear();
+	const size_t n = instances.size();
+	if (n == 0){
+		return;
+	}
+	assert(n <= std::numeric_limits<uint32_t>::max());
+
+	//Sort by Morton code so each subtree we split off covers a contiguous range
+	std::vector<uint64_t> codes;
+	std::vector<uint32_t> sorted_order;
+	morton_sort(jobs, instances, MortonBits::BITS_30, codes, sorted_order);
+	std::vector<Instance> sorted;
+	permute_instances(jobs, instances, sorted_order, sorted);
+	instances.swap(sorted);
+	if (order){
+		order->swap(sorted_order);
+	}
+
+	//Build the top of the tree serially until the ranges are small enough that there's
+	//plenty of subtrees to build in parallel
+	std::vector<BuildTask> tasks;
+	const size_t defer_size = std::max(n / (8 * jobs.size()), leaf_size);
+	build_subtree(nodes, codes, instances, 0, n, leaf_size, &tasks, defer_size);
+
+	std::vector<std::vector<BVHNode>> subtrees(tasks.size());
+	jobs.parallel_for(tasks.size(), 1, [&](size_t begin, size_t end, unsigned){
+		for (size_t t = begin; t < end; ++t){
+			build_subtree(subtrees[t], codes, instances, tasks[t].first, tasks[t].last, leaf_size,
+				nullptr, 0);
+		}
+	});
+	//Splice the subtrees in, their root replaces the placeholder node and the rest are appended
+	for (size_t t = 0; t < tasks.size(); ++t){
+		const std::vector<BVHNode> &sub = subtrees[t];
+		const uint32_t base = nodes.size() - 1;
+		for (size_t j = 0; j < sub.size(); ++j){
+			BVHNode node = sub[j];
+			if (!node.is_leaf()){
+				node.left += base;
+				node.right += base;
+			}
+			if (j == 0){
+				nodes[tasks[t].node] = node;
+			}
+			else {
+				nodes.push_back(node);
+			}
+		}
+	}
+	//Children always come after their parent so we can compute the interior bounds bottom up
+	for (size_t i = nodes.size(); i-- > 0;){
+		BVHNode &node = nodes[i];
+		if (!node.is_leaf()){
+			node.lower = glm::min(nodes[node.left].lower, nodes[node.right].lower);
+			node.upper = glm::max(nodes[node.left].upper, nodes[node.right].upper);
+			node.min_radius = std::min(nodes[node.left].min_radius, nodes[node.right].min_radius);
+			node.max_radius = std::max(nodes[node.left].max_radius, nodes[node.right].max_radius);
+		}
+	}
+}
+void BVH::cull(const Frustum &frustum, const InstanceSoA &spheres, std::vector<DrawRange> &ranges,
+	CullISA isa, BVHCullStats *stats, const ScreenSizeCull *size_cull) const
+{
+	ranges.clear();
+	if (nodes.empty()){
+		return;
+	}
+	BVHCullStats local;
+	std::vector<uint32_t> visible;
+	//Each level of the tree splits on a Morton code bit so it's at most 31 deep
+	uint32_t stack[64];
+	int stack_size = 0;
+	stack[stack_size++] = 0;
+	while (stack_size > 0){
+		const BVHNode &node = nodes[stack[--stack_size]];
+		++local.nodes_visited;
+		const Overlap overlap = test_aabb(frustum, node.lower, node.upper);
+		if (overlap == Overlap::OUTSIDE){
+			continue;
+		}
+		//The node's nearest point is at its upper z and its farthest at its lower z, so if
+		//its largest instance is too small there it's all too small and if its smallest
+		//instance is big enough at the far end it's all big enough
+		bool test_size = false;
+		if (size_cull){
+			if (!size_cull->large_enough(node.max_radius, node.upper.z)){
+				local.size_culled += node.count;
+				continue;
+			}
+			test_size = !size_cull->large_enough(node.min_radius, node.lower.z);
+		}
+		if (overlap == Overlap::INSIDE && !test_size){
+			++local.nodes_inside;
+			local.visible += node.count;
+			push_range(ranges, node.first, node.count);
+		}
+		else if (node.is_leaf()){
+			size_t n_visible = node.count;
+			visible.resize(node.count);
+			if (overlap == Overlap::INSIDE){
+				for (uint32_t i = 0; i < node.count; ++i){
+					visible[i] = node.first + i;
+				}
+			}
+			else {
+				n_visible = cull_spheres(frustum, spheres, node.first, node.first + node.count, visible.data(), isa);
+			}
+			if (test_size){
+				const size_t in_frustum = n_visible;
+				n_visible = 0;
+				for (size_t i = 0; i < in_frustum; ++i){
+					const uint32_t j = visible[i];
+					if (size_cull->large_enough(spheres.radius[j], spheres.z[j] + spheres.radius[j])){
+						visible[n_visible++] = j;
+					}
+				}
+				local.size_culled += in_frustum - n_visible;
+			}
+			local.instances_tested += node.count;
+			local.visible += n_visible;
+			for (size_t i = 0; i < n_visible; ++i){
+				push_range(ranges, visible[i], 1);
+			}
+		}
+		else {
+			//Push the right child first so we walk the instances in order and can merge ranges
+			stack[stack_size++] = node.right;
+			stack[stack_size++] = node.left;
+		}
+	}
+	if (stats){
+		*stats = local;
+	}
+}
+const std::vector<BVHNode>& BVH::node_list() const {
+	return nodes;
+}
+size_t BVH::memory_bytes() const {
+	return nodes.size() * sizeof(BVHNode);
+}
+size_t copy_ranges(JobSystem &jobs, const std::vector<DrawRange> &ranges, const Instance *src,
+	Instance *dst)
+{
+	//Find where each range starts in the output then split the copying up evenly by
+	//output instance so a few huge ranges still get spread over the workers
+	std::vector<size_t> offsets(ranges.size() + 1, 0);
+	for (size_t i = 0; i < ranges.size(); ++i){
+		offsets[i + 1] = offsets[i] + ranges[i].count;
+	}
+	const size_t total = offsets.back();
+	jobs.parallel_for(total, CHUNK_SIZE, [&](size_t begin, size_t end, unsigned){
+		size_t r = std::upper_bound(offsets.begin(), offsets.end(), begin) - offsets.begin() - 1;
+		for (size_t out = begin; out < end; ++r){
+			const size_t range_end = std::min(offsets[r + 1], end);
+			const Instance *from = src + ranges[r].first + (out - offsets[r]);
+			std::copy(from, from + (range_end - out), dst + out);
+			out = range_end;
+		}
+	});
+	return total;
+}
+
@@ -0,0 +1,367 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include "util.h"
+#include "trace.h"
+#include "chunk_stream.h"
+
+namespace {
+	struct WantedChunk {
+		uint32_t chunk;
+		//Prefetched chunks come after all the visible ones, then nearer chunks come first. The
+		//distance is to the eye for visible chunks and to the point ahead for prefetched ones
+		bool prefetch;
+		float distance;
+
+		bool operator<(const WantedChunk &b) const {
+			return prefetch != b.prefetch ? b.prefetch : distance < b.distance;
+		}
+	};
+}
+
+ChunkStreamer::ChunkStreamer(SceneFile &scene, size_t pool_bytes, unsigned io_threads, size_t upload_budget,
+	float prefetch_distance)
+	: scene(scene), slot_bytes(scene.header().chunk_size * sizeof(Instance)), upload_budget(upload_budget),
+	prefetch_distance(prefetch_distance), pool(0), gpu_done_frame(0), chunks(scene.chunk_count()), frame(0),
+	n_resident(0), n_pending(0), quit(false)
+{
+	const size_t n_slots = std::max(pool_bytes / slot_bytes, size_t{1});
+	slots.resize(n_slots, -1);
+	slot_drawn.resize(n_slots, 0);
+	//The pool is allocated once up front, chunks are only ever copied into its slots
+	glGenBuffers(1, &pool);
+	glBindBuffer(GL_ARRAY_BUFFER, pool);
+	glBufferData(GL_ARRAY_BUFFER, n_slots * slot_bytes, NULL, GL_DYNAMIC_DRAW);
+
+	//Two staging buffers per thread so each one has another chunk queued while
+	//the render thread uploads what it read
+	const size_t n_staging = io_threads == 0 ? 1 : 2 * io_threads;
+	staging.resize(n_staging);
+	for (size_t i = 0; i < n_staging; ++i){
+		staging[i].resize(scene.header().chunk_size);
+		free_staging.push_back(static_cast<int32_t>(n_staging - i - 1));
+	}
+	for (unsigned i = 0; i < io_threads; ++i){
+		this->io_threads.emplace_back([this](){ io_loop(); });
+	}
+}
+ChunkStreamer::~ChunkStreamer(){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wakeup.notify_all();
+	for (std::thread &t : io_threads){
+		t.join();
+	}
+	for (const DrawFence &f : draw_fences){
+		glDeleteSync(f.fence);
+	}
+	glDeleteBuffers(1, &pool);
+}
+void ChunkStreamer::update(const glm::vec3 &eye, const glm::vec3 &view_dir, const Frustum &frustum){
+	//Visible chunks are wanted nearest first, then the chunks we'll reach soon if
+	//we keep going the way we're looking
+	const glm::vec3 ahead = eye + view_dir * prefetch_distance;
+	std::vector<WantedChunk> by_priority;
+	for (size_t i = 0; i < chunks.size(); ++i){
+		const SceneChunk &c = scene.chunk(i);
+		if (c.count == 0){
+			continue;
+		}
+		const glm::vec3 lower{c.bounds_min[0], c.bounds_min[1], c.bounds_min[2]};
+		const glm::vec3 upper{c.bounds_max[0], c.bounds_max[1], c.bounds_max[2]};
+		if (test_aabb(frustum, lower, upper) != Overlap::OUTSIDE){
+			by_priority.push_back(WantedChunk{static_cast<uint32_t>(i), false,
+				util::box_distance(eye, c.bounds_min, c.bounds_max)});
+		}
+		else {
+			const float ahead_dist = util::box_distance(ahead, c.bounds_min, c.bounds_max);
+			if (ahead_dist < prefetch_distance){
+				by_priority.push_back(WantedChunk{static_cast<uint32_t>(i), true, ahead_dist});
+			}
+		}
+	}
+	std::sort(by_priority.begin(), by_priority.end());
+	std::vector<StreamChunk> chunk_list(by_priority.size());
+	for (size_t i = 0; i < by_priority.size(); ++i){
+		chunk_list[i] = StreamChunk{by_priority[i].chunk, !by_priority[i].prefetch};
+	}
+	update(chunk_list);
+}
+void ChunkStreamer::update(const std::vector<StreamChunk> &chunk_list){
+	trace::Span span{"stream update"};
+	++frame;
+	frame_counters = ChunkStreamStats{};
+	uploads.clear();
+
+	//Pick up the chunks the I/O threads finished reading
+	std::vector<uint32_t> done;
+	if (!io_threads.empty()){
+		std::lock_guard<std::mutex> lock(mutex);
+		done.swap(finished);
+	}
+	for (uint32_t c : done){
+		chunks[c].state = ChunkState::STAGED;
+	}
+	retire_fences();
+
+	for (ChunkEntry &entry : chunks){
+		entry.visible = false;
+	}
+	for (const StreamChunk &c : chunk_list){
+		chunks[c.chunk].visible = c.visible;
+		if (c.visible){
+			++frame_counters.visible;
+		}
+	}
+	//We can't keep more chunks than fit in the pool
+	wanted.assign(chunk_list.begin(), chunk_list.begin() + std::min(chunk_list.size(), slots.size()));
+	for (size_t i = 0; i < wanted.size(); ++i){
+		chunks[wanted[i].chunk].last_wanted = frame;
+		chunks[wanted[i].chunk].rank = static_cast<uint32_t>(i);
+	}
+
+	//Requests still queued from earlier frames for chunks we don't want anymore are dropped,
+	//the rest are kept and re-ordered by their priority this frame
+	if (!io_threads.empty()){
+		std::lock_guard<std::mutex> lock(mutex);
+		auto dropped = std::stable_partition(requests.begin(), requests.end(),
+			[this](const ReadRequest &r){ return chunks[r.chunk].last_wanted == frame; });
+		for (auto it = dropped; it != requests.end(); ++it){
+			chunks[it->chunk].state = ChunkState::ON_DISK;
+			chunks[it->chunk].staging = -1;
+			free_staging.push_back(it->staging);
+			--n_pending;
+		}
+		requests.erase(dropped, requests.end());
+	}
+	//Request reads of the wanted chunks that aren't in memory, highest priority first
+	std::vector<ReadRequest> new_requests;
+	for (const StreamChunk &w : wanted){
+		if (free_staging.empty()){
+			break;
+		}
+		ChunkEntry &entry = chunks[w.chunk];
+		if (entry.state != ChunkState::ON_DISK){
+			continue;
+		}
+		entry.staging = free_staging.back();
+		free_staging.pop_back();
+		++n_pending;
+		if (!entry.visible){
+			++frame_counters.prefetches;
+		}
+		if (io_threads.empty()){
+			//Without I/O threads we read and upload it now, stalling the frame on the disk
+			read_chunk(w.chunk, staging[entry.staging]);
+			entry.state = ChunkState::STAGED;
+			glBindBuffer(GL_ARRAY_BUFFER, pool);
+			frame_counters.upload_bytes += upload_chunk(w.chunk);
+		}
+		else {
+			entry.state = ChunkState::READING;
+			new_requests.push_back(ReadRequest{w.chunk, entry.staging});
+		}
+	}
+	if (!new_requests.empty()){
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			requests.insert(requests.end(), new_requests.begin(), new_requests.end());
+			std::sort(requests.begin(), requests.end(), [this](const ReadRequest &a, const ReadRequest &b){
+				return chunks[a.chunk].rank < chunks[b.chunk].rank;
+			});
+		}
+		wakeup.notify_all();
+	}
+}
+void ChunkStreamer::upload(){
+	trace::Span span{"stream upload"};
+	const auto start = std::chrono::high_resolution_clock::now();
+	glBindBuffer(GL_ARRAY_BUFFER, pool);
+	//Staged chunks we no longer want give their staging buffer back without being uploaded
+	for (size_t i = 0; i < chunks.size(); ++i){
+		ChunkEntry &entry = chunks[i];
+		if (entry.state == ChunkState::STAGED && entry.last_wanted != frame){
+			entry.state = ChunkState::ON_DISK;
+			free_staging.push_back(entry.staging);
+			entry.staging = -1;
+			--n_pending;
+		}
+	}
+	draw_list.clear();
+	size_t uploaded = 0;
+	for (const StreamChunk &w : wanted){
+		ChunkEntry &entry = chunks[w.chunk];
+		const size_t bytes = scene.chunk(w.chunk).count * sizeof(Instance);
+		//Always upload at least one chunk a frame so a budget smaller than a chunk still makes progress
+		if (entry.state == ChunkState::STAGED && (upload_budget == 0 || uploaded == 0
+			|| uploaded + bytes <= upload_budget))
+		{
+			const size_t chunk_bytes = upload_chunk(w.chunk);
+			//No slot was free to write, the chunk stays staged and we try again next frame
+			if (chunk_bytes == 0){
+				++frame_counters.deferred;
+			}
+			uploaded += chunk_bytes;
+		}
+		if (entry.visible){
+			if (entry.state == ChunkState::RESIDENT){
+				draw_list.push_back(w.chunk);
+				++frame_counters.drawn;
+			}
+			else {
+				++frame_counters.missing;
+			}
+		}
+	}
+	//Visible chunks that didn't fit in the pool are missing too
+	for (size_t i = 0; i < chunks.size(); ++i){
+		if (chunks[i].visible && chunks[i].last_wanted != frame){
+			++frame_counters.missing;
+		}
+	}
+	frame_counters.upload_bytes += uploaded;
+	frame_counters.upload_ms = std::chrono::duration<double, std::milli>(
+		std::chrono::high_resolution_clock::now() - start).count();
+	frame_counters.resident = n_resident;
+	frame_counters.pending = n_pending;
+
+	total.resident = n_resident;
+	total.pending = n_pending;
+	total.visible += frame_counters.visible;
+	total.missing += frame_counters.missing;
+	total.drawn += frame_counters.drawn;
+	total.loads += frame_counters.loads;
+	total.evictions += frame_counters.evictions;
+	total.prefetches += frame_counters.prefetches;
+	total.deferred += frame_counters.deferred;
+	total.upload_bytes += frame_counters.upload_bytes;
+	total.upload_ms += frame_counters.upload_ms;
+	if (trace::enabled()){
+		trace::counter("resident chunks", n_resident);
+		trace::counter("pending chunk reads", n_pending);
+		trace::counter("chunk evictions", frame_counters.evictions);
+		trace::counter("missing chunks", frame_counters.missing);
+		trace::counter("chunk loads", frame_counters.loads);
+		trace::counter("drawn chunks", frame_counters.drawn);
+	}
+}
+size_t ChunkStreamer::draw(){
+	size_t drawn = 0;
+	for (uint32_t c : draw_list){
+		const size_t count = scene.chunk(c).count;
+		setup_instance_attribs(pool, chunks[c].slot * slot_bytes);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(count));
+		slot_drawn[chunks[c].slot] = frame;
+		drawn += count;
+	}
+	//Fence the frame's draws so we know when their slots can be written again
+	if (!draw_list.empty() && (draw_fences.empty() || draw_fences.back().frame != frame)){
+		draw_fences.push_back(DrawFence{frame, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+	}
+	return drawn;
+}
+void ChunkStreamer::set_read_callback(std::function<void()> callback){
+	read_callback = callback;
+}
+const std::vector<uint32_t>& ChunkStreamer::frame_uploads() const {
+	return uploads;
+}
+size_t ChunkStreamer::pool_slots() const {
+	return slots.size();
+}
+const ChunkStreamStats& ChunkStreamer::frame_stats() const {
+	return frame_counters;
+}
+const ChunkStreamStats& ChunkStreamer::total_stats() const {
+	return total;
+}
+void ChunkStreamer::io_loop(){
+	if (trace::enabled()){
+		trace::set_thread_name("chunk io");
+	}
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true){
+		wakeup.wait(lock, [this](){ return quit || !requests.empty(); });
+		if (quit){
+			return;
+		}
+		const ReadRequest req = requests.front();
+		requests.pop_front();
+		lock.unlock();
+		read_chunk(req.chunk, staging[req.staging]);
+		lock.lock();
+		finished.push_back(req.chunk);
+		//Call back outside the lock so the callback doesn't hold up the other threads,
+		//it's set before the first update so reading it unlocked is fine
+		if (read_callback){
+			lock.unlock();
+			read_callback();
+			lock.lock();
+		}
+	}
+}
+void ChunkStreamer::read_chunk(uint32_t chunk, std::vector<Instance> &buf){
+	trace::Span span{"read chunk"};
+	scene.prefetch(chunk);
+	std::memcpy(buf.data(), scene.chunk_instances(chunk), scene.chunk(chunk).count * sizeof(Instance));
+	//We have our own copy now, don't keep the file's pages mapped in
+	scene.release(chunk);
+}
+size_t ChunkStreamer::upload_chunk(uint32_t chunk){
+	const int64_t slot = find_slot();
+	if (slot == -1){
+		return 0;
+	}
+	ChunkEntry &entry = chunks[chunk];
+	const size_t bytes = scene.chunk(chunk).count * sizeof(Instance);
+	glBufferSubData(GL_ARRAY_BUFFER, slot * slot_bytes, bytes, staging[entry.staging].data());
+	slots[slot] = chunk;
+	entry.state = ChunkState::RESIDENT;
+	entry.slot = static_cast<int32_t>(slot);
+	free_staging.push_back(entry.staging);
+	entry.staging = -1;
+	--n_pending;
+	++n_resident;
+	++frame_counters.loads;
+	if (entry.visible){
+		uploads.push_back(chunk);
+	}
+	return bytes;
+}
+int64_t ChunkStreamer::find_slot(){
+	int64_t lru = -1;
+	uint32_t lru_frame = frame;
+	for (size_t i = 0; i < slots.size(); ++i){
+		if (slots[i] == -1){
+			return i;
+		}
+		const uint32_t last = chunks[slots[i]].last_wanted;
+		if (last < lru_frame && slot_drawn[i] <= gpu_done_frame){
+			lru = i;
+			lru_frame = last;
+		}
+	}
+	if (lru != -1){
+		ChunkEntry &evicted = chunks[slots[lru]];
+		evicted.state = ChunkState::ON_DISK;
+		evicted.slot = -1;
+		slots[lru] = -1;
+		--n_resident;
+		++frame_counters.evictions;
+	}
+	return lru;
+}
+void ChunkStreamer::retire_fences(){
+	while (!draw_fences.empty()){
+		const GLenum status = glClientWaitSync(draw_fences.front().fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED){
+			return;
+		}
+		gpu_done_frame = draw_fences.front().frame;
+		glDeleteSync(draw_fences.front().fence);
+		draw_fences.pop_front();
+	}
+}
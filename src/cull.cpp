@@ -0,0 +1,258 @@
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "instance.h"
+#include "cull.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VSB_HAVE_SSE
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef VSB_HAVE_AVX
+//The AVX kernel is in cull_avx.cpp since it's built with AVX code generation enabled
+size_t cull_spheres_avx(const float planes[6][4], const float *xs, const float *ys, const float *zs,
+	const float *radii, size_t begin, size_t end, uint32_t *out);
+#endif
+
+void InstanceSoA::assign(const Instance *instances, size_t n){
+	x.resize(n);
+	y.resize(n);
+	z.resize(n);
+	radius.resize(n);
+	for (size_t i = 0; i < n; ++i){
+		x[i] = instances[i].pos.x;
+		y[i] = instances[i].pos.y;
+		z[i] = instances[i].pos.z;
+		radius[i] = instance_radius(instances[i]);
+	}
+}
+size_t InstanceSoA::size() const {
+	return x.size();
+}
+Frustum extract_frustum(const glm::mat4 &m){
+	//Gribb & Hartmann, the planes are combinations of the rows of the matrix
+	//and glm matrices are indexed [col][row]
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; ++i){
+		row[i] = glm::vec4{m[0][i], m[1][i], m[2][i], m[3][i]};
+	}
+	Frustum f;
+	f.planes[0] = row[3] + row[0];
+	f.planes[1] = row[3] - row[0];
+	f.planes[2] = row[3] + row[1];
+	f.planes[3] = row[3] - row[1];
+	f.planes[4] = row[3] + row[2];
+	f.planes[5] = row[3] - row[2];
+	for (glm::vec4 &p : f.planes){
+		p = p / glm::length(glm::vec3{p});
+	}
+	return f;
+}
+glm::mat4 billboard_view(const glm::mat4 &view){
+	glm::mat4 modified_view = view;
+	modified_view[0] = glm::vec4{1, 0, 0, 0};
+	modified_view[1] = glm::vec4{0, 1, 0, 0};
+	modified_view[2] = glm::vec4{0, 0, 1, 0};
+	return modified_view;
+}
+Frustum billboard_frustum(const glm::mat4 &view, const glm::mat4 &proj){
+	return extract_frustum(proj * billboard_view(view));
+}
+ScreenSizeCull screen_size_cull(const glm::mat4 &view, const glm::mat4 &proj, float viewport_height, float min_px){
+	//proj[1][1] scales view space y to [-1, 1] at a depth of 1, which is half the viewport
+	return ScreenSizeCull{proj[1][1] * viewport_height / 2, -view[3].z, min_px};
+}
+Overlap test_aabb(const Frustum &frustum, const glm::vec3 &lower, const glm::vec3 &upper){
+	Overlap result = Overlap::INSIDE;
+	for (const glm::vec4 &p : frustum.planes){
+		//Test the corners furthest along and against the plane normal
+		const glm::vec3 pos_vert{p.x > 0 ? upper.x : lower.x, p.y > 0 ? upper.y : lower.y,
+			p.z > 0 ? upper.z : lower.z};
+		const glm::vec3 neg_vert{p.x > 0 ? lower.x : upper.x, p.y > 0 ? lower.y : upper.y,
+			p.z > 0 ? lower.z : upper.z};
+		if (glm::dot(glm::vec3{p}, pos_vert) + p.w < 0){
+			return Overlap::OUTSIDE;
+		}
+		if (glm::dot(glm::vec3{p}, neg_vert) + p.w < 0){
+			result = Overlap::INTERSECTS;
+		}
+	}
+	return result;
+}
+float instance_radius(const Instance &instance){
+	//The quad corners are at +/-size along x and y, rotation doesn't change their distance
+	return instance.size * 1.41421356f;
+}
+bool cull_isa_supported(CullISA isa){
+	switch (isa){
+	case CullISA::SCALAR:
+		return true;
+	case CullISA::SSE:
+#ifdef VSB_HAVE_SSE
+		return true;
+#else
+		return false;
+#endif
+	case CullISA::AVX:
+#if !defined(VSB_HAVE_AVX)
+		return false;
+#elif defined(_MSC_VER)
+		{
+			//Check the CPU supports AVX and the OS saves the YMM registers
+			int info[4];
+			__cpuid(info, 1);
+			const bool osxsave = (info[2] & (1 << 27)) != 0;
+			const bool avx = (info[2] & (1 << 28)) != 0;
+			return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+		}
+#else
+		return __builtin_cpu_supports("avx");
+#endif
+	}
+	return false;
+}
+CullISA best_cull_isa(){
+	if (cull_isa_supported(CullISA::AVX)){
+		return CullISA::AVX;
+	}
+	if (cull_isa_supported(CullISA::SSE)){
+		return CullISA::SSE;
+	}
+	return CullISA::SCALAR;
+}
+const char* cull_isa_name(CullISA isa){
+	switch (isa){
+	case CullISA::SCALAR:
+		return "scalar";
+	case CullISA::SSE:
+		return "SSE";
+	case CullISA::AVX:
+		return "AVX";
+	}
+	return "unknown";
+}
+static size_t cull_spheres_scalar(const Frustum &frustum, const InstanceSoA &spheres, size_t begin,
+	size_t end, uint32_t *out)
+{
+	size_t n = 0;
+	for (size_t i = begin; i < end; ++i){
+		bool inside = true;
+		for (const glm::vec4 &p : frustum.planes){
+			const float d = p.x * spheres.x[i] + p.y * spheres.y[i] + p.z * spheres.z[i] + p.w;
+			inside = inside && d >= -spheres.radius[i];
+		}
+		//Write the index unconditionally and only advance if it's visible to avoid branching
+		out[n] = static_cast<uint32_t>(i);
+		n += inside ? 1 : 0;
+	}
+	return n;
+}
+#ifdef VSB_HAVE_SSE
+static size_t cull_spheres_sse(const Frustum &frustum, const InstanceSoA &spheres, size_t begin,
+	size_t end, uint32_t *out)
+{
+	__m128 plane[6][4];
+	for (int p = 0; p < 6; ++p){
+		for (int c = 0; c < 4; ++c){
+			plane[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+		}
+	}
+	size_t n = 0;
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4){
+		const __m128 x = _mm_loadu_ps(&spheres.x[i]);
+		const __m128 y = _mm_loadu_ps(&spheres.y[i]);
+		const __m128 z = _mm_loadu_ps(&spheres.z[i]);
+		const __m128 neg_r = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; ++p){
+			__m128 d = _mm_add_ps(_mm_mul_ps(x, plane[p][0]), _mm_mul_ps(y, plane[p][1]));
+			d = _mm_add_ps(d, _mm_add_ps(_mm_mul_ps(z, plane[p][2]), plane[p][3]));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(d, neg_r));
+		}
+		const int visible = ~_mm_movemask_ps(outside);
+		for (int k = 0; k < 4; ++k){
+			out[n] = static_cast<uint32_t>(i + k);
+			n += (visible >> k) & 1;
+		}
+	}
+	return n + cull_spheres_scalar(frustum, spheres, i, end, out + n);
+}
+#endif
+size_t cull_spheres(const Frustum &frustum, const InstanceSoA &spheres, size_t begin, size_t end,
+	uint32_t *out, CullISA isa)
+{
+	switch (isa){
+#ifdef VSB_HAVE_AVX
+	case CullISA::AVX:
+		{
+			float planes[6][4];
+			for (int p = 0; p < 6; ++p){
+				for (int c = 0; c < 4; ++c){
+					planes[p][c] = frustum.planes[p][c];
+				}
+			}
+			return cull_spheres_avx(planes, spheres.x.data(), spheres.y.data(), spheres.z.data(),
+				spheres.radius.data(), begin, end, out);
+		}
+#endif
+#ifdef VSB_HAVE_SSE
+	case CullISA::SSE:
+		return cull_spheres_sse(frustum, spheres, begin, end, out);
+#endif
+	default:
+		return cull_spheres_scalar(frustum, spheres, begin, end, out);
+	}
+}
+size_t cull_instances(const Frustum &frustum, const InstanceSoA &spheres, const Instance *instances,
+	size_t begin, size_t end, Instance *out, CullISA isa)
+{
+	//Cull in blocks small enough to keep the visible indices on the stack and in cache
+	const size_t BLOCK_SIZE = 2048;
+	uint32_t visible[BLOCK_SIZE];
+	size_t n = 0;
+	for (size_t b = begin; b < end; b += BLOCK_SIZE){
+		const size_t n_visible = cull_spheres(frustum, spheres, b, std::min(b + BLOCK_SIZE, end),
+			visible, isa);
+		for (size_t i = 0; i < n_visible; ++i){
+			out[n++] = instances[visible[i]];
+		}
+	}
+	return n;
+}
+
+ParallelCuller::ParallelCuller(JobSystem &jobs, size_t chunk_size)
+	: jobs(jobs), chunk_size(chunk_size)
+{}
+size_t ParallelCuller::cull(const Frustum &frustum, const InstanceSoA &spheres, const Instance *instances,
+	size_t n, Instance *out, CullISA isa)
+{
+	const size_t n_chunks = (n + chunk_size - 1) / chunk_size;
+	visible.resize(n);
+	chunk_offsets.resize(n_chunks + 1);
+	chunk_offsets[0] = 0;
+	//Cull each chunk, writing the indices of its visible instances into its range of the index list
+	jobs.parallel_for(n, chunk_size, [&](size_t begin, size_t end, unsigned){
+		chunk_offsets[begin / chunk_size + 1] = cull_spheres(frustum, spheres, begin, end,
+			&visible[begin], isa);
+	});
+	for (size_t c = 0; c < n_chunks; ++c){
+		chunk_offsets[c + 1] += chunk_offsets[c];
+	}
+	//Each chunk now knows where its instances go so they can be packed into the output in parallel
+	jobs.parallel_for(n, chunk_size, [&](size_t begin, size_t, unsigned){
+		const size_t c = begin / chunk_size;
+		const uint32_t *idx = &visible[begin];
+		Instance *dst = out + chunk_offsets[c];
+		const size_t count = chunk_offsets[c + 1] - chunk_offsets[c];
+		for (size_t i = 0; i < count; ++i){
+			dst[i] = instances[idx[i]];
+		}
+	});
+	return chunk_offsets[n_chunks];
+}
+
@@ -0,0 +1,51 @@
+#include <cstddef>
+#include <cstdint>
+#include <immintrin.h>
+
+/*
+ * AVX version of the frustum culling kernel, this file is compiled with AVX
+ * code generation enabled and is only called if cull_isa_supported says
+ * the CPU supports it. It takes raw arrays and includes no STL or glm headers
+ * so no inline function they define gets emitted here with AVX instructions,
+ * where the linker could pick that copy for the other kernels' callers too
+ */
+size_t cull_spheres_avx(const float planes[6][4], const float *xs, const float *ys, const float *zs,
+	const float *radii, size_t begin, size_t end, uint32_t *out)
+{
+	__m256 plane[6][4];
+	for (int p = 0; p < 6; ++p){
+		for (int c = 0; c < 4; ++c){
+			plane[p][c] = _mm256_set1_ps(planes[p][c]);
+		}
+	}
+	size_t n = 0;
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8){
+		const __m256 x = _mm256_loadu_ps(xs + i);
+		const __m256 y = _mm256_loadu_ps(ys + i);
+		const __m256 z = _mm256_loadu_ps(zs + i);
+		const __m256 neg_r = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radii + i));
+		__m256 outside = _mm256_setzero_ps();
+		for (int p = 0; p < 6; ++p){
+			__m256 d = _mm256_add_ps(_mm256_mul_ps(x, plane[p][0]), _mm256_mul_ps(y, plane[p][1]));
+			d = _mm256_add_ps(d, _mm256_add_ps(_mm256_mul_ps(z, plane[p][2]), plane[p][3]));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, neg_r, _CMP_LT_OQ));
+		}
+		const int visible = ~_mm256_movemask_ps(outside);
+		for (int k = 0; k < 8; ++k){
+			out[n] = static_cast<uint32_t>(i + k);
+			n += (visible >> k) & 1;
+		}
+	}
+	//Finish off the remainder with the scalar loop
+	for (; i < end; ++i){
+		bool inside = true;
+		for (int p = 0; p < 6; ++p){
+			const float d = planes[p][0] * xs[i] + planes[p][1] * ys[i] + planes[p][2] * zs[i] + planes[p][3];
+			inside = inside && d >= -radii[i];
+		}
+		out[n] = static_cast<uint32_t>(i);
+		n += inside ? 1 : 0;
+	}
+	return n;
+}
@@ -0,0 +1,254 @@
+#include <cstring>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include <vector>
+#include <glm/glm.hpp>
+#include "instance.h"
+#include "job_system.h"
+#include "cull.h"
+#include "bvh.h"
+#include "trace.h"
+#include "depth_sort.h"
+
+namespace {
+	const size_t CHUNK_SIZE = 16384;
+}
+
+const char* sort_order_name(SortOrder order){
+	switch (order){
+	case SortOrder::NONE:
+		return "unsorted";
+	case SortOrder::BACK_TO_FRONT:
+		return "back to front";
+	case SortOrder::FRONT_TO_BACK:
+		return "front to back";
+	}
+	return "unknown";
+}
+uint32_t float_sort_key(float f){
+	uint32_t bits;
+	std::memcpy(&bits, &f, sizeof(float));
+	//Flip all the bits of negative numbers so larger magnitudes sort first and
+	//just the sign bit of positive ones so they sort after the negatives
+	const uint32_t mask = (bits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u;
+	return bits ^ mask;
+}
+DepthSorter::DepthSorter(bool incremental, float disorder_limit)
+	: stamp(0), incremental(incremental), disorder_limit(disorder_limit), prev_order(SortOrder::NONE),
+	full_ms_per_instance(0)
+{}
+size_t DepthSorter::sort(JobSystem &jobs, const glm::mat4 &view, const Instance *instances,
+	const std::vector<DrawRange> &ranges, SortOrder sort_order, Instance *out)
+{
+	frame = DepthSortStats{};
+	if (sort_order == SortOrder::NONE){
+		order.clear();
+		prev_order = sort_order;
+		return copy_ranges(jobs, ranges, instances, out);
+	}
+	const auto start = std::chrono::high_resolution_clock::now();
+	offsets.resize(ranges.size() + 1);
+	offsets[0] = 0;
+	for (size_t i = 0; i < ranges.size(); ++i){
+		offsets[i + 1] = offsets[i] + ranges[i].count;
+	}
+	const size_t n = offsets.back();
+	//The previous order is only a good starting point if it was sorted the same way
+	const bool try_incremental = incremental && sort_order == prev_order && !order.empty()
+		&& full_ms_per_instance > 0;
+	prev_order = sort_order;
+	size_t n_kept = 0;
+	if (try_incremental){
+		trace::Span span{"coherent order"};
+		n_kept = coherent_order(ranges);
+	}
+	else {
+		trace::Span span{"expand ranges"};
+		order.resize(n);
+		jobs.parallel_for(n, CHUNK_SIZE, [&](size_t begin, size_t end, unsigned){
+			size_t r = std::upper_bound(offsets.begin(), offsets.end(), begin) - offsets.begin() - 1;
+			for (size_t i = begin; i < end; ++i){
+				while (i >= offsets[r + 1]){
+					++r;
+				}
+				order[i] = ranges[r].first + (i - offsets[r]);
+			}
+		});
+	}
+
+	//We only need the view space z of each instance, negated so the depth increases away from the eye
+	const glm::mat4 bview = billboard_view(view);
+	const glm::vec4 z_row{bview[0][2], bview[1][2], bview[2][2], bview[3][2]};
+	const bool back_to_front = sort_order == SortOrder::BACK_TO_FRONT;
+	keys.resize(n);
+	{
+		trace::Span span{"depth keys"};
+		jobs.parallel_for(n, CHUNK_SIZE, [&](size_t begin, size_t end, unsigned){
+			for (size_t i = begin; i < end; ++i){
+				const glm::vec3 &p = instances[order[i]].pos;
+				const float depth = -(z_row.x * p.x + z_row.y * p.y + z_row.z * p.z + z_row.w);
+				const uint32_t key = float_sort_key(depth);
+				keys[i] = back_to_front ? ~key : key;
+			}
+		});
+	}
+
+	bool full_sort = !try_incremental;
+	if (try_incremental){
+		trace::Span span{"insertion sort"};
+		++frame.incremental;
+		//Sort each chunk of the instances kept from last frame in parallel first, the final
+		//pass over all of them then only has to fix up the inversions crossing the chunk boundaries
+		const size_t n_chunks = (n_kept + CHUNK_SIZE - 1) / CHUNK_SIZE;
+		chunk_inversions.resize(n_chunks);
+		jobs.parallel_for(n_kept, CHUNK_SIZE, [&](size_t begin, size_t end, unsigned){
+			chunk_inversions[begin / CHUNK_SIZE] = insertion_sort(keys, order, begin, end,
+				disorder_limit * (end - begin));
+		});
+		const size_t max_inversions = disorder_limit * n_kept;
+		for (size_t c : chunk_inversions){
+			frame.inversions_fixed += c;
+		}
+		if (frame.inversions_fixed <= max_inversions){
+			frame.inversions_fixed += insertion_sort(keys, order, 0, n_kept,
+				max_inversions - frame.inversions_fixed);
+		}
+		full_sort = frame.inversions_fixed > max_inversions;
+		//The newly visible instances are in no particular order, so sort them on their own
+		//and merge them in instead of inserting each one
+		if (!full_sort && n_kept < n){
+			new_keys.assign(keys.begin() + n_kept, keys.end());
+			new_order.assign(order.begin() + n_kept, order.end());
+			sorter.sort(jobs, new_keys, new_order);
+			merge_sorted(n_kept);
+		}
+	}
+	if (full_sort){
+		trace::Span span{"radix sort"};
+		++frame.full;
+		sorter.sort(jobs, keys, order);
+	}
+	frame.sorted = n;
+	frame.sort_ms = std::chrono::duration<double, std::milli>(
+		std::chrono::high_resolution_clock::now() - start).count();
+	if (!try_incremental && n > 0){
+		const double ms_per_instance = frame.sort_ms / n;
+		full_ms_per_instance = full_ms_per_instance == 0 ? ms_per_instance
+			: 0.9 * full_ms_per_instance + 0.1 * ms_per_instance;
+	}
+	else if (try_incremental){
+		frame.saved_ms = full_ms_per_instance * n - frame.sort_ms;
+	}
+	total.sorted += frame.sorted;
+	total.incremental += frame.incremental;
+	total.full += frame.full;
+	total.inversions_fixed += frame.inversions_fixed;
+	total.sort_ms += frame.sort_ms;
+	total.saved_ms += frame.saved_ms;
+
+	trace::Span span{"gather"};
+	jobs.parallel_for(n, CHUNK_SIZE, [&](size_t begin, size_t end, unsigned){
+		for (size_t i = begin; i < end; ++i){
+			out[i] = instances[order[i]];
+		}
+	});
+	return n;
+}
+const std::vector<uint32_t>& DepthSorter::sorted_indices() const {
+	return order;
+}
+
+void DepthSorter::set_incremental(bool inc){
+	incremental = inc;
+	order.clear();
+}
+bool DepthSorter::is_incremental() const {
+	return incremental;
+}
+const DepthSortStats& DepthSorter::frame_stats() const {
+	return frame;
+}
+const DepthSortStats& DepthSorter::total_stats() const {
+	return total;
+}
+size_t DepthSorter::coherent_order(const std::vector<DrawRange> &ranges){
+	//Each frame uses two new stamp values, one marking the instances visible this
+	//frame and one marking those that were also visible last frame
+	if (stamp >= std::numeric_limits<uint32_t>::max() - 2){
+		stamp = 0;
+		std::fill(stamps.begin(), stamps.end(), 0);
+	}
+	stamp += 2;
+	const uint32_t visible = stamp;
+	const uint32_t kept = stamp + 1;
+	if (!ranges.empty()){
+		stamps.resize(std::max(stamps.size(), size_t{ranges.back().first + ranges.back().count}), 0);
+	}
+	//Filling the stamps is about as cheap as a memset, so it's done here rather than paying
+	//for a job per range when the BVH's partial leaves give many tiny ones
+	for (const DrawRange &r : ranges){
+		std::fill(stamps.begin() + r.first, stamps.begin() + r.first + r.count, visible);
+	}
+	//Keep last frame's order for the instances that are still visible then append the new ones
+	size_t n_kept = 0;
+	for (size_t i = 0; i < order.size(); ++i){
+		const uint32_t idx = order[i];
+		if (idx < stamps.size() && stamps[idx] == visible){
+			stamps[idx] = kept;
+			order[n_kept++] = idx;
+		}
+	}
+	order.resize(n_kept);
+	for (const DrawRange &r : ranges){
+		for (uint32_t idx = r.first; idx < r.first + r.count; ++idx){
+			if (stamps[idx] == visible){
+				order.push_back(idx);
+			}
+		}
+	}
+	return n_kept;
+}
+void DepthSorter::merge_sorted(size_t n_kept){
+	//Merge from the back so we can write over the unsorted new instances in place
+	size_t out = keys.size();
+	size_t a = n_kept;
+	size_t b = new_keys.size();
+	while (b > 0){
+		if (a > 0 && keys[a - 1] > new_keys[b - 1]){
+			--a;
+			keys[--out] = keys[a];
+			order[out] = order[a];
+		}
+		else {
+			--b;
+			keys[--out] = new_keys[b];
+			order[out] = new_order[b];
+		}
+	}
+}
+size_t DepthSorter::insertion_sort(std::vector<uint32_t> &keys, std::vector<uint32_t> &order,
+	size_t begin, size_t end, size_t max_inversions)
+{
+	//Each step an element moves down fixes one inversion, give up once we've hit the limit
+	size_t inversions = 0;
+	for (size_t i = begin + 1; i < end; ++i){
+		if (keys[i - 1] <= keys[i]){
+			continue;
+		}
+		const uint32_t key = keys[i];
+		const uint32_t idx = order[i];
+		size_t j = i;
+		for (; j > begin && keys[j - 1] > key; --j){
+			keys[j] = keys[j - 1];
+			order[j] = order[j - 1];
+		}
+		keys[j] = key;
+		order[j] = idx;
+		inversions += i - j;
+		if (inversions > max_inversions){
+			break;
+		}
+	}
+	return inversions;
+}
@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <glm/glm.hpp>
+#include "gl_core_3_3.h"
+#include "util.h"
+#include "instance.h"
+#include "job_system.h"
+#include "cull.h"
+#include "bvh.h"
+#include "far_field.h"
+
+namespace {
+	const size_t SPLAT_CHUNK_SIZE = 16384;
+
+}
+
+FarFieldSplat::FarFieldSplat(size_t width, size_t height, float far_distance)
+	: width(width), height(height), far_distance(far_distance), pixels(width * height * 4, 0),
+	program(-1), texture(0), vao(0)
+{}
+FarFieldSplat::~FarFieldSplat(){
+	if (program != -1){
+		glDeleteProgram(program);
+	}
+	glDeleteTextures(1, &texture);
+	glDeleteVertexArrays(1, &vao);
+}
+FarFieldSplat::ShaderList FarFieldSplat::shader_files(const std::string &res_path){
+	return {std::make_tuple(GL_VERTEX_SHADER, res_path + "splat_vertex.glsl"),
+		std::make_tuple(GL_FRAGMENT_SHADER, res_path + "splat_fragment.glsl")};
+}
+bool FarFieldSplat::create(ProgramCache &cache, const std::string &res_path){
+	const GLint built = cache.load_program(shader_files(res_path));
+	if (built == -1){
+		std::cerr << "FarFieldSplat: failed to build the compositing shaders\n";
+		return false;
+	}
+	set_program(built);
+	glGenTextures(1, &texture);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glActiveTexture(GL_TEXTURE0);
+	//The quad's corners come from the vertex id but core profile still needs a VAO to draw with
+	glGenVertexArrays(1, &vao);
+	return true;
+}
+void FarFieldSplat::set_program(GLint new_program){
+	if (program != -1){
+		glDeleteProgram(program);
+	}
+	program = new_program;
+	glUseProgram(program);
+	//Unit 0 has the sprite atlas so the far field goes on unit 1
+	glUniform1i(glGetUniformLocation(program, "far_field"), 1);
+}
+void FarFieldSplat::split(const std::vector<DrawRange> &visible, const InstanceSoA &spheres, const glm::mat4 &view,
+	std::vector<DrawRange> &near)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+	frame_counters = FarFieldStats{};
+	near.clear();
+	far_ranges.clear();
+	//Only the view's translation is used to draw the billboards (see billboard_view)
+	//so an instance's distance in front of the eye is just along z
+	const float far_z = -view[3].z - far_distance;
+	for (const DrawRange &r : visible){
+		for (uint32_t i = r.first; i < r.first + r.count; ++i){
+			if (spheres.z[i] + spheres.radius[i] < far_z){
+				push_range(far_ranges, i, 1);
+			}
+			else {
+				push_range(near, i, 1);
+			}
+		}
+	}
+	far_offsets.resize(far_ranges.size() + 1);
+	far_offsets[0] = 0;
+	for (size_t i = 0; i < far_ranges.size(); ++i){
+		far_offsets[i + 1] = far_offsets[i] + far_ranges[i].count;
+	}
+	frame_counters.far = far_offsets.back();
+	for (const DrawRange &r : near){
+		frame_counters.near += r.count;
+	}
+	frame_counters.split_ms = util::elapsed_ms(start);
+}
+void FarFieldSplat::splat(JobSystem &jobs, const Instance *instances, const glm::mat4 &view, const glm::mat4 &proj,
+	const std::array<glm::vec4, 16> &sprite_colors)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	if (grids.size() != jobs.size()){
+		grids.assign(jobs.size(), std::vector<glm::vec4>(width * height, glm::vec4{0}));
+	}
+	//The quads' vertex colors are interpolated over them so a far away one is about their average
+	glm::vec4 average_colors[4];
+	for (size_t i = 0; i < 4; ++i){
+		average_colors[i] = (sprite_colors[i * 4] + sprite_colors[i * 4 + 1] + sprite_colors[i * 4 + 2]
+			+ sprite_colors[i * 4 + 3]) / 4.f;
+	}
+	const glm::mat4 proj_view = proj * billboard_view(view);
+	//A quad of size s at depth d is s * cells_per_unit / d cells across
+	const float cells_per_unit = proj[1][1] * height;
+	const float grid_w = width, grid_h = height;
+	jobs.parallel_for(frame_counters.far, SPLAT_CHUNK_SIZE, [&](size_t begin, size_t end, unsigned worker){
+		std::vector<glm::vec4> &grid = grids[worker];
+		size_t r = std::upper_bound(far_offsets.begin(), far_offsets.end(), begin) - far_offsets.begin() - 1;
+		for (size_t f = begin; f < end; ++r){
+			const size_t range_end = std::min(far_offsets[r + 1], end);
+			const Instance *it = instances + far_ranges[r].first + (f - far_offsets[r]);
+			for (; f < range_end; ++f, ++it){
+				const glm::vec4 clip = proj_view * glm::vec4{it->pos, 1};
+				if (clip.w <= 0){
+					continue;
+				}
+				const float x = (clip.x / clip.w * 0.5f + 0.5f) * grid_w;
+				const float y = (clip.y / clip.w * 0.5f + 0.5f) * grid_h;
+				if (x < 0 || y < 0 || x >= grid_w || y >= grid_h){
+					continue;
+				}
+				//Far instances are smaller than a cell, so their coverage is the fraction of it they cover
+				const float side = it->size * cells_per_unit / clip.w;
+				const float coverage = std::min(side * side, 1.f);
+				const glm::vec4 color = average_colors[std::min(std::max(it->sprite_id, 0), 3)]
+					* unpack_rgba8(it->color);
+				glm::vec4 &cell = grid[static_cast<size_t>(y) * width + static_cast<size_t>(x)];
+				cell += glm::vec4{glm::vec3{color} * coverage, coverage};
+			}
+		}
+	});
+	frame_counters.splat_ms = util::elapsed_ms(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	//Sum the workers' grids into the texture's pixels and clear them for the next frame as we go
+	jobs.parallel_for(height, 16, [&](size_t begin, size_t end, unsigned){
+		for (size_t i = begin * width; i < end * width; ++i){
+			glm::vec4 sum{0};
+			for (std::vector<glm::vec4> &grid : grids){
+				sum += grid[i];
+				grid[i] = glm::vec4{0};
+			}
+			if (sum.w > 0){
+				const glm::vec3 color = glm::vec3{sum} / sum.w;
+				const float alpha = 1.f - std::exp(-sum.w);
+				pixels[i * 4] = static_cast<uint8_t>(std::min(color.x, 1.f) * 255.f + 0.5f);
+				pixels[i * 4 + 1] = static_cast<uint8_t>(std::min(color.y, 1.f) * 255.f + 0.5f);
+				pixels[i * 4 + 2] = static_cast<uint8_t>(std::min(color.z, 1.f) * 255.f + 0.5f);
+				pixels[i * 4 + 3] = static_cast<uint8_t>(alpha * 255.f + 0.5f);
+			}
+			else {
+				pixels[i * 4] = pixels[i * 4 + 1] = pixels[i * 4 + 2] = pixels[i * 4 + 3] = 0;
+			}
+		}
+	});
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	glActiveTexture(GL_TEXTURE0);
+	frame_counters.resolve_ms = util::elapsed_ms(start);
+
+	total.near += frame_counters.near;
+	total.far += frame_counters.far;
+	total.split_ms += frame_counters.split_ms;
+	total.splat_ms += frame_counters.splat_ms;
+	total.resolve_ms += frame_counters.resolve_ms;
+}
+void FarFieldSplat::draw(){
+	//The far field is behind all the near billboards so it's drawn first without touching the depth buffer
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDisable(GL_DEPTH_TEST);
+	glUseProgram(program);
+	glBindVertexArray(vao);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+float FarFieldSplat::distance() const {
+	return far_distance;
+}
+const FarFieldStats& FarFieldSplat::frame_stats() const {
+	return frame_counters;
+}
+const FarFieldStats& FarFieldSplat::total_stats() const {
+	return total;
+}
@@ -0,0 +1,187 @@
+#include <iostream>
+#include <string>
+#include <utility>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+#include "file_view.h"
+
+#ifndef _WIN32
+namespace {
+	int madvise_flag(FileAccess access){
+		switch (access){
+			case FileAccess::SEQUENTIAL: return MADV_SEQUENTIAL;
+			case FileAccess::RANDOM: return MADV_RANDOM;
+			default: return MADV_NORMAL;
+		}
+	}
+}
+#endif
+
+#ifdef _WIN32
+FileView::FileView() : ptr(nullptr), len(0), opened(false), file(INVALID_HANDLE_VALUE), mapping(nullptr){}
+#else
+FileView::FileView() : ptr(nullptr), len(0), opened(false){}
+#endif
+FileView::FileView(const std::string &file, FileAccess access) : FileView(){
+	open(file, access);
+}
+FileView::~FileView(){
+	close();
+}
+FileView::FileView(FileView &&other) : FileView(){
+	*this = std::move(other);
+}
+FileView& FileView::operator=(FileView &&other){
+	if (this != &other){
+		close();
+		std::swap(ptr, other.ptr);
+		std::swap(len, other.len);
+		std::swap(opened, other.opened);
+#ifdef _WIN32
+		std::swap(file, other.file);
+		std::swap(mapping, other.mapping);
+#endif
+	}
+	return *this;
+}
+#ifdef _WIN32
+bool FileView::open(const std::string &fname, FileAccess access){
+	close();
+	const DWORD flags = access == FileAccess::SEQUENTIAL ? FILE_FLAG_SEQUENTIAL_SCAN
+		: access == FileAccess::RANDOM ? FILE_FLAG_RANDOM_ACCESS : FILE_ATTRIBUTE_NORMAL;
+	file = CreateFileA(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+	if (file == INVALID_HANDLE_VALUE){
+		std::cerr << "FileView: Failed to open " << fname << ", error " << GetLastError() << "\n";
+		return false;
+	}
+	LARGE_INTEGER file_size;
+	GetFileSizeEx(file, &file_size);
+	len = static_cast<size_t>(file_size.QuadPart);
+	if (len > 0){
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		ptr = mapping ? static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+		if (!ptr){
+			std::cerr << "FileView: Failed to map " << fname << ", error " << GetLastError() << "\n";
+			close();
+			return false;
+		}
+	}
+	opened = true;
+	return true;
+}
+void FileView::close(){
+	if (ptr){
+		UnmapViewOfFile(ptr);
+	}
+	if (mapping){
+		CloseHandle(mapping);
+	}
+	if (file != INVALID_HANDLE_VALUE){
+		CloseHandle(file);
+	}
+	ptr = nullptr;
+	len = 0;
+	opened = false;
+	file = INVALID_HANDLE_VALUE;
+	mapping = nullptr;
+}
+void FileView::advise(FileAccess, size_t, size_t){}
+void FileView::prefetch(size_t, size_t){}
+void FileView::release(size_t, size_t){}
+#else
+bool FileView::open(const std::string &fname, FileAccess access){
+	close();
+	const int fd = ::open(fname.c_str(), O_RDONLY);
+	if (fd == -1){
+		std::cerr << "FileView: Failed to open " << fname << ": " << std::strerror(errno) << "\n";
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0){
+		std::cerr << "FileView: Failed to stat " << fname << ": " << std::strerror(errno) << "\n";
+		::close(fd);
+		return false;
+	}
+	len = static_cast<size_t>(info.st_size);
+	if (len > 0){
+		void *map = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED){
+			std::cerr << "FileView: Failed to map " << fname << ": " << std::strerror(errno) << "\n";
+			::close(fd);
+			len = 0;
+			return false;
+		}
+		ptr = static_cast<const char*>(map);
+	}
+	//The mapping keeps the file's pages referenced, we don't need the descriptor
+	::close(fd);
+	opened = true;
+	advise(access);
+	return true;
+}
+void FileView::close(){
+	if (ptr){
+		munmap(const_cast<char*>(ptr), len);
+	}
+	ptr = nullptr;
+	len = 0;
+	opened = false;
+}
+void FileView::advise(FileAccess access, size_t offset, size_t count){
+	if (!ptr || offset >= len){
+		return;
+	}
+	//madvise needs a page aligned start
+	const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	const size_t start = offset - offset % page;
+	const size_t end = count == 0 || offset + count > len ? len : offset + count;
+	madvise(const_cast<char*>(ptr) + start, end - start, madvise_flag(access));
+}
+void FileView::prefetch(size_t offset, size_t count){
+	if (!ptr || offset >= len || count == 0){
+		return;
+	}
+	const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	const size_t start = offset - offset % page;
+	const size_t end = offset + count > len ? len : offset + count;
+	madvise(const_cast<char*>(ptr) + start, end - start, MADV_WILLNEED);
+}
+void FileView::release(size_t offset, size_t count){
+	if (!ptr || offset >= len || count == 0){
+		return;
+	}
+	//Only drop the pages fully inside the range, the ones it shares with its neighbours may still be in use
+	const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	const size_t start = (offset + page - 1) / page * page;
+	const size_t end = offset + count >= len ? len : (offset + count) / page * page;
+	if (start < end){
+		madvise(const_cast<char*>(ptr) + start, end - start, MADV_DONTNEED);
+	}
+}
+#endif
+bool FileView::is_open() const {
+	return opened;
+}
+const char* FileView::data() const {
+	return ptr;
+}
+size_t FileView::size() const {
+	return len;
+}
+const char* FileView::begin() const {
+	return ptr;
+}
+const char* FileView::end() const {
+	return ptr + len;
+}
+
@@ -0,0 +1,143 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "instance.h"
+#include "camera.h"
+#include "flythrough.h"
+
+namespace {
+	bool read_vec3(std::istream &is, glm::vec3 &v){
+		return static_cast<bool>(is >> v.x >> v.y >> v.z);
+	}
+}
+
+Camera CameraPath::camera_at(float t) const {
+	if (keys.empty()){
+		return Camera{glm::vec3{0, 0, 5}, glm::vec3{0, 0, 0}, glm::vec3{0, 1, 0}};
+	}
+	if (t <= keys.front().time || keys.size() == 1){
+		return Camera{keys.front().eye, keys.front().center, keys.front().up};
+	}
+	if (t >= keys.back().time){
+		return Camera{keys.back().eye, keys.back().center, keys.back().up};
+	}
+	auto next = std::upper_bound(keys.begin(), keys.end(), t,
+		[](float time, const CameraKey &k){ return time < k.time; });
+	const CameraKey &a = *(next - 1);
+	const CameraKey &b = *next;
+	const float s = (t - a.time) / (b.time - a.time);
+	return Camera{glm::mix(a.eye, b.eye, s), glm::mix(a.center, b.center, s),
+		glm::normalize(glm::mix(a.up, b.up, s))};
+}
+float CameraPath::duration() const {
+	return keys.empty() ? 0 : keys.back().time - keys.front().time;
+}
+Camera Flythrough::camera_at_frame(int frame) const {
+	const float start = path.keys.empty() ? 0 : path.keys.front().time;
+	const float s = frames > 1 ? static_cast<float>(frame) / (frames - 1) : 0;
+	return path.camera_at(start + s * path.duration());
+}
+bool load_flythrough(const std::string &file, Flythrough &flythrough){
+	std::ifstream fin{file};
+	if (!fin){
+		std::cerr << "Failed to open flythrough " << file << "\n";
+		return false;
+	}
+	flythrough = Flythrough{};
+	std::string line;
+	for (int line_num = 1; std::getline(fin, line); ++line_num){
+		std::istringstream is{line};
+		std::string directive;
+		if (!(is >> directive) || directive[0] == '#'){
+			continue;
+		}
+		bool ok = true;
+		if (directive == "scene"){
+			SceneDesc &scene = flythrough.scene;
+			std::string dist;
+			ok = static_cast<bool>(is >> scene.instances >> dist);
+			if (dist == "uniform"){
+				scene.distribution = SceneDistribution::UNIFORM;
+			}
+			else if (dist == "clustered"){
+				scene.distribution = SceneDistribution::CLUSTERED;
+			}
+			else {
+				ok = false;
+			}
+			//The rest are optional and keep their defaults if they're left off, we read
+			//into temporaries since a failed read zeroes the value
+			float extent, size;
+			int clusters;
+			uint32_t seed;
+			if (ok && is >> extent){
+				scene.extent = extent;
+				if (is >> clusters){
+					scene.clusters = clusters;
+					if (is >> size){
+						scene.size = size;
+						if (is >> seed){
+							scene.seed = seed;
+						}
+					}
+				}
+			}
+		}
+		else if (directive == "frames"){
+			ok = static_cast<bool>(is >> flythrough.frames) && flythrough.frames > 0;
+		}
+		else if (directive == "key"){
+			CameraKey key;
+			ok = is >> key.time && read_vec3(is, key.eye) && read_vec3(is, key.center) && read_vec3(is, key.up);
+			if (ok && !flythrough.path.keys.empty() && key.time <= flythrough.path.keys.back().time){
+				std::cerr << file << ":" << line_num << ": keys must be in increasing time order\n";
+				return false;
+			}
+			flythrough.path.keys.push_back(key);
+		}
+		else {
+			std::cerr << file << ":" << line_num << ": unknown directive " << directive << "\n";
+			return false;
+		}
+		if (!ok){
+			std::cerr << file << ":" << line_num << ": bad " << directive << " line: " << line << "\n";
+			return false;
+		}
+	}
+	if (flythrough.path.keys.empty()){
+		std::cerr << "Flythrough " << file << " has no camera keys\n";
+		return false;
+	}
+	return true;
+}
+void generate_scene(const SceneDesc &desc, std::vector<Instance> &instances){
+	std::mt19937 rng{desc.seed};
+	std::uniform_real_distribution<float> pos_dist{-desc.extent, desc.extent};
+	std::uniform_int_distribution<int> sprite_dist{0, 15};
+	std::uniform_real_distribution<float> rot_dist{0, 6.283f};
+	std::vector<glm::vec3> centers;
+	std::normal_distribution<float> cluster_dist{0, desc.extent / 8};
+	if (desc.distribution == SceneDistribution::CLUSTERED){
+		for (int i = 0; i < std::max(desc.clusters, 1); ++i){
+			centers.push_back(glm::vec3{pos_dist(rng), pos_dist(rng), pos_dist(rng)});
+		}
+	}
+	instances.resize(desc.instances);
+	for (size_t i = 0; i < instances.size(); ++i){
+		glm::vec3 pos;
+		if (desc.distribution == SceneDistribution::CLUSTERED){
+			pos = centers[i % centers.size()]
+				+ glm::vec3{cluster_dist(rng), cluster_dist(rng), cluster_dist(rng)};
+			pos = glm::clamp(pos, glm::vec3{-desc.extent}, glm::vec3{desc.extent});
+		}
+		else {
+			pos = glm::vec3{pos_dist(rng), pos_dist(rng), pos_dist(rng)};
+		}
+		instances[i] = Instance{pos, sprite_dist(rng), desc.size, pack_rgba8(glm::vec4{1}), rot_dist(rng)};
+	}
+}
+
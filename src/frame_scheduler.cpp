@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <SDL.h>
+#include <glm/glm.hpp>
+#include "gl_core_3_3.h"
+#include "util.h"
+#include "frame_scheduler.h"
+
+ScreenRect rect_union(const ScreenRect &a, const ScreenRect &b){
+	if (a.empty()){
+		return b;
+	}
+	if (b.empty()){
+		return a;
+	}
+	const int x = std::min(a.x, b.x);
+	const int y = std::min(a.y, b.y);
+	return ScreenRect{x, y, std::max(a.x + a.width, b.x + b.width) - x, std::max(a.y + a.height, b.y + b.height) - y};
+}
+ScreenRect project_box(const glm::mat4 &proj_view, const glm::vec3 &lower, const glm::vec3 &upper,
+	int width, int height, float pad_px)
+{
+	glm::vec2 rect_min{1}, rect_max{-1};
+	for (int i = 0; i < 8; ++i){
+		const glm::vec4 corner{i & 1 ? upper.x : lower.x, i & 2 ? upper.y : lower.y, i & 4 ? upper.z : lower.z, 1};
+		const glm::vec4 clip = proj_view * corner;
+		if (clip.w <= 0){
+			return ScreenRect{0, 0, width, height};
+		}
+		const glm::vec2 ndc{clip.x / clip.w, clip.y / clip.w};
+		rect_min = glm::min(rect_min, ndc);
+		rect_max = glm::max(rect_max, ndc);
+	}
+	const glm::vec2 pad{2 * pad_px / width, 2 * pad_px / height};
+	rect_min = glm::max(rect_min - pad, glm::vec2{-1});
+	rect_max = glm::min(rect_max + pad, glm::vec2{1});
+	if (rect_min.x >= rect_max.x || rect_min.y >= rect_max.y){
+		return ScreenRect{0, 0, 0, 0};
+	}
+	//Round out to whole pixels so the edges of the box are covered
+	const int x0 = static_cast<int>((rect_min.x * 0.5f + 0.5f) * width);
+	const int y0 = static_cast<int>((rect_min.y * 0.5f + 0.5f) * height);
+	const int x1 = std::min(static_cast<int>((rect_max.x * 0.5f + 0.5f) * width) + 1, width);
+	const int y1 = std::min(static_cast<int>((rect_max.y * 0.5f + 0.5f) * height) + 1, height);
+	return ScreenRect{x0, y0, x1 - x0, y1 - y0};
+}
+
+FrameScheduler::FrameScheduler(int width, int height, GLuint target, bool target_preserved, int timeout_ms)
+	: target(target), timeout_ms(timeout_ms),
+	notify_event(SDL_RegisterEvents(1)), notify_pending(false), full_damage(true), damage{0, 0, 0, 0},
+	partial_frame(false)
+{
+	if (notify_event == static_cast<uint32_t>(-1)){
+		std::cerr << "FrameScheduler: out of SDL user events, notifications will wait for the timeout\n";
+	}
+	if (!target_preserved){
+		if (!canvas.create(width, height)){
+			std::cerr << "FrameScheduler: canvas framebuffer is incomplete\n";
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, target);
+	}
+}
+void FrameScheduler::notify(){
+	if (notify_event == static_cast<uint32_t>(-1) || notify_pending.exchange(true)){
+		return;
+	}
+	SDL_Event e;
+	SDL_zero(e);
+	e.type = notify_event;
+	SDL_PushEvent(&e);
+}
+void FrameScheduler::wait(){
+	if (is_dirty()){
+		return;
+	}
+	//std::clock is the CPU time of all the process' threads on POSIX systems
+	const std::clock_t cpu_start = std::clock();
+	const auto start = std::chrono::high_resolution_clock::now();
+	//Waiting without an event to fill in leaves it in the queue for the render loop to poll
+	SDL_WaitEventTimeout(nullptr, timeout_ms);
+	//Flush the notification before clearing the flag. A notify in between sees the flag still
+	//set and doesn't push, which is fine since we're awake and pick up its data this frame. The
+	//other way around its event could be flushed with the flag left set, dropping later notifies
+	if (notify_pending){
+		SDL_FlushEvent(notify_event);
+		notify_pending = false;
+	}
+	total.wait_ms += std::chrono::duration<double, std::milli>(
+		std::chrono::high_resolution_clock::now() - start).count();
+	total.wait_cpu_ms += 1000.0 * (std::clock() - cpu_start) / CLOCKS_PER_SEC;
+}
+void FrameScheduler::mark_dirty(){
+	full_damage = true;
+}
+void FrameScheduler::mark_dirty(const ScreenRect &rect){
+	damage = rect_union(damage, rect);
+}
+bool FrameScheduler::is_dirty() const {
+	return full_damage || !damage.empty();
+}
+void FrameScheduler::skip_frame(){
+	++total.idle_wakeups;
+}
+void FrameScheduler::begin_frame(){
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer());
+	partial_frame = !full_damage && !damage.empty();
+	if (partial_frame){
+		++total.partial;
+		total.partial_pixels += static_cast<size_t>(damage.width) * damage.height;
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(damage.x, damage.y, damage.width, damage.height);
+	}
+	else {
+		++total.full;
+	}
+	full_damage = false;
+	damage = ScreenRect{0, 0, 0, 0};
+}
+void FrameScheduler::end_frame(){
+	if (partial_frame){
+		glDisable(GL_SCISSOR_TEST);
+	}
+	if (canvas.framebuffer()){
+		canvas.blit(target);
+	}
+	else {
+		glBindFramebuffer(GL_FRAMEBUFFER, target);
+	}
+}
+GLuint FrameScheduler::framebuffer() const {
+	return canvas.framebuffer() ? canvas.framebuffer() : target;
+}
+const SchedulerStats& FrameScheduler::total_stats() const {
+	return total;
+}
@@ -0,0 +1,166 @@
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "frame_stats.h"
+
+namespace {
+	template<typename F>
+	StatSummary summarize_field(const std::vector<FrameRecord> &records, F field){
+		std::vector<double> values;
+		values.reserve(records.size());
+		for (const FrameRecord &r : records){
+			const double v = field(r);
+			//Skip GPU times we never got the results for
+			if (v >= 0){
+				values.push_back(v);
+			}
+		}
+		return summarize(values);
+	}
+	void write_summary_json(std::ostream &os, const char *name, const StatSummary &s, bool last){
+		os << "\t\t\"" << name << "\": {\"mean\": " << s.mean << ", \"min\": " << s.min
+			<< ", \"max\": " << s.max << ", \"p50\": " << s.p50 << ", \"p95\": " << s.p95
+			<< ", \"p99\": " << s.p99 << "}" << (last ? "\n" : ",\n");
+	}
+	void print_summary_row(std::ostream &os, const char *name, const StatSummary &s){
+		os << std::setw(16) << name << std::setw(14) << s.mean << std::setw(14) << s.p50
+			<< std::setw(14) << s.p95 << std::setw(14) << s.p99 << s.max << "\n";
+	}
+}
+
+const char* frame_scope_name(FrameScope scope){
+	switch (scope){
+	case FrameScope::EVENTS:
+		return "events";
+	case FrameScope::CLEAR:
+		return "clear";
+	case FrameScope::CULL:
+		return "cull";
+	case FrameScope::SORT_UPLOAD:
+		return "sort_upload";
+	case FrameScope::DRAW:
+		return "draw";
+	case FrameScope::SWAP:
+		return "swap";
+	}
+	return "unknown";
+}
+StatSummary summarize(std::vector<double> values){
+	StatSummary s;
+	if (values.empty()){
+		return s;
+	}
+	std::sort(values.begin(), values.end());
+	auto percentile = [&](double p){
+		const size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+		return values[std::min(std::max(rank, size_t{1}), values.size()) - 1];
+	};
+	s.mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+	s.min = values.front();
+	s.max = values.back();
+	s.p50 = percentile(50);
+	s.p95 = percentile(95);
+	s.p99 = percentile(99);
+	return s;
+}
+void FrameLog::add(const FrameRecord &record){
+	records.push_back(record);
+}
+const std::vector<FrameRecord>& FrameLog::frames() const {
+	return records;
+}
+StatSummary FrameLog::cpu_ms() const {
+	return summarize_field(records, [](const FrameRecord &r){ return r.cpu_ms; });
+}
+StatSummary FrameLog::gpu_ms() const {
+	return summarize_field(records, [](const FrameRecord &r){ return r.gpu_ms; });
+}
+StatSummary FrameLog::cpu_scope_ms(FrameScope scope) const {
+	const size_t i = static_cast<size_t>(scope);
+	return summarize_field(records, [i](const FrameRecord &r){ return r.cpu_scope_ms[i]; });
+}
+StatSummary FrameLog::gpu_scope_ms(FrameScope scope) const {
+	const size_t i = static_cast<size_t>(scope);
+	return summarize_field(records, [i](const FrameRecord &r){ return r.gpu_scope_ms[i]; });
+}
+StatSummary FrameLog::visible() const {
+	return summarize_field(records, [](const FrameRecord &r){ return static_cast<double>(r.visible); });
+}
+StatSummary FrameLog::upload_bytes() const {
+	return summarize_field(records, [](const FrameRecord &r){ return static_cast<double>(r.upload_bytes); });
+}
+bool FrameLog::write_csv(const std::string &file) const {
+	std::ofstream fout{file};
+	if (!fout){
+		std::cerr << "Failed to open " << file << " for writing\n";
+		return false;
+	}
+	fout << "frame,cpu_ms,gpu_ms,visible,upload_bytes";
+	for (size_t i = 0; i < FRAME_SCOPE_COUNT; ++i){
+		const char *name = frame_scope_name(static_cast<FrameScope>(i));
+		fout << ",cpu_" << name << "_ms,gpu_" << name << "_ms";
+	}
+	fout << "\n";
+	for (const FrameRecord &r : records){
+		fout << r.frame << "," << r.cpu_ms << "," << r.gpu_ms << "," << r.visible << "," << r.upload_bytes;
+		for (size_t i = 0; i < FRAME_SCOPE_COUNT; ++i){
+			fout << "," << r.cpu_scope_ms[i] << "," << r.gpu_scope_ms[i];
+		}
+		fout << "\n";
+	}
+	return true;
+}
+bool FrameLog::write_json(const std::string &file) const {
+	std::ofstream fout{file};
+	if (!fout){
+		std::cerr << "Failed to open " << file << " for writing\n";
+		return false;
+	}
+	fout << "{\n\t\"summary\": {\n";
+	write_summary_json(fout, "cpu_ms", cpu_ms(), false);
+	write_summary_json(fout, "gpu_ms", gpu_ms(), false);
+	write_summary_json(fout, "visible", visible(), false);
+	write_summary_json(fout, "upload_bytes", upload_bytes(), false);
+	for (size_t i = 0; i < FRAME_SCOPE_COUNT; ++i){
+		const FrameScope scope = static_cast<FrameScope>(i);
+		const std::string name = frame_scope_name(scope);
+		write_summary_json(fout, ("cpu_" + name + "_ms").c_str(), cpu_scope_ms(scope), false);
+		write_summary_json(fout, ("gpu_" + name + "_ms").c_str(), gpu_scope_ms(scope),
+			i + 1 == FRAME_SCOPE_COUNT);
+	}
+	fout << "\t},\n\t\"frames\": [\n";
+	for (size_t i = 0; i < records.size(); ++i){
+		const FrameRecord &r = records[i];
+		fout << "\t\t{\"frame\": " << r.frame << ", \"cpu_ms\": " << r.cpu_ms << ", \"gpu_ms\": " << r.gpu_ms
+			<< ", \"visible\": " << r.visible << ", \"upload_bytes\": " << r.upload_bytes;
+		for (size_t j = 0; j < FRAME_SCOPE_COUNT; ++j){
+			const char *name = frame_scope_name(static_cast<FrameScope>(j));
+			fout << ", \"cpu_" << name << "_ms\": " << r.cpu_scope_ms[j]
+				<< ", \"gpu_" << name << "_ms\": " << r.gpu_scope_ms[j];
+		}
+		fout << "}" << (i + 1 < records.size() ? ",\n" : "\n");
+	}
+	fout << "\t]\n}\n";
+	return true;
+}
+void FrameLog::print_summary(std::ostream &os) const {
+	const std::ios::fmtflags flags = os.flags();
+	os << std::left << std::fixed << std::setprecision(3) << std::setw(16) << "" << std::setw(14) << "mean"
+		<< std::setw(14) << "p50" << std::setw(14) << "p95" << std::setw(14) << "p99" << "max\n";
+	print_summary_row(os, "cpu (ms)", cpu_ms());
+	print_summary_row(os, "gpu (ms)", gpu_ms());
+	print_summary_row(os, "visible", visible());
+	print_summary_row(os, "upload (bytes)", upload_bytes());
+	for (size_t i = 0; i < FRAME_SCOPE_COUNT; ++i){
+		const FrameScope scope = static_cast<FrameScope>(i);
+		const std::string name = frame_scope_name(scope);
+		print_summary_row(os, ("cpu " + name).c_str(), cpu_scope_ms(scope));
+		print_summary_row(os, ("gpu " + name).c_str(), gpu_scope_ms(scope));
+	}
+	os.flags(flags);
+}
+
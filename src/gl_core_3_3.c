@@ -95,7 +95,20 @@ static PROC WinGetProcAddress(const char *name)
 	#endif
 #endif
 
+int ogl_ext_ARB_buffer_storage = ogl_LOAD_FAILED;
 int ogl_ext_ARB_debug_output = ogl_LOAD_FAILED;
+int ogl_ext_ARB_get_program_binary = ogl_LOAD_FAILED;
+int ogl_ext_KHR_parallel_shader_compile = ogl_LOAD_FAILED;
+
+void (CODEGEN_FUNCPTR *_ptrc_glBufferStorage)(GLenum, GLsizeiptr, const void *, GLbitfield) = NULL;
+
+static int Load_ARB_buffer_storage()
+{
+	int numFailed = 0;
+	_ptrc_glBufferStorage = (void (CODEGEN_FUNCPTR *)(GLenum, GLsizeiptr, const void *, GLbitfield))IntGetProcAddress("glBufferStorage");
+	if(!_ptrc_glBufferStorage) numFailed++;
+	return numFailed;
+}
 
 void (CODEGEN_FUNCPTR *_ptrc_glDebugMessageCallbackARB)(GLDEBUGPROCARB, const void *) = NULL;
 void (CODEGEN_FUNCPTR *_ptrc_glDebugMessageControlARB)(GLenum, GLenum, GLenum, GLsizei, const GLuint *, GLboolean) = NULL;
@@ -116,6 +129,32 @@ static int Load_ARB_debug_output()
 	return numFailed;
 }
 
+void (CODEGEN_FUNCPTR *_ptrc_glGetProgramBinary)(GLuint, GLsizei, GLsizei *, GLenum *, void *) = NULL;
+void (CODEGEN_FUNCPTR *_ptrc_glProgramBinary)(GLuint, GLenum, const void *, GLsizei) = NULL;
+void (CODEGEN_FUNCPTR *_ptrc_glProgramParameteri)(GLuint, GLenum, GLint) = NULL;
+
+static int Load_ARB_get_program_binary()
+{
+	int numFailed = 0;
+	_ptrc_glGetProgramBinary = (void (CODEGEN_FUNCPTR *)(GLuint, GLsizei, GLsizei *, GLenum *, void *))IntGetProcAddress("glGetProgramBinary");
+	if(!_ptrc_glGetProgramBinary) numFailed++;
+	_ptrc_glProgramBinary = (void (CODEGEN_FUNCPTR *)(GLuint, GLenum, const void *, GLsizei))IntGetProcAddress("glProgramBinary");
+	if(!_ptrc_glProgramBinary) numFailed++;
+	_ptrc_glProgramParameteri = (void (CODEGEN_FUNCPTR *)(GLuint, GLenum, GLint))IntGetProcAddress("glProgramParameteri");
+	if(!_ptrc_glProgramParameteri) numFailed++;
+	return numFailed;
+}
+
+void (CODEGEN_FUNCPTR *_ptrc_glMaxShaderCompilerThreadsKHR)(GLuint) = NULL;
+
+static int Load_KHR_parallel_shader_compile()
+{
+	int numFailed = 0;
+	_ptrc_glMaxShaderCompilerThreadsKHR = (void (CODEGEN_FUNCPTR *)(GLuint))IntGetProcAddress("glMaxShaderCompilerThreadsKHR");
+	if(!_ptrc_glMaxShaderCompilerThreadsKHR) numFailed++;
+	return numFailed;
+}
+
 void (CODEGEN_FUNCPTR *_ptrc_glBlendFunc)(GLenum, GLenum) = NULL;
 void (CODEGEN_FUNCPTR *_ptrc_glClear)(GLbitfield) = NULL;
 void (CODEGEN_FUNCPTR *_ptrc_glClearColor)(GLfloat, GLfloat, GLfloat, GLfloat) = NULL;
@@ -1264,11 +1303,14 @@ typedef struct ogl_StrToExtMap_s
 	PFN_LOADFUNCPOINTERS LoadExtension;
 } ogl_StrToExtMap;
 
-static ogl_StrToExtMap ExtensionMap[1] = {
+static ogl_StrToExtMap ExtensionMap[4] = {
+	{"GL_ARB_buffer_storage", &ogl_ext_ARB_buffer_storage, Load_ARB_buffer_storage},
 	{"GL_ARB_debug_output", &ogl_ext_ARB_debug_output, Load_ARB_debug_output},
+	{"GL_ARB_get_program_binary", &ogl_ext_ARB_get_program_binary, Load_ARB_get_program_binary},
+	{"GL_KHR_parallel_shader_compile", &ogl_ext_KHR_parallel_shader_compile, Load_KHR_parallel_shader_compile},
 };
 
-static int g_extensionMapSize = 1;
+static int g_extensionMapSize = 4;
 
 static ogl_StrToExtMap *FindExtEntry(const char *extensionName)
 {
@@ -1285,7 +1327,10 @@ static ogl_StrToExtMap *FindExtEntry(const char *extensionName)
 
 static void ClearExtensionVars()
 {
+	ogl_ext_ARB_buffer_storage = ogl_LOAD_FAILED;
 	ogl_ext_ARB_debug_output = ogl_LOAD_FAILED;
+	ogl_ext_ARB_get_program_binary = ogl_LOAD_FAILED;
+	ogl_ext_KHR_parallel_shader_compile = ogl_LOAD_FAILED;
 }
 
 
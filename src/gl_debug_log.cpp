@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include "gl_core_3_3.h"
+#include "util.h"
+#include "gl_debug_log.h"
+
+namespace {
+	const std::chrono::milliseconds DRAIN_INTERVAL{10};
+
+	//Hash everything identifying a message so repeats of it land in the same entry
+	uint64_t hash_record(const GLDebugRecord &record){
+		uint64_t h = util::fnv1a(&record.src, sizeof(record.src));
+		h = util::fnv1a(&record.type, sizeof(record.type), h);
+		h = util::fnv1a(&record.severity, sizeof(record.severity), h);
+		h = util::fnv1a(&record.id, sizeof(record.id), h);
+		return util::fnv1a(record.msg, std::strlen(record.msg), h);
+	}
+	size_t next_pow2(size_t n){
+		size_t p = 2;
+		while (p < n){
+			p <<= 1;
+		}
+		return p;
+	}
+}
+
+GLDebugRecord make_gldebug_record(uint32_t time_ms, GLenum src, GLenum type, GLuint id, GLenum severity,
+	GLsizei len, const char *msg)
+{
+	GLDebugRecord record;
+	record.time_ms = time_ms;
+	record.src = src;
+	record.type = type;
+	record.severity = severity;
+	record.id = id;
+	size_t n = 0;
+	if (msg){
+		n = len < 0 ? std::strlen(msg) : static_cast<size_t>(len);
+		n = std::min(n, GLDebugRecord::MAX_MSG - 1);
+		std::memcpy(record.msg, msg, n);
+	}
+	record.msg[n] = '\0';
+	return record;
+}
+void write_gldebug_record(std::ostream &os, const GLDebugRecord &record){
+	const uint32_t min = record.time_ms / 60000;
+	const uint32_t sec = (record.time_ms / 1000) % 60;
+	const uint32_t ms = record.time_ms % 1000;
+	os << "[" << min << ":" << std::setfill('0') << std::setw(2) << sec << "."
+		<< std::setw(3) << ms << std::setfill(' ') << "] OpenGL Debug -";
+	switch (record.severity){
+	case GL_DEBUG_SEVERITY_HIGH_ARB:
+		os << " High severity";
+		break;
+	case GL_DEBUG_SEVERITY_MEDIUM_ARB:
+		os << " Medium severity";
+		break;
+	case GL_DEBUG_SEVERITY_LOW_ARB:
+		os << " Low severity";
+	}
+	switch (record.src){
+	case GL_DEBUG_SOURCE_API_ARB:
+		os << " API";
+		break;
+	case GL_DEBUG_SOURCE_WINDOW_SYSTEM_ARB:
+		os << " Window system";
+		break;
+	case GL_DEBUG_SOURCE_SHADER_COMPILER_ARB:
+		os << " Shader compiler";
+		break;
+	case GL_DEBUG_SOURCE_THIRD_PARTY_ARB:
+		os << " Third party";
+		break;
+	case GL_DEBUG_SOURCE_APPLICATION_ARB:
+		os << " Application";
+		break;
+	default:
+		os << " Other";
+	}
+	switch (record.type){
+	case GL_DEBUG_TYPE_ERROR_ARB:
+		os << " Error";
+		break;
+	case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR_ARB:
+		os << " Deprecated behavior";
+		break;
+	case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR_ARB:
+		os << " Undefined behavior";
+		break;
+	case GL_DEBUG_TYPE_PORTABILITY_ARB:
+		os << " Portability";
+		break;
+	case GL_DEBUG_TYPE_PERFORMANCE_ARB:
+		os << " Performance";
+		break;
+	default:
+		os << " Other";
+	}
+	os << ":\n\t" << record.msg << "\n";
+}
+const char* gl_error_name(GLenum err){
+	switch (err){
+	case GL_NO_ERROR: return "No error";
+	case GL_INVALID_ENUM: return "Invalid enum";
+	case GL_INVALID_VALUE: return "Invalid value";
+	case GL_INVALID_OPERATION: return "Invalid operation";
+	case GL_OUT_OF_MEMORY: return "Out of memory";
+	case GL_INVALID_FRAMEBUFFER_OPERATION: return "Invalid FrameBuffer operation";
+	default: return "Unknown error";
+	}
+}
+
+GLDebugLog::GLDebugLog(size_t capacity, unsigned rate_limit_ms, std::ostream &os)
+	: slots(new Slot[next_pow2(capacity)]), mask(next_pow2(capacity) - 1), rate_limit_ms(rate_limit_ms),
+	os(os), start(std::chrono::steady_clock::now()), head(0), tail(0), running(true),
+	synchronous(false), n_dropped(0), n_suppressed(0), drain_requested(false)
+{
+	for (size_t i = 0; i <= mask; ++i){
+		slots[i].seq.store(i, std::memory_order_relaxed);
+	}
+	thread = std::thread([this](){ thread_loop(); });
+}
+GLDebugLog::~GLDebugLog(){
+	{
+		std::lock_guard<std::mutex> lock(wake_mutex);
+		running.store(false);
+	}
+	wake.notify_one();
+	thread.join();
+	std::lock_guard<std::mutex> lock(consumer_mutex);
+	drain();
+	print_suppressed();
+	if (n_dropped.load() > 0){
+		os << "GL debug log dropped " << n_dropped.load() << " messages, the ring was full\n";
+	}
+	os.flush();
+}
+bool GLDebugLog::push(GLenum src, GLenum type, GLuint id, GLenum severity, GLsizei len, const char *msg){
+	return enqueue(make_gldebug_record(elapsed_ms(), src, type, id, severity, len, msg));
+}
+bool GLDebugLog::push_error(GLenum err, const char *where){
+	char msg[GLDebugRecord::MAX_MSG];
+	std::snprintf(msg, sizeof(msg), "glGetError returned %s (0x%x) - %s", gl_error_name(err), err, where);
+	return enqueue(make_gldebug_record(elapsed_ms(), GL_DEBUG_SOURCE_API_ARB, GL_DEBUG_TYPE_ERROR_ARB,
+		err, GL_DEBUG_SEVERITY_HIGH_ARB, -1, msg));
+}
+void GLDebugLog::set_synchronous(bool sync){
+	synchronous.store(sync);
+}
+bool GLDebugLog::is_synchronous() const {
+	return synchronous.load();
+}
+void GLDebugLog::flush(){
+	std::lock_guard<std::mutex> lock(consumer_mutex);
+	drain();
+	os.flush();
+}
+size_t GLDebugLog::dropped() const {
+	return n_dropped.load();
+}
+size_t GLDebugLog::suppressed() const {
+	return n_suppressed.load();
+}
+uint32_t GLDebugLog::elapsed_ms() const {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - start).count();
+}
+bool GLDebugLog::enqueue(const GLDebugRecord &record){
+	//Claim a slot by advancing head, the slot's sequence number tells us if the
+	//consumer is done with it yet or if the ring is full
+	size_t pos = head.load(std::memory_order_relaxed);
+	Slot *slot = nullptr;
+	for (;;){
+		slot = &slots[pos & mask];
+		const size_t seq = slot->seq.load(std::memory_order_acquire);
+		const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+		if (diff == 0){
+			if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+				break;
+			}
+		}
+		else if (diff < 0){
+			n_dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		else {
+			pos = head.load(std::memory_order_relaxed);
+		}
+	}
+	slot->record = record;
+	slot->seq.store(pos + 1, std::memory_order_release);
+	if (synchronous.load(std::memory_order_relaxed)){
+		flush();
+	}
+	//Wake the thread early if a burst of messages has filled half the ring
+	else if (((pos + 1) & (mask >> 1)) == 0){
+		std::lock_guard<std::mutex> lock(wake_mutex);
+		drain_requested = true;
+		wake.notify_one();
+	}
+	return true;
+}
+void GLDebugLog::drain(){
+	for (;;){
+		Slot &slot = slots[tail & mask];
+		if (slot.seq.load(std::memory_order_acquire) != tail + 1){
+			return;
+		}
+		const GLDebugRecord record = slot.record;
+		slot.seq.store(tail + mask + 1, std::memory_order_release);
+		++tail;
+		print(record);
+	}
+}
+void GLDebugLog::print(const GLDebugRecord &record){
+	const uint64_t key = hash_record(record);
+	auto fnd = repeats.find(key);
+	if (fnd != repeats.end()){
+		Repeat &r = fnd->second;
+		if (record.time_ms < r.last_print_ms + rate_limit_ms){
+			++r.suppressed;
+			r.record = record;
+			n_suppressed.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		write_gldebug_record(os, record);
+		if (r.suppressed > 0){
+			os << "\t(repeated " << r.suppressed << " times since last shown)\n";
+		}
+		r.last_print_ms = record.time_ms;
+		r.suppressed = 0;
+		return;
+	}
+	write_gldebug_record(os, record);
+	Repeat r;
+	r.last_print_ms = record.time_ms;
+	r.suppressed = 0;
+	r.record = record;
+	repeats[key] = r;
+}
+void GLDebugLog::print_suppressed(){
+	for (const auto &r : repeats){
+		if (r.second.suppressed > 0){
+			write_gldebug_record(os, r.second.record);
+			os << "\t(repeated " << r.second.suppressed << " more times before exiting)\n";
+		}
+	}
+}
+void GLDebugLog::thread_loop(){
+	while (running.load()){
+		{
+			std::unique_lock<std::mutex> lock(wake_mutex);
+			wake.wait_for(lock, DRAIN_INTERVAL, [this](){ return !running.load() || drain_requested; });
+			drain_requested = false;
+		}
+		std::lock_guard<std::mutex> lock(consumer_mutex);
+		drain();
+		os.flush();
+	}
+}
@@ -0,0 +1,88 @@
+#include <cstdlib>
+#include <string>
+#include "gl_core_3_3.h"
+#include "gl_debug_log.h"
+#include "gl_error_check.h"
+
+namespace {
+	//glGetError only returns one error flag per call, bound how many we'll pull
+	//at once in case of a lost context which keeps reporting the same error
+	const int MAX_ERRORS_PER_CHECK = 8;
+}
+
+const char* gl_error_mode_name(GLErrorMode mode){
+	switch (mode){
+	case GLErrorMode::OFF: return "off";
+	case GLErrorMode::DEBUG_CALLBACK: return "callback";
+	case GLErrorMode::SAMPLED: return "sampled";
+	default: return "unknown";
+	}
+}
+bool parse_gl_error_mode(const std::string &str, GLErrorMode &mode, unsigned &interval){
+	if (str == "off"){
+		mode = GLErrorMode::OFF;
+		return true;
+	}
+	if (str == "callback"){
+		mode = GLErrorMode::DEBUG_CALLBACK;
+		return true;
+	}
+	if (str.compare(0, 7, "sampled") == 0){
+		if (str.size() == 7){
+			mode = GLErrorMode::SAMPLED;
+			return true;
+		}
+		if (str[7] == ':' && str.size() > 8){
+			char *end = nullptr;
+			const long n = std::strtol(str.c_str() + 8, &end, 10);
+			if (*end == '\0' && n >= 0){
+				mode = GLErrorMode::SAMPLED;
+				interval = n;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+GLErrorChecker::GLErrorChecker(GLDebugLog &log, GLErrorMode mode, unsigned interval)
+	: log(log), mode(mode), interval(interval), n_checks(0), n_errors(0)
+{}
+void GLErrorChecker::apply() const {
+	glDebugMessageControlARB(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL,
+		mode == GLErrorMode::OFF ? GL_FALSE : GL_TRUE);
+}
+void GLErrorChecker::end_frame(size_t frame){
+	if (mode == GLErrorMode::SAMPLED && interval > 0 && frame % interval == 0){
+		check("end of frame");
+	}
+}
+bool GLErrorChecker::check(const char *where){
+	if (mode != GLErrorMode::SAMPLED){
+		return false;
+	}
+	++n_checks;
+	bool found = false;
+	for (int i = 0; i < MAX_ERRORS_PER_CHECK; ++i){
+		const GLenum err = glGetError();
+		if (err == GL_NO_ERROR){
+			break;
+		}
+		++n_errors;
+		found = true;
+		log.push_error(err, where);
+	}
+	return found;
+}
+GLErrorMode GLErrorChecker::error_mode() const {
+	return mode;
+}
+unsigned GLErrorChecker::sample_interval() const {
+	return interval;
+}
+size_t GLErrorChecker::checks() const {
+	return n_checks;
+}
+size_t GLErrorChecker::errors() const {
+	return n_errors;
+}
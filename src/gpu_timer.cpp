@@ -0,0 +1,36 @@
+#include <cassert>
+#include "gl_core_3_3.h"
+#include "gpu_timer.h"
+
+GPUTimer::GPUTimer() : issued(false){
+	glGenQueries(2, queries);
+}
+GPUTimer::~GPUTimer(){
+	glDeleteQueries(2, queries);
+}
+void GPUTimer::begin(){
+	glQueryCounter(queries[0], GL_TIMESTAMP);
+	issued = true;
+}
+void GPUTimer::end(){
+	assert(issued);
+	glQueryCounter(queries[1], GL_TIMESTAMP);
+}
+void GPUTimer::reset(){
+	issued = false;
+}
+bool GPUTimer::is_issued() const {
+	return issued;
+}
+bool GPUTimer::is_available() const {
+	assert(issued);
+	//The end query finishing means the begin one has as well
+	GLint available = GL_FALSE;
+	glGetQueryObjectiv(queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+	return available == GL_TRUE;
+}
+void GPUTimer::read(GLuint64 &begin, GLuint64 &end) const {
+	assert(issued);
+	glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &begin);
+	glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &end);
+}
@@ -0,0 +1,122 @@
+#include <iostream>
+#include <string>
+#ifdef VSB_HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#include "gl_core_3_3.h"
+#include "util.h"
+#include "headless.h"
+
+#ifdef VSB_HAVE_EGL
+namespace {
+	EGLDisplay get_display(){
+		//Prefer Mesa's surfaceless platform since it doesn't need any display server or device
+		const char *client_exts = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+		if (client_exts && std::string{client_exts}.find("EGL_MESA_platform_surfaceless") != std::string::npos){
+			PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display
+				= reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+			if (get_platform_display){
+				EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+				if (display != EGL_NO_DISPLAY){
+					return display;
+				}
+			}
+		}
+		return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+}
+#endif
+
+HeadlessContext::HeadlessContext() : display(nullptr), context(nullptr), width(0), height(0){}
+HeadlessContext::~HeadlessContext(){
+#ifdef VSB_HAVE_EGL
+	if (context){
+		fbo.destroy();
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(display, context);
+	}
+	if (display){
+		eglTerminate(display);
+	}
+#endif
+}
+bool HeadlessContext::create(int w, int h, bool debug){
+#ifdef VSB_HAVE_EGL
+	display = get_display();
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)){
+		std::cerr << "Headless: failed to initialize EGL display\n";
+		display = nullptr;
+		return false;
+	}
+	if (!eglBindAPI(EGL_OPENGL_API)){
+		std::cerr << "Headless: EGL doesn't support desktop OpenGL\n";
+		return false;
+	}
+	//We never create a surface so any config that can render desktop GL will do, but we
+	//have to ask for pbuffer support since the default is window surfaces which the
+	//surfaceless platform doesn't have
+	const EGLint config_attribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint n_configs = 0;
+	if (!eglChooseConfig(display, config_attribs, &config, 1, &n_configs) || n_configs == 0){
+		std::cerr << "Headless: no EGL config supporting OpenGL\n";
+		return false;
+	}
+	const EGLint context_attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_CONTEXT_OPENGL_DEBUG, debug ? EGL_TRUE : EGL_FALSE,
+		EGL_NONE
+	};
+	context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+	if (context == EGL_NO_CONTEXT){
+		std::cerr << "Headless: failed to create GL 3.3 core context, EGL error "
+			<< std::hex << eglGetError() << std::dec << "\n";
+		context = nullptr;
+		return false;
+	}
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)){
+		std::cerr << "Headless: failed to make the context current\n";
+		return false;
+	}
+	if (ogl_LoadFunctions() == ogl_LOAD_FAILED){
+		std::cerr << "Headless: ogl load failed\n";
+		return false;
+	}
+
+	width = w;
+	height = h;
+	if (!fbo.create(width, height)){
+		std::cerr << "Headless: framebuffer is incomplete\n";
+		return false;
+	}
+	glViewport(0, 0, width, height);
+	return true;
+#else
+	(void)w;
+	(void)h;
+	(void)debug;
+	std::cerr << "Headless: not built with EGL support\n";
+	return false;
+#endif
+}
+void HeadlessContext::present(){
+	glFlush();
+}
+GLuint HeadlessContext::framebuffer() const {
+	return fbo.framebuffer();
+}
+int HeadlessContext::fb_width() const {
+	return width;
+}
+int HeadlessContext::fb_height() const {
+	return height;
+}
+
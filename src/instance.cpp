@@ -0,0 +1,48 @@
+#include <array>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "gl_core_3_3.h"
+#include "instance.h"
+
+const std::array<VertexAttrib, 5> INSTANCE_LAYOUT = {{
+	{0, 3, GL_FLOAT, GL_FALSE, false, offsetof(Instance, pos)},
+	{1, 1, GL_INT, GL_FALSE, true, offsetof(Instance, sprite_id)},
+	{2, 1, GL_FLOAT, GL_FALSE, false, offsetof(Instance, size)},
+	{3, 4, GL_UNSIGNED_BYTE, GL_TRUE, false, offsetof(Instance, color)},
+	{4, 1, GL_FLOAT, GL_FALSE, false, offsetof(Instance, rotation)}
+}};
+
+GLuint pack_rgba8(const glm::vec4 &color){
+	GLuint packed = 0;
+	for (int i = 0; i < 4; ++i){
+		float c = std::min(std::max(color[i], 0.f), 1.f);
+		packed |= static_cast<GLuint>(c * 255.f + 0.5f) << (8 * i);
+	}
+	return packed;
+}
+glm::vec4 unpack_rgba8(GLuint color){
+	return glm::vec4{static_cast<float>(color & 0xff), static_cast<float>((color >> 8) & 0xff),
+		static_cast<float>((color >> 16) & 0xff), static_cast<float>(color >> 24)} / 255.f;
+}
+void setup_vertex_attribs(GLuint buf, const VertexAttrib *attribs, size_t n_attribs,
+	GLsizei stride, GLintptr base, GLuint divisor)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, buf);
+	for (size_t i = 0; i < n_attribs; ++i){
+		const VertexAttrib &a = attribs[i];
+		const GLvoid *offset = reinterpret_cast<const GLvoid*>(base + a.offset);
+		glEnableVertexAttribArray(a.index);
+		if (a.integer){
+			glVertexAttribIPointer(a.index, a.components, a.type, stride, offset);
+		}
+		else {
+			glVertexAttribPointer(a.index, a.components, a.type, a.normalized, stride, offset);
+		}
+		glVertexAttribDivisor(a.index, divisor);
+	}
+}
+void setup_instance_attribs(GLuint buf, GLintptr base){
+	setup_vertex_attribs(buf, INSTANCE_LAYOUT.data(), INSTANCE_LAYOUT.size(),
+		sizeof(Instance), base);
+}
+
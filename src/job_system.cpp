@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+#include "trace.h"
+#include "job_system.h"
+
+JobSystem::JobSystem(unsigned n_workers) : queued(0), quit(false){
+	if (n_workers == 0){
+		n_workers = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	for (unsigned i = 0; i < n_workers; ++i){
+		queues.emplace_back(new WorkQueue);
+	}
+	//Worker 0 is the thread calling parallel_for
+	for (unsigned i = 1; i < n_workers; ++i){
+		threads.emplace_back(&JobSystem::worker_loop, this, i);
+	}
+}
+JobSystem::~JobSystem(){
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		quit = true;
+	}
+	wakeup.notify_all();
+	for (std::thread &t : threads){
+		t.join();
+	}
+}
+unsigned JobSystem::size() const {
+	return queues.size();
+}
+void JobSystem::parallel_for(size_t count, size_t chunk_size, const ChunkFn &fn){
+	chunk_size = std::max(chunk_size, size_t{1});
+	const size_t n_chunks = (count + chunk_size - 1) / chunk_size;
+	if (n_chunks == 0){
+		return;
+	}
+	//Not worth waking anyone up for a single chunk
+	if (n_chunks == 1 || queues.size() == 1){
+		for (size_t b = 0; b < count; b += chunk_size){
+			fn(b, std::min(b + chunk_size, count), 0);
+		}
+		return;
+	}
+	std::atomic<size_t> remaining(n_chunks);
+	//Give each worker a contiguous run of chunks so neighbouring data tends to
+	//stay on the same core, stealing balances things out if some finish early
+	const size_t n_queues = queues.size();
+	for (size_t q = 0; q < n_queues; ++q){
+		const size_t first = q * n_chunks / n_queues;
+		const size_t last = (q + 1) * n_chunks / n_queues;
+		std::lock_guard<std::mutex> lock(queues[q]->mutex);
+		for (size_t c = first; c < last; ++c){
+			queues[q]->jobs.push_back(Job{&fn, c * chunk_size, std::min((c + 1) * chunk_size, count),
+				&remaining});
+		}
+	}
+	queued += n_chunks;
+	{
+		//Taking the lock ensures a worker checking if it should sleep sees the new jobs
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	wakeup.notify_all();
+
+	Job job;
+	while (remaining.load(std::memory_order_acquire) > 0){
+		if (find_job(0, job)){
+			run_job(job, 0);
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+}
+void JobSystem::worker_loop(unsigned worker){
+	if (trace::enabled()){
+		trace::set_thread_name("worker " + std::to_string(worker));
+	}
+	Job job;
+	while (true){
+		if (find_job(worker, job)){
+			run_job(job, worker);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		wakeup.wait(lock, [this](){ return quit || queued > 0; });
+		if (quit){
+			return;
+		}
+	}
+}
+bool JobSystem::find_job(unsigned worker, Job &job){
+	const size_t n_queues = queues.size();
+	for (size_t i = 0; i < n_queues; ++i){
+		WorkQueue &q = *queues[(worker + i) % n_queues];
+		std::lock_guard<std::mutex> lock(q.mutex);
+		if (q.jobs.empty()){
+			continue;
+		}
+		//Work from the back of our own queue and steal from the front of others
+		if (i == 0){
+			job = q.jobs.back();
+			q.jobs.pop_back();
+		}
+		else {
+			job = q.jobs.front();
+			q.jobs.pop_front();
+		}
+		--queued;
+		return true;
+	}
+	return false;
+}
+void JobSystem::run_job(const Job &job, unsigned worker){
+	trace::Span span{"job"};
+	(*job.fn)(job.begin, job.end, worker);
+	job.remaining->fetch_sub(1, std::memory_order_release);
+}
+
@@ -0,0 +1,581 @@
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <glm/glm.hpp>
+#include "util.h"
+#include "instance.h"
+#include "cull.h"
+#include "file_view.h"
+#include "scene_file.h"
+#include "lod_octree.h"
+
+namespace {
+	//Deeper nodes than this keep all their instances, in case many billboards are on top of each other
+	const uint32_t MAX_LEVEL = 24;
+	//Levels of cells the scene is split into for building, at most 8^MAX_CELL_LEVEL cells
+	const uint32_t MAX_CELL_LEVEL = 5;
+
+	/*
+	 * A node while its subtree is being built, its instances are held in memory
+	 * until it's written to the nodes file
+	 */
+	struct BuildNode {
+		glm::vec3 lower;
+		float size;
+		uint32_t level;
+		std::vector<Instance> instances;
+		//Index of the child in each octant, in the cell's nodes while building a cell
+		//and in the written nodes once they're written, -1 if there's none
+		int64_t children[8];
+
+		BuildNode(const glm::vec3 &lower, float size, uint32_t level) : lower(lower), size(size), level(level){
+			std::fill(children, children + 8, -1);
+		}
+	};
+	/*
+	 * A node written to the nodes file
+	 */
+	struct WrittenNode {
+		glm::vec3 lower;
+		float size;
+		uint32_t level;
+		uint64_t offset;
+		uint32_t count;
+		int64_t children[8];
+	};
+	/*
+	 * The file nodes are written to as they're finished, in no particular order
+	 */
+	struct NodeWriter {
+		std::mutex mutex;
+		std::ofstream out;
+		uint64_t offset;
+		std::vector<WrittenNode> nodes;
+
+		NodeWriter() : offset(0){}
+		//Write out the node, children must already be indices of written nodes
+		int64_t write(const BuildNode &node){
+			std::lock_guard<std::mutex> lock(mutex);
+			WrittenNode n;
+			n.lower = node.lower;
+			n.size = node.size;
+			n.level = node.level;
+			n.offset = offset;
+			n.count = node.instances.size();
+			std::copy(node.children, node.children + 8, n.children);
+			out.write(reinterpret_cast<const char*>(node.instances.data()), n.count * sizeof(Instance));
+			offset += n.count * sizeof(Instance);
+			nodes.push_back(n);
+			return nodes.size() - 1;
+		}
+	};
+
+	glm::uvec3 grid_cell(const glm::vec3 &p, const glm::vec3 &lower, float size, uint32_t res){
+		const glm::vec3 c = (p - lower) / size * static_cast<float>(res);
+		auto clamp_cell = [res](float x){ return x <= 0 ? 0u : std::min(static_cast<uint32_t>(x), res - 1); };
+		return glm::uvec3{clamp_cell(c.x), clamp_cell(c.y), clamp_cell(c.z)};
+	}
+	uint32_t octant(const glm::vec3 &p, const BuildNode &node){
+		const glm::vec3 mid = node.lower + glm::vec3{node.size / 2};
+		return (p.x >= mid.x ? 1 : 0) | (p.y >= mid.y ? 2 : 0) | (p.z >= mid.z ? 4 : 0);
+	}
+	glm::vec3 octant_lower(const BuildNode &node, uint32_t o){
+		return node.lower + glm::vec3{o & 1 ? 1.f : 0.f, o & 2 ? 1.f : 0.f, o & 4 ? 1.f : 0.f} * (node.size / 2);
+	}
+	/*
+	 * Move the first instance landing in each free cell of the sample grid over the node into
+	 * samples and mark the cell taken, the instances that weren't taken stay in from
+	 */
+	void take_samples(std::vector<Instance> &from, const BuildNode &node, uint32_t grid, std::vector<char> &taken,
+		std::vector<Instance> &samples)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < from.size(); ++i){
+			const glm::uvec3 c = grid_cell(from[i].pos, node.lower, node.size, grid);
+			char &t = taken[(c.z * grid + c.y) * grid + c.x];
+			if (!t){
+				t = 1;
+				samples.push_back(from[i]);
+			}
+			else {
+				from[kept++] = from[i];
+			}
+		}
+		from.resize(kept);
+	}
+	/*
+	 * Build the subtree of the node at nodes[idx] from its instances, the nodes are appended to nodes
+	 */
+	void build_subtree(std::vector<BuildNode> &nodes, size_t idx, std::vector<Instance> &instances,
+		const LodBuildOptions &options, size_t &max_depth)
+	{
+		max_depth = std::max(max_depth, static_cast<size_t>(nodes[idx].level));
+		if (instances.size() <= options.max_leaf || nodes[idx].level >= MAX_LEVEL){
+			nodes[idx].instances.swap(instances);
+			return;
+		}
+		std::vector<char> taken(options.sample_grid * options.sample_grid * options.sample_grid, 0);
+		take_samples(instances, nodes[idx], options.sample_grid, taken, nodes[idx].instances);
+		//The rest are split between the children by octant
+		std::vector<Instance> child_instances[8];
+		for (const Instance &i : instances){
+			child_instances[octant(i.pos, nodes[idx])].push_back(i);
+		}
+		std::vector<Instance>().swap(instances);
+		for (uint32_t o = 0; o < 8; ++o){
+			if (child_instances[o].empty()){
+				continue;
+			}
+			const size_t child = nodes.size();
+			nodes.push_back(BuildNode{octant_lower(nodes[idx], o), nodes[idx].size / 2, nodes[idx].level + 1});
+			nodes[idx].children[o] = child;
+			build_subtree(nodes, child, child_instances[o], options, max_depth);
+		}
+	}
+	/*
+	 * Write the nodes of a cell's subtree below its root, children first so their indices are
+	 * known when their parent is written. Returns the written node's index
+	 */
+	int64_t write_subtree(NodeWriter &writer, std::vector<BuildNode> &nodes, size_t idx){
+		for (int64_t &c : nodes[idx].children){
+			if (c != -1){
+				c = write_subtree(writer, nodes, c);
+			}
+		}
+		const int64_t written = writer.write(nodes[idx]);
+		std::vector<Instance>().swap(nodes[idx].instances);
+		return written;
+	}
+	std::string file_name(const std::string &path){
+		const size_t sep = path.find_last_of("/\\");
+		return sep == std::string::npos ? path : path.substr(sep + 1);
+	}
+}
+
+bool build_lod_octree(JobSystem &jobs, const std::string &in_file, const std::string &out_file,
+	const LodBuildOptions &options, LodBuildStats *stats)
+{
+	LodBuildStats build_stats;
+	SceneFile scene;
+	if (!scene.open(in_file)){
+		return false;
+	}
+	if (scene.size() == 0){
+		std::cerr << "build_lod_octree: " << in_file << " has no instances\n";
+		return false;
+	}
+	if (options.sample_grid == 0 || options.max_leaf == 0){
+		std::cerr << "build_lod_octree: The sample grid and leaf size must be at least 1\n";
+		return false;
+	}
+	std::string temp_dir = options.temp_dir.empty() ? util::directory_of(out_file) : options.temp_dir;
+	if (!temp_dir.empty() && temp_dir.back() != '/' && temp_dir.back() != '\\'){
+		temp_dir += "/";
+	}
+	const std::string cells_file = temp_dir + file_name(out_file) + ".cells.tmp";
+	const std::string nodes_file = temp_dir + file_name(out_file) + ".nodes.tmp";
+
+	//The octree's root is the cube around the scene, split into a grid of cells
+	//small enough to build the subtree of each one in memory
+	const SceneHeader &header = scene.header();
+	const glm::vec3 root_lower{header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]};
+	const glm::vec3 root_upper{header.bounds_max[0], header.bounds_max[1], header.bounds_max[2]};
+	const glm::vec3 extent = root_upper - root_lower;
+	const float root_size = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+	uint32_t cell_level = 0;
+	while (cell_level < MAX_CELL_LEVEL && scene.size() >> (3 * cell_level) > options.cell_instances){
+		++cell_level;
+	}
+	const uint32_t cell_res = 1 << cell_level;
+	const size_t n_cells = static_cast<size_t>(cell_res) * cell_res * cell_res;
+	auto cell_index = [&](const glm::vec3 &p){
+		const glm::uvec3 c = grid_cell(p, root_lower, root_size, cell_res);
+		return (static_cast<size_t>(c.z) * cell_res + c.y) * cell_res + c.x;
+	};
+
+	//Count the instances in each cell, each worker counts into its own array
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<std::vector<uint64_t>> worker_counts(jobs.size(), std::vector<uint64_t>(n_cells, 0));
+	std::vector<float> worker_radius(jobs.size(), 0);
+	jobs.parallel_for(scene.chunk_count(), 1, [&](size_t begin, size_t end, unsigned worker){
+		std::vector<uint64_t> &counts = worker_counts[worker];
+		for (size_t c = begin; c < end; ++c){
+			const Instance *instances = scene.chunk_instances(c);
+			for (size_t i = 0; i < scene.chunk(c).count; ++i){
+				++counts[cell_index(instances[i].pos)];
+				worker_radius[worker] = std::max(worker_radius[worker], instance_radius(instances[i]));
+			}
+		}
+	});
+	std::vector<uint64_t> cell_offsets(n_cells + 1, 0);
+	for (size_t i = 0; i < n_cells; ++i){
+		uint64_t count = 0;
+		for (const std::vector<uint64_t> &counts : worker_counts){
+			count += counts[i];
+		}
+		cell_offsets[i + 1] = cell_offsets[i] + count;
+	}
+	worker_counts.clear();
+	const float max_radius = *std::max_element(worker_radius.begin(), worker_radius.end());
+	build_stats.instances = scene.size();
+	build_stats.count_ms = util::elapsed_ms(start);
+
+	//Copy the instances into the cells file grouped by cell. Workers sort each chunk
+	//by cell and claim space for each run of a cell's instances with an atomic cursor
+	start = std::chrono::high_resolution_clock::now();
+	{
+		std::ofstream cells_out(cells_file, std::ios::binary);
+		cells_out.seekp(scene.size() * sizeof(Instance) - 1);
+		cells_out.put(0);
+		if (!cells_out){
+			std::cerr << "build_lod_octree: Failed to create " << cells_file << "\n";
+			return false;
+		}
+	}
+	std::unique_ptr<std::atomic<uint64_t>[]> cursors(new std::atomic<uint64_t>[n_cells]);
+	for (size_t i = 0; i < n_cells; ++i){
+		cursors[i] = cell_offsets[i];
+	}
+	std::vector<std::unique_ptr<std::fstream>> worker_files(jobs.size());
+	std::atomic<bool> write_failed(false);
+	jobs.parallel_for(scene.chunk_count(), 1, [&](size_t begin, size_t end, unsigned worker){
+		std::unique_ptr<std::fstream> &file = worker_files[worker];
+		if (!file){
+			file.reset(new std::fstream(cells_file, std::ios::in | std::ios::out | std::ios::binary));
+		}
+		std::vector<std::pair<size_t, uint32_t>> by_cell;
+		std::vector<Instance> run;
+		for (size_t c = begin; c < end; ++c){
+			const Instance *instances = scene.chunk_instances(c);
+			const uint32_t count = scene.chunk(c).count;
+			by_cell.resize(count);
+			for (uint32_t i = 0; i < count; ++i){
+				by_cell[i] = std::make_pair(cell_index(instances[i].pos), i);
+			}
+			std::sort(by_cell.begin(), by_cell.end());
+			for (size_t i = 0; i < by_cell.size();){
+				const size_t cell = by_cell[i].first;
+				run.clear();
+				for (; i < by_cell.size() && by_cell[i].first == cell; ++i){
+					run.push_back(instances[by_cell[i].second]);
+				}
+				const uint64_t pos = cursors[cell].fetch_add(run.size());
+				file->seekp(pos * sizeof(Instance));
+				file->write(reinterpret_cast<const char*>(run.data()), run.size() * sizeof(Instance));
+			}
+		}
+		if (!*file){
+			write_failed = true;
+		}
+	});
+	worker_files.clear();
+	cursors.reset();
+	if (write_failed){
+		std::cerr << "build_lod_octree: Failed to write " << cells_file << "\n";
+		std::remove(cells_file.c_str());
+		return false;
+	}
+	build_stats.distribute_ms = util::elapsed_ms(start);
+
+	//Build each cell's subtree in memory in parallel. The nodes below the cells' roots
+	//are written out as they're finished, the roots stay in memory to take samples from
+	//for the levels above the cells
+	start = std::chrono::high_resolution_clock::now();
+	FileView cells_view;
+	if (!cells_view.open(cells_file, FileAccess::SEQUENTIAL)){
+		std::remove(cells_file.c_str());
+		return false;
+	}
+	std::vector<size_t> cells;
+	for (size_t i = 0; i < n_cells; ++i){
+		if (cell_offsets[i + 1] > cell_offsets[i]){
+			cells.push_back(i);
+		}
+	}
+	build_stats.cells = cells.size();
+	NodeWriter writer;
+	writer.out.open(nodes_file, std::ios::binary);
+	std::map<size_t, BuildNode> roots;
+	std::mutex roots_mutex;
+	std::vector<size_t> worker_depth(jobs.size(), 0);
+	const float cell_size = root_size / cell_res;
+	jobs.parallel_for(cells.size(), 1, [&](size_t begin, size_t end, unsigned worker){
+		for (size_t c = begin; c < end; ++c){
+			const size_t cell = cells[c];
+			const Instance *first = reinterpret_cast<const Instance*>(cells_view.data()) + cell_offsets[cell];
+			std::vector<Instance> instances(first, first + (cell_offsets[cell + 1] - cell_offsets[cell]));
+			cells_view.release(cell_offsets[cell] * sizeof(Instance), instances.size() * sizeof(Instance));
+			const glm::vec3 cell_pos{static_cast<float>(cell % cell_res),
+				static_cast<float>(cell / cell_res % cell_res), static_cast<float>(cell / (cell_res * cell_res))};
+			std::vector<BuildNode> nodes;
+			nodes.push_back(BuildNode{root_lower + cell_pos * cell_size, cell_size, cell_level});
+			build_subtree(nodes, 0, instances, options, worker_depth[worker]);
+			for (int64_t &child : nodes[0].children){
+				if (child != -1){
+					child = write_subtree(writer, nodes, child);
+				}
+			}
+			std::lock_guard<std::mutex> lock(roots_mutex);
+			roots.emplace(cell, std::move(nodes[0]));
+		}
+	});
+	cells_view.close();
+	std::remove(cells_file.c_str());
+
+	//Build the levels above the cells, each parent takes its samples from its children's
+	//instances, which is where their subtrees' coarsest samples are
+	std::vector<char> taken(options.sample_grid * options.sample_grid * options.sample_grid);
+	for (uint32_t level = cell_level; level > 0; --level){
+		const size_t res = size_t{1} << level, parent_res = res / 2;
+		const float parent_size = root_size / parent_res;
+		//Group the roots by their parent at the level above, with the octant they're in
+		std::map<size_t, std::vector<std::pair<uint32_t, BuildNode*>>> children;
+		for (std::pair<const size_t, BuildNode> &r : roots){
+			const size_t x = r.first % res, y = r.first / res % res, z = r.first / (res * res);
+			const size_t parent = ((z / 2) * parent_res + y / 2) * parent_res + x / 2;
+			const uint32_t o = (x & 1) | ((y & 1) << 1) | ((z & 1) << 2);
+			children[parent].push_back(std::make_pair(o, &r.second));
+		}
+		std::map<size_t, BuildNode> parents;
+		for (std::pair<const size_t, std::vector<std::pair<uint32_t, BuildNode*>>> &c : children){
+			const glm::vec3 pos{static_cast<float>(c.first % parent_res),
+				static_cast<float>(c.first / parent_res % parent_res),
+				static_cast<float>(c.first / (parent_res * parent_res))};
+			BuildNode &parent = parents.emplace(c.first,
+				BuildNode{root_lower + pos * parent_size, parent_size, level - 1}).first->second;
+			std::fill(taken.begin(), taken.end(), 0);
+			for (std::pair<uint32_t, BuildNode*> &child : c.second){
+				take_samples(child.second->instances, parent, options.sample_grid, taken, parent.instances);
+				//Children that gave all their instances to the parent and have no children of their own are dropped
+				if (!child.second->instances.empty() || std::any_of(child.second->children,
+					child.second->children + 8, [](int64_t i){ return i != -1; }))
+				{
+					parent.children[child.first] = writer.write(*child.second);
+				}
+			}
+		}
+		roots.swap(parents);
+	}
+	const int64_t root = writer.write(roots.begin()->second);
+	roots.clear();
+	writer.out.close();
+	if (!writer.out){
+		std::cerr << "build_lod_octree: Failed to write " << nodes_file << "\n";
+		std::remove(nodes_file.c_str());
+		return false;
+	}
+	for (size_t d : worker_depth){
+		build_stats.max_depth = std::max(build_stats.max_depth, d);
+	}
+	build_stats.index_ms = util::elapsed_ms(start);
+
+	//Put the nodes in breadth first order so each node's children are contiguous and
+	//write them out as the chunks of the scene file
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<int64_t> order{root};
+	std::vector<LodNode> lod_nodes;
+	for (size_t i = 0; i < order.size(); ++i){
+		const WrittenNode &n = writer.nodes[order[i]];
+		LodNode node;
+		std::memset(&node, 0, sizeof(LodNode));
+		for (int j = 0; j < 3; ++j){
+			node.bounds_min[j] = n.lower[j] - max_radius;
+			node.bounds_max[j] = n.lower[j] + n.size + max_radius;
+		}
+		node.spacing = n.size / options.sample_grid;
+		node.count = n.count;
+		node.first_child = order.size();
+		node.level = n.level;
+		for (uint32_t o = 0; o < 8; ++o){
+			if (n.children[o] != -1){
+				node.child_mask |= 1 << o;
+				order.push_back(n.children[o]);
+			}
+		}
+		lod_nodes.push_back(node);
+	}
+	FileView nodes_view;
+	if (!nodes_view.open(nodes_file, FileAccess::SEQUENTIAL)){
+		std::remove(nodes_file.c_str());
+		return false;
+	}
+	std::vector<uint32_t> counts(order.size());
+	for (size_t i = 0; i < order.size(); ++i){
+		counts[i] = writer.nodes[order[i]].count;
+	}
+	const bool scene_written = write_scene_file(out_file, counts, [&](size_t i){
+		return reinterpret_cast<const Instance*>(nodes_view.data() + writer.nodes[order[i]].offset);
+	});
+	nodes_view.close();
+	std::remove(nodes_file.c_str());
+	if (!scene_written){
+		return false;
+	}
+
+	LodHeader lod_header;
+	std::memset(&lod_header, 0, sizeof(LodHeader));
+	std::memcpy(lod_header.magic, "VSBL", 4);
+	lod_header.version = LOD_FILE_VERSION;
+	lod_header.n_nodes = lod_nodes.size();
+	lod_header.sample_grid = options.sample_grid;
+	lod_header.n_instances = scene.size();
+	std::copy(lod_nodes[0].bounds_min, lod_nodes[0].bounds_min + 3, lod_header.bounds_min);
+	std::copy(lod_nodes[0].bounds_max, lod_nodes[0].bounds_max + 3, lod_header.bounds_max);
+	const std::string lod_file = out_file + ".lod";
+	const std::string tmp = lod_file + ".tmp";
+	{
+		std::ofstream out(tmp, std::ios::binary);
+		out.write(reinterpret_cast<const char*>(&lod_header), sizeof(LodHeader));
+		out.write(reinterpret_cast<const char*>(lod_nodes.data()), lod_nodes.size() * sizeof(LodNode));
+		if (!out){
+			std::cerr << "build_lod_octree: Failed to write " << tmp << "\n";
+			return false;
+		}
+	}
+	std::remove(lod_file.c_str());
+	if (std::rename(tmp.c_str(), lod_file.c_str()) != 0){
+		std::cerr << "build_lod_octree: Failed to move " << tmp << " to " << lod_file << "\n";
+		std::remove(tmp.c_str());
+		return false;
+	}
+	build_stats.nodes = lod_nodes.size();
+	build_stats.write_ms = util::elapsed_ms(start);
+	if (stats){
+		*stats = build_stats;
+	}
+	return true;
+}
+
+LodOctree::LodOctree() : head(nullptr), node_list(nullptr){}
+bool LodOctree::open(const std::string &file){
+	close();
+	if (!scene_file.open(file, FileAccess::RANDOM)){
+		return false;
+	}
+	const std::string lod_file = file + ".lod";
+	if (!hierarchy.open(lod_file, FileAccess::SEQUENTIAL)){
+		close();
+		return false;
+	}
+	const LodHeader *h = reinterpret_cast<const LodHeader*>(hierarchy.data());
+	if (hierarchy.size() < sizeof(LodHeader) || std::memcmp(h->magic, "VSBL", 4) != 0
+		|| h->version != LOD_FILE_VERSION)
+	{
+		std::cerr << "LodOctree: " << lod_file << " is not a version " << LOD_FILE_VERSION << " octree file\n";
+		close();
+		return false;
+	}
+	if (hierarchy.size() < sizeof(LodHeader) + static_cast<size_t>(h->n_nodes) * sizeof(LodNode)
+		|| h->n_nodes == 0 || h->n_nodes != scene_file.chunk_count())
+	{
+		std::cerr << "LodOctree: " << lod_file << " is truncated or doesn't match " << file << "\n";
+		close();
+		return false;
+	}
+	const LodNode *nodes = reinterpret_cast<const LodNode*>(hierarchy.data() + sizeof(LodHeader));
+	for (size_t i = 0; i < h->n_nodes; ++i){
+		const uint32_t n_children = std::bitset<8>(nodes[i].child_mask).count();
+		if (nodes[i].count != scene_file.chunk(i).count
+			|| (n_children > 0 && (nodes[i].first_child <= i || nodes[i].first_child + n_children > h->n_nodes)))
+		{
+			std::cerr << "LodOctree: " << lod_file << " node " << i << " doesn't match " << file << "\n";
+			close();
+			return false;
+		}
+	}
+	head = h;
+	node_list = nodes;
+	return true;
+}
+void LodOctree::close(){
+	scene_file.close();
+	hierarchy.close();
+	head = nullptr;
+	node_list = nullptr;
+}
+bool LodOctree::is_open() const {
+	return head != nullptr;
+}
+const LodHeader& LodOctree::header() const {
+	return *head;
+}
+size_t LodOctree::node_count() const {
+	return head ? head->n_nodes : 0;
+}
+const LodNode& LodOctree::node(size_t i) const {
+	return node_list[i];
+}
+SceneFile& LodOctree::scene(){
+	return scene_file;
+}
+LodSelectStats LodOctree::select(const glm::vec3 &eye, const Frustum &frustum, const glm::mat4 &proj,
+	float viewport_height, size_t budget, float max_spacing_px, std::vector<StreamChunk> &selected) const
+{
+	LodSelectStats stats;
+	selected.clear();
+	if (!head){
+		return stats;
+	}
+	//Pixels covered by a length of 1 at a distance of 1
+	const float px_scale = proj[1][1] * viewport_height / 2;
+	auto spacing_px = [&](uint32_t i){
+		const LodNode &n = node_list[i];
+		return n.spacing * px_scale / std::max(util::box_distance(eye, n.bounds_min, n.bounds_max), 1e-4f);
+	};
+	//Traverse the nodes with the most spread out samples on screen first, these
+	//are the big nodes close to the camera
+	typedef std::pair<float, uint32_t> Candidate;
+	std::priority_queue<Candidate> queue;
+	std::vector<StreamChunk> prefetch;
+	queue.push(Candidate{spacing_px(0), 0});
+	while (!queue.empty()){
+		const Candidate c = queue.top();
+		queue.pop();
+		const LodNode &n = node_list[c.second];
+		++stats.traversed;
+		const glm::vec3 lower{n.bounds_min[0], n.bounds_min[1], n.bounds_min[2]};
+		const glm::vec3 upper{n.bounds_max[0], n.bounds_max[1], n.bounds_max[2]};
+		if (test_aabb(frustum, lower, upper) == Overlap::OUTSIDE){
+			continue;
+		}
+		//The root is the coarsest we can draw, so it's drawn even if it's over the budget
+		if (c.second != 0 && stats.instances + n.count > budget){
+			break;
+		}
+		if (n.count > 0){
+			selected.push_back(StreamChunk{c.second, true});
+			++stats.selected;
+			stats.instances += n.count;
+		}
+		//Refine the node while its samples are too far apart on screen, and read its children
+		//ahead of time when we're getting close to needing them
+		if (c.first <= max_spacing_px / 2){
+			continue;
+		}
+		uint32_t child = n.first_child;
+		for (uint32_t o = 0; o < 8; ++o){
+			if (n.child_mask & (1 << o)){
+				if (c.first > max_spacing_px){
+					queue.push(Candidate{spacing_px(child), child});
+				}
+				else {
+					prefetch.push_back(StreamChunk{child, false});
+				}
+				++child;
+			}
+		}
+	}
+	selected.insert(selected.end(), prefetch.begin(), prefetch.end());
+	return stats;
+}
+
@@ -1,7 +1,17 @@
 #include <iostream>
+#include <iomanip>
+#include <sstream>
 #include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
 #include <tuple>
 #include <functional>
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
 #include <SDL.h>
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
@@ -9,37 +19,157 @@
 #include "gl_core_3_3.h"
 #include "util.h"
 #include "camera.h"
+#include "instance.h"
+#include "stream_buffer.h"
+#include "job_system.h"
+#include "cull.h"
+#include "bvh.h"
+#include "depth_sort.h"
+#include "headless.h"
+#include "flythrough.h"
+#include "frame_stats.h"
+#include "profiler.h"
+#include "trace.h"
+#include "gl_debug_log.h"
+#include "gl_error_check.h"
+#include "program_cache.h"
+#include "shader_reload.h"
+#include "shader_variants.h"
+#include "scene_file.h"
+#include "chunk_stream.h"
+#include "lod_octree.h"
+#include "far_field.h"
+#include "progressive.h"
+#include "frame_scheduler.h"
 
 const int WIN_WIDTH = 1280;
 const int WIN_HEIGHT = 720;
 
-void run(SDL_Window *win);
+//Size of the Viewing uniform block: view and projection matrices, the eye position and the viewport
+const size_t VIEWING_BLOCK_SIZE = 2 * sizeof(glm::mat4) + 2 * sizeof(glm::vec4);
+
+/*
+ * Options set on the command line
+ * usage: vsbillboards [--headless] [--frames N] [--flythrough file] [--bench-out prefix] [--trace file]
+ *	[--gl-debug-sync] [--gl-errors off|callback|sampled[:N]] [--shader-cache dir|off] [--atlas]
+ *	[--scene file.vsbs] [--stream pool_MB] [--lod budget] [--min-px px] [--clamp-px px]
+ *	[--far-field distance] [--progressive budget] [--on-demand] [--duration seconds]
+ */
+struct Options {
+	//Render offscreen without a window or input, see HeadlessContext
+	bool headless;
+	//Number of frames to render before exiting, 0 runs until we're closed
+	int frames;
+	//Benchmark by playing back the camera path and scene in this file, see load_flythrough
+	std::string flythrough;
+	//Write the benchmark's per-frame stats to <prefix>.csv and <prefix>.json
+	std::string bench_out;
+	//Record a timeline of the CPU threads and GPU and write it to this Chrome trace file
+	std::string trace_file;
+	//Print GL debug messages synchronously from within the call that raised them so they
+	//can be traced back in a debugger, otherwise they're queued and printed off thread
+	bool gl_debug_sync;
+	//When to check glGetError, see GLErrorMode. Sampled mode checks every gl_error_interval frames
+	GLErrorMode gl_errors;
+	unsigned gl_error_interval;
+	//Directory to cache linked shader program binaries in, off disables the cache.
+	//Defaults to SDL's preference path, see ProgramCache
+	std::string shader_cache;
+	//Texture the sprites from the sprite atlas and alpha test them against it
+	bool atlas;
+	//Draw the billboards in this scene file instead of the built in or flythrough scene,
+	//see scene_file.h and tools/scene_convert
+	std::string scene_file;
+	//Stream the scene file's chunks in and out of a GPU pool of this many MB instead of
+	//loading the whole scene, for scenes too big for memory. 0 loads the whole scene
+	size_t stream_pool_mb;
+	//Draw the scene file as a level of detail octree built by tools/lod_build, drawing at most
+	//this many instances a frame. The nodes are streamed through the --stream pool. 0 draws every instance
+	size_t lod_budget;
+	//Cull billboards less than this many pixels across on screen, 0 draws them all
+	float min_px;
+	//Draw billboards at least this many pixels across with the MIN_SIZE shader variant, 0 doesn't grow them
+	float clamp_px;
+	//Splat the billboards further than this from the eye into a density layer instead of
+	//drawing each one, see FarFieldSplat. 0 draws them all as billboards
+	float far_field;
+	//Draw at most this many instances a frame, adding the rest to the image over the following
+	//frames once the camera stops, see ProgressiveRenderer. 0 draws them all every frame
+	size_t progressive_budget;
+	//Only draw frames when something changed instead of continuously, see FrameScheduler
+	bool on_demand;
+	//Seconds to run for before exiting, 0 runs until we're closed or have drawn --frames
+	double duration;
+
+	Options() : headless(false), frames(0), gl_debug_sync(false), gl_errors(GLErrorMode::SAMPLED),
+		gl_error_interval(120), atlas(false), stream_pool_mb(0), lod_budget(0), min_px(0), clamp_px(0),
+		far_field(0), progressive_budget(0), on_demand(false), duration(0)
+	{}
+};
+
+Options parse_options(int argc, char **argv);
+//Run the renderer, presenting to the window or if it's null to the headless context's framebuffer
+void run(SDL_Window *win, HeadlessContext *headless, const Options &opts, GLErrorChecker &gl_errors);
+//Pick the shader variant with only the features the scene uses
+VariantKey scene_variant(const std::vector<Instance> &instances, bool atlas);
+//Start using a newly loaded billboard program and hook up its uniform blocks and atlas sampler
+void use_shader(GLint shader);
+//Create the sprite atlas texture, a 2x2 grid of white sprite shapes in the alpha channel
+GLuint make_sprite_atlas();
+//Write the camera's viewing information and the pixel size MIN_SIZE grows billboards to
+//to the next region of the viewing buffer and bind it to the Viewing block. The region
+//must be fenced after the draws using it
+void update_viewing(StreamBuffer &viewing_buf, const Camera &camera, const glm::mat4 &proj, float clamp_px);
+//Setup blending and depth testing for drawing sprites sorted in the order passed,
+//back to front sorting is used for alpha blended sprites and doesn't need the depth test
+void set_sort_order(SortOrder order);
+//Set the blending and depth test for the sort order without logging it, e.g. to restore it after the far field
+void set_blend_state(SortOrder order);
+//Show the frame's times and visible instance count in the window title
+void update_title(SDL_Window *win, const FrameRecord &record);
 //Handle input events to the camera, returns true if the camera was moved
 bool move_camera(Camera &camera, const SDL_Event &e);
 
 int main(int argc, char **argv){
-	if (SDL_Init(SDL_INIT_EVERYTHING) != 0){
+	const Options opts = parse_options(argc, argv);
+	//Must outlive the GL context since the driver can call the debug callback until it's destroyed
+	GLDebugLog gl_log;
+	//We still use SDL's timer and paths in headless mode, just not its video subsystem.
+	//Drawing on demand waits on SDL's event queue so it needs the events too
+	if (SDL_Init(opts.headless ? SDL_INIT_TIMER | (opts.on_demand ? SDL_INIT_EVENTS : 0) : SDL_INIT_EVERYTHING) != 0){
 		std::cerr << "SDL_Init error: " << SDL_GetError() << "\n";
 		return 1;
 	}
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
-	SDL_GL_SetSwapInterval(1);
-	SDL_SetRelativeMouseMode(SDL_TRUE);
+	SDL_Window *win = nullptr;
+	SDL_GLContext context = nullptr;
+	HeadlessContext headless;
+	if (opts.headless){
+		if (!headless.create(WIN_WIDTH, WIN_HEIGHT, true)){
+			SDL_Quit();
+			return 1;
+		}
+	}
+	else {
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+		SDL_GL_SetSwapInterval(1);
+		SDL_SetRelativeMouseMode(SDL_TRUE);
 
-	SDL_Window *win = SDL_CreateWindow("Fast Billboards", SDL_WINDOWPOS_CENTERED,
-		SDL_WINDOWPOS_CENTERED, WIN_WIDTH, WIN_HEIGHT, SDL_WINDOW_OPENGL);
-	SDL_GLContext context = SDL_GL_CreateContext(win);
+		win = SDL_CreateWindow("Fast Billboards", SDL_WINDOWPOS_CENTERED,
+			SDL_WINDOWPOS_CENTERED, WIN_WIDTH, WIN_HEIGHT, SDL_WINDOW_OPENGL);
+		context = SDL_GL_CreateContext(win);
 
-	if (ogl_LoadFunctions() == ogl_LOAD_FAILED){
-		std::cerr << "ogl load failed\n";
-		SDL_GL_DeleteContext(context);
-		SDL_DestroyWindow(win);
-		SDL_Quit();
-		return 1;
+		if (ogl_LoadFunctions() == ogl_LOAD_FAILED){
+			std::cerr << "ogl load failed\n";
+			SDL_GL_DeleteContext(context);
+			SDL_DestroyWindow(win);
+			SDL_Quit();
+			return 1;
+		}
 	}
+	util::setup_shader_compiler();
 	glClearColor(0.f, 0.f, 0.f, 1.f);
 	glClearDepth(1.f);
 	glEnable(GL_DEPTH_TEST);
@@ -51,60 +181,209 @@ int main(int argc, char **argv){
 		<< "OpenGL Renderer: " << glGetString(GL_RENDERER) << "\n"
 		<< "GLSL Version: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << "\n";
 
-	std::cout << "CONTROLS:\n"
-		<< "\tw/s - forward/back\n" << "\ta/d - strafe left/right\n"
-		<< "\tq/e - strafe up/down\n" << "\tr/f - roll clockwise/counterclockwise\n"
-		<< "\tclick + drag - move camera look direction\n";
+	if (!opts.headless){
+		std::cout << "CONTROLS:\n"
+			<< "\tw/s - forward/back\n" << "\ta/d - strafe left/right\n"
+			<< "\tq/e - strafe up/down\n" << "\tr/f - roll clockwise/counterclockwise\n"
+			<< "\tt - cycle sprite sort order (unsorted, front to back, back to front + blending)\n"
+			<< "\ti - toggle incremental sorting from the previous frame's order\n"
+			<< "\tclick + drag - move camera look direction\n";
+	}
 
-	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
-	glDebugMessageCallbackARB(util::gldebug_callback, NULL);
-	glDebugMessageControlARB(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0,
-		NULL, GL_TRUE);
+	if (!opts.trace_file.empty()){
+		trace::enable();
+		trace::set_thread_name("main");
+		trace::calibrate_gpu();
+	}
 
-	run(win);
+	if (opts.gl_debug_sync){
+		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
+		gl_log.set_synchronous(true);
+	}
+	glDebugMessageCallbackARB(util::gldebug_callback, &gl_log);
+	GLErrorChecker gl_errors{gl_log, opts.gl_errors, opts.gl_error_interval};
+	gl_errors.apply();
+	std::cout << "GL error checking: " << gl_error_mode_name(opts.gl_errors);
+	if (opts.gl_errors == GLErrorMode::SAMPLED && opts.gl_error_interval > 0){
+		std::cout << ", glGetError every " << opts.gl_error_interval << " frames";
+	}
+	std::cout << "\n";
+
+	run(win, opts.headless ? &headless : nullptr, opts, gl_errors);
+	if (!opts.trace_file.empty()){
+		trace::write(opts.trace_file);
+	}
 
-	SDL_GL_DeleteContext(context);
-	SDL_DestroyWindow(win);
+	if (win){
+		SDL_GL_DeleteContext(context);
+		SDL_DestroyWindow(win);
+	}
 	SDL_Quit();
 	return 0;
 }
-void run(SDL_Window *win){
+Options parse_options(int argc, char **argv){
+	Options opts;
+	for (int i = 1; i < argc; ++i){
+		if (std::strcmp(argv[i], "--headless") == 0){
+			opts.headless = true;
+		}
+		else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc){
+			opts.frames = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--flythrough") == 0 && i + 1 < argc){
+			opts.flythrough = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--bench-out") == 0 && i + 1 < argc){
+			opts.bench_out = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc){
+			opts.trace_file = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--gl-debug-sync") == 0){
+			opts.gl_debug_sync = true;
+		}
+		else if (std::strcmp(argv[i], "--shader-cache") == 0 && i + 1 < argc){
+			opts.shader_cache = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--atlas") == 0){
+			opts.atlas = true;
+		}
+		else if (std::strcmp(argv[i], "--scene") == 0 && i + 1 < argc){
+			opts.scene_file = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--stream") == 0 && i + 1 < argc){
+			opts.stream_pool_mb = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (std::strcmp(argv[i], "--lod") == 0 && i + 1 < argc){
+			opts.lod_budget = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (std::strcmp(argv[i], "--min-px") == 0 && i + 1 < argc){
+			opts.min_px = std::max(static_cast<float>(std::atof(argv[++i])), 0.f);
+		}
+		else if (std::strcmp(argv[i], "--clamp-px") == 0 && i + 1 < argc){
+			opts.clamp_px = std::max(static_cast<float>(std::atof(argv[++i])), 0.f);
+		}
+		else if (std::strcmp(argv[i], "--far-field") == 0 && i + 1 < argc){
+			opts.far_field = std::max(static_cast<float>(std::atof(argv[++i])), 0.f);
+		}
+		else if (std::strcmp(argv[i], "--progressive") == 0 && i + 1 < argc){
+			opts.progressive_budget = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (std::strcmp(argv[i], "--on-demand") == 0){
+			opts.on_demand = true;
+		}
+		else if (std::strcmp(argv[i], "--duration") == 0 && i + 1 < argc){
+			opts.duration = std::max(std::atof(argv[++i]), 0.0);
+		}
+		else if (std::strcmp(argv[i], "--gl-errors") == 0 && i + 1 < argc){
+			if (!parse_gl_error_mode(argv[++i], opts.gl_errors, opts.gl_error_interval)){
+				std::cerr << "Invalid GL error mode " << argv[i] << ", expected off, callback or sampled[:N]\n";
+			}
+		}
+		else {
+			std::cerr << "Unrecognized option " << argv[i] << "\n";
+		}
+	}
+	//There's no way to close the headless renderer so make sure it stops, flythroughs
+	//run for the number of frames in their file
+	if (opts.headless && opts.frames <= 0 && opts.flythrough.empty()){
+		opts.frames = 300;
+	}
+	//Nothing changes in a headless scene without a flythrough, so drawing it on demand
+	//only draws a few frames and it runs for a fixed time to measure how idle it is instead
+	if (opts.headless && opts.on_demand && opts.duration <= 0 && opts.flythrough.empty()){
+		opts.duration = 5;
+	}
+	if (opts.stream_pool_mb > 0 && opts.scene_file.empty()){
+		std::cerr << "--stream needs a scene file to stream from, pass one with --scene\n";
+		opts.stream_pool_mb = 0;
+	}
+	if (opts.lod_budget > 0 && opts.scene_file.empty()){
+		std::cerr << "--lod needs an octree's scene file to draw, pass one with --scene\n";
+		opts.lod_budget = 0;
+	}
+	if (opts.far_field > 0 && (opts.stream_pool_mb > 0 || opts.lod_budget > 0)){
+		std::cerr << "--far-field splats the culled instances so it can't be used with --stream or --lod\n";
+		opts.far_field = 0;
+	}
+	if (opts.progressive_budget > 0 && (opts.stream_pool_mb > 0 || opts.lod_budget > 0 || opts.far_field > 0)){
+		std::cerr << "--progressive draws slices of the sorted instances so it can't be used with --stream, "
+			<< "--lod or --far-field\n";
+		opts.progressive_budget = 0;
+	}
+	//Octrees are always streamed, through a 256MB pool unless we're told otherwise
+	if (opts.lod_budget > 0 && opts.stream_pool_mb == 0){
+		opts.stream_pool_mb = 256;
+	}
+	return opts;
+}
+void run(SDL_Window *win, HeadlessContext *headless, const Options &opts, GLErrorChecker &gl_errors){
+	//In benchmark mode the scene is generated and the camera follows the flythrough's path
+	const bool benchmark = !opts.flythrough.empty();
+	Flythrough flythrough;
+	if (benchmark && !load_flythrough(opts.flythrough, flythrough)){
+		return;
+	}
+	const int max_frames = benchmark && opts.frames <= 0 ? flythrough.frames : opts.frames;
+	//All the per-instance data (positions, sprite ids, sizes, etc.) is interleaved
+	//into Instance structs, see instance.h for the layout
+	std::vector<Instance> instances;
+	//Streamed scenes stay mapped and their chunks are paged in as the camera needs them
+	const bool streaming = opts.stream_pool_mb > 0;
+	SceneFile scene;
+	//Octrees are drawn by streaming the nodes picked for the camera out of the octree's scene file
+	LodOctree lod;
+	if (opts.lod_budget > 0){
+		if (!lod.open(opts.scene_file)){
+			return;
+		}
+		std::cout << "Drawing the " << lod.header().n_instances << " instance octree " << opts.scene_file
+			<< " with " << lod.node_count() << " nodes at up to " << opts.lod_budget << " instances/frame\n";
+	}
+	else if (!opts.scene_file.empty()){
+		if (!scene.open(opts.scene_file, streaming ? FileAccess::RANDOM : FileAccess::SEQUENTIAL)){
+			return;
+		}
+		if (scene.size() == 0){
+			std::cerr << "Scene file " << opts.scene_file << " has no instances\n";
+			return;
+		}
+	}
+	if (!opts.scene_file.empty() && !streaming){
+		//Scene files are the Instance structs as they are in memory, so this is just a copy out of the mapping
+		const auto load_start = std::chrono::high_resolution_clock::now();
+		scene.read_instances(instances);
+		const double load_ms = std::chrono::duration<double, std::milli>(
+			std::chrono::high_resolution_clock::now() - load_start).count();
+		std::cout << "Loaded " << instances.size() << " instances in " << scene.chunk_count() << " chunks from "
+			<< opts.scene_file << " in " << load_ms << "ms, "
+			<< instances.size() * sizeof(Instance) / (load_ms * 1e6) << "GB/s\n";
+	}
+
 	std::string res_path = util::get_resource_path();
-	GLint shader = util::load_program({std::make_tuple(GL_VERTEX_SHADER, res_path + "vertex.glsl"),
-		std::make_tuple(GL_FRAGMENT_SHADER, res_path + "fragment.glsl")});
-	assert(shader != -1);
-	glUseProgram(shader);
+	//Load the shaders from the program binary cache when we can, compiling
+	//them is most of our startup time with larger shaders
+	ProgramCache program_cache{opts.shader_cache == "off" ? ""
+		: opts.shader_cache.empty() ? ProgramCache::default_dir() : opts.shader_cache};
+	const ShaderReloader::ShaderList shader_files = {std::make_tuple(GL_VERTEX_SHADER, res_path + "vertex.glsl"),
+		std::make_tuple(GL_FRAGMENT_SHADER, res_path + "fragment.glsl")};
 
 	Camera camera{glm::vec3{0, 0, 5}, glm::vec3{0, 0, 0}, glm::vec3{0, 1, 0}};
 
 	//Setup our viewing matrix buffer to pass viewing information to the shaders
-	//as a uniform block
-	GLuint viewing_buf;
-	glGenBuffers(1, &viewing_buf);
-	glBindBuffer(GL_UNIFORM_BUFFER, viewing_buf);
-	glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4) + 1 * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
-	{
-		char *buf = static_cast<char*>(glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY));
-		glm::mat4 *m = reinterpret_cast<glm::mat4*>(buf);
-		m[0] = camera.view_mat();
-		m[1] = glm::perspective<GLfloat>(util::deg_to_rad(75.f),
-			static_cast<float>(WIN_WIDTH) / WIN_HEIGHT, 1, 100);
-		glm::vec4 *v = reinterpret_cast<glm::vec4*>(buf + 2 * sizeof(glm::mat4));
-		v[0] = glm::vec4{camera.eye_pos(), 0};
-		glUnmapBuffer(GL_UNIFORM_BUFFER);
-	}
-	GLuint viewing_block = glGetUniformBlockIndex(shader, "Viewing");
-	glUniformBlockBinding(shader, viewing_block, 0);
-	glBindBufferBase(GL_UNIFORM_BUFFER, 0, viewing_buf);
+	//as a uniform block. It's streamed through a ring of fenced regions so updating
+	//it while the GPU is still drawing with the previous view doesn't stall
+	const glm::mat4 proj = glm::perspective<GLfloat>(util::deg_to_rad(75.f),
+		static_cast<float>(WIN_WIDTH) / WIN_HEIGHT, 1, 100);
+	GLint ubo_align;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ubo_align);
+	StreamBuffer viewing_buf{GL_UNIFORM_BUFFER, VIEWING_BLOCK_SIZE, 3, static_cast<size_t>(ubo_align)};
 
 	//Setup our uniform color data for the sprites (here you'd instead pass uv data or whatever)
 	//This will be indexed by the sprite id instance attribute
-	GLuint color_buf;
-	glGenBuffers(1, &color_buf);
-	glBindBuffer(GL_UNIFORM_BUFFER, color_buf);
-	glBufferData(GL_UNIFORM_BUFFER, 16 * sizeof(glm::vec4), NULL, GL_STATIC_DRAW);
+	//The far field splat needs the colors too so we keep a copy
+	std::array<glm::vec4, 16> color;
 	{
-		glm::vec4 *color = static_cast<glm::vec4*>(glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY));
 		color[0] = glm::vec4{1, 0, 0, 1};
 		color[1] = glm::vec4{0, 1, 0, 1};
 		color[2] = glm::vec4{0, 0, 1, 1};
@@ -124,134 +403,601 @@ void run(SDL_Window *win){
 		color[13] = glm::vec4{0.5, 0, 0.5, 1};
 		color[14] = glm::vec4{0, 0.5, 0.5, 1};
 		color[15] = glm::vec4{1, 0.5, 0.5, 1};
-		glUnmapBuffer(GL_UNIFORM_BUFFER);
 	}
-	GLuint color_block = glGetUniformBlockIndex(shader, "Colors");
-	glUniformBlockBinding(shader, color_block, 1);
+	GLuint color_buf;
+	glGenBuffers(1, &color_buf);
+	glBindBuffer(GL_UNIFORM_BUFFER, color_buf);
+	glBufferData(GL_UNIFORM_BUFFER, color.size() * sizeof(glm::vec4), color.data(), GL_STATIC_DRAW);
 	glBindBufferBase(GL_UNIFORM_BUFFER, 1, color_buf);
+	//The atlas is only sampled by the ATLAS variants, it stays bound to unit 0
+	GLuint atlas = make_sprite_atlas();
 
-	/*
-	 * IMPORTANT NOTE: I use two buffers here for simplicity but you'd really want to compact all
-	 * the instance data (positions, ids, etc) into a single buffer to be more efficient
-	 */
-	
-	int n_billboards = 4;
-	//Setup the buffer containing our billboard positions
-	GLuint pos_buf;
-	glGenBuffers(1, &pos_buf);
-	glBindBuffer(GL_ARRAY_BUFFER, pos_buf);
-	glBufferData(GL_ARRAY_BUFFER, n_billboards * sizeof(glm::vec3), NULL, GL_STATIC_DRAW);
-	{
-		glm::vec3 *pos = static_cast<glm::vec3*>(glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY));
-		pos[0] = glm::vec3{-2, -2, 0};
-		pos[1] = glm::vec3{2, -2, 0};
-		pos[2] = glm::vec3{-2, 2, 0};
-		pos[3] = glm::vec3{2, 2, 0};
-		glUnmapBuffer(GL_ARRAY_BUFFER);
-	}
-
-	/*
-	 * Setup other per-instance data, eg. sprite ids to be used to select the
-	 * proper uv coordinates (and optionally texture array index) to draw
-	 * the appropriate sprite texture
-	 * In this demo it's used to look up colors for the vertices
-	 */
-	GLuint extra_buf;
-	glGenBuffers(1, &extra_buf);
-	glBindBuffer(GL_ARRAY_BUFFER, extra_buf);
-	glBufferData(GL_ARRAY_BUFFER, n_billboards * sizeof(GLint), NULL, GL_STATIC_DRAW);
-	{
-		int *indices = static_cast<int*>(glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY));
-		indices[0] = 0;
-		indices[1] = 1;
-		indices[2] = 2;
-		indices[3] = 3;
-		glUnmapBuffer(GL_ARRAY_BUFFER);
+	//Without a scene file we draw the flythrough's scene or our four billboards
+	if (opts.scene_file.empty() && benchmark){
+		generate_scene(flythrough.scene, instances);
+	}
+	else if (opts.scene_file.empty()){
+		const glm::vec3 pos[4] = {
+			glm::vec3{-2, -2, 0}, glm::vec3{2, -2, 0}, glm::vec3{-2, 2, 0}, glm::vec3{2, 2, 0}
+		};
+		for (int i = 0; i < 4; ++i){
+			//The sprite id is used to look up the colors for the vertices
+			instances.push_back(Instance{pos[i], i, 1, pack_rgba8(glm::vec4{1}), 0});
+		}
+	}
+	//Building the BVH and packing the visible instances is split up over a worker per core
+	JobSystem jobs;
+	//Build a BVH over the instances so culling can skip or accept whole subtrees at once,
+	//this reorders the instances so each subtree is a contiguous range
+	BVH bvh;
+	bvh.build(jobs, instances);
+	//Bounding spheres of the instances for culling the ones in partially visible leaves
+	InstanceSoA instance_bounds;
+	instance_bounds.assign(instances.data(), instances.size());
+	const CullISA cull_isa = best_cull_isa();
+	std::vector<DrawRange> visible_ranges;
+	//The visible instances are sorted by depth each frame, front to back by default
+	//since our sprites are opaque and this lets early-z reject the hidden ones. The camera
+	//only moves a bit each frame so we can sort incrementally from the last frame's order
+	DepthSorter depth_sorter{true};
+	//The rest of a progressive image is sorted once when the camera stops, with its own sorter
+	//so it doesn't throw off the incremental sorts of the samples drawn while moving
+	DepthSorter rest_sorter{false};
+	std::vector<DrawRange> sample_ranges;
+	SortOrder sort_order = SortOrder::FRONT_TO_BACK;
+	set_sort_order(sort_order);
+	std::cout << "Culling with " << cull_isa_name(cull_isa) << " kernel on "
+		<< jobs.size() << " threads, BVH with " << bvh.node_list().size() << " nodes\n";
+
+	//The variant we draw with only has the features the scene needs, e.g. scenes without
+	//rotated sprites don't pay for the sin and cos per vertex. Only it is built before the
+	//first frame, the other shipped variants are built in the background afterwards so
+	//they're in the program cache and a scene using them starts without compiling
+	ShaderVariants shader_variants{program_cache, shader_files};
+	VariantKey variant = scene_variant(instances, opts.atlas);
+	//We don't see a streamed scene's instances up front so it's drawn with sizes and rotations
+	if (streaming){
+		variant |= feature_bit(ShaderFeature::SIZE) | feature_bit(ShaderFeature::ROTATION);
+	}
+	if (opts.clamp_px > 0){
+		variant |= feature_bit(ShaderFeature::MIN_SIZE);
+	}
+	GLint shader = shader_variants.get(variant);
+	assert(shader != -1);
+	use_shader(shader);
+	shader_variants.prebuild(shipped_variants());
+	std::cout << "Built shader variant " << variant_name(variant) << " in "
+		<< shader_variants.variant_stats().last_build_ms << "ms"
+		<< (!program_cache.enabled() ? " (program cache disabled)"
+			: shader_variants.variant_stats().cache_hits ? " from the program cache" : "")
+		<< ", building " << shader_variants.queued_count() << " more in the background\n";
+	//The instances are streamed to the GPU each frame through a ring of regions
+	//so the CPU can write the next frames while the GPU draws the current one
+	StreamBuffer instance_buf{GL_ARRAY_BUFFER, std::max(instances.size(), size_t{1}) * sizeof(Instance)};
+	std::cout << "Instance streaming: "
+		<< (instance_buf.is_persistent() ? "persistent mapped" : "unsynchronized map range") << "\n";
+	//Streamed scenes are drawn straight from the chunks resident in the streamer's GPU pool
+	//instead of being culled and sorted per instance, see ChunkStreamer
+	std::unique_ptr<ChunkStreamer> streamer;
+	SceneFile *streamer_scene = lod.is_open() ? &lod.scene() : &scene;
+	if (streaming){
+		streamer.reset(new ChunkStreamer{*streamer_scene, opts.stream_pool_mb * 1024 * 1024});
+		std::cout << "Streaming " << streamer_scene->size() << " instances in " << streamer_scene->chunk_count()
+			<< " chunks from " << opts.scene_file << " through a pool of " << streamer->pool_slots() << " chunks\n";
 	}
+	//The octree nodes to stream this frame, the ones to draw followed by the ones to prefetch
+	std::vector<StreamChunk> lod_nodes;
+	LodSelectStats lod_total;
 
-	//Setup our vao bindings for the billboards
+	//Far away billboards are splatted into a density layer at half the window's resolution, they're
+	//smaller than a pixel anyway and a coarser grid is less to clear and sum each frame
+	std::unique_ptr<FarFieldSplat> far_field;
+	std::vector<DrawRange> near_ranges;
+	if (opts.far_field > 0){
+		far_field.reset(new FarFieldSplat{WIN_WIDTH / 2, WIN_HEIGHT / 2, opts.far_field});
+		if (!far_field->create(program_cache, res_path)){
+			far_field.reset();
+		}
+		else {
+			std::cout << "Splatting billboards further than " << opts.far_field << " into a far field\n";
+		}
+		glUseProgram(shader);
+	}
+
+	//Drawing on demand only draws frames when something changed, woken up by events or the streamer
+	//finishing reading chunks. The window's back buffer isn't kept between swaps so frames are drawn
+	//to the scheduler's canvas to redraw just the part that changed, the headless framebuffer is kept
+	std::unique_ptr<FrameScheduler> scheduler;
+	if (opts.on_demand){
+		scheduler.reset(new FrameScheduler{WIN_WIDTH, WIN_HEIGHT, headless ? headless->framebuffer() : 0,
+			headless != nullptr});
+		if (streamer){
+			FrameScheduler *s = scheduler.get();
+			streamer->set_read_callback([s](){ s->notify(); });
+		}
+		std::cout << "Drawing on demand\n";
+	}
+
+	//Progressive rendering draws into its own framebuffer and blits it to the window's or headless context's
+	std::unique_ptr<ProgressiveRenderer> progressive;
+	if (opts.progressive_budget > 0){
+		progressive.reset(new ProgressiveRenderer{WIN_WIDTH, WIN_HEIGHT, opts.progressive_budget,
+			scheduler ? scheduler->framebuffer() : headless ? headless->framebuffer() : 0});
+		std::cout << "Progressive rendering up to " << opts.progressive_budget << " instances/frame\n";
+	}
+
+	//Setup our vao for the billboards, the attributes are pointed at the current
+	//region of the instance stream each frame
 	GLuint vao;
 	glGenVertexArrays(1, &vao);
 	glBindVertexArray(vao);
 
-	glBindBuffer(GL_ARRAY_BUFFER, pos_buf);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	glVertexAttribDivisor(0, 1);
-
-	glBindBuffer(GL_ARRAY_BUFFER, extra_buf);
-	glEnableVertexAttribArray(1);
-	glVertexAttribIPointer(1, 1, GL_INT, 0, 0);
-	glVertexAttribDivisor(1, 1);
-
 	//Monitor the shaders for changes and reload them if they're updated
 	//This isn't required for the billboard rendering but does make it
-	//easier to work on the shaders since you get hot reloading
+	//easier to work on the shaders since you get hot reloading. The new
+	//program is built in the background and swapped in once it's ready. Changes
+	//to the files the shaders include trigger a reload too
+	ShaderReloader shader_reloader{program_cache, shader_files, variant_defines(variant)};
+	std::unique_ptr<ShaderReloader> splat_reloader;
+	if (far_field){
+		splat_reloader.reset(new ShaderReloader{program_cache, FarFieldSplat::shader_files(res_path)});
+	}
 	lfw::Watcher file_watcher;
 	file_watcher.watch(res_path, lfw::Notify::FILE_MODIFIED,
-		[&shader, res_path](const lfw::EventData &e){
-			if (e.fname == "vertex.glsl" || e.fname == "fragment.glsl"){
-				GLint new_shader = util::load_program({std::make_tuple(GL_VERTEX_SHADER, res_path + "vertex.glsl"),
-					std::make_tuple(GL_FRAGMENT_SHADER, res_path + "fragment.glsl")});
-				if (new_shader == -1){
-					std::cerr << "Error compiling reloaded shader, aborting...\n";
-				}
-				else {
-					glDeleteProgram(shader);
-					shader = new_shader;
-					glUseProgram(shader);
-					//Re-hook up the uniform bindings
-					GLuint viewing_block = glGetUniformBlockIndex(shader, "Viewing");
-					glUniformBlockBinding(shader, viewing_block, 0);
-					GLuint color_block = glGetUniformBlockIndex(shader, "Colors");
-					glUniformBlockBinding(shader, color_block, 1);
-				}
+		[&shader_reloader, &splat_reloader, res_path](const lfw::EventData &e){
+			if (shader_reloader.depends_on(res_path + e.fname)){
+				shader_reloader.request();
+			}
+			if (splat_reloader && splat_reloader->depends_on(res_path + e.fname)){
+				splat_reloader->request();
 			}
 		});
 
-	bool update_view = false;
+	gl_errors.check("setup");
+
+	//Time the parts of each frame on the CPU and GPU, the GPU times are read back
+	//a few frames later so we don't stall waiting on them. Benchmark runs keep
+	//the record of every frame, otherwise the latest is shown in the window title
+	FrameProfiler profiler;
+	FrameLog frame_log;
+	FrameRecord record;
+	auto title_update = std::chrono::high_resolution_clock::now();
+
+	//Instances culled for being smaller than --min-px over all frames
+	size_t size_culled = 0;
+	//Write the initial viewing information on the first frame
+	bool update_view = true;
 	bool quit = false;
+	int frame = 0;
+	//Wall time of the previous frame, for measuring hitches from shader reloads
+	double last_frame_ms = 0;
+	const auto start = std::chrono::high_resolution_clock::now();
 	while (!quit){
-		SDL_Event e;
-		while (SDL_PollEvent(&e)){
-			if (e.type == SDL_QUIT || (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE)){
-				quit = true;
-			}
-			else if (e.type == SDL_KEYDOWN
-				|| (e.type == SDL_MOUSEMOTION && (SDL_GetMouseState(NULL, NULL) & SDL_BUTTON(SDL_BUTTON_LEFT))))
-			{
-				update_view = move_camera(camera, e);
+		//On demand we sleep until there's an event, a chunk finished reading or it's time to poll the
+		//file watcher again. Flythroughs move the camera every frame so there's never a reason to wait
+		if (scheduler && !benchmark){
+			trace::Span span{"wait"};
+			scheduler->wait();
+		}
+		if (opts.duration > 0 && std::chrono::high_resolution_clock::now() - start
+			>= std::chrono::duration<double>(opts.duration))
+		{
+			break;
+		}
+		const auto frame_start = std::chrono::high_resolution_clock::now();
+		profiler.begin_frame(frame);
+		profiler.begin(FrameScope::EVENTS);
+		if (benchmark){
+			camera = flythrough.camera_at_frame(frame);
+			update_view = true;
+		}
+		{
+			trace::Span span{"poll events"};
+			SDL_Event e;
+			//There's no input in headless mode since we don't have a window, but drawing on demand
+			//still needs to see quit events since it waits on the queue instead of drawing --frames
+			while ((!headless || scheduler) && SDL_PollEvent(&e)){
+				if (e.type == SDL_QUIT || (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE)){
+					quit = true;
+				}
+				else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_t){
+					sort_order = sort_order == SortOrder::NONE ? SortOrder::FRONT_TO_BACK
+						: sort_order == SortOrder::FRONT_TO_BACK ? SortOrder::BACK_TO_FRONT : SortOrder::NONE;
+					set_sort_order(sort_order);
+					//The progressive image has to be redrawn in the new order
+					update_view = true;
+				}
+				else if (e.type == SDL_WINDOWEVENT && scheduler){
+					//The window may have been uncovered or resized, we don't know what's left of it
+					scheduler->mark_dirty();
+				}
+				else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_i){
+					depth_sorter.set_incremental(!depth_sorter.is_incremental());
+					std::cout << "Incremental sorting " << (depth_sorter.is_incremental() ? "on" : "off") << "\n";
+				}
+				else if (e.type == SDL_KEYDOWN
+					|| (e.type == SDL_MOUSEMOTION && (SDL_GetMouseState(NULL, NULL) & SDL_BUTTON(SDL_BUTTON_LEFT))))
+				{
+					trace::Span span{"move_camera"};
+					update_view |= move_camera(camera, e);
+				}
 			}
 		}
+		//Anything changing what's drawn restarts the progressive image
+		bool image_changed = update_view;
 		if (update_view){
+			trace::Span span{"update_viewing"};
 			update_view = false;
-			glBindBuffer(GL_UNIFORM_BUFFER, viewing_buf);
-			char *buf = static_cast<char*>(glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY));
-			glm::mat4 *m = reinterpret_cast<glm::mat4*>(buf);
-			m[0] = camera.view_mat();
-			glm::vec4 *v = reinterpret_cast<glm::vec4*>(buf + 2 * sizeof(glm::mat4));
-			v[0] = glm::vec4{camera.eye_pos(), 0};
-			glUnmapBuffer(GL_UNIFORM_BUFFER);
+			update_viewing(viewing_buf, camera, proj, opts.clamp_px);
+		}
+		{
+			trace::Span span{"file_watcher"};
+			file_watcher.update();
+			shader_variants.update();
+			GLint new_shader = shader_reloader.update(last_frame_ms);
+			if (new_shader != -1){
+				GLErrorScope check{gl_errors, "shader reload"};
+				//This deletes the old program and the other variants built from the old sources
+				shader_variants.replace(variant, new_shader);
+				shader = new_shader;
+				use_shader(shader);
+				image_changed = true;
+			}
+			GLint new_splat = splat_reloader ? splat_reloader->update(last_frame_ms) : -1;
+			if (new_splat != -1){
+				GLErrorScope check{gl_errors, "splat shader reload"};
+				far_field->set_program(new_splat);
+				glUseProgram(shader);
+				image_changed = true;
+			}
+		}
+		profiler.end(FrameScope::EVENTS);
+		if (scheduler && image_changed){
+			scheduler->mark_dirty();
+		}
+		//On demand frames with nothing new to draw are dropped and we go back to waiting. Streamed
+		//scenes pick up the chunks that finished reading first, they only dirty the part of the frame they cover
+		if (scheduler && !streamer && !scheduler->is_dirty()){
+			scheduler->skip_frame();
+			profiler.cancel_frame();
+			continue;
 		}
-		file_watcher.update();
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		//Draw our four billboard instances
-		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, n_billboards);
+		//Once the progressive image is complete there's nothing to draw until it changes. Only
+		//restarted progressive images are culled and sorted, the following slices are drawn from
+		//the instances sorted when the camera stopped
+		const bool draw_frame = !progressive || image_changed || !progressive->is_complete();
+		const bool cull_frame = !progressive || image_changed;
 
-		SDL_GL_SwapWindow(win);
-		GLenum err = glGetError();
-		if (err != GL_NO_ERROR){
-			std::cerr << "OpenGL Error: " << std::hex << err << std::dec << "\n";
+		//Cull the BVH against the view frustum, sort the visible instances by depth
+		//and stream them straight into this frame's region of the instance buffer
+		//Streamed scenes instead pick the chunks to page in and upload the ones that are ready
+		profiler.begin(FrameScope::CULL);
+		const Frustum frustum = billboard_frustum(camera.view_mat(), proj);
+		const ScreenSizeCull size_cull = screen_size_cull(camera.view_mat(), proj, WIN_HEIGHT, opts.min_px);
+		if (lod.is_open()){
+			//Refine until neighbouring samples are about a pixel and a half apart on screen
+			const LodSelectStats lod_stats = lod.select(camera.eye_pos(), frustum, proj, WIN_HEIGHT,
+				opts.lod_budget, 1.5f, lod_nodes);
+			streamer->update(lod_nodes);
+			lod_total.traversed += lod_stats.traversed;
+			lod_total.selected += lod_stats.selected;
+			lod_total.instances += lod_stats.instances;
+			if (trace::enabled()){
+				trace::counter("lod nodes traversed", lod_stats.traversed);
+				trace::counter("lod nodes selected", lod_stats.selected);
+				trace::counter("lod instances selected", lod_stats.instances);
+			}
 		}
+		else if (streamer){
+			streamer->update(camera.eye_pos(), camera.view_dir(), frustum);
+		}
+		else if (cull_frame){
+			BVHCullStats cull_stats;
+			bvh.cull(frustum, instance_bounds, visible_ranges, cull_isa, &cull_stats,
+				opts.min_px > 0 ? &size_cull : nullptr);
+			size_culled += cull_stats.size_culled;
+			if (trace::enabled() && opts.min_px > 0){
+				trace::counter("size culled", cull_stats.size_culled);
+			}
+			if (far_field){
+				far_field->split(visible_ranges, instance_bounds, camera.view_mat(), near_ranges);
+			}
+			if (progressive){
+				progressive->select(visible_ranges, sample_ranges);
+			}
+		}
+		profiler.end(FrameScope::CULL);
+
+		profiler.begin(FrameScope::SORT_UPLOAD);
+		int n_billboards = 0;
+		if (streamer){
+			streamer->upload();
+		}
+		else if (cull_frame){
+			//A moving progressive image only sorts and uploads the sample it draws
+			Instance *visible = static_cast<Instance*>(instance_buf.map());
+			n_billboards = depth_sorter.sort(jobs, camera.view_mat(), instances.data(),
+				far_field ? near_ranges : progressive ? sample_ranges : visible_ranges, sort_order, visible);
+			instance_buf.unmap(n_billboards * sizeof(Instance));
+			setup_instance_attribs(instance_buf.buffer(), instance_buf.offset());
+			if (far_field){
+				far_field->splat(jobs, instances.data(), camera.view_mat(), proj, color);
+				if (trace::enabled()){
+					trace::counter("far field instances", far_field->frame_stats().far);
+				}
+			}
+		}
+		else if (progressive && progressive->needs_rest()){
+			Instance *rest = progressive->map_rest();
+			progressive->unmap_rest(rest_sorter.sort(jobs, camera.view_mat(), instances.data(),
+				progressive->rest_ranges(), sort_order, rest));
+		}
+		profiler.end(FrameScope::SORT_UPLOAD);
+
+		if (scheduler && streamer){
+			//The chunk bounds only cover the billboards' world size, MIN_SIZE grows quads to clamp_px
+			//across on screen so pad the rects by that much to keep the grown quads inside them
+			const glm::mat4 proj_view = proj * billboard_view(camera.view_mat());
+			for (uint32_t c : streamer->frame_uploads()){
+				const SceneChunk &info = streamer_scene->chunk(c);
+				const glm::vec3 lower{info.bounds_min[0], info.bounds_min[1], info.bounds_min[2]};
+				const glm::vec3 upper{info.bounds_max[0], info.bounds_max[1], info.bounds_max[2]};
+				scheduler->mark_dirty(project_box(proj_view, lower, upper, WIN_WIDTH, WIN_HEIGHT, opts.clamp_px));
+			}
+			if (!scheduler->is_dirty()){
+				scheduler->skip_frame();
+				profiler.cancel_frame();
+				continue;
+			}
+		}
+
+		//The clear comes after the upload so on demand frames know which part of the frame to redraw.
+		//The progressive image is only cleared when it's restarted
+		profiler.begin(FrameScope::CLEAR);
+		if (scheduler){
+			scheduler->begin_frame();
+		}
+		if (progressive){
+			progressive->begin(image_changed);
+		}
+		else {
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		}
+		profiler.end(FrameScope::CLEAR);
+
+		profiler.begin(FrameScope::DRAW);
+		if (streamer){
+			n_billboards = static_cast<int>(streamer->draw());
+		}
+		else if (progressive){
+			if (image_changed){
+				n_billboards = static_cast<int>(progressive->draw_sample(instance_buf.buffer(), instance_buf.offset(),
+					n_billboards));
+			}
+			else if (draw_frame){
+				n_billboards = static_cast<int>(progressive->draw_slice());
+			}
+			if (draw_frame && trace::enabled()){
+				trace::counter("progressive slice", progressive->current_slice());
+			}
+			progressive->end();
+		}
+		else {
+			if (far_field){
+				far_field->draw();
+				set_blend_state(sort_order);
+				glUseProgram(shader);
+				glBindVertexArray(vao);
+			}
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, n_billboards);
+		}
+		instance_buf.fence();
+		viewing_buf.fence();
+		profiler.end(FrameScope::DRAW);
+
+		profiler.begin(FrameScope::SWAP);
+		if (scheduler){
+			scheduler->end_frame();
+			//Keep drawing until the progressive image is complete
+			if (progressive && !progressive->is_complete()){
+				scheduler->mark_dirty();
+			}
+		}
+		if (headless){
+			headless->present();
+		}
+		else {
+			SDL_GL_SwapWindow(win);
+		}
+		profiler.end(FrameScope::SWAP);
+		gl_errors.end_frame(frame);
+		profiler.current().visible = n_billboards;
+		profiler.current().upload_bytes = instance_buf.frame_stats().bytes_streamed
+			+ viewing_buf.frame_stats().bytes_streamed + (streamer ? streamer->frame_stats().upload_bytes : 0);
+		profiler.end_frame();
+		while (profiler.poll(record)){
+			if (benchmark){
+				frame_log.add(record);
+			}
+		}
+		if (win && std::chrono::high_resolution_clock::now() - title_update > std::chrono::milliseconds(500)){
+			title_update = std::chrono::high_resolution_clock::now();
+			update_title(win, profiler.latest());
+		}
+		if (frame == 0){
+			std::cout << "Startup: first frame submitted " << SDL_GetTicks() << "ms after SDL_Init\n";
+		}
+		last_frame_ms = std::chrono::duration<double, std::milli>(
+			std::chrono::high_resolution_clock::now() - frame_start).count();
+		++frame;
+		if (max_frames > 0 && frame >= max_frames){
+			quit = true;
+		}
+	}
+	glFinish();
+	if (benchmark){
+		while (profiler.poll(record, true)){
+			frame_log.add(record);
+		}
+		std::cout << "Flythrough " << opts.flythrough << ": " << flythrough.scene.instances << " instances\n";
+		frame_log.print_summary(std::cout);
+		if (!opts.bench_out.empty()){
+			frame_log.write_csv(opts.bench_out + ".csv");
+			frame_log.write_json(opts.bench_out + ".json");
+		}
+	}
+	const double elapsed_ms = std::chrono::duration<double, std::milli>(
+		std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << "Rendered " << frame << " frames in " << elapsed_ms << "ms, "
+		<< elapsed_ms / std::max(frame, 1) << "ms/frame\n";
+	const StreamStats &stream_stats = instance_buf.total_stats();
+	std::cout << "Instance streaming: " << stream_stats.bytes_streamed / std::max(instance_buf.frame_count(), 1)
+		<< " bytes/frame, blocked on " << stream_stats.blocked << " of " << instance_buf.frame_count()
+		<< " frames, " << stream_stats.fence_wait_ms << "ms total fence wait\n";
+	const DepthSortStats &sort_stats = depth_sorter.total_stats();
+	std::cout << "Depth sorting: " << sort_stats.incremental << " incremental and " << sort_stats.full
+		<< " full sorts, " << sort_stats.inversions_fixed / std::max(sort_stats.incremental, size_t{1})
+		<< " inversions fixed/incremental sort, " << sort_stats.sort_ms << "ms total sorting, "
+		<< sort_stats.saved_ms << "ms saved over full sorts\n";
+	if (opts.min_px > 0){
+		std::cout << "Size culling: " << size_culled / static_cast<double>(std::max(frame, 1))
+			<< " instances/frame smaller than " << opts.min_px << "px culled\n";
+	}
+	if (progressive){
+		const ProgressiveStats &prog_stats = progressive->total_stats();
+		std::cout << "Progressive: " << prog_stats.restarts << " frames restarted the image, " << prog_stats.accumulating
+			<< " added to it and " << prog_stats.complete << " skipped drawing it, " << prog_stats.images_completed
+			<< " images completed in " << prog_stats.frames_to_complete / static_cast<double>(
+				std::max(prog_stats.images_completed, size_t{1})) << " frames on average\n";
+	}
+	if (far_field){
+		const FarFieldStats &far_stats = far_field->total_stats();
+		const double frames = std::max(frame, 1);
+		std::cout << "Far field: " << far_stats.far / frames << " instances/frame splatted and "
+			<< far_stats.near / frames << " drawn as billboards, " << (far_stats.split_ms + far_stats.splat_ms) / frames
+			<< "ms/frame splitting and splatting, " << far_stats.resolve_ms / frames << "ms/frame resolving\n";
+	}
+	if (scheduler){
+		const SchedulerStats &sched_stats = scheduler->total_stats();
+		std::cout << "On demand: " << sched_stats.full << " full and " << sched_stats.partial << " partial redraws ("
+			<< sched_stats.partial_pixels / static_cast<double>(std::max(sched_stats.partial, size_t{1}))
+			<< " pixels on average), " << sched_stats.idle_wakeups << " wakeups with nothing to draw, waited "
+			<< sched_stats.wait_ms << "ms using " << sched_stats.wait_cpu_ms << "ms of CPU ("
+			<< 100 * sched_stats.wait_cpu_ms / std::max(sched_stats.wait_ms, 1.0) << "% of a core idle)\n";
+	}
+	if (streamer){
+		const ChunkStreamStats &chunk_stats = streamer->total_stats();
+		std::cout << "Chunk streaming: " << chunk_stats.loads << " chunks loaded (" << chunk_stats.prefetches
+			<< " prefetched), " << chunk_stats.evictions << " evicted, " << chunk_stats.deferred
+			<< " uploads deferred on the GPU, " << chunk_stats.resident << " resident, "
+			<< chunk_stats.missing / static_cast<double>(std::max(frame, 1)) << " visible chunks missing/frame, "
+			<< chunk_stats.upload_bytes / (1024.0 * 1024.0) << "MB uploaded in " << chunk_stats.upload_ms << "ms\n";
+	}
+	if (lod.is_open()){
+		const double frames = std::max(frame, 1);
+		std::cout << "LOD octree: " << lod_total.traversed / frames << " nodes traversed/frame, "
+			<< lod_total.selected / frames << " nodes selected/frame with " << lod_total.instances / frames
+			<< " instances, " << streamer->total_stats().drawn / frames << " nodes drawn/frame\n";
 	}
-	glDeleteProgram(shader);
-	glDeleteBuffers(1, &viewing_buf);
+	glDeleteTextures(1, &atlas);
 	glDeleteBuffers(1, &color_buf);
-	glDeleteBuffers(1, &pos_buf);
-	glDeleteBuffers(1, &extra_buf);
 	glDeleteVertexArrays(1, &vao);
 }
+VariantKey scene_variant(const std::vector<Instance> &instances, bool atlas){
+	VariantKey key = 0;
+	for (const Instance &i : instances){
+		if (i.size != 1){
+			key |= feature_bit(ShaderFeature::SIZE);
+		}
+		if (i.rotation != 0){
+			key |= feature_bit(ShaderFeature::ROTATION);
+		}
+	}
+	if (atlas){
+		key |= feature_bit(ShaderFeature::ATLAS) | feature_bit(ShaderFeature::ALPHA_TEST);
+	}
+	return key;
+}
+void use_shader(GLint shader){
+	glUseProgram(shader);
+	GLuint viewing_block = glGetUniformBlockIndex(shader, "Viewing");
+	glUniformBlockBinding(shader, viewing_block, 0);
+	GLuint color_block = glGetUniformBlockIndex(shader, "Colors");
+	glUniformBlockBinding(shader, color_block, 1);
+	//Variants without the atlas don't have the sampler
+	GLint atlas_unit = glGetUniformLocation(shader, "atlas");
+	if (atlas_unit != -1){
+		glUniform1i(atlas_unit, 0);
+	}
+}
+GLuint make_sprite_atlas(){
+	const int cell = 64;
+	const int dim = 2 * cell;
+	std::vector<uint8_t> pixels(dim * dim * 4, 255);
+	for (int y = 0; y < dim; ++y){
+		for (int x = 0; x < dim; ++x){
+			//Position within the sprite's cell in [-1, 1]
+			const float u = 2.f * (x % cell + 0.5f) / cell - 1.f;
+			const float v = 2.f * (y % cell + 0.5f) / cell - 1.f;
+			const float r = std::sqrt(u * u + v * v);
+			bool inside = false;
+			//Sprites 0 to 3 are a disc, a ring, a diamond and a cross
+			switch ((y / cell) * 2 + x / cell){
+				case 0: inside = r < 0.95f; break;
+				case 1: inside = r < 0.95f && r > 0.6f; break;
+				case 2: inside = std::abs(u) + std::abs(v) < 0.95f; break;
+				default: inside = std::abs(u) < 0.3f || std::abs(v) < 0.3f; break;
+			}
+			pixels[(y * dim + x) * 4 + 3] = inside ? 255 : 0;
+		}
+	}
+	GLuint tex;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, dim, dim, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return tex;
+}
+void update_viewing(StreamBuffer &viewing_buf, const Camera &camera, const glm::mat4 &proj, float clamp_px){
+	char *buf = static_cast<char*>(viewing_buf.map());
+	glm::mat4 *m = reinterpret_cast<glm::mat4*>(buf);
+	m[0] = camera.view_mat();
+	m[1] = proj;
+	glm::vec4 *v = reinterpret_cast<glm::vec4*>(buf + 2 * sizeof(glm::mat4));
+	v[0] = glm::vec4{camera.eye_pos(), 0};
+	v[1] = glm::vec4{WIN_WIDTH, WIN_HEIGHT, clamp_px, 0};
+	viewing_buf.unmap(VIEWING_BLOCK_SIZE);
+	glBindBufferRange(GL_UNIFORM_BUFFER, 0, viewing_buf.buffer(), viewing_buf.offset(), VIEWING_BLOCK_SIZE);
+}
+void set_sort_order(SortOrder order){
+	std::cout << "Sorting sprites " << sort_order_name(order) << "\n";
+	set_blend_state(order);
+}
+void set_blend_state(SortOrder order){
+	if (order == SortOrder::BACK_TO_FRONT){
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		//Disabling the depth test instead of just depth writes so glClear still clears
+		//the depth buffer for when we switch back to an opaque mode
+		glDisable(GL_DEPTH_TEST);
+	}
+	else {
+		glDisable(GL_BLEND);
+		glEnable(GL_DEPTH_TEST);
+	}
+}
+void update_title(SDL_Window *win, const FrameRecord &record){
+	std::ostringstream title;
+	title << std::fixed << std::setprecision(2) << "Fast Billboards - cpu " << record.cpu_ms << "ms, gpu "
+		<< record.gpu_ms << "ms (draw " << record.gpu_scope_ms[static_cast<size_t>(FrameScope::DRAW)]
+		<< "ms), " << record.visible << " visible";
+	SDL_SetWindowTitle(win, title.str().c_str());
+}
 bool move_camera(Camera &camera, const SDL_Event &e){
 	if (e.type == SDL_KEYDOWN){
 		switch (e.key.keysym.sym){
@@ -0,0 +1,137 @@
+#include <cassert>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <glm/glm.hpp>
+#include "instance.h"
+#include "job_system.h"
+#include "radix_sort.h"
+#include "morton.h"
+
+namespace {
+	const size_t CHUNK_SIZE = 16384;
+
+	//Spread the lower 10 bits of v out so there are two 0 bits between each
+	uint32_t expand_bits_10(uint32_t v){
+		v = (v * 0x00010001u) & 0xFF0000FFu;
+		v = (v * 0x00000101u) & 0x0F00F00Fu;
+		v = (v * 0x00000011u) & 0xC30C30C3u;
+		v = (v * 0x00000005u) & 0x49249249u;
+		return v;
+	}
+	//Spread the lower 21 bits of v out so there are two 0 bits between each
+	uint64_t expand_bits_21(uint64_t v){
+		v &= 0x1FFFFF;
+		v = (v | v << 32) & 0x1F00000000FFFFull;
+		v = (v | v << 16) & 0x1F0000FF0000FFull;
+		v = (v | v << 8) & 0x100F00F00F00F00Full;
+		v = (v | v << 4) & 0x10C30C30C30C30C3ull;
+		v = (v | v << 2) & 0x1249249249249249ull;
+		return v;
+	}
+	uint32_t quantize(float x, float scale){
+		return static_cast<uint32_t>(std::min(std::max(x * scale, 0.f), scale - 1.f));
+	}
+}
+
+uint32_t morton3_30(const glm::vec3 &p){
+	return (expand_bits_10(quantize(p.x, 1024.f)) << 2) | (expand_bits_10(quantize(p.y, 1024.f)) << 1)
+		| expand_bits_10(quantize(p.z, 1024.f));
+}
+uint64_t morton3_63(const glm::vec3 &p){
+	const float scale = static_cast<float>(1 << 21);
+	return (expand_bits_21(quantize(p.x, scale)) << 2) | (expand_bits_21(quantize(p.y, scale)) << 1)
+		| expand_bits_21(quantize(p.z, scale));
+}
+void InstanceRemap::reset(size_t n){
+	id_to_index.resize(n);
+	index_to_id.resize(n);
+	for (size_t i = 0; i < n; ++i){
+		id_to_index[i] = i;
+		index_to_id[i] = i;
+	}
+}
+void InstanceRemap::apply(const std::vector<uint32_t> &order){
+	assert(order.size() == index_to_id.size());
+	std::vector<uint32_t> prev_ids(order.size());
+	prev_ids.swap(index_to_id);
+	for (size_t i = 0; i < order.size(); ++i){
+		const uint32_t id = prev_ids[order[i]];
+		index_to_id[i] = id;
+		id_to_index[id] = i;
+	}
+}
+uint32_t InstanceRemap::index(uint32_t id) const {
+	return id_to_index[id];
+}
+uint32_t InstanceRemap::id(uint32_t index) const {
+	return index_to_id[index];
+}
+size_t InstanceRemap::size() const {
+	return index_to_id.size();
+}
+void morton_sort(JobSystem &jobs, const std::vector<Instance> &instances, MortonBits bits,
+	std::vector<uint64_t> &codes, std::vector<uint32_t> &order)
+{
+	const size_t n = instances.size();
+	assert(n <= std::numeric_limits<uint32_t>::max());
+	codes.resize(n);
+	order.resize(n);
+	if (n == 0){
+		return;
+	}
+	//Find the bounds of the instance centers to quantize them within
+	const size_t n_chunks = (n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	std::vector<glm::vec3> chunk_lower(n_chunks), chunk_upper(n_chunks);
+	jobs.parallel_for(n, CHUNK_SIZE, [&](size_t begin, size_t end, unsigned){
+		glm::vec3 lower = instances[begin].pos;
+		glm::vec3 upper = instances[begin].pos;
+		for (size_t i = begin + 1; i < end; ++i){
+			lower = glm::min(lower, instances[i].pos);
+			upper = glm::max(upper, instances[i].pos);
+		}
+		chunk_lower[begin / CHUNK_SIZE] = lower;
+		chunk_upper[begin / CHUNK_SIZE] = upper;
+	});
+	glm::vec3 lower = chunk_lower[0];
+	glm::vec3 upper = chunk_upper[0];
+	for (size_t i = 1; i < n_chunks; ++i){
+		lower = glm::min(lower, chunk_lower[i]);
+		upper = glm::max(upper, chunk_upper[i]);
+	}
+	const glm::vec3 extent = glm::max(upper - lower, glm::vec3{1e-6f});
+
+	jobs.parallel_for(n, CHUNK_SIZE, [&](size_t begin, size_t end, unsigned){
+		for (size_t i = begin; i < end; ++i){
+			const glm::vec3 p = (instances[i].pos - lower) / extent;
+			codes[i] = bits == MortonBits::BITS_30 ? morton3_30(p) : morton3_63(p);
+			order[i] = i;
+		}
+	});
+	RadixSorter<uint64_t> sorter;
+	sorter.sort(jobs, codes, order, static_cast<int>(bits));
+}
+void morton_reorder(JobSystem &jobs, std::vector<Instance> &instances, MortonBits bits,
+	InstanceRemap *remap)
+{
+	std::vector<uint64_t> codes;
+	std::vector<uint32_t> order;
+	morton_sort(jobs, instances, bits, codes, order);
+	std::vector<Instance> sorted;
+	permute_instances(jobs, instances, order, sorted);
+	instances.swap(sorted);
+	if (remap){
+		remap->apply(order);
+	}
+}
+void permute_instances(JobSystem &jobs, const std::vector<Instance> &src, const std::vector<uint32_t> &order,
+	std::vector<Instance> &dst)
+{
+	dst.resize(order.size());
+	jobs.parallel_for(order.size(), CHUNK_SIZE, [&](size_t begin, size_t end, unsigned){
+		for (size_t i = begin; i < end; ++i){
+			dst[i] = src[order[i]];
+		}
+	});
+}
+
@@ -0,0 +1,129 @@
+#include <cassert>
+#include <algorithm>
+#include <chrono>
+#include "gl_core_3_3.h"
+#include "frame_stats.h"
+#include "trace.h"
+#include "profiler.h"
+
+FrameProfiler::FrameProfiler(int latency) : ring(latency), cur(0), in_frame(false){}
+FrameProfiler::~FrameProfiler(){}
+void FrameProfiler::begin_frame(int frame){
+	assert(!in_frame);
+	PendingFrame &pf = ring[cur];
+	//If the GPU is further behind than the ring covers we have to wait on
+	//the old frame's results before we can reuse its queries
+	if (pf.pending){
+		resolve(pf, true);
+		finished.push_back(pf.record);
+		pf.pending = false;
+	}
+	pf.record = FrameRecord{};
+	pf.record.frame = frame;
+	for (GPUTimer &t : pf.scopes){
+		t.reset();
+	}
+	in_frame = true;
+	frame_start = Clock::now();
+	frame_trace_start = trace::enabled() ? trace::now_ns() : 0;
+}
+void FrameProfiler::begin(FrameScope scope){
+	assert(in_frame);
+	const size_t i = static_cast<size_t>(scope);
+	PendingFrame &pf = ring[cur];
+	pf.scopes[i].begin();
+	scope_start[i] = Clock::now();
+	scope_trace_start[i] = trace::enabled() ? trace::now_ns() : 0;
+}
+void FrameProfiler::end(FrameScope scope){
+	assert(in_frame);
+	const size_t i = static_cast<size_t>(scope);
+	PendingFrame &pf = ring[cur];
+	pf.record.cpu_scope_ms[i] = std::chrono::duration<double, std::milli>(Clock::now() - scope_start[i]).count();
+	pf.scopes[i].end();
+	if (trace::enabled()){
+		trace::record(frame_scope_name(scope), scope_trace_start[i], trace::now_ns());
+	}
+}
+FrameRecord& FrameProfiler::current(){
+	assert(in_frame);
+	return ring[cur].record;
+}
+void FrameProfiler::end_frame(){
+	assert(in_frame);
+	PendingFrame &pf = ring[cur];
+	pf.record.cpu_ms = std::chrono::duration<double, std::milli>(Clock::now() - frame_start).count();
+	if (trace::enabled()){
+		trace::record("frame", frame_trace_start, trace::now_ns());
+	}
+	pf.pending = true;
+	cur = (cur + 1) % ring.size();
+	in_frame = false;
+}
+void FrameProfiler::cancel_frame(){
+	assert(in_frame);
+	//The slot isn't pending so the next frame reuses it and its queries
+	in_frame = false;
+}
+bool FrameProfiler::resolve(PendingFrame &pf, bool wait){
+	size_t first = FRAME_SCOPE_COUNT, last_scope = 0;
+	for (size_t i = 0; i < FRAME_SCOPE_COUNT; ++i){
+		if (pf.scopes[i].is_issued()){
+			first = std::min(first, i);
+			last_scope = i;
+		}
+	}
+	if (first == FRAME_SCOPE_COUNT){
+		return true;
+	}
+	//Queries finish in order, so if the last one is done they all are
+	if (!wait && !pf.scopes[last_scope].is_available()){
+		return false;
+	}
+	GLuint64 frame_begin = 0, frame_end = 0;
+	for (size_t i = first; i <= last_scope; ++i){
+		if (!pf.scopes[i].is_issued()){
+			continue;
+		}
+		GLuint64 begin = 0, end = 0;
+		pf.scopes[i].read(begin, end);
+		pf.record.gpu_scope_ms[i] = (end - begin) / 1e6;
+		if (trace::enabled()){
+			trace::record_gpu(frame_scope_name(static_cast<FrameScope>(i)), begin, end);
+		}
+		if (i == first){
+			frame_begin = begin;
+		}
+		frame_end = end;
+	}
+	pf.record.gpu_ms = (frame_end - frame_begin) / 1e6;
+	return true;
+}
+bool FrameProfiler::poll(FrameRecord &record, bool wait){
+	if (finished.empty()){
+		//The oldest frame in flight is the next one we'd reuse
+		for (size_t i = 0; i < ring.size(); ++i){
+			PendingFrame &pf = ring[(cur + i) % ring.size()];
+			if (!pf.pending){
+				continue;
+			}
+			if (!resolve(pf, wait)){
+				return false;
+			}
+			pf.pending = false;
+			finished.push_back(pf.record);
+			break;
+		}
+	}
+	if (finished.empty()){
+		return false;
+	}
+	record = finished.front();
+	finished.pop_front();
+	last = record;
+	return true;
+}
+const FrameRecord& FrameProfiler::latest() const {
+	return last;
+}
+
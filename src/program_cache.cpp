@@ -0,0 +1,277 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <SDL.h>
+#include "gl_core_3_3.h"
+#include "util.h"
+#include "shader_preprocessor.h"
+#include "program_cache.h"
+
+namespace {
+	//Version 2 names entries by the program instead of by the sources' key
+	const uint32_t CACHE_VERSION = 2;
+
+	//Written before the program binary in each cache file
+	struct BinaryHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		uint32_t format;
+		uint32_t length;
+	};
+}
+
+ProgramCache::ProgramCache(const std::string &dir) : dir(dir), supported(false){
+	if (dir.empty() || ogl_ext_ARB_get_program_binary != ogl_LOAD_SUCCEEDED){
+		return;
+	}
+	//Some drivers expose the extension but don't support any binary formats
+	GLint n_formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+	supported = n_formats > 0;
+	driver = std::string(reinterpret_cast<const char*>(glGetString(GL_RENDERER))) + "\n"
+		+ reinterpret_cast<const char*>(glGetString(GL_VERSION));
+}
+GLint ProgramCache::load_program(const std::vector<std::tuple<GLenum, std::string>> &shaders,
+	const std::vector<std::string> &defines)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+	PendingProgram pending;
+	pending.name = program_name(shaders, defines);
+	for (const std::tuple<GLenum, std::string> &s : shaders){
+		ShaderSource src;
+		if (!preprocess_shader(std::get<1>(s), defines, src)){
+			std::cerr << "ProgramCache: Failed to read shader " << std::get<1>(s) << "\n";
+			return -1;
+		}
+		pending.sources.push_back(std::make_tuple(std::get<0>(s), src.source));
+		pending.shader_names.push_back(util::shader_name(src.files));
+	}
+	const GLint program = load(pending);
+	//Include the time spent reading the files
+	stats.last_load_ms = util::elapsed_ms(start);
+	return program;
+}
+GLint ProgramCache::load_program_sources(const std::string &name,
+	const std::vector<std::tuple<GLenum, std::string>> &sources)
+{
+	PendingProgram pending;
+	pending.name = name;
+	pending.sources = sources;
+	pending.shader_names.assign(sources.size(), "shader source");
+	return load(pending);
+}
+GLint ProgramCache::find(const std::string &name, const std::vector<std::tuple<GLenum, std::string>> &sources){
+	const auto start = std::chrono::high_resolution_clock::now();
+	stats.last_hit = false;
+	GLint program = -1;
+	if (supported){
+		const uint64_t key = cache_key(sources);
+		program = load_binary(entry_file(name), key);
+	}
+	if (program != -1){
+		++stats.hits;
+		stats.last_hit = true;
+	}
+	else {
+		++stats.misses;
+	}
+	stats.last_load_ms = util::elapsed_ms(start);
+	return program;
+}
+void ProgramCache::prepare(GLuint program) const {
+	if (supported){
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+}
+void ProgramCache::store(GLuint program, const std::string &name,
+	const std::vector<std::tuple<GLenum, std::string>> &sources)
+{
+	if (supported){
+		store_binary(program, entry_file(name), cache_key(sources));
+	}
+}
+bool ProgramCache::begin_build(PendingProgram &pending){
+	if (pending.sources.empty()){
+		return false;
+	}
+	pending.program = find(pending.name, pending.sources);
+	if (pending.program != -1){
+		return true;
+	}
+	pending.program = glCreateProgram();
+	prepare(pending.program);
+	for (const std::tuple<GLenum, std::string> &s : pending.sources){
+		GLuint shader = glCreateShader(std::get<0>(s));
+		const char *src = std::get<1>(s).c_str();
+		glShaderSource(shader, 1, &src, 0);
+		glCompileShader(shader);
+		glAttachShader(pending.program, shader);
+		pending.shaders.push_back(shader);
+	}
+	glLinkProgram(pending.program);
+	return true;
+}
+bool ProgramCache::build_done(const PendingProgram &pending){
+	if (pending.shaders.empty() || ogl_ext_KHR_parallel_shader_compile != ogl_LOAD_SUCCEEDED){
+		return true;
+	}
+	GLint done = GL_FALSE;
+	glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &done);
+	return done == GL_TRUE;
+}
+GLint ProgramCache::finish_build(PendingProgram &pending){
+	if (pending.program == -1 || pending.shaders.empty()){
+		const GLint program = pending.program;
+		pending.program = -1;
+		return program;
+	}
+	GLint status;
+	glGetProgramiv(pending.program, GL_LINK_STATUS, &status);
+	if (status == GL_FALSE){
+		std::cerr << "ProgramCache: " << pending.name << " failed to build\n";
+		for (size_t i = 0; i < pending.shaders.size(); ++i){
+			GLint compiled;
+			glGetShaderiv(pending.shaders[i], GL_COMPILE_STATUS, &compiled);
+			if (compiled == GL_FALSE){
+				std::cerr << pending.shader_names[i] << " failed to compile. Compilation log:\n";
+				util::print_info_log(pending.shaders[i], false);
+			}
+		}
+		util::print_info_log(pending.program, true);
+	}
+	for (GLuint s : pending.shaders){
+		glDetachShader(pending.program, s);
+		glDeleteShader(s);
+	}
+	pending.shaders.clear();
+	GLint program = pending.program;
+	pending.program = -1;
+	if (status == GL_FALSE){
+		glDeleteProgram(program);
+		return -1;
+	}
+	store(program, pending.name, pending.sources);
+	return program;
+}
+GLint ProgramCache::load(PendingProgram &pending){
+	const auto start = std::chrono::high_resolution_clock::now();
+	const GLint program = begin_build(pending) ? finish_build(pending) : -1;
+	stats.last_load_ms = util::elapsed_ms(start);
+	return program;
+}
+void ProgramCache::evict(const std::string &name){
+	if (supported){
+		std::remove(entry_file(name).c_str());
+	}
+}
+bool ProgramCache::enabled() const {
+	return supported;
+}
+const ProgramCacheStats& ProgramCache::cache_stats() const {
+	return stats;
+}
+std::string ProgramCache::default_dir(){
+	char *pref = SDL_GetPrefPath("Twinklebear", "vsbillboards");
+	if (!pref){
+		std::cerr << "ProgramCache: Error getting preference path: " << SDL_GetError() << "\n";
+		return "";
+	}
+	const std::string dir = pref;
+	SDL_free(pref);
+	return dir;
+}
+std::string ProgramCache::program_name(const std::vector<std::tuple<GLenum, std::string>> &shaders,
+	const std::vector<std::string> &defines)
+{
+	std::string name;
+	for (const std::tuple<GLenum, std::string> &s : shaders){
+		name += (name.empty() ? "" : ",") + std::get<1>(s);
+	}
+	for (const std::string &d : defines){
+		name += "|" + d;
+	}
+	return name;
+}
+std::string ProgramCache::entry_file(const std::string &name) const {
+	std::ostringstream str;
+	str << dir << "program_" << std::hex << std::setw(16) << std::setfill('0')
+		<< util::fnv1a(name.data(), name.size()) << ".bin";
+	return str.str();
+}
+uint64_t ProgramCache::cache_key(const std::vector<std::tuple<GLenum, std::string>> &sources) const {
+	uint64_t key = util::fnv1a(driver.data(), driver.size());
+	for (const std::tuple<GLenum, std::string> &s : sources){
+		const GLenum type = std::get<0>(s);
+		key = util::fnv1a(&type, sizeof(type), key);
+		key = util::fnv1a(std::get<1>(s).data(), std::get<1>(s).size(), key);
+	}
+	return key;
+}
+GLint ProgramCache::load_binary(const std::string &file, uint64_t key){
+	std::ifstream in(file, std::ios::binary);
+	if (!in){
+		return -1;
+	}
+	BinaryHeader header;
+	//A different key means the entry is from older sources or another driver, it's replaced once we rebuild
+	if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, "VSBP", 4) != 0
+		|| header.version != CACHE_VERSION || header.key != key)
+	{
+		return -1;
+	}
+	std::vector<char> binary(header.length);
+	if (!in.read(binary.data(), binary.size())){
+		return -1;
+	}
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.format, binary.data(), binary.size());
+	GLint status;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status == GL_FALSE){
+		//The driver can reject binaries from older versions of itself, this isn't an error
+		//so drop the stale entry and compile instead
+		++stats.rejected;
+		glDeleteProgram(program);
+		std::remove(file.c_str());
+		return -1;
+	}
+	return program;
+}
+void ProgramCache::store_binary(GLuint program, const std::string &file, uint64_t key){
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0){
+		return;
+	}
+	BinaryHeader header;
+	std::memcpy(header.magic, "VSBP", 4);
+	header.version = CACHE_VERSION;
+	header.key = key;
+	std::vector<char> binary(length);
+	GLenum format;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+	header.format = format;
+	header.length = length;
+
+	//Write to a temporary file and move it into place so we never leave a partial entry
+	const std::string tmp = file + ".tmp";
+	{
+		std::ofstream out(tmp, std::ios::binary);
+		if (!out.write(reinterpret_cast<const char*>(&header), sizeof(header))
+			|| !out.write(binary.data(), length))
+		{
+			std::cerr << "ProgramCache: Failed to write " << tmp << "\n";
+			return;
+		}
+	}
+	std::remove(file.c_str());
+	if (std::rename(tmp.c_str(), file.c_str()) != 0){
+		std::cerr << "ProgramCache: Failed to move " << tmp << " to " << file << "\n";
+		std::remove(tmp.c_str());
+	}
+}
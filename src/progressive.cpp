@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <iostream>
+#include "gl_core_3_3.h"
+#include "instance.h"
+#include "bvh.h"
+#include "progressive.h"
+
+namespace {
+	//GL 3.3 doesn't let us query the largest attribute stride, 4.4 guarantees at least 2048
+	//bytes so the slices after the sample stay under that. Scenes needing more slices draw
+	//more than the budget a slice
+	const size_t MAX_SLICES = 2048 / sizeof(Instance) + 1;
+}
+
+ProgressiveRenderer::ProgressiveRenderer(int width, int height, size_t budget, GLuint target)
+	: budget(std::max(budget, size_t{1})), target(target), n_rest(0), rest_buf(0),
+	rest_ready(false), slices(1), next_slice(0), frames_in_image(0)
+{
+	if (!image.create(width, height)){
+		std::cerr << "ProgressiveRenderer: image framebuffer is incomplete\n";
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+	glGenBuffers(1, &rest_buf);
+}
+ProgressiveRenderer::~ProgressiveRenderer(){
+	glDeleteBuffers(1, &rest_buf);
+}
+void ProgressiveRenderer::select(const std::vector<DrawRange> &visible, std::vector<DrawRange> &sample){
+	size_t n = 0;
+	for (const DrawRange &r : visible){
+		n += r.count;
+	}
+	slices = std::min(std::max((n + budget - 1) / budget, size_t{1}), MAX_SLICES);
+	sample.clear();
+	rest.clear();
+	n_rest = 0;
+	rest_ready = false;
+	//Walk the visible instances taking every slices-th one into the sample, i counts
+	//the instances seen so far so the sample stays even across the ranges
+	size_t i = 0;
+	for (const DrawRange &r : visible){
+		uint32_t first = r.first;
+		const uint32_t end = r.first + r.count;
+		while (first < end){
+			const size_t to_sample = (slices - i % slices) % slices;
+			if (to_sample >= end - first){
+				push_range(rest, first, end - first);
+				i += end - first;
+				break;
+			}
+			if (to_sample > 0){
+				push_range(rest, first, to_sample);
+			}
+			push_range(sample, first + to_sample, 1);
+			first += to_sample + 1;
+			i += to_sample + 1;
+		}
+	}
+	n_rest = n - (n + slices - 1) / slices;
+}
+bool ProgressiveRenderer::needs_rest() const {
+	return !rest_ready && slices > 1 && next_slice > 0 && next_slice < slices;
+}
+const std::vector<DrawRange>& ProgressiveRenderer::rest_ranges() const {
+	return rest;
+}
+Instance* ProgressiveRenderer::map_rest(){
+	glBindBuffer(GL_ARRAY_BUFFER, rest_buf);
+	glBufferData(GL_ARRAY_BUFFER, std::max(n_rest, size_t{1}) * sizeof(Instance), NULL, GL_STATIC_DRAW);
+	return static_cast<Instance*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, std::max(n_rest, size_t{1}) * sizeof(Instance),
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+}
+void ProgressiveRenderer::unmap_rest(size_t n){
+	glBindBuffer(GL_ARRAY_BUFFER, rest_buf);
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+	n_rest = n;
+	rest_ready = true;
+}
+bool ProgressiveRenderer::begin(bool view_changed){
+	if (view_changed){
+		++total.restarts;
+		next_slice = 0;
+		frames_in_image = 0;
+	}
+	if (!view_changed && next_slice >= slices){
+		++total.complete;
+		return false;
+	}
+	if (!view_changed){
+		++total.accumulating;
+	}
+	++frames_in_image;
+	glBindFramebuffer(GL_FRAMEBUFFER, image.framebuffer());
+	if (next_slice == 0){
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	}
+	return true;
+}
+size_t ProgressiveRenderer::draw_sample(GLuint buf, GLintptr base, size_t n){
+	next_slice = 1;
+	setup_vertex_attribs(buf, INSTANCE_LAYOUT.data(), INSTANCE_LAYOUT.size(), sizeof(Instance), base);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, n);
+	return n;
+}
+size_t ProgressiveRenderer::draw_slice(){
+	if (next_slice == 0 || next_slice >= slices || !rest_ready){
+		return 0;
+	}
+	//The rest is split over the slices after the sample
+	const size_t stride = slices - 1;
+	const size_t slice = next_slice++ - 1;
+	if (next_slice == slices){
+		++total.images_completed;
+		total.frames_to_complete += frames_in_image;
+	}
+	if (slice >= n_rest){
+		return 0;
+	}
+	const size_t count = (n_rest - slice + stride - 1) / stride;
+	setup_vertex_attribs(rest_buf, INSTANCE_LAYOUT.data(), INSTANCE_LAYOUT.size(), stride * sizeof(Instance),
+		slice * sizeof(Instance));
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+	return count;
+}
+void ProgressiveRenderer::end(){
+	image.blit(target);
+}
+bool ProgressiveRenderer::is_complete() const {
+	return next_slice >= slices;
+}
+size_t ProgressiveRenderer::current_slice() const {
+	return next_slice == 0 ? 0 : next_slice - 1;
+}
+size_t ProgressiveRenderer::slice_count() const {
+	return slices;
+}
+const ProgressiveStats& ProgressiveRenderer::total_stats() const {
+	return total;
+}
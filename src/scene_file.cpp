@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "instance.h"
+#include "cull.h"
+#include "file_view.h"
+#include "scene_file.h"
+
+namespace {
+	const char *ATTRIB_NAMES[] = {"pos", "sprite_id", "size", "color", "rotation"};
+
+	//Get the bounds of the billboards, including their quads
+	void instance_bounds(const Instance *instances, size_t n, float *bmin, float *bmax){
+		glm::vec3 lo{std::numeric_limits<float>::max()};
+		glm::vec3 hi{std::numeric_limits<float>::lowest()};
+		for (size_t i = 0; i < n; ++i){
+			const float r = instance_radius(instances[i]);
+			lo = glm::min(lo, instances[i].pos - glm::vec3{r});
+			hi = glm::max(hi, instances[i].pos + glm::vec3{r});
+		}
+		for (int i = 0; i < 3; ++i){
+			bmin[i] = lo[i];
+			bmax[i] = hi[i];
+		}
+	}
+	size_t align_up(size_t x, size_t align){
+		return (x + align - 1) / align * align;
+	}
+}
+
+SceneFile::SceneFile() : head(nullptr), attrib_list(nullptr), chunk_list(nullptr){}
+bool SceneFile::open(const std::string &file, FileAccess access){
+	close();
+	if (!view.open(file, access)){
+		return false;
+	}
+	if (view.size() < sizeof(SceneHeader)){
+		std::cerr << "SceneFile: " << file << " is too small to be a scene file\n";
+		close();
+		return false;
+	}
+	const SceneHeader *h = reinterpret_cast<const SceneHeader*>(view.data());
+	if (std::memcmp(h->magic, "VSBS", 4) != 0){
+		std::cerr << "SceneFile: " << file << " is not a scene file\n";
+		close();
+		return false;
+	}
+	if (h->version != SCENE_FILE_VERSION || h->layout != SceneLayout::INTERLEAVED || h->stride != sizeof(Instance)){
+		std::cerr << "SceneFile: " << file << " is version " << h->version << " with layout "
+			<< static_cast<uint32_t>(h->layout) << " and stride " << h->stride << ", we can only read version "
+			<< SCENE_FILE_VERSION << " interleaved scenes with stride " << sizeof(Instance) << "\n";
+		close();
+		return false;
+	}
+	const size_t tables = sizeof(SceneHeader) + h->n_attribs * sizeof(SceneAttrib)
+		+ static_cast<size_t>(h->n_chunks) * sizeof(SceneChunk);
+	if (view.size() < tables){
+		std::cerr << "SceneFile: " << file << " is truncated\n";
+		close();
+		return false;
+	}
+	const SceneAttrib *attribs = reinterpret_cast<const SceneAttrib*>(view.data() + sizeof(SceneHeader));
+	//The schema has to match our layout exactly for the data to be used in place
+	bool schema_ok = h->n_attribs == INSTANCE_LAYOUT.size();
+	for (size_t i = 0; schema_ok && i < INSTANCE_LAYOUT.size(); ++i){
+		const VertexAttrib &a = INSTANCE_LAYOUT[i];
+		schema_ok = attribs[i].index == a.index && attribs[i].components == static_cast<uint32_t>(a.components)
+			&& attribs[i].type == a.type && attribs[i].normalized == a.normalized
+			&& attribs[i].integer == static_cast<uint32_t>(a.integer) && attribs[i].offset == a.offset;
+	}
+	if (!schema_ok){
+		std::cerr << "SceneFile: " << file << " has an instance schema that doesn't match ours\n";
+		close();
+		return false;
+	}
+	const SceneChunk *chunks = reinterpret_cast<const SceneChunk*>(view.data() + sizeof(SceneHeader)
+		+ h->n_attribs * sizeof(SceneAttrib));
+	uint64_t total = 0;
+	for (size_t i = 0; i < h->n_chunks; ++i){
+		const SceneChunk &c = chunks[i];
+		if (c.compression != SceneCompression::NONE || c.offset % sizeof(float) != 0
+			|| c.bytes != c.count * sizeof(Instance) || c.offset > view.size() || c.bytes > view.size() - c.offset)
+		{
+			std::cerr << "SceneFile: " << file << " chunk " << i << " is compressed or out of bounds\n";
+			close();
+			return false;
+		}
+		//The ChunkStreamer's staging buffers and pool slots hold chunk_size instances, a
+		//bigger chunk would be read past their end
+		if (c.count > h->chunk_size){
+			std::cerr << "SceneFile: " << file << " chunk " << i << " has " << c.count
+				<< " instances but the header's chunk size is " << h->chunk_size << "\n";
+			close();
+			return false;
+		}
+		total += c.count;
+	}
+	if (total != h->n_instances){
+		std::cerr << "SceneFile: " << file << " chunks have " << total << " instances but the header says "
+			<< h->n_instances << "\n";
+		close();
+		return false;
+	}
+	head = h;
+	attrib_list = attribs;
+	chunk_list = chunks;
+	return true;
+}
+void SceneFile::close(){
+	view.close();
+	head = nullptr;
+	attrib_list = nullptr;
+	chunk_list = nullptr;
+}
+bool SceneFile::is_open() const {
+	return head != nullptr;
+}
+const SceneHeader& SceneFile::header() const {
+	return *head;
+}
+size_t SceneFile::size() const {
+	return head ? head->n_instances : 0;
+}
+size_t SceneFile::chunk_count() const {
+	return head ? head->n_chunks : 0;
+}
+const SceneChunk& SceneFile::chunk(size_t i) const {
+	return chunk_list[i];
+}
+const Instance* SceneFile::chunk_instances(size_t i) const {
+	return reinterpret_cast<const Instance*>(view.data() + chunk_list[i].offset);
+}
+void SceneFile::read_instances(std::vector<Instance> &instances) const {
+	instances.resize(size());
+	copy_instances(instances.data());
+}
+void SceneFile::copy_instances(void *dst) const {
+	char *out = static_cast<char*>(dst);
+	for (size_t i = 0; i < chunk_count(); ++i){
+		std::memcpy(out, view.data() + chunk_list[i].offset, chunk_list[i].bytes);
+		out += chunk_list[i].bytes;
+	}
+}
+void SceneFile::prefetch(size_t i){
+	view.prefetch(chunk_list[i].offset, chunk_list[i].bytes);
+}
+void SceneFile::release(size_t i){
+	view.release(chunk_list[i].offset, chunk_list[i].bytes);
+}
+
+bool write_scene_file(const std::string &file, const std::vector<Instance> &instances, uint32_t chunk_size){
+	chunk_size = std::max(chunk_size, 1u);
+	std::vector<uint32_t> counts((instances.size() + chunk_size - 1) / chunk_size, chunk_size);
+	if (!counts.empty()){
+		counts.back() = instances.size() - (counts.size() - 1) * static_cast<size_t>(chunk_size);
+	}
+	return write_scene_file(file, counts, [&](size_t i){ return instances.data() + i * chunk_size; });
+}
+bool write_scene_file(const std::string &file, const std::vector<uint32_t> &counts,
+	const std::function<const Instance*(size_t)> &chunk_data)
+{
+	SceneHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, "VSBS", 4);
+	header.version = SCENE_FILE_VERSION;
+	header.layout = SceneLayout::INTERLEAVED;
+	header.n_attribs = INSTANCE_LAYOUT.size();
+	header.n_chunks = counts.size();
+	header.stride = sizeof(Instance);
+	for (int i = 0; i < 3; ++i){
+		header.bounds_min[i] = std::numeric_limits<float>::max();
+		header.bounds_max[i] = std::numeric_limits<float>::lowest();
+	}
+
+	std::vector<SceneAttrib> attribs(INSTANCE_LAYOUT.size());
+	for (size_t i = 0; i < INSTANCE_LAYOUT.size(); ++i){
+		const VertexAttrib &a = INSTANCE_LAYOUT[i];
+		std::memset(&attribs[i], 0, sizeof(SceneAttrib));
+		std::strncpy(attribs[i].name, ATTRIB_NAMES[i], sizeof(attribs[i].name) - 1);
+		attribs[i].index = a.index;
+		attribs[i].components = a.components;
+		attribs[i].type = a.type;
+		attribs[i].normalized = a.normalized;
+		attribs[i].integer = a.integer;
+		attribs[i].offset = a.offset;
+	}
+	std::vector<SceneChunk> chunks(header.n_chunks);
+	size_t offset = align_up(sizeof(SceneHeader) + attribs.size() * sizeof(SceneAttrib)
+		+ chunks.size() * sizeof(SceneChunk), SCENE_CHUNK_ALIGN);
+	for (size_t i = 0; i < chunks.size(); ++i){
+		SceneChunk &c = chunks[i];
+		std::memset(&c, 0, sizeof(SceneChunk));
+		c.count = counts[i];
+		c.offset = offset;
+		c.bytes = c.count * sizeof(Instance);
+		c.raw_bytes = c.bytes;
+		c.compression = SceneCompression::NONE;
+		instance_bounds(chunk_data(i), c.count, c.bounds_min, c.bounds_max);
+		for (int j = 0; j < 3; ++j){
+			header.bounds_min[j] = std::min(header.bounds_min[j], c.bounds_min[j]);
+			header.bounds_max[j] = std::max(header.bounds_max[j], c.bounds_max[j]);
+		}
+		header.n_instances += c.count;
+		header.chunk_size = std::max(header.chunk_size, c.count);
+		offset = align_up(offset + c.bytes, SCENE_CHUNK_ALIGN);
+	}
+	header.chunk_size = std::max(header.chunk_size, 1u);
+
+	//Write to a temporary file and move it into place so we never leave a partial scene
+	const std::string tmp = file + ".tmp";
+	{
+		std::ofstream out(tmp, std::ios::binary);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(attribs.data()), attribs.size() * sizeof(SceneAttrib));
+		out.write(reinterpret_cast<const char*>(chunks.data()), chunks.size() * sizeof(SceneChunk));
+		const std::vector<char> padding(SCENE_CHUNK_ALIGN, 0);
+		for (size_t i = 0; i < chunks.size() && out; ++i){
+			out.write(padding.data(), chunks[i].offset - static_cast<size_t>(out.tellp()));
+			out.write(reinterpret_cast<const char*>(chunk_data(i)), chunks[i].bytes);
+		}
+		if (!out){
+			std::cerr << "write_scene_file: Failed to write " << tmp << "\n";
+			return false;
+		}
+	}
+	std::remove(file.c_str());
+	if (std::rename(tmp.c_str(), file.c_str()) != 0){
+		std::cerr << "write_scene_file: Failed to move " << tmp << " to " << file << "\n";
+		std::remove(tmp.c_str());
+		return false;
+	}
+	return true;
+}
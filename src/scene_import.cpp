@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "instance.h"
+#include "file_view.h"
+#include "scene_import.h"
+
+namespace {
+	//The instance attributes we import, in the default CSV column order
+	enum Field { X, Y, Z, SPRITE_ID, SIZE, R, G, B, A, ROTATION, N_FIELDS, IGNORED = N_FIELDS };
+	const char *FIELD_NAMES[N_FIELDS] = {"x", "y", "z", "sprite_id", "size", "r", "g", "b", "a", "rotation"};
+
+	/*
+	 * Build an instance from the fields read, the ones not present keep the default values
+	 */
+	Instance make_instance(const double *values, const bool *present, const Instance &defaults){
+		Instance inst = defaults;
+		glm::vec4 color = unpack_rgba8(defaults.color);
+		for (int f = 0; f < N_FIELDS; ++f){
+			if (!present[f]){
+				continue;
+			}
+			const float v = static_cast<float>(values[f]);
+			switch (f){
+				case X: case Y: case Z: inst.pos[f - X] = v; break;
+				case SPRITE_ID: inst.sprite_id = static_cast<GLint>(values[f]); break;
+				case SIZE: inst.size = v; break;
+				case R: case G: case B: case A: color[f - R] = v; break;
+				case ROTATION: inst.rotation = v; break;
+			}
+		}
+		inst.color = pack_rgba8(color);
+		return inst;
+	}
+	//Split the next line out of the view, stripping any \r
+	bool next_line(const char *&it, const char *end, std::string &line){
+		if (it == end){
+			return false;
+		}
+		const char *line_end = std::find(it, end, '\n');
+		line.assign(it, line_end);
+		if (!line.empty() && line.back() == '\r'){
+			line.pop_back();
+		}
+		it = line_end == end ? line_end : line_end + 1;
+		return true;
+	}
+	std::string trim(const std::string &s){
+		const size_t b = s.find_first_not_of(" \t\"");
+		const size_t e = s.find_last_not_of(" \t\"");
+		return b == std::string::npos ? "" : s.substr(b, e - b + 1);
+	}
+	bool ends_with(const std::string &s, const std::string &suffix){
+		return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	enum class PlyType { INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64, INVALID };
+	struct PlyProperty {
+		PlyType type;
+		int field;
+	};
+	PlyType ply_type(const std::string &t){
+		if (t == "char" || t == "int8") return PlyType::INT8;
+		if (t == "uchar" || t == "uint8") return PlyType::UINT8;
+		if (t == "short" || t == "int16") return PlyType::INT16;
+		if (t == "ushort" || t == "uint16") return PlyType::UINT16;
+		if (t == "int" || t == "int32") return PlyType::INT32;
+		if (t == "uint" || t == "uint32") return PlyType::UINT32;
+		if (t == "float" || t == "float32") return PlyType::FLOAT32;
+		if (t == "double" || t == "float64") return PlyType::FLOAT64;
+		return PlyType::INVALID;
+	}
+	size_t ply_type_size(PlyType t){
+		switch (t){
+			case PlyType::INT8: case PlyType::UINT8: return 1;
+			case PlyType::INT16: case PlyType::UINT16: return 2;
+			case PlyType::FLOAT64: return 8;
+			default: return 4;
+		}
+	}
+	int ply_field(const std::string &name){
+		if (name == "red") return R;
+		if (name == "green") return G;
+		if (name == "blue") return B;
+		if (name == "alpha") return A;
+		if (name == "radius" || name == "scale") return SIZE;
+		for (int f = 0; f < N_FIELDS; ++f){
+			if (name == FIELD_NAMES[f]){
+				return f;
+			}
+		}
+		return IGNORED;
+	}
+	template<typename T>
+	double read_binary(const char *p, bool swap){
+		char bytes[sizeof(T)];
+		std::memcpy(bytes, p, sizeof(T));
+		if (swap){
+			std::reverse(bytes, bytes + sizeof(T));
+		}
+		T v;
+		std::memcpy(&v, bytes, sizeof(T));
+		return static_cast<double>(v);
+	}
+	double read_ply_value(PlyType t, const char *p, bool swap){
+		switch (t){
+			case PlyType::INT8: return read_binary<int8_t>(p, swap);
+			case PlyType::UINT8: return read_binary<uint8_t>(p, swap);
+			case PlyType::INT16: return read_binary<int16_t>(p, swap);
+			case PlyType::UINT16: return read_binary<uint16_t>(p, swap);
+			case PlyType::INT32: return read_binary<int32_t>(p, swap);
+			case PlyType::UINT32: return read_binary<uint32_t>(p, swap);
+			case PlyType::FLOAT32: return read_binary<float>(p, swap);
+			default: return read_binary<double>(p, swap);
+		}
+	}
+	bool is_color(int field){
+		return field == R || field == G || field == B || field == A;
+	}
+	bool is_integer(PlyType t){
+		return t != PlyType::FLOAT32 && t != PlyType::FLOAT64;
+	}
+}
+
+bool import_csv(const std::string &file, const Instance &defaults, std::vector<Instance> &instances){
+	FileView view{file, FileAccess::SEQUENTIAL};
+	if (!view.is_open()){
+		return false;
+	}
+	const char *it = view.begin();
+	std::string line;
+	//Which field each column is, without a header they're in the default order
+	std::vector<int> columns;
+	for (int f = 0; f < N_FIELDS; ++f){
+		columns.push_back(f);
+	}
+	size_t line_num = 0;
+	const char *first = it;
+	if (next_line(it, view.end(), line)){
+		++line_num;
+		const std::string c = trim(line.substr(0, line.find(',')));
+		if (!c.empty() && !(std::isdigit(static_cast<unsigned char>(c[0])) || c[0] == '-' || c[0] == '+' || c[0] == '.')){
+			columns.clear();
+			std::istringstream names(line);
+			std::string name;
+			while (std::getline(names, name, ',')){
+				name = trim(name);
+				int field = IGNORED;
+				for (int f = 0; f < N_FIELDS; ++f){
+					if (name == FIELD_NAMES[f]){
+						field = f;
+					}
+				}
+				columns.push_back(field);
+			}
+			if (std::find(columns.begin(), columns.end(), X) == columns.end()
+				|| std::find(columns.begin(), columns.end(), Y) == columns.end()
+				|| std::find(columns.begin(), columns.end(), Z) == columns.end())
+			{
+				std::cerr << "import_csv: " << file << " header must have x, y and z columns\n";
+				return false;
+			}
+		}
+		else {
+			it = first;
+			line_num = 0;
+		}
+	}
+	instances.clear();
+	double values[N_FIELDS];
+	bool present[N_FIELDS];
+	while (next_line(it, view.end(), line)){
+		++line_num;
+		if (line.empty() || line[0] == '#'){
+			continue;
+		}
+		std::fill(present, present + N_FIELDS, false);
+		const char *c = line.c_str();
+		for (size_t col = 0; col < columns.size() && *c; ++col){
+			char *end = nullptr;
+			const double v = std::strtod(c, &end);
+			if (end == c){
+				std::cerr << "import_csv: " << file << ":" << line_num << ": bad value in column " << col + 1 << "\n";
+				return false;
+			}
+			if (columns[col] != IGNORED){
+				values[columns[col]] = v;
+				present[columns[col]] = true;
+			}
+			c = std::strchr(end, ',');
+			if (!c){
+				break;
+			}
+			++c;
+		}
+		if (!present[X] || !present[Y] || !present[Z]){
+			std::cerr << "import_csv: " << file << ":" << line_num << ": missing x, y or z\n";
+			return false;
+		}
+		instances.push_back(make_instance(values, present, defaults));
+	}
+	return true;
+}
+bool import_ply(const std::string &file, const Instance &defaults, std::vector<Instance> &instances){
+	FileView view{file, FileAccess::SEQUENTIAL};
+	if (!view.is_open()){
+		return false;
+	}
+	const char *it = view.begin();
+	std::string line;
+	if (!next_line(it, view.end(), line) || line != "ply"){
+		std::cerr << "import_ply: " << file << " is not a PLY file\n";
+		return false;
+	}
+	bool ascii = false, swap = false;
+	size_t n_vertices = 0;
+	//-1 before we've seen an element, 0 while reading the vertex element's properties
+	//and 1 once we've seen another element
+	int element = -1;
+	std::vector<PlyProperty> props;
+	bool header_done = false;
+	while (!header_done && next_line(it, view.end(), line)){
+		std::istringstream is(line);
+		std::string keyword;
+		is >> keyword;
+		if (keyword == "format"){
+			std::string format;
+			is >> format;
+			ascii = format == "ascii";
+			//We're little endian like everything else that runs this
+			swap = format == "binary_big_endian";
+			if (!ascii && !swap && format != "binary_little_endian"){
+				std::cerr << "import_ply: " << file << " has unknown format " << format << "\n";
+				return false;
+			}
+		}
+		else if (keyword == "element"){
+			std::string name;
+			is >> name;
+			if (element == -1 && name != "vertex"){
+				std::cerr << "import_ply: " << file << " must start with the vertex element\n";
+				return false;
+			}
+			if (element == -1){
+				is >> n_vertices;
+			}
+			element = element == -1 ? 0 : 1;
+		}
+		else if (keyword == "property" && element == 0){
+			std::string type, name;
+			is >> type >> name;
+			if (type == "list"){
+				std::cerr << "import_ply: " << file << " has list properties on vertices, they're not supported\n";
+				return false;
+			}
+			PlyProperty p{ply_type(type), ply_field(name)};
+			if (p.type == PlyType::INVALID){
+				std::cerr << "import_ply: " << file << " has unknown property type " << type << "\n";
+				return false;
+			}
+			props.push_back(p);
+		}
+		else if (keyword == "end_header"){
+			header_done = true;
+		}
+	}
+	if (!header_done || props.empty()){
+		std::cerr << "import_ply: " << file << " has no vertex element or the header is incomplete\n";
+		return false;
+	}
+	size_t stride = 0;
+	for (const PlyProperty &p : props){
+		stride += ply_type_size(p.type);
+	}
+	if (!ascii && static_cast<size_t>(view.end() - it) < n_vertices * stride){
+		std::cerr << "import_ply: " << file << " is truncated\n";
+		return false;
+	}
+	instances.clear();
+	instances.reserve(n_vertices);
+	double values[N_FIELDS];
+	bool present[N_FIELDS];
+	for (size_t i = 0; i < n_vertices; ++i){
+		std::fill(present, present + N_FIELDS, false);
+		if (ascii){
+			if (!next_line(it, view.end(), line)){
+				std::cerr << "import_ply: " << file << " is truncated\n";
+				return false;
+			}
+			const char *c = line.c_str();
+			for (const PlyProperty &p : props){
+				char *end = nullptr;
+				const double v = std::strtod(c, &end);
+				if (end == c){
+					std::cerr << "import_ply: " << file << ": bad value on vertex " << i << "\n";
+					return false;
+				}
+				c = end;
+				if (p.field != IGNORED){
+					values[p.field] = is_color(p.field) && is_integer(p.type) ? v / 255.0 : v;
+					present[p.field] = true;
+				}
+			}
+		}
+		else {
+			for (const PlyProperty &p : props){
+				if (p.field != IGNORED){
+					const double v = read_ply_value(p.type, it, swap);
+					values[p.field] = is_color(p.field) && is_integer(p.type) ? v / 255.0 : v;
+					present[p.field] = true;
+				}
+				it += ply_type_size(p.type);
+			}
+		}
+		if (!present[X] || !present[Y] || !present[Z]){
+			std::cerr << "import_ply: " << file << " vertices must have x, y and z\n";
+			return false;
+		}
+		instances.push_back(make_instance(values, present, defaults));
+	}
+	return true;
+}
+bool import_scene(const std::string &file, const Instance &defaults, std::vector<Instance> &instances){
+	std::string lower = file;
+	for (char &c : lower){
+		c = std::tolower(static_cast<unsigned char>(c));
+	}
+	if (ends_with(lower, ".csv")){
+		return import_csv(file, defaults, instances);
+	}
+	if (ends_with(lower, ".ply")){
+		return import_ply(file, defaults, instances);
+	}
+	std::cerr << "import_scene: Don't know how to import " << file << ", expected a .csv or .ply file\n";
+	return false;
+}
+
@@ -0,0 +1,99 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "util.h"
+#include "shader_preprocessor.h"
+
+namespace {
+	//Check if the line is the preprocessor directive, allowing whitespace before and after the #
+	bool is_directive(const std::string &line, const std::string &directive, size_t &end){
+		size_t i = line.find_first_not_of(" \t");
+		if (i == std::string::npos || line[i] != '#'){
+			return false;
+		}
+		i = line.find_first_not_of(" \t", i + 1);
+		if (i == std::string::npos || line.compare(i, directive.size(), directive) != 0){
+			return false;
+		}
+		end = i + directive.size();
+		return true;
+	}
+	bool include_file(const std::string &file, const std::string &from, size_t from_line,
+		const std::vector<std::string> &defines, ShaderSource &out)
+	{
+		//Read rather than mapped since the file may be rewritten by an editor while we hot reload it
+		const std::string src = util::read_file(file);
+		if (src.empty()){
+			std::cerr << "preprocess_shader: Failed to read " << file;
+			if (!from.empty()){
+				std::cerr << " included from " << from << ":" << from_line;
+			}
+			std::cerr << "\n";
+			return false;
+		}
+		const size_t index = out.files.size();
+		out.files.push_back(file);
+		const std::string dir = util::directory_of(file);
+		bool has_version = false;
+		std::string line;
+		const char *next = src.data();
+		const char *src_end = src.data() + src.size();
+		for (size_t n = 1; next != src_end; ++n){
+			const char *line_end = std::find(next, src_end, '\n');
+			line.assign(next, line_end);
+			next = line_end == src_end ? line_end : line_end + 1;
+			size_t end;
+			if (is_directive(line, "version", end)){
+				//Only the shader's own #version is kept, the defines go right after it
+				if (index == 0){
+					has_version = true;
+					out.source += line + "\n";
+					for (const std::string &d : defines){
+						out.source += "#define " + d + "\n";
+					}
+					out.source += "#line " + std::to_string(n + 1) + " " + std::to_string(index) + "\n";
+				}
+				else {
+					out.source += "\n";
+				}
+				continue;
+			}
+			if (!is_directive(line, "include", end)){
+				out.source += line + "\n";
+				continue;
+			}
+			const size_t open = line.find('"', end);
+			const size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+			if (close == std::string::npos){
+				std::cerr << "preprocess_shader: Malformed #include at " << file << ":" << n
+					<< ", expected #include \"file\"\n";
+				return false;
+			}
+			const std::string inc = dir + line.substr(open + 1, close - open - 1);
+			if (std::find(out.files.begin(), out.files.end(), inc) == out.files.end()){
+				out.source += "#line 1 " + std::to_string(out.files.size()) + "\n";
+				if (!include_file(inc, file, n, defines, out)){
+					return false;
+				}
+			}
+			out.source += "#line " + std::to_string(n + 1) + " " + std::to_string(index) + "\n";
+		}
+		//Without a #version the defines can go right at the start
+		if (index == 0 && !has_version && !defines.empty()){
+			std::string header;
+			for (const std::string &d : defines){
+				header += "#define " + d + "\n";
+			}
+			out.source = header + "#line 1 0\n" + out.source;
+		}
+		return true;
+	}
+}
+
+bool preprocess_shader(const std::string &file, const std::vector<std::string> &defines, ShaderSource &out){
+	out.source.clear();
+	out.files.clear();
+	return include_file(file, "", 0, defines, out);
+}
+
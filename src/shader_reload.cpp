@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "gl_core_3_3.h"
+#include "util.h"
+#include "program_cache.h"
+#include "shader_preprocessor.h"
+#include "shader_reload.h"
+
+ShaderReloader::ShaderReloader(ProgramCache &cache, const ShaderList &files,
+	const std::vector<std::string> &defines, bool async)
+	: files(files), defines(defines), cache(cache), async(async),
+	parallel(ogl_ext_KHR_parallel_shader_compile == ogl_LOAD_SUCCEEDED),
+	read_requested(false), sources_ready(false), quit(false), pending(false),
+	frames_waited(0), hitch_frames(0), reload_hitch_ms(0), reload_render_ms(0)
+{
+	//Find the included files up front so the first change to them triggers a reload
+	ShaderList read;
+	std::vector<std::string> read_names;
+	read_sources(read, read_names, dependencies);
+	if (async){
+		thread = std::thread([this](){ loader_loop(); });
+	}
+}
+ShaderReloader::~ShaderReloader(){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wakeup.notify_one();
+	if (thread.joinable()){
+		thread.join();
+	}
+	const GLint program = cache.finish_build(build);
+	if (program != -1){
+		glDeleteProgram(program);
+	}
+}
+void ShaderReloader::request(){
+	if (!pending){
+		pending = true;
+		request_time = Clock::now();
+		reload_hitch_ms = 0;
+		reload_render_ms = 0;
+	}
+	if (async){
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			read_requested = true;
+		}
+		wakeup.notify_one();
+	}
+}
+bool ShaderReloader::depends_on(const std::string &file){
+	std::lock_guard<std::mutex> lock(mutex);
+	return std::find(dependencies.begin(), dependencies.end(), file) != dependencies.end();
+}
+GLint ShaderReloader::update(double last_frame_ms){
+	//The frame we swapped the new program in on is only reported on the next update
+	if (hitch_frames > 0){
+		reload_hitch_ms = std::max(reload_hitch_ms, last_frame_ms);
+		if (--hitch_frames == 0){
+			stats.max_hitch_ms = std::max(stats.max_hitch_ms, reload_hitch_ms);
+			std::cout << "Shader reload took " << stats.last_latency_ms << "ms, "
+				<< stats.last_render_ms << "ms of it on the render thread, longest frame during it "
+				<< reload_hitch_ms << "ms\n";
+		}
+	}
+	if (!pending){
+		return -1;
+	}
+	reload_hitch_ms = std::max(reload_hitch_ms, last_frame_ms);
+	const auto start = Clock::now();
+	GLint result = -1;
+	if (!async){
+		std::vector<std::string> deps;
+		read_sources(build.sources, build.shader_names, deps);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			dependencies.swap(deps);
+		}
+		result = begin_build() ? finish_build(true) : fail_build();
+	}
+	else {
+		if (build.program == -1 && take_sources() && !begin_build()){
+			result = fail_build();
+		}
+		if (build.program != -1){
+			result = finish_build(false);
+		}
+	}
+	reload_render_ms += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	if (!pending){
+		stats.last_render_ms = reload_render_ms;
+		hitch_frames = 1;
+		//If the files changed again while we were building start on the new version
+		std::lock_guard<std::mutex> lock(mutex);
+		if (async && (read_requested || sources_ready)){
+			pending = true;
+			request_time = Clock::now();
+			reload_render_ms = 0;
+		}
+	}
+	return result;
+}
+bool ShaderReloader::busy() const {
+	return pending;
+}
+bool ShaderReloader::is_async() const {
+	return async;
+}
+bool ShaderReloader::is_parallel() const {
+	return parallel;
+}
+const ShaderReloadStats& ShaderReloader::reload_stats() const {
+	return stats;
+}
+void ShaderReloader::loader_loop(){
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!quit){
+		wakeup.wait(lock, [this](){ return quit || read_requested; });
+		if (quit){
+			break;
+		}
+		//Editors often write a file a few times when saving, any requests that come
+		//in while we're reading are picked up by reading it again
+		read_requested = false;
+		lock.unlock();
+		ShaderList read;
+		std::vector<std::string> read_names, deps;
+		read_sources(read, read_names, deps);
+		lock.lock();
+		loaded_sources.swap(read);
+		loaded_names.swap(read_names);
+		dependencies.swap(deps);
+		sources_ready = true;
+	}
+}
+void ShaderReloader::read_sources(ShaderList &read, std::vector<std::string> &read_names,
+	std::vector<std::string> &deps) const
+{
+	read.clear();
+	read_names.clear();
+	deps.clear();
+	for (const std::tuple<GLenum, std::string> &f : files){
+		ShaderSource src;
+		const bool ok = preprocess_shader(std::get<1>(f), defines, src);
+		//Keep watching the files we did find so fixing a bad include triggers a reload
+		if (src.files.empty()){
+			deps.push_back(std::get<1>(f));
+		}
+		deps.insert(deps.end(), src.files.begin(), src.files.end());
+		if (!ok){
+			read.clear();
+			continue;
+		}
+		read.push_back(std::make_tuple(std::get<0>(f), src.source));
+		read_names.push_back(util::shader_name(src.files));
+	}
+	if (read.size() != files.size()){
+		read.clear();
+	}
+}
+bool ShaderReloader::take_sources(){
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!sources_ready){
+		return false;
+	}
+	build.sources.swap(loaded_sources);
+	build.shader_names.swap(loaded_names);
+	sources_ready = false;
+	return true;
+}
+bool ShaderReloader::begin_build(){
+	build.name = ProgramCache::program_name(files, defines);
+	frames_waited = 0;
+	return cache.begin_build(build);
+}
+GLint ShaderReloader::fail_build(){
+	std::cerr << "Error reading reloaded shader, keeping the old one\n";
+	++stats.failed;
+	pending = false;
+	stats.last_latency_ms = std::chrono::duration<double, std::milli>(Clock::now() - request_time).count();
+	return -1;
+}
+GLint ShaderReloader::finish_build(bool wait){
+	if (!wait && !build.cached()){
+		if (parallel){
+			if (!ProgramCache::build_done(build)){
+				return -1;
+			}
+		}
+		//Without the extension give drivers that compile on another thread a frame
+		//to get it done before we block on the link status
+		else if (frames_waited++ < 1){
+			return -1;
+		}
+	}
+	const GLint result = cache.finish_build(build);
+	if (result == -1){
+		std::cerr << "Error compiling reloaded shader, keeping the old one\n";
+		++stats.failed;
+	}
+	else {
+		++stats.reloads;
+	}
+	pending = false;
+	stats.last_latency_ms = std::chrono::duration<double, std::milli>(Clock::now() - request_time).count();
+	return result;
+}
@@ -0,0 +1,204 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "gl_core_3_3.h"
+#include "util.h"
+#include "job_system.h"
+#include "program_cache.h"
+#include "shader_preprocessor.h"
+#include "shader_variants.h"
+
+const char* shader_feature_name(ShaderFeature f){
+	switch (f){
+		case ShaderFeature::SIZE: return "SIZE";
+		case ShaderFeature::ROTATION: return "ROTATION";
+		case ShaderFeature::ATLAS: return "ATLAS";
+		case ShaderFeature::ALPHA_TEST: return "ALPHA_TEST";
+		case ShaderFeature::MIN_SIZE: return "MIN_SIZE";
+		default: return "UNKNOWN";
+	}
+}
+std::vector<std::string> variant_defines(VariantKey key){
+	std::vector<std::string> defines;
+	for (size_t i = 0; i < SHADER_FEATURE_COUNT; ++i){
+		const ShaderFeature f = static_cast<ShaderFeature>(i);
+		if (key & feature_bit(f)){
+			defines.push_back(shader_feature_name(f));
+		}
+	}
+	return defines;
+}
+std::string variant_name(VariantKey key){
+	std::string name;
+	for (const std::string &d : variant_defines(key)){
+		name += (name.empty() ? "" : "|") + d;
+	}
+	return name.empty() ? "BASE" : name;
+}
+std::vector<VariantKey> all_variants(){
+	std::vector<VariantKey> keys;
+	for (VariantKey k = 0; k < (1u << SHADER_FEATURE_COUNT); ++k){
+		keys.push_back(k);
+	}
+	return keys;
+}
+std::vector<VariantKey> shipped_variants(){
+	const VariantKey textured = feature_bit(ShaderFeature::ATLAS) | feature_bit(ShaderFeature::ALPHA_TEST);
+	std::vector<VariantKey> keys;
+	for (VariantKey k : all_variants()){
+		if ((k & textured) == 0 || (k & textured) == textured){
+			keys.push_back(k);
+		}
+	}
+	return keys;
+}
+
+ShaderVariants::ShaderVariants(ProgramCache &cache, const ShaderList &files) : cache(cache), files(files), building_key(0){}
+ShaderVariants::~ShaderVariants(){
+	clear();
+}
+size_t ShaderVariants::build(JobSystem &jobs, const std::vector<VariantKey> &keys){
+	const auto start = std::chrono::high_resolution_clock::now();
+	std::vector<VariantKey> missing;
+	for (VariantKey k : keys){
+		if (programs.find(k) == programs.end() && std::find(missing.begin(), missing.end(), k) == missing.end()){
+			missing.push_back(k);
+		}
+	}
+	//Reading and splicing together the files for each variant is independent, so do them all at once
+	std::vector<PendingProgram> pending(missing.size());
+	jobs.parallel_for(missing.size(), 1, [&](size_t begin, size_t end, unsigned){
+		for (size_t i = begin; i < end; ++i){
+			read_sources(missing[i], pending[i]);
+		}
+	});
+
+	//Issue all the compiles and links before asking for the status of any of them,
+	//drivers that compile in the background can then build them in parallel
+	for (PendingProgram &p : pending){
+		cache.begin_build(p);
+	}
+	size_t failed = 0;
+	for (size_t i = 0; i < missing.size(); ++i){
+		if (!finish(missing[i], pending[i])){
+			++failed;
+		}
+	}
+	stats.last_build_ms = util::elapsed_ms(start);
+	return failed;
+}
+GLint ShaderVariants::get(VariantKey key){
+	auto fnd = programs.find(key);
+	if (fnd != programs.end()){
+		return fnd->second;
+	}
+	const auto start = std::chrono::high_resolution_clock::now();
+	const GLint program = cache.load_program(files, variant_defines(key));
+	stats.last_build_ms = util::elapsed_ms(start);
+	if (program == -1){
+		++stats.failed;
+		return -1;
+	}
+	if (cache.cache_stats().last_hit){
+		++stats.cache_hits;
+	}
+	else {
+		++stats.built;
+	}
+	programs[key] = program;
+	return program;
+}
+void ShaderVariants::prebuild(const std::vector<VariantKey> &keys){
+	for (VariantKey k : keys){
+		if (programs.find(k) == programs.end() && std::find(queued.begin(), queued.end(), k) == queued.end()){
+			queued.push_back(k);
+		}
+	}
+}
+void ShaderVariants::update(){
+	if (building.program != -1){
+		if (!ProgramCache::build_done(building)){
+			return;
+		}
+		finish(building_key, building);
+	}
+	//Start the next variant, it's picked up on a later frame so the driver can build it in the meantime
+	while (!queued.empty() && building.program == -1){
+		building_key = queued.front();
+		queued.pop_front();
+		if (programs.find(building_key) != programs.end()){
+			continue;
+		}
+		building = PendingProgram{};
+		read_sources(building_key, building);
+		if (!cache.begin_build(building)){
+			std::cerr << "ShaderVariants: Failed to read the shaders for variant " << variant_name(building_key) << "\n";
+			++stats.failed;
+		}
+	}
+}
+size_t ShaderVariants::queued_count() const {
+	return queued.size() + (building.program != -1 ? 1 : 0);
+}
+void ShaderVariants::replace(VariantKey key, GLint program){
+	clear();
+	programs[key] = program;
+}
+void ShaderVariants::clear(){
+	//A variant being built in the background was built from the old sources, queue it again
+	if (building.program != -1){
+		const GLint old = cache.finish_build(building);
+		if (old != -1){
+			glDeleteProgram(old);
+		}
+		queued.push_front(building_key);
+	}
+	for (const auto &p : programs){
+		glDeleteProgram(p.second);
+	}
+	programs.clear();
+}
+size_t ShaderVariants::size() const {
+	return programs.size();
+}
+const ShaderVariantStats& ShaderVariants::variant_stats() const {
+	return stats;
+}
+void ShaderVariants::read_sources(VariantKey key, PendingProgram &pending) const {
+	const std::vector<std::string> defines = variant_defines(key);
+	pending.name = ProgramCache::program_name(files, defines);
+	for (const std::tuple<GLenum, std::string> &f : files){
+		ShaderSource src;
+		if (!preprocess_shader(std::get<1>(f), defines, src)){
+			pending.sources.clear();
+			return;
+		}
+		pending.sources.push_back(std::make_tuple(std::get<0>(f), src.source));
+		pending.shader_names.push_back(util::shader_name(src.files));
+	}
+}
+bool ShaderVariants::finish(VariantKey key, PendingProgram &pending){
+	const bool cached = pending.cached();
+	const GLint program = cache.finish_build(pending);
+	if (program == -1){
+		std::cerr << "ShaderVariants: Variant " << variant_name(key) << " failed to build\n";
+		++stats.failed;
+		return false;
+	}
+	//The variant may have been built by get while this one was in flight
+	if (programs.find(key) != programs.end()){
+		glDeleteProgram(program);
+		return true;
+	}
+	programs[key] = program;
+	if (cached){
+		++stats.cache_hits;
+	}
+	else {
+		++stats.built;
+	}
+	return true;
+}
+
@@ -0,0 +1,113 @@
+#include <cassert>
+#include <chrono>
+#include <vector>
+#include "gl_core_3_3.h"
+#include "stream_buffer.h"
+
+StreamBuffer::StreamBuffer(GLenum target, size_t region_size, int n_regions, size_t alignment,
+	bool allow_persistent)
+	: target(target), buf(0), region_size(((region_size + alignment - 1) / alignment) * alignment),
+	cur_region(n_regions - 1), fences(n_regions, nullptr), persistent(nullptr), mapped(false), frames(0)
+{
+	assert(n_regions > 0);
+	const GLsizeiptr size = this->region_size * n_regions;
+	glGenBuffers(1, &buf);
+	glBindBuffer(target, buf);
+	if (allow_persistent && ogl_ext_ARB_buffer_storage == ogl_LOAD_SUCCEEDED){
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(target, size, NULL, flags);
+		persistent = static_cast<char*>(glMapBufferRange(target, 0, size, flags));
+	}
+	else {
+		glBufferData(target, size, NULL, GL_STREAM_DRAW);
+	}
+}
+StreamBuffer::~StreamBuffer(){
+	for (GLsync f : fences){
+		if (f){
+			glDeleteSync(f);
+		}
+	}
+	if (persistent || mapped){
+		glBindBuffer(target, buf);
+		glUnmapBuffer(target);
+	}
+	glDeleteBuffers(1, &buf);
+}
+void* StreamBuffer::map(){
+	assert(!mapped);
+	cur_region = (cur_region + 1) % fences.size();
+	GLsync &f = fences[cur_region];
+	if (f){
+		//Poll the fence first so we only count it as blocking if we really had to wait
+		GLenum status = glClientWaitSync(f, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED){
+			++frame.blocked;
+			auto start = std::chrono::high_resolution_clock::now();
+			GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+			do {
+				status = glClientWaitSync(f, flags, 1000000);
+				flags = 0;
+			} while (status == GL_TIMEOUT_EXPIRED);
+			frame.fence_wait_ms += std::chrono::duration<double, std::milli>(
+				std::chrono::high_resolution_clock::now() - start).count();
+		}
+		glDeleteSync(f);
+		f = nullptr;
+	}
+	mapped = true;
+	if (persistent){
+		return persistent + offset();
+	}
+	glBindBuffer(target, buf);
+	return glMapBufferRange(target, offset(), region_size,
+		GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+}
+void StreamBuffer::unmap(size_t bytes){
+	assert(mapped && bytes <= region_size);
+	mapped = false;
+	frame.bytes_streamed += bytes;
+	if (!persistent){
+		glBindBuffer(target, buf);
+		glUnmapBuffer(target);
+	}
+}
+void StreamBuffer::fence(){
+	assert(!mapped);
+	//If the region is still in use from an earlier frame replace its fence with
+	//a new one covering the commands issued since then
+	GLsync &f = fences[cur_region];
+	if (f){
+		glDeleteSync(f);
+	}
+	f = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	last_frame = frame;
+	total.bytes_streamed += frame.bytes_streamed;
+	total.fence_wait_ms += frame.fence_wait_ms;
+	total.blocked += frame.blocked;
+	frame = StreamStats{};
+	++frames;
+}
+GLuint StreamBuffer::buffer() const {
+	return buf;
+}
+GLintptr StreamBuffer::offset() const {
+	return cur_region * region_size;
+}
+size_t StreamBuffer::capacity() const {
+	return region_size;
+}
+bool StreamBuffer::is_persistent() const {
+	return persistent != nullptr;
+}
+const StreamStats& StreamBuffer::frame_stats() const {
+	return last_frame;
+}
+const StreamStats& StreamBuffer::total_stats() const {
+	return total;
+}
+int StreamBuffer::frame_count() const {
+	return frames;
+}
+
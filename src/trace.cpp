@@ -0,0 +1,151 @@
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "gl_core_3_3.h"
+#include "trace.h"
+
+namespace {
+	struct Event {
+		const char *name;
+		uint64_t begin, end;
+		//Counters are recorded at begin with this value and no end
+		bool counter;
+		int64_t value;
+	};
+	/*
+	 * A block of events, only the owning thread writes to it and it publishes
+	 * new events and chunks with release stores so the writer can read them
+	 */
+	struct Chunk {
+		static const size_t SIZE = 4096;
+		Event events[SIZE];
+		std::atomic<size_t> count;
+		std::atomic<Chunk*> next;
+
+		Chunk() : count(0), next(nullptr){}
+	};
+	struct ThreadBuffer {
+		int tid;
+		std::string name;
+		Chunk *head, *tail;
+
+		ThreadBuffer(int tid, const std::string &name) : tid(tid), name(name), head(new Chunk), tail(head){}
+		~ThreadBuffer(){
+			while (head){
+				Chunk *next = head->next.load();
+				delete head;
+				head = next;
+			}
+		}
+		void push(const Event &e){
+			size_t n = tail->count.load(std::memory_order_relaxed);
+			if (n == Chunk::SIZE){
+				Chunk *c = new Chunk;
+				tail->next.store(c, std::memory_order_release);
+				tail = c;
+				n = 0;
+			}
+			tail->events[n] = e;
+			tail->count.store(n + 1, std::memory_order_release);
+		}
+	};
+
+	typedef std::chrono::steady_clock Clock;
+	std::atomic<bool> tracing(false);
+	Clock::time_point start;
+	//Offset to add to GPU timestamps to move them on to our clock
+	int64_t gpu_offset = 0;
+	//Buffers are never freed while we're running since exited threads' events are still needed
+	std::mutex registry_mutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+	ThreadBuffer *gpu_buffer = nullptr;
+	thread_local ThreadBuffer *local_buffer = nullptr;
+
+	ThreadBuffer* register_buffer(const std::string &name){
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		buffers.emplace_back(new ThreadBuffer(buffers.size(), name));
+		return buffers.back().get();
+	}
+	ThreadBuffer* thread_buffer(){
+		if (!local_buffer){
+			local_buffer = register_buffer("thread");
+		}
+		return local_buffer;
+	}
+}
+
+void trace::enable(){
+	start = Clock::now();
+	tracing.store(true, std::memory_order_release);
+}
+bool trace::enabled(){
+	return tracing.load(std::memory_order_relaxed);
+}
+uint64_t trace::now_ns(){
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+void trace::set_thread_name(const std::string &name){
+	ThreadBuffer *buf = thread_buffer();
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	buf->name = name;
+}
+void trace::record(const char *name, uint64_t begin_ns, uint64_t end_ns){
+	thread_buffer()->push(Event{name, begin_ns, end_ns, false, 0});
+}
+void trace::counter(const char *name, int64_t value){
+	const uint64_t now = now_ns();
+	thread_buffer()->push(Event{name, now, now, true, value});
+}
+void trace::record_gpu(const char *name, uint64_t gpu_begin_ns, uint64_t gpu_end_ns){
+	if (!gpu_buffer){
+		gpu_buffer = register_buffer("GPU");
+	}
+	gpu_buffer->push(Event{name, gpu_begin_ns + gpu_offset, gpu_end_ns + gpu_offset, false, 0});
+}
+void trace::calibrate_gpu(){
+	//Finish any queued work so the timestamp we get is for now and not when the
+	//GPU gets through the work in front of it
+	glFinish();
+	GLint64 gpu_now = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+	gpu_offset = static_cast<int64_t>(now_ns()) - gpu_now;
+}
+bool trace::write(const std::string &file){
+	std::ofstream fout{file};
+	if (!fout){
+		std::cerr << "Failed to open trace file " << file << "\n";
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	//Trace timestamps are in microseconds, keep the nanoseconds
+	fout << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	bool first = true;
+	for (const std::unique_ptr<ThreadBuffer> &buf : buffers){
+		fout << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+			<< buf->tid << ", \"args\": {\"name\": \"" << buf->name << "\"}}";
+		first = false;
+		for (Chunk *c = buf->head; c; c = c->next.load(std::memory_order_acquire)){
+			const size_t n = c->count.load(std::memory_order_acquire);
+			for (size_t i = 0; i < n; ++i){
+				const Event &e = c->events[i];
+				if (e.counter){
+					fout << ",\n{\"name\": \"" << e.name << "\", \"ph\": \"C\", \"pid\": 1, \"tid\": " << buf->tid
+						<< ", \"ts\": " << e.begin / 1000.0 << ", \"args\": {\"value\": " << e.value << "}}";
+				}
+				else {
+					fout << ",\n{\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buf->tid
+						<< ", \"ts\": " << e.begin / 1000.0 << ", \"dur\": " << (e.end - e.begin) / 1000.0 << "}";
+				}
+			}
+		}
+	}
+	fout << "\n]}\n";
+	return true;
+}
+
@@ -10,7 +10,30 @@
 #include <SDL.h>
 #include "gl_core_3_3.h"
 #include "util.h"
+#include "gl_debug_log.h"
+#include "shader_preprocessor.h"
+#include "file_view.h"
 
+uint64_t util::fnv1a(const void *data, size_t len, uint64_t hash){
+	const unsigned char *bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < len; ++i){
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+double util::elapsed_ms(const std::chrono::high_resolution_clock::time_point &start){
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+float util::box_distance(const glm::vec3 &p, const float *lower, const float *upper){
+	const glm::vec3 lo{lower[0], lower[1], lower[2]};
+	const glm::vec3 hi{upper[0], upper[1], upper[2]};
+	return glm::length(glm::max(glm::max(lo - p, p - hi), glm::vec3{0}));
+}
+std::string util::directory_of(const std::string &file){
+	const size_t sep = file.find_last_of("/\\");
+	return sep == std::string::npos ? "" : file.substr(0, sep + 1);
+}
 std::string util::get_resource_path(const std::string &sub_dir){
 #ifdef _WIN32
 	const char PATH_SEP = '\\';
@@ -38,17 +61,28 @@ std::string util::get_resource_path(const std::string &sub_dir){
 	return base_res + sub_dir + PATH_SEP;
 }
 std::string util::read_file(const std::string &fName){
-	std::ifstream file(fName);
+	std::ifstream file(fName, std::ios::binary | std::ios::ate);
 	if (!file.is_open()){
 		std::cout << "Failed to open file: " << fName << std::endl;
 		return "";
 	}
-	return std::string((std::istreambuf_iterator<char>(file)),
-		std::istreambuf_iterator<char>());
+	//The file may be shrinking as we read it if it's being saved, so keep what we actually got
+	const std::streamoff size = file.tellg();
+	std::string data(size > 0 ? static_cast<size_t>(size) : 0, '\0');
+	file.seekg(0);
+	file.read(&data[0], data.size());
+	data.resize(static_cast<size_t>(file.gcount()));
+	return data;
 }
-GLint util::load_shader(GLenum type, const std::string &file){
+GLint util::load_shader(GLenum type, const std::string &file, const std::vector<std::string> &defines){
+	ShaderSource src;
+	if (!preprocess_shader(file, defines, src)){
+		return -1;
+	}
+	return compile_shader(type, src.source, shader_name(src.files));
+}
+GLint util::compile_shader(GLenum type, const std::string &src, const std::string &name){
 	GLuint shader = glCreateShader(type);
-	std::string src = read_file(file);
 	const char *csrc = src.c_str();
 	glShaderSource(shader, 1, &csrc, 0);
 	glCompileShader(shader);
@@ -70,7 +104,7 @@ GLint util::load_shader(GLenum type, const std::string &file){
 		default:
 			std::cerr << "Other shader type: ";
 		}
-		std::cerr << file << " failed to compile. Compilation log:\n";
+		std::cerr << name << " failed to compile. Compilation log:\n";
 		GLint len;
 		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &len);
 		char *log = new char[len];
@@ -82,10 +116,12 @@ GLint util::load_shader(GLenum type, const std::string &file){
 	}
 	return shader;
 }
-GLint util::load_program(const std::vector<std::tuple<GLenum, std::string>> &shaders){
+GLint util::load_program(const std::vector<std::tuple<GLenum, std::string>> &shaders,
+	const std::vector<std::string> &defines)
+{
 	std::vector<GLuint> glshaders;
 	for (const std::tuple<GLenum, std::string> &s : shaders){
-		GLint h = load_shader(std::get<0>(s), std::get<1>(s));
+		GLint h = load_shader(std::get<0>(s), std::get<1>(s), defines);
 		if (h == -1){
 			std::cerr << "load_program: A required shader failed to compile, aborting\n";
 			for (GLuint g : glshaders){
@@ -96,7 +132,14 @@ GLint util::load_program(const std::vector<std::tuple<GLenum, std::string>> &sha
 		glshaders.push_back(h);
 	}
 	GLuint program = glCreateProgram();
-	for (GLuint s : glshaders){
+	if (!link_program(program, glshaders)){
+		glDeleteProgram(program);
+		return -1;
+	}
+	return program;
+}
+bool util::link_program(GLuint program, const std::vector<GLuint> &shaders){
+	for (GLuint s : shaders){
 		glAttachShader(program, s);
 	}
 	glLinkProgram(program);
@@ -111,18 +154,90 @@ GLint util::load_program(const std::vector<std::tuple<GLenum, std::string>> &sha
 		std::cerr << log << "\n";
 		delete[] log;
 	}
-	for (GLuint s : glshaders){
+	for (GLuint s : shaders){
 		glDetachShader(program, s);
 		glDeleteShader(s);
 	}
-	if (status == GL_FALSE){
-		glDeleteProgram(program);
-		return -1;
+	return status == GL_TRUE;
+}
+void util::setup_shader_compiler(){
+	if (ogl_ext_KHR_parallel_shader_compile == ogl_LOAD_SUCCEEDED){
+		//Let the driver pick how many threads to compile with
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
 	}
-	return program;
+}
+void util::print_info_log(GLuint obj, bool is_program){
+	GLint len = 0;
+	if (is_program){
+		glGetProgramiv(obj, GL_INFO_LOG_LENGTH, &len);
+	}
+	else {
+		glGetShaderiv(obj, GL_INFO_LOG_LENGTH, &len);
+	}
+	if (len <= 1){
+		return;
+	}
+	std::vector<char> log(len);
+	if (is_program){
+		glGetProgramInfoLog(obj, len, 0, log.data());
+	}
+	else {
+		glGetShaderInfoLog(obj, len, 0, log.data());
+	}
+	std::cerr << log.data() << "\n";
+}
+std::string util::shader_name(const std::vector<std::string> &files){
+	if (files.size() < 2){
+		return files.empty() ? "shader source" : files.front();
+	}
+	std::string name = files.front() + " (";
+	for (size_t i = 0; i < files.size(); ++i){
+		name += (i == 0 ? "" : ", ") + std::to_string(i) + ": " + files[i];
+	}
+	return name + ")";
+}
+util::OffscreenFramebuffer::OffscreenFramebuffer() : fbo(0), color_rb(0), depth_rb(0), width(0), height(0){}
+util::OffscreenFramebuffer::~OffscreenFramebuffer(){
+	destroy();
+}
+bool util::OffscreenFramebuffer::create(int w, int h){
+	destroy();
+	width = w;
+	height = h;
+	glGenRenderbuffers(1, &color_rb);
+	glBindRenderbuffer(GL_RENDERBUFFER, color_rb);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &depth_rb);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth_rb);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_rb);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_rb);
+	return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+void util::OffscreenFramebuffer::destroy(){
+	if (fbo){
+		glDeleteFramebuffers(1, &fbo);
+		glDeleteRenderbuffers(1, &color_rb);
+		glDeleteRenderbuffers(1, &depth_rb);
+		fbo = color_rb = depth_rb = 0;
+	}
+}
+void util::OffscreenFramebuffer::blit(GLuint target) const {
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+}
+GLuint util::OffscreenFramebuffer::framebuffer() const {
+	return fbo;
 }
 GLuint util::load_texture(const std::string &file){
-	SDL_Surface *surf = SDL_LoadBMP(file.c_str());
+	//Let SDL decode straight out of the mapped file instead of reading it again
+	FileView view{file};
+	SDL_Surface *surf = view.is_open() && view.size() > 0
+		? SDL_LoadBMP_RW(SDL_RWFromConstMem(view.data(), static_cast<int>(view.size())), 1) : nullptr;
 	//TODO: Throw an error?
 	if (!surf){
 		std::cout << "Failed to load bmp: " << file
@@ -197,60 +312,11 @@ void util::gldebug_callback(GLenum src, GLenum type, GLuint id, GLenum severity,
 	GLsizei len, const GLchar *msg, const GLvoid *user)
 #endif
 {
-	//Print a time stamp for the message
-	float sec = SDL_GetTicks() / 1000.f;
-	int min = static_cast<int>(sec / 60.f);
-	sec -= sec / 60.f;
-	std::cerr << "[" << min << ":"
-		<< std::setprecision(3) << sec << "] OpenGL Debug -";
-	switch (severity){
-	case GL_DEBUG_SEVERITY_HIGH_ARB:
-		std::cerr << " High severity";
-		break;
-	case GL_DEBUG_SEVERITY_MEDIUM_ARB:
-		std::cerr << " Medium severity";
-		break;
-	case GL_DEBUG_SEVERITY_LOW_ARB:
-		std::cerr << " Low severity";
-	}
-	switch (src){
-	case GL_DEBUG_SOURCE_API_ARB:
-		std::cerr << " API";
-		break;
-	case GL_DEBUG_SOURCE_WINDOW_SYSTEM_ARB:
-		std::cerr << " Window system";
-		break;
-	case GL_DEBUG_SOURCE_SHADER_COMPILER_ARB:
-		std::cerr << " Shader compiler";
-		break;
-	case GL_DEBUG_SOURCE_THIRD_PARTY_ARB:
-		std::cerr << " Third party";
-		break;
-	case GL_DEBUG_SOURCE_APPLICATION_ARB:
-		std::cerr << " Application";
-		break;
-	default:
-		std::cerr << " Other";
-	}
-	switch (type){
-	case GL_DEBUG_TYPE_ERROR_ARB:
-		std::cerr << " Error";
-		break;
-	case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR_ARB:
-		std::cerr << " Deprecated behavior";
-		break;
-	case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR_ARB:
-		std::cerr << " Undefined behavior";
-		break;
-	case GL_DEBUG_TYPE_PORTABILITY_ARB:
-		std::cerr << " Portability";
-		break;
-	case GL_DEBUG_TYPE_PERFORMANCE_ARB:
-		std::cerr << " Performance";
-		break;
-	default:
-		std::cerr << " Other";
+	//If we were given a log queue the message for its thread to print, otherwise print it now
+	if (user){
+		static_cast<GLDebugLog*>(const_cast<GLvoid*>(user))->push(src, type, id, severity, len, msg);
+		return;
 	}
-	std::cerr << ":\n\t" << msg << "\n";
+	write_gldebug_record(std::cerr, make_gldebug_record(SDL_GetTicks(), src, type, id, severity, len, msg));
 }
 
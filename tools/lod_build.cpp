@@ -0,0 +1,57 @@
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include "job_system.h"
+#include "lod_octree.h"
+
+/*
+ * Build a level of detail octree from the billboards in a scene file, see lod_octree.h.
+ * Writes <out.vsbs> with the nodes' billboards and <out.vsbs>.lod with the hierarchy.
+ * --grid sets the resolution of the grid each node samples on, --leaf the most
+ * billboards a leaf can hold, --cell about how many billboards are built in memory
+ * at once per thread and --tmp where the temporary files go
+ * usage: lod_build <in.vsbs> <out.vsbs> [--grid N] [--leaf N] [--cell N] [--tmp dir]
+ */
+int main(int argc, char **argv){
+	std::string in, out;
+	LodBuildOptions options;
+	for (int i = 1; i < argc; ++i){
+		if (std::strcmp(argv[i], "--grid") == 0 && i + 1 < argc){
+			options.sample_grid = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--leaf") == 0 && i + 1 < argc){
+			options.max_leaf = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--cell") == 0 && i + 1 < argc){
+			options.cell_instances = std::atoll(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--tmp") == 0 && i + 1 < argc){
+			options.temp_dir = argv[++i];
+		}
+		else if (in.empty()){
+			in = argv[i];
+		}
+		else {
+			out = argv[i];
+		}
+	}
+	if (in.empty() || out.empty()){
+		std::cerr << "usage: lod_build <in.vsbs> <out.vsbs> [--grid N] [--leaf N] [--cell N] [--tmp dir]\n";
+		return 1;
+	}
+	const auto start = std::chrono::high_resolution_clock::now();
+	JobSystem jobs;
+	LodBuildStats stats;
+	if (!build_lod_octree(jobs, in, out, options, &stats)){
+		return 1;
+	}
+	const double elapsed = std::chrono::duration<double, std::milli>(
+		std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << "Built an octree of " << stats.instances << " instances with " << stats.nodes << " nodes "
+		<< stats.max_depth + 1 << " levels deep from " << stats.cells << " cells on " << jobs.size()
+		<< " threads in " << elapsed << "ms (count " << stats.count_ms << "ms, distribute " << stats.distribute_ms
+		<< "ms, index " << stats.index_ms << "ms, write " << stats.write_ms << "ms)\n";
+	return 0;
+}
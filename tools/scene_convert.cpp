@@ -0,0 +1,83 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include "instance.h"
+#include "flythrough.h"
+#include "scene_import.h"
+#include "scene_file.h"
+#include "job_system.h"
+#include "morton.h"
+
+/*
+ * Convert billboards in a CSV or PLY file to a binary scene file, see
+ * scene_import.h for the columns and properties read. Passing a flythrough
+ * file instead writes out the scene it generates, which is handy for making
+ * large test scenes. --size and --sprite set the size and sprite id of
+ * billboards that don't have their own, --chunk sets the instances per chunk.
+ * The instances are written in Morton order so each chunk covers a compact
+ * region of the scene, which keeps the chunk bounds tight for streaming
+ * usage: scene_convert <in.csv|in.ply|--flythrough file> <out.vsbs> [--size S] [--sprite N] [--chunk N]
+ */
+int main(int argc, char **argv){
+	std::string in, out, flythrough_file;
+	Instance defaults{glm::vec3{0}, 0, 1, pack_rgba8(glm::vec4{1}), 0};
+	uint32_t chunk_size = 65536;
+	for (int i = 1; i < argc; ++i){
+		if (std::strcmp(argv[i], "--flythrough") == 0 && i + 1 < argc){
+			flythrough_file = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc){
+			defaults.size = std::atof(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--sprite") == 0 && i + 1 < argc){
+			defaults.sprite_id = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--chunk") == 0 && i + 1 < argc){
+			const int n = std::atoi(argv[++i]);
+			if (n <= 0){
+				std::cerr << "--chunk must be at least 1 instance, got " << argv[i] << "\n";
+				return 1;
+			}
+			chunk_size = n;
+		}
+		else if (in.empty() && flythrough_file.empty()){
+			in = argv[i];
+		}
+		else {
+			out = argv[i];
+		}
+	}
+	if ((in.empty() && flythrough_file.empty()) || out.empty()){
+		std::cerr << "usage: scene_convert <in.csv|in.ply|--flythrough file> <out.vsbs> [--size S] [--sprite N]"
+			<< " [--chunk N]\n";
+		return 1;
+	}
+	const auto start = std::chrono::high_resolution_clock::now();
+	std::vector<Instance> instances;
+	if (!flythrough_file.empty()){
+		Flythrough flythrough;
+		if (!load_flythrough(flythrough_file, flythrough)){
+			return 1;
+		}
+		generate_scene(flythrough.scene, instances);
+	}
+	else if (!import_scene(in, defaults, instances)){
+		return 1;
+	}
+	{
+		JobSystem jobs;
+		morton_reorder(jobs, instances, MortonBits::BITS_63);
+	}
+	if (!write_scene_file(out, instances, chunk_size)){
+		return 1;
+	}
+	const double elapsed = std::chrono::duration<double, std::milli>(
+		std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << "Wrote " << instances.size() << " instances in " << (instances.size() + chunk_size - 1) / chunk_size
+		<< " chunks to " << out << " in " << elapsed << "ms\n";
+	return 0;
+}
+